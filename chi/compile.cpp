@@ -1,18 +1,27 @@
 #include <llvm-c/BitWriter.h>
 #include <llvm-c/Transforms/PassBuilder.h>
 
+#include <algorithm>
 #include <boost/program_options.hpp>
+#include <chi/CompileSession.hpp>
 #include <chi/Context.hpp>
 #include <chi/GraphFunction.hpp>
 #include <chi/GraphModule.hpp>
 #include <chi/LangModule.hpp>
+#include <chi/Multiversion.hpp>
+#include <chi/NameMangler.hpp>
+#include <chi/NativeCodegen.hpp>
 #include <chi/NodeType.hpp>
+#include <chi/Profile.hpp>
 #include <chi/Support/Result.hpp>
 #include <chi/Support/json.hpp>
+#include <chi/Target.hpp>
+#include <chi/ThinLink.hpp>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace chi;
@@ -26,15 +35,25 @@ int compile(const std::vector<std::string>& opts) {
 	// clang-format off
 	compile_opts.add_options()
 		("input-file", po::value<std::string>(), "Input file")
-		("output,o", po::value<std::string>()->default_value("-"), "Output file, - for stdout (the default)")
+		("output,o", po::value<std::string>()->default_value("-"), "Output file, - for stdout (the default). A .o file is written as a native object")
 		(",c", "Output a binary file (llvm bitcode)")
 		(",S", "Output a textual file (llvm assembly)")
+		("executable,e", "Output a native executable, linked with the runtime")
 		("no-dependencies,D", "Don't link the dependencies into the module")
 		("fresh,f", "Don't use the cache")
+		("lazy,l", "Only load the parts of cached dependencies that are reachable from the module")
 		("machine-readable,m", "Create machine readable error messages (in JSON)")
 		("no-debug,n", "Strip debug information from the module")
+		("stats", "Print how many modules were compiled and how many were reused")
 		("help,h", "Show this help page")
 		("optimization,O", po::value<int>()->default_value(2), "The optimization level. Either 0, 1, 2, or 3")
+		("jobs,j", po::value<unsigned>()->default_value(std::max(1u, std::thread::hardware_concurrency())), "The number of modules to compile at once, and of partitions to generate native code for at once")
+		("thin-link", "Optimize each module on its own, --jobs at once, importing the small functions it uses from the others, then link them instead of optimizing the linked module")
+		("profile-generate", po::value<std::string>()->implicit_value("default.chiprofraw"), "Instrument the module to write a profile to the given file (default.chiprofraw by default) when it exits")
+		("profile-use", po::value<std::string>(), "Optimize with a profile from --profile-generate, raw or merged with chi profile merge")
+		("target-cpu", po::value<std::string>()->default_value(""), "The CPU to generate code for, like skylake, or native for this one. A generic CPU by default")
+		("target-features", po::value<std::string>()->default_value(""), "CPU features to turn on or off, like +avx2,-fma, or native for all of this CPU's")
+		("multiversion", po::value<std::string>(), "Give the graph functions a version for each of a comma separated list of instruction sets (sse4.2, avx2, avx512) and pick one when they're called from what the CPU supports")
 		;
 	// clang-format on
 
@@ -64,6 +83,13 @@ int compile(const std::vector<std::string>& opts) {
 
 	Context c{fs::current_path()};
 
+	auto jobs = vm["jobs"].as<unsigned>();
+	if (jobs == 0) {
+		std::cerr << "chi compile: error: --jobs must be at least 1" << std::endl;
+		return 1;
+	}
+	c.setCompileThreadCount(jobs);
+
 	// add .chimod suffix if it doesn't have it
 	if (infile.extension().empty()) { infile.replace_extension(".chimod"); }
 
@@ -84,16 +110,20 @@ int compile(const std::vector<std::string>& opts) {
 		infile = infileRelToPwd;
 	}
 
-	if (LLVMInitializeNativeTarget()) {
-		std::cerr << "Failed to initialize native target" << std::endl;
-		return 1;
-	}
-
 	// get module name
 	auto moduleName = fs::relative(infile, c.workspacePath() / "src").replace_extension("");
 
 	Result res;
 
+	TargetSettings target;
+	target.cpu      = vm["target-cpu"].as<std::string>();
+	target.features = vm["target-features"].as<std::string>();
+	res += c.setTarget(target);
+	if (!res) {
+		std::cerr << res << std::endl;
+		return 1;
+	}
+
 	// load it as a module
 	ChiModule* chiModule;
 	res += c.loadModule(moduleName, &chiModule);
@@ -103,13 +133,121 @@ int compile(const std::vector<std::string>& opts) {
 		return 1;
 	}
 
+	// get the optimization level
+	auto levelInt = vm["optimization"].as<int>();
+
+	// vaidate it
+	if (levelInt < 0 || levelInt > 3) {
+		std::cerr << "Unrecognized optimization level: " << levelInt << std::endl;
+		return 1;
+	}
+
+	bool thinLink = vm.count("thin-link") != 0;
+	if (thinLink && vm.count("no-dependencies") != 0) {
+		std::cerr << "chi compile: cannot specify both --thin-link and -D, the thin link links the "
+		             "dependencies in"
+		          << std::endl;
+		return 1;
+	}
+
+	// get outpath
+	fs::path outpath = vm["output"].as<std::string>();
+
+	// get output type
+	enum class OutputType { Assembly, Bitcode, Object, Executable };
+	auto outputType = OutputType::Assembly;
+
+	// first see if we can deduce from output file
+	if (outpath != "-") {
+		auto ext = outpath.extension();
+		if (ext == ".ll") { outputType = OutputType::Assembly; }
+		if (ext == ".bc") { outputType = OutputType::Bitcode; }
+		if (ext == ".o" || ext == ".obj") { outputType = OutputType::Object; }
+	}
+
+	// then see if options were applied--these take precedence
+
+	// first make sure they weren't both specified
+	if (vm.count("-S") + vm.count("-c") + vm.count("executable") > 1) {
+		std::cerr << "chi compile: cannot specify more than one of -S, -c and --executable, please "
+		             "only specify one"
+		          << std::endl;
+		return 1;
+	}
+
+	if (vm.count("-S") != 0) { outputType = OutputType::Assembly; }
+	if (vm.count("-c") != 0) { outputType = OutputType::Bitcode; }
+	if (vm.count("executable") != 0) { outputType = OutputType::Executable; }
+
+	bool nativeOutput = outputType == OutputType::Object || outputType == OutputType::Executable;
+	if (nativeOutput && outpath == "-") {
+		std::cerr << "chi compile: native objects and executables can't be written to stdout, "
+		             "please specify an output file with -o"
+		          << std::endl;
+		return 1;
+	}
+	if (outputType == OutputType::Executable && vm.count("no-dependencies") != 0) {
+		std::cerr << "chi compile: cannot specify both --executable and -D, executables need the "
+		             "dependencies linked in"
+		          << std::endl;
+		return 1;
+	}
+
+	bool profileGenerate = vm.count("profile-generate") != 0;
+	bool profileUse      = vm.count("profile-use") != 0;
+	if (profileGenerate && profileUse) {
+		std::cerr << "chi compile: cannot specify both --profile-generate and --profile-use"
+		          << std::endl;
+		return 1;
+	}
+	if ((profileGenerate || profileUse) && thinLink) {
+		std::cerr << "chi compile: profiles can't be used with --thin-link, which optimizes the "
+		             "modules before they're linked"
+		          << std::endl;
+		return 1;
+	}
+	if (profileGenerate && vm.count("no-dependencies") != 0) {
+		std::cerr << "chi compile: cannot specify both --profile-generate and -D, the whole "
+		             "program has to be instrumented together"
+		          << std::endl;
+		return 1;
+	}
+
+	std::vector<VectorISA> multiversionISAs;
+	if (vm.count("multiversion") != 0) {
+		if (thinLink) {
+			std::cerr << "chi compile: cannot specify both --multiversion and --thin-link, the "
+			             "versions are made before the module is optimized"
+			          << std::endl;
+			return 1;
+		}
+
+		res += parseVectorISAs(vm["multiversion"].as<std::string>(), &multiversionISAs);
+		if (!res) {
+			std::cerr << res << std::endl;
+			return 1;
+		}
+	}
+
 	// make settings
 	Flags<CompileSettings> settings;
 	if (vm.count("no-dependencies") == 0) { settings |= CompileSettings::LinkDependencies; }
 	if (vm.count("fresh") == 0) { settings |= CompileSettings::UseCache; }
+	if (vm.count("lazy") != 0) { settings |= CompileSettings::LazyLoadCache; }
+	if (outputType == OutputType::Executable) { settings |= CompileSettings::NativeRuntime; }
 
+	CompileSession  session{c, settings};
 	OwnedLLVMModule llmod;
-	res += c.compileModule(*chiModule, settings, &llmod);
+	if (thinLink) {
+		ThinLinkSettings thinSettings;
+		thinSettings.optimizationLevel = levelInt;
+		thinSettings.threadCount       = jobs;
+		thinSettings.target            = c.target();
+
+		res += c.compileModuleWithThinLink(*chiModule, session, thinSettings, &llmod);
+	} else {
+		res += c.compileModule(*chiModule, session, &llmod);
+	}
 
 	if (!res) {
 		if (vm.count("machine-readable") == 0) {
@@ -120,63 +258,104 @@ int compile(const std::vector<std::string>& opts) {
 		return 1;
 	}
 
-	// strip debug if specified
-	if (vm.count("no-debug") != 0) { LLVMStripModuleDebugInfo(*llmod); }
-
-	// optimize
-
-	// get the level
-	auto levelInt = vm["optimization"].as<int>();
-
-	// vaidate it
-	if (levelInt < 0 || levelInt > 3) {
-		std::cerr << "Unrecognized optimization level: " << levelInt << std::endl;
-		return 1;
+	if (vm.count("stats") != 0) {
+		const auto& stats = session.stats();
+		std::cerr << "chi compile: modules: " << stats.moduleMisses << " compiled or retrieved, "
+		          << stats.moduleHits << " reused; dependency lists: " << stats.dependencyMisses
+		          << " found, " << stats.dependencyHits << " reused" << std::endl;
 	}
 
-	auto defaultTriple = LLVMGetDefaultTargetTriple();
-	LLVMTargetRef target;
-	char* msg = nullptr;
-	if (LLVMGetTargetFromTriple(defaultTriple, &target, &msg) != 0) {
-		std::cerr << "Failed to get target from triple: " << defaultTriple << ": " << msg << std::endl;
-		LLVMDisposeMessage(msg);
-		return 1;
+	// profiles refer to nodes by line, so this is done before the debug info is stripped
+	if (profileGenerate) {
+		instrumentProfiling(*llmod, vm["profile-generate"].as<std::string>());
 	}
-	LLVMDisposeMessage(defaultTriple);
+	if (profileUse) {
+		Profile profile;
+		res += readProfile(vm["profile-use"].as<std::string>(), &profile);
+		if (res) { res += applyProfile(*llmod, profile); }
 
-	auto targetMachine = OwnedTargetMachine(LLVMCreateTargetMachine(target, defaultTriple, nullptr, nullptr, LLVMCodeGenOptLevel(LLVMCodeGenLevelNone + levelInt), LLVMRelocStatic, LLVMCodeModelDefault));
-	if (targetMachine == nullptr) {
-		std::cerr << "Failed to create target machine" << std::endl;
-		return 1;
+		if (!res) {
+			std::cerr << "chi compile: Failed to use profile: " << std::endl << res << std::endl;
+			return 1;
+		}
+		if (!res.result_json.empty()) { std::cerr << res << std::endl; }
 	}
 
-	auto pbo = OwnedPassBuilderOptions(LLVMCreatePassBuilderOptions());
-	LLVMRunPasses(*llmod, ("default<O" + std::to_string(levelInt) + ">").c_str(), *targetMachine, *pbo);
+	// every exec input of every graph function has a specialized clone, which is what gets called
+	if (!multiversionISAs.empty()) {
+		std::vector<std::string> functionNames;
+		for (auto mod : c.modules()) {
+			auto graphMod = dynamic_cast<GraphModule*>(mod);
+			if (graphMod == nullptr) { continue; }
+
+			for (const auto& func : graphMod->functions()) {
+				for (auto id = 0ull; id < func->execInputs().size(); ++id) {
+					functionNames.push_back(
+					    mangleSpecializedFunctionName(graphMod->fullName(), func->name(), id));
+				}
+			}
+		}
 
-	// get outpath
-	fs::path outpath = vm["output"].as<std::string>();
+		res += multiversionFunctions(*llmod, functionNames, multiversionISAs);
+		if (!res) {
+			std::cerr << "chi compile: Failed to make versions of functions: " << std::endl
+			          << res << std::endl;
+			return 1;
+		}
+	}
 
-	// get output type
-	bool binaryOutput = false;
+	// strip debug if specified
+	if (vm.count("no-debug") != 0) { LLVMStripModuleDebugInfo(*llmod); }
 
-	// first see if we can deduce from output file
-	if (outpath != "-") {
-		auto ext = outpath.extension();
-		if (ext == ".ll") { binaryOutput = false; }
-		if (ext == ".bc") { binaryOutput = true; }
+	// optimize, unless the thin link already did
+	if (!thinLink) {
+		OwnedTargetMachine targetMachine;
+		res += createTargetMachine(c.target(), LLVMCodeGenOptLevel(LLVMCodeGenLevelNone + levelInt),
+		                           LLVMRelocDefault, &targetMachine);
+		if (!res) {
+			std::cerr << res << std::endl;
+			return 1;
+		}
+
+		auto pbo = OwnedPassBuilderOptions(LLVMCreatePassBuilderOptions());
+		LLVMRunPasses(*llmod, ("default<O" + std::to_string(levelInt) + ">").c_str(),
+		              *targetMachine, *pbo);
 	}
 
-	// then see if options were applied--these take precedence
+	if (nativeOutput) {
+		CodegenSettings codegenSettings;
+		codegenSettings.optimizationLevel = levelInt;
+		codegenSettings.threadCount       = jobs;
+		codegenSettings.target            = c.target();
+
+		std::vector<std::string> objects;
+		res += emitObjectFiles(*llmod, codegenSettings, &objects);
+
+		if (res && outputType == OutputType::Object) {
+			res += writeObjectFile(objects, outpath);
+		} else if (res) {
+			auto runtimeObject = runtimeObjectPath();
+			if (runtimeObject.empty()) {
+				res.addEntry("EUKN", "Failed to find runtime.o in lib/chigraph/runtime.o", {});
+			} else {
+				res += linkExecutable(objects, {runtimeObject}, outpath);
+			}
+		}
 
-	// first make sure they weren't both specified
-	if (vm.count("-S") != 0 && vm.count("c") != 0) {
-		std::cerr << "chi compile: cannot specify both -S and -c, please only specify one"
-		          << std::endl;
-		return 1;
+		if (!res) {
+			if (vm.count("machine-readable") == 0) {
+				std::cerr << "chi compile: Failed to generate native code: " << std::endl
+				          << res << std::endl;
+			} else {
+				std::cerr << res.result_json.dump(2) << std::endl;
+			}
+			return 1;
+		}
+
+		return 0;
 	}
 
-	if (vm.count("-S") != 0) { binaryOutput = false; }
-	if (vm.count("-c") != 0) { binaryOutput = true; }
+	bool binaryOutput = outputType == OutputType::Bitcode;
 
 	auto writeOutput = [&](std::ostream& outputStream) {
 		if (binaryOutput) {
@@ -6,6 +6,7 @@
 #include <chi/Context.hpp>
 #include <chi/Owned.hpp>
 #include <chi/Support/Result.hpp>
+#include <chi/Target.hpp>
 #include <deque>
 #include <iostream>
 #include <string>
@@ -22,6 +23,10 @@ int interpret(const std::vector<std::string>& opts, const char* argv0) {
 	    "Input file, - for stdin")("optimization,O", po::value<int>()->default_value(2),
 	                               "Optimization value, either 0, 1, 2, or 3")(
 	    "function,f", po::value<std::string>()->default_value("main"), "The function to run")(
+	    "target-cpu", po::value<std::string>(),
+	    "The CPU to generate code for, like skylake, or native for this one")(
+	    "target-features", po::value<std::string>(),
+	    "CPU features to turn on or off, like +avx2,-fma, or native for all of this CPU's")(
 	    "subargs", po::value<std::vector<std::string>>(), "arguments for command");
 
 	po::positional_options_description pos;
@@ -102,6 +107,23 @@ int interpret(const std::vector<std::string>& opts, const char* argv0) {
 		mods.pop_front();
 	}
 
+	// the module keeps its own target unless it's asked for
+	if (vm.count("target-cpu") != 0 || vm.count("target-features") != 0) {
+		TargetSettings target;
+		if (vm.count("target-cpu") != 0) { target.cpu = vm["target-cpu"].as<std::string>(); }
+		if (vm.count("target-features") != 0) {
+			target.features = vm["target-features"].as<std::string>();
+		}
+
+		OwnedTargetMachine targetMachine;
+		auto res = createTargetMachine(target, optLevel, LLVMRelocDefault, &targetMachine);
+		if (!res) {
+			std::cerr << res << std::endl;
+			return 1;
+		}
+		setModuleTarget(*realMod, *targetMachine);
+	}
+
 	// run it
 	auto func = LLVMGetNamedFunction(*realMod, vm["function"].as<std::string>().c_str());
 	if (func == nullptr) {
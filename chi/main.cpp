@@ -15,6 +15,7 @@ extern int get(const std::vector<std::string>& opts);
 extern int run(const std::vector<std::string>& opts, const char* argv0);
 extern int interpret(const std::vector<std::string>& opts, const char* argv0);
 extern int init(const std::vector<std::string>& opts);
+extern int profile(const std::vector<std::string>& opts);
 
 const char* helpString =
     R"(Usage: chi [ -C <path> ] <command> <command arguments>
@@ -26,6 +27,7 @@ run          Run a chigraph module
 interpret    Interpret LLVM IR (similar to lli)
 get          Fetch modules from the internet
 init         Initialize a new workspace with a hello world module
+profile      Merge profiles from --profile-generate and show the hottest nodes
 
 Use chi <command> --help to get usage for a command)";
 
@@ -78,6 +80,7 @@ int main(int argc, char** argv) {
 	if (cmd == "interpret") { return interpret(opts, argv[0]); }
 	if (cmd == "get") { return get(opts); }
 	if (cmd == "init") { return init(opts); }
+	if (cmd == "profile") { return profile(opts); }
 	// TODO: write other ones
 
 	std::cerr << "Unrecognized command: " << cmd << " see chi --help for commands" << std::endl;
@@ -0,0 +1,135 @@
+#include <boost/program_options.hpp>
+#include <chi/ChiModule.hpp>
+#include <chi/Context.hpp>
+#include <chi/GraphFunction.hpp>
+#include <chi/NodeInstance.hpp>
+#include <chi/NodeType.hpp>
+#include <chi/Profile.hpp>
+#include <chi/Support/Result.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace chi;
+
+namespace fs = std::filesystem;
+namespace po = boost::program_options;
+
+namespace {
+
+int merge(const po::variables_map& vm, const std::vector<std::string>& inputs) {
+	if (vm.count("output") == 0) {
+		std::cerr << "chi profile merge: error: no output file, specify one with -o" << std::endl;
+		return 1;
+	}
+
+	Result  res;
+	Profile merged;
+	for (const auto& input : inputs) {
+		Profile profile;
+		res += readProfile(input, &profile);
+		if (res) { res += mergeProfiles(profile, &merged); }
+
+		if (!res) {
+			std::cerr << "chi profile merge: Failed to merge " << input << ": " << std::endl
+			          << res << std::endl;
+			return 1;
+		}
+	}
+
+	std::ofstream stream{vm["output"].as<std::string>()};
+	stream << profileToJson(merged).dump(2) << std::endl;
+
+	return 0;
+}
+
+int show(const po::variables_map& vm, const std::vector<std::string>& inputs) {
+	if (inputs.size() != 2) {
+		std::cerr << "chi profile show: error: expected a profile and the module it's a profile of"
+		          << std::endl;
+		return 1;
+	}
+
+	Result  res;
+	Profile profile;
+	res += readProfile(inputs[0], &profile);
+
+	Context    c{fs::current_path()};
+	ChiModule* mod;
+	if (res) { res += c.loadModule(inputs[1], &mod); }
+
+	if (!res) {
+		std::cerr << res << std::endl;
+		return 1;
+	}
+
+	std::unordered_map<GraphFunction*, std::vector<NodeCount>> nodeCounts;
+	attributeProfileToNodes(c, profile, &nodeCounts);
+
+	// the functions with the hottest nodes first
+	std::vector<std::pair<GraphFunction*, const std::vector<NodeCount>*>> functions;
+	for (const auto& [func, counts] : nodeCounts) { functions.emplace_back(func, &counts); }
+	std::sort(functions.begin(), functions.end(), [](const auto& lhs, const auto& rhs) {
+		if (lhs.second->front().count != rhs.second->front().count) {
+			return lhs.second->front().count > rhs.second->front().count;
+		}
+		return lhs.first->qualifiedName() < rhs.first->qualifiedName();
+	});
+
+	auto top = vm["top"].as<size_t>();
+	for (const auto& [func, counts] : functions) {
+		std::cout << func->qualifiedName() << std::endl;
+
+		for (auto idx = 0ull; idx < std::min(top, counts->size()); ++idx) {
+			const auto& nodeCount = (*counts)[idx];
+			std::cout << "  " << nodeCount.count << "\t" << nodeCount.node->type().qualifiedName()
+			          << "\t" << nodeCount.node->stringId() << std::endl;
+		}
+	}
+
+	return 0;
+}
+
+}  // anonymous namespace
+
+int profile(const std::vector<std::string>& opts) {
+	po::options_description profile_opts("chi profile");
+
+	// clang-format off
+	profile_opts.add_options()
+		("action", po::value<std::string>(), "What to do: merge raw or merged profiles into one, or show the hottest nodes in each function of a module")
+		("inputs", po::value<std::vector<std::string>>(), "For merge, the profiles. For show, the profile and the module.")
+		("output,o", po::value<std::string>(), "The merged profile to write")
+		("top,t", po::value<size_t>()->default_value(10), "How many nodes to show for each function")
+		("help,h", "Show this help page")
+		;
+	// clang-format on
+
+	po::positional_options_description pos;
+	pos.add("action", 1).add("inputs", -1);
+
+	po::variables_map vm;
+	po::store(po::command_line_parser(opts).options(profile_opts).positional(pos).run(), vm);
+
+	if (vm.count("help") != 0 || vm.count("action") == 0) {
+		std::cerr << "Usage: chi profile merge -o <output> <profiles...>" << std::endl
+		          << "       chi profile show <profile> <module>" << std::endl
+		          << std::endl
+		          << profile_opts << std::endl;
+		return vm.count("help") != 0 ? 0 : 1;
+	}
+
+	std::vector<std::string> inputs;
+	if (vm.count("inputs") != 0) { inputs = vm["inputs"].as<std::vector<std::string>>(); }
+
+	auto action = vm["action"].as<std::string>();
+	if (action == "merge") { return merge(vm, inputs); }
+	if (action == "show") { return show(vm, inputs); }
+
+	std::cerr << "chi profile: error: unrecognized action: " << action
+	          << ", expected merge or show" << std::endl;
+	return 1;
+}
@@ -1,7 +1,10 @@
+#include <algorithm>
+#include <chrono>
 #include <boost/program_options.hpp>
 #include <chi/Context.hpp>
 #include <chi/GraphFunction.hpp>
 #include <chi/GraphModule.hpp>
+#include <chi/JitSession.hpp>
 #include <chi/LangModule.hpp>
 #include <chi/NodeType.hpp>
 #include <chi/Support/Result.hpp>
@@ -9,6 +12,7 @@
 #include <filesystem>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace po = boost::program_options;
@@ -23,6 +27,9 @@ int run(const std::vector<std::string>& opts, const char* argv0) {
 	run_opts.add_options()
 		("input-file", po::value<std::string>(), "The input file, - for stdin. Should be a chi module")
 		("subargs", po::value<std::vector<std::string>>(), "Arguments to call main with")
+		("stats", "Print how much native code was generated and loaded from the cache to stderr")
+		("target-cpu", po::value<std::string>()->default_value(""), "The CPU to generate code for, like skylake, or native for this one. A generic CPU by default")
+		("target-features", po::value<std::string>()->default_value(""), "CPU features to turn on or off, like +avx2,-fma, or native for all of this CPU's")
 		;
 	// clang-format on
 
@@ -48,12 +55,22 @@ int run(const std::vector<std::string>& opts, const char* argv0) {
 	std::string infile = vm["input-file"].as<std::string>();
 
 	Context c{fs::current_path()};
+	c.setCompileThreadCount(std::max(1u, std::thread::hardware_concurrency()));
+
+	Result res;
+
+	TargetSettings target;
+	target.cpu      = vm["target-cpu"].as<std::string>();
+	target.features = vm["target-features"].as<std::string>();
+	res += c.setTarget(target);
+	if (!res) {
+		std::cerr << res << std::endl;
+		return 1;
+	}
 
 	// load module
 	GraphModule* jmod = nullptr;
 
-	Result res;
-
 	if (infile == "-") {
 		nlohmann::json read_json = {};
 		std::cin >> read_json;
@@ -83,13 +100,31 @@ int run(const std::vector<std::string>& opts, const char* argv0) {
 	}
 
 	OwnedLLVMModule llmod;
-	res += c.compileModule(jmod->fullName(), CompileSettings::Default, &llmod);
+	// only what's reachable from main is needed to run it, so cached dependencies can load lazily
+	res += c.compileModule(jmod->fullName(),
+	                       Flags<CompileSettings>{CompileSettings::Default} |
+	                           CompileSettings::LazyLoadCache,
+	                       &llmod);
 
 	if (!res) {
 		std::cerr << "Error compiling module: " << res << std::endl;
 		return 1;
 	}
 
+	// the native code is cached in the workspace, so unchanged programs start without codegen
+	JitSession* session;
+	res += JitSession::instance(LLVMCodeGenLevelDefault, &session);
+	if (!res) {
+		std::cerr << res << std::endl;
+		return 1;
+	}
+	if (!c.workspacePath().empty()) {
+		session->setObjectCacheDirectory(c.workspacePath() / "lib" / "objects");
+
+		// code for versions of programs that aren't run anymore would pile up
+		session->pruneObjectCache();
+	}
+
 	// run it!
 
 	int ret;
@@ -100,5 +135,19 @@ int run(const std::vector<std::string>& opts, const char* argv0) {
 		return 1;
 	}
 
+	if (vm.count("stats") != 0) {
+		using std::chrono::milliseconds;
+
+		auto stats = session->stats();
+		std::cerr << "functions compiled: " << stats.functionsCompiled << "\n"
+		          << "object cache hits: " << stats.objectCacheHits
+		          << ", misses: " << stats.objectCacheMisses << "\n"
+		          << "codegen time: "
+		          << std::chrono::duration_cast<milliseconds>(stats.codegenTime).count() << "ms, "
+		          << "saved: "
+		          << std::chrono::duration_cast<milliseconds>(stats.codegenTimeSaved).count()
+		          << "ms" << std::endl;
+	}
+
 	return ret;
 }
@@ -17,6 +17,12 @@ namespace chi {
 Result parseBitcodeFile(const std::filesystem::path& file, LLVMContextRef ctx,
                         OwnedLLVMModule* toFill);
 Result parseBitcodeString(const std::string& bitcode, LLVMContextRef ctx, OwnedLLVMModule* toFill);
+
+/// Lazily load a bitcode file. Only the module's globals and declarations are read up front;
+/// function bodies are read when they're materialized, for example when linking them into another
+/// module. The module can't be cloned before it's fully materialized.
+Result parseBitcodeFileLazily(const std::filesystem::path& file, LLVMContextRef ctx,
+                              OwnedLLVMModule* toFill);
 }  // namespace chi
 
 #endif  // CHI_BITCODE_PARSER_HPP
@@ -0,0 +1,101 @@
+/// \file chi/CompileSession.hpp
+/// Defines the CompileSession class
+
+#ifndef CHI_COMPILE_SESSION_HPP
+#define CHI_COMPILE_SESSION_HPP
+
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "chi/Context.hpp"
+#include "chi/Fwd.hpp"
+#include "chi/Owned.hpp"
+#include "chi/Support/Flags.hpp"
+
+namespace chi {
+
+/// The state of a single build, so every module in it is compiled--or retrieved from the
+/// ModuleCache--at most once, and the transitive dependencies of each module are only walked once.
+///
+/// Pass the same session to every Context::compileModule call that is part of the build. The
+/// compiled modules are kept in the session, and clones of them are handed out for linking.
+///
+/// A session doesn't notice modules being edited or unloaded, so it should only live as long as
+/// the build does.
+struct CompileSession {
+	/// Hit and miss counts for a session
+	struct Stats {
+		/// The number of times a module was requested and had already been compiled
+		size_t moduleHits = 0;
+
+		/// The number of times a module was requested and had to be compiled or retrieved
+		size_t moduleMisses = 0;
+
+		/// The number of times the transitive dependencies of a module were already known
+		size_t dependencyHits = 0;
+
+		/// The number of times the transitive dependencies of a module had to be found
+		size_t dependencyMisses = 0;
+	};
+
+	/// Create a session
+	/// \param ctx The context the modules being compiled are in
+	/// \param settings The settings to compile with
+	CompileSession(Context& ctx, Flags<CompileSettings> settings = CompileSettings::Default);
+
+	// no copy or move, the compiled modules are owned by the session
+	CompileSession(const CompileSession&) = delete;
+	CompileSession(CompileSession&&)      = delete;
+	CompileSession& operator=(const CompileSession&) = delete;
+	CompileSession& operator=(CompileSession&&) = delete;
+
+	/// Get the context that the session is compiling modules in
+	/// \return The Context
+	Context& context() const { return *mContext; }
+
+	/// Get the settings the session is compiling with
+	/// \return The settings
+	Flags<CompileSettings> settings() const { return mSettings; }
+
+	/// Get a clone of a module that has already been compiled in this session. Counted as a hit if
+	/// it has been compiled, and a miss if it hasn't
+	/// \param mod The module to get
+	/// \return The clone, or nullptr if `mod` hasn't been compiled in this session yet
+	OwnedLLVMModule cloneCompiledModule(const ChiModule& mod);
+
+	/// Add a compiled module to the session
+	/// \param mod The module that was compiled
+	/// \param compiled The IR compiled from `mod`, without its dependencies linked in
+	/// \pre `compiled`
+	/// \return A clone of `compiled`, for the caller to use
+	OwnedLLVMModule addCompiledModule(const ChiModule& mod, OwnedLLVMModule compiled);
+
+	/// Get all the modules that a module depends on, directly or not. Dependencies are allowed to be
+	/// circular here--this is what forward declarations are made from, not a build order.
+	/// \param[in] mod The module to get the dependencies of
+	/// \param[out] toFill The dependencies, in breadth first order. Stays valid as long as the
+	/// session does.
+	/// \pre `toFill != nullptr`
+	/// \return The Result. E36 if a dependency isn't loaded.
+	Result transitiveDependencies(ChiModule& mod, const std::vector<ChiModule*>** toFill);
+
+	/// Get the hit and miss counts for the session
+	/// \return The Stats
+	const Stats& stats() const { return mStats; }
+
+private:
+	Context*               mContext;
+	Flags<CompileSettings> mSettings;
+
+	std::unordered_map<const ChiModule*, OwnedLLVMModule>         mCompiledModules;
+	std::unordered_map<const ChiModule*, std::vector<ChiModule*>> mTransitiveDependencies;
+
+	Stats mStats;
+};
+
+}  // namespace chi
+
+#endif  // CHI_COMPILE_SESSION_HPP
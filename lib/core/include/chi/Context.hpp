@@ -8,14 +8,17 @@
 
 #include <llvm-c/TargetMachine.h>
 
+#include <cassert>
 #include <filesystem>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include "chi/Fwd.hpp"
 #include "chi/ModuleCache.hpp"
 #include "chi/Support/Flags.hpp"
 #include "chi/Support/json.hpp"
+#include "chi/Target.hpp"
 
 namespace chi {
 
@@ -31,7 +34,16 @@ enum class CompileSettings {
 	/// For functions in that module
 	LinkDependencies = 1u << 1,
 
-	/// Default, which is both
+	/// Load dependencies that come from the cache lazily, only reading and linking in the parts of
+	/// them that are reachable from the module being compiled. Only has an effect with both
+	/// UseCache and LinkDependencies.
+	LazyLoadCache = 1u << 2,
+
+	/// Don't link the runtime bitcode into main modules, because the native runtime
+	/// (runtimeObjectPath()) is going to be linked into the executable instead
+	NativeRuntime = 1u << 3,
+
+	/// Default, which is UseCache and LinkDependencies
 	Default = UseCache | LinkDependencies
 };
 
@@ -150,6 +162,9 @@ struct Context {
 	                     OwnedLLVMModule* toFill);
 
 	/// Compile a module to a \c llvm::Module
+	/// If `settings` has CompileSettings::LinkDependencies, the whole dependency graph is computed
+	/// first (failing with E53 if it has a cycle), every module in it is compiled once--on up to
+	/// compileThreadCount() threads--and then they are all linked together.
 	/// \param[in] mod The module to compile
 	/// \param[in] settings The settings. See CompileSettings for more details
 	/// \param[out] toFill The \c llvm::Module to fill -- this can be nullptr it will be replaced
@@ -158,6 +173,69 @@ struct Context {
 	/// \return The `Result`
 	Result compileModule(ChiModule& mod, Flags<CompileSettings> settings, OwnedLLVMModule* toFill);
 
+	/// Compile a module to a \c llvm::Module as part of a larger build
+	/// Modules that have already been compiled in `session` are reused instead of being compiled
+	/// or retrieved from the cache again.
+	/// \param[in] mod The module to compile
+	/// \param[in] session The session to compile in. Its settings are used.
+	/// \param[out] toFill The \c llvm::Module to fill
+	/// \pre `toFill != nullptr`
+	/// \pre `&session.context() == this`
+	/// \return The `Result`
+	Result compileModule(ChiModule& mod, CompileSession& session, OwnedLLVMModule* toFill);
+
+	/// Compile a module and link its dependencies into it, optimizing each module on its own
+	/// before they're linked instead of the linked module as a whole (see thinLinkModules). The
+	/// modules are compiled or retrieved from the cache like compileModule does.
+	/// \param[in] mod The module to compile
+	/// \param[in] session The session to compile in. Its settings are used, and have to include
+	/// CompileSettings::LinkDependencies. CompileSettings::LazyLoadCache is ignored.
+	/// \param[in] settings How to optimize the modules
+	/// \param[out] toFill The optimized and linked module
+	/// \pre `toFill != nullptr`
+	/// \pre `&session.context() == this`
+	/// \return The `Result`
+	Result compileModuleWithThinLink(ChiModule& mod, CompileSession& session,
+	                                 const ThinLinkSettings& settings, OwnedLLVMModule* toFill);
+
+	/// Set the number of threads compileModule can use to compile dependencies
+	/// Each thread gets its own Context and `LLVMContext`, with the modules being compiled
+	/// reloaded into it. Only GraphModule and LangModule dependencies can be compiled that way; if
+	/// there are others the build falls back to compiling on the calling thread.
+	/// \param newCount The number of threads. 1 (the default) compiles on the calling thread.
+	/// \pre `newCount > 0`
+	void setCompileThreadCount(unsigned newCount) {
+		assert(newCount > 0 && "Cannot compile with zero threads");
+		mCompileThreadCount = newCount;
+	}
+
+	/// Get the number of threads compileModule can use to compile dependencies
+	/// \return The thread count
+	unsigned compileThreadCount() const { return mCompileThreadCount; }
+
+	/// Set the machine that modules are compiled for. Every module the Context creates gets its
+	/// triple and data layout, and the functions in it get its CPU and features. It's the host
+	/// triple with a generic CPU by default.
+	/// \param settings The target
+	/// \return The Result. EUKN if it isn't a target chigraph was built with.
+	Result setTarget(const TargetSettings& settings);
+
+	/// Get the machine that modules are compiled for, with `native` resolved
+	/// \return The target
+	const TargetSettings& target() const { return mTarget; }
+
+	/// Make a module target the machine modules are compiled for. See chi::setModuleTarget.
+	/// \param module The module
+	void applyTarget(LLVMModuleRef module) const;
+
+	/// Get a copy of the runtime module, which is linked into modules named `main`
+	/// It's parsed from runtimeBitcodePath() the first time, and cloned after that. The copy
+	/// targets target().
+	/// \param[out] toFill The module to fill
+	/// \pre `toFill != nullptr`
+	/// \return The Result. EUKN if runtime.bc couldn't be found or read.
+	Result runtimeModule(OwnedLLVMModule* toFill);
+
 	/// Find all uses of a node type in all the loaded modules
 	/// \param moduleName The name of the module that the type being search for is in
 	/// \param typeName The name of the type in `module` to search for
@@ -207,20 +285,45 @@ struct Context {
 	LLVMValueRef constBool(bool value);
 
 private:
+	// Get every module in the build of mod from the session or the cache, or compile it, in build
+	// order, so mod is last. Modules are only loaded lazily if allowLazy is set and the session's
+	// settings ask for it.
+	Result compileBuild(ChiModule& mod, CompileSession& session, bool allowLazy,
+	                    std::vector<ChiModule*>*      buildOrder,
+	                    std::vector<OwnedLLVMModule>* compiledModules,
+	                    std::vector<bool>*            loadedLazily);
+
+	// Generate the IR for a single module, without looking at or updating the cache
+	Result generateModuleIR(ChiModule& mod, CompileSession& session, OwnedLLVMModule* toFill);
+
+	// Generate the IR for some of the modules in a build on compileThreadCount() threads
+	// buildOrder has to contain every dependency of the modules in toCompile
+	Result generateModuleIRInParallel(const std::vector<ChiModule*>& buildOrder,
+	                                  const std::vector<ChiModule*>& toCompile,
+	                                  std::vector<OwnedLLVMModule>*  toFill);
+
 	std::filesystem::path mWorkspacePath;
 
 	OwnedLLVMContext mLLVMContext;
 
 	std::vector<std::unique_ptr<ChiModule>> mModules;
 
-	// This cache is only for use during compilation to not duplicate modules
-	std::unordered_map<std::string /*full name*/, LLVMModuleRef /*the compiled module*/>
-	    mCompileCache;
+	// Index of mModules by full name, so lookups don't have to scan every module. mModules is still
+	// the owner and keeps the insertion order for modules()
+	std::unordered_map<std::string /*full name*/, ChiModule*> mModulesByName;
 
 	LangModule* mLangModule = nullptr;
 
 	std::unique_ptr<ModuleCache> mModuleCache;
 
+	// The parsed runtime.bc, declared after mLLVMContext so it's destroyed first
+	OwnedLLVMModule mRuntimeModule;
+
+	unsigned mCompileThreadCount = 1;
+
+	TargetSettings     mTarget;
+	OwnedTargetMachine mTargetMachine;
+
 	std::unordered_map<std::string /*from Type*/,
 	                   std::unordered_map<std::string /*to type*/, std::unique_ptr<NodeType>>>
 	    mTypeConverters;
@@ -233,12 +336,32 @@ private:
 /// \return The workspace path, or an empty path if it wasn't found
 std::filesystem::path workspaceFromChildPath(const std::filesystem::path& path);
 
+/// Find the bitcode of the chigraph runtime, which is installed to lib/chigraph/runtime.bc
+/// \return The path, or an empty path if it wasn't found
+std::filesystem::path runtimeBitcodePath();
+
+/// Find the precompiled native object of the chigraph runtime, which is installed to
+/// lib/chigraph/runtime.o, for linking ahead of time compiled executables. It's optimized, but for
+/// the generic CPU of the target it was built for, so it runs on any machine the executables do.
+/// \return The path, or an empty path if it wasn't found
+std::filesystem::path runtimeObjectPath();
+
+/// Get the order to compile a module and all of its transitive dependencies in
+/// \param[in] mod The module to get the build order for
+/// \param[out] toFill The modules, each one after all of its dependencies. `mod` is last.
+/// \pre `toFill != nullptr`
+/// \return The Result. E36 if a dependency isn't loaded, E53 if there's a circular dependency.
+Result moduleBuildOrder(ChiModule& mod, std::vector<ChiModule*>* toFill);
+
 /// Turns a type into a string
 /// \param ty The type to stringify
 /// \return The return string
 std::string stringifyLLVMType(LLVMTypeRef ty);
 
 /// Interpret LLVM IR, just a convenience function
+/// The module is added to the JitSession for `optLevel`, so only the functions that are called
+/// are compiled, and it's removed once the function returns. Functions can be run if they take no
+/// arguments, or if they look like `main`.
 /// \param[in] mod The LLVM Module to interpret
 /// \param[in] optLevel How much the optimization should be applied. The default is roughly
 /// equilivant to -O2
@@ -251,6 +374,8 @@ Result interpretLLVMIR(OwnedLLVMModule mod, LLVMCodeGenOptLevel optLevel = LLVMC
                        LLVMGenericValueRef* ret = nullptr);
 
 /// Interpret LLVM IR as if it were the main function
+/// The module is added to the JitSession for `optLevel`, so only the functions that are called
+/// are compiled, and it's removed once main returns.
 /// \param[in] mod The module to interpret
 /// \param[in] optLevel The optimization level
 /// \param[in] args The arguments to main
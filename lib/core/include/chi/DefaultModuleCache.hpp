@@ -7,6 +7,9 @@
 
 namespace chi {
 
+/// A ModuleCache that decides if a cache is fresh by comparing modification times. Contexts use
+/// HashedModuleCache by default, as this one can't tell when a checkout or a restored cache made
+/// the times lie.
 struct DefaultModuleCache : public ModuleCache {
 	/// Default constrcutor
 	/// \param ctx The context to cache for
@@ -30,6 +33,14 @@ struct DefaultModuleCache : public ModuleCache {
 	/// \copydoc ModuleCache::retrieveFromCache
 	OwnedLLVMModule retrieveFromCache(const std::filesystem::path& moduleName,
 	                                  time_point                   atLeastThisNew) override;
+
+	/// \copydoc ModuleCache::retrieveFromCacheLazily
+	OwnedLLVMModule retrieveFromCacheLazily(const std::filesystem::path& moduleName,
+	                                        time_point                   atLeastThisNew) override;
+
+private:
+	OwnedLLVMModule retrieve(const std::filesystem::path& moduleName, time_point atLeastThisNew,
+	                         bool lazily);
 };
 }  // namespace chi
 
@@ -7,10 +7,13 @@
 #define CHI_FUNCTION_COMPILER_HPP
 
 #include <memory>
+#include <optional>
 #include <unordered_map>
+#include <unordered_set>
 #include <string_view>
 #include <string>
 
+#include "chi/FunctionOptimizer.hpp"
 #include "chi/Fwd.hpp"
 #include "chi/NodeCompiler.hpp"
 
@@ -23,9 +26,12 @@ struct FunctionCompiler {
 	/// \param moduleToGenInto The module to create the function in
 	/// \param debugCU The compile unit we're in, this is a DICompileUnit
 	/// \param debugBuilder The Debug information builder for the module
+	/// \param execInput The exec input to compile a specialized clone of the function for, which
+	/// starts there instead of switching on the exec input ID. Empty to compile the function
+	/// itself. See mangleSpecializedFunctionName.
 	FunctionCompiler(const GraphFunction& func, LLVMModuleRef moduleToGenInto,
 	                 LLVMMetadataRef debugFile, LLVMMetadataRef debugCU,
-	                 LLVMDIBuilderRef debugBuilder);
+	                 LLVMDIBuilderRef debugBuilder, std::optional<size_t> execInput = {});
 
 	/// Creates the function, but don't actually generate into it
 	/// \pre `initialized() == false`
@@ -41,6 +47,27 @@ struct FunctionCompiler {
 	/// \return The Result
 	Result compile();
 
+	/// Generate the function as a switch on the exec input ID that calls its specialized clones,
+	/// instead of generating the graph into it
+	/// \pre `initialized() == true`
+	/// \pre `compiled() == false`
+	/// \pre `!specializedExecInput()`
+	/// \return The Result
+	Result compileDispatcher();
+
+	/// Set where the nodes of a copy of a function that had calls inlined into it came from, so
+	/// they get the line numbers of those nodes. See InlinedFunction::origins.
+	/// \pre `initialized() == false`
+	/// \param origins The node in the original function that each node came from
+	void setNodeOrigins(std::unordered_map<const NodeInstance*, const NodeInstance*> origins) {
+		assert(!initialized() && "Node origins have to be set before initializing");
+		mNodeOrigins = std::move(origins);
+	}
+
+	/// Get the exec input the function is being specialized for
+	/// \return The exec input, or empty if it's the function itself
+	std::optional<size_t> specializedExecInput() const { return mExecInput; }
+
 	/// Create the subroutine type for the function
 	/// \return The subroutine type
 	LLVMMetadataRef createSubroutineType();
@@ -93,15 +120,6 @@ struct FunctionCompiler {
 		return mLLFunction;
 	}
 
-	/// Get the value for the address to jump back to
-	/// \pre `initialized() == true`
-	/// \return The value
-	LLVMValueRef postPureBreak() const {
-		assert(initialized() &&
-		       "Please initialize the function compiler before trying to get the post-pure break");
-		return mPostPureBreak;
-	}
-
 	/// Get the graph function
 	/// \retrun The GraphFunction
 	const GraphFunction& function() const { return *mFunction; }
@@ -121,6 +139,31 @@ struct FunctionCompiler {
 	/// \return The line number
 	int nodeLineNumber(NodeInstance& node);
 
+	/// Get if a pure node already holds its current value when a node is run, so it doesn't have to
+	/// be evaluated again. See availablePures.
+	/// \pre `compile()` has been called
+	/// \param node The non-pure node that is about to run
+	/// \param inputExecID The input exec it's being run from
+	/// \param pure The pure that it depends on
+	/// \return True if it's available, false if it has to be evaluated
+	bool pureAvailable(const NodeInstance& node, size_t inputExecID, NodeInstance& pure) const;
+
+	/// Get if a node always runs before another one, so its outputs can be used directly. See
+	/// nodesThatAlwaysRunBefore.
+	/// \pre `compile()` has been called
+	/// \param before The node that might run first
+	/// \param node The non-pure node that is about to run
+	/// \param inputExecID The input exec it's being run from
+	/// \return True if `before` always runs before it
+	bool alwaysRunsBefore(const NodeInstance& before, const NodeInstance& node,
+	                      size_t inputExecID) const;
+
+	/// Get what optimizeFunction found out about the function, which is compiled instead of what's
+	/// written
+	/// \pre `compile()` has been called
+	/// \return The FunctionOptimizations
+	const FunctionOptimizations& optimizations() const { return mOptimizations; }
+
 	/// Get if the function is initialized (`initialize()` has been called)
 	/// \return True if it is, false otherwise
 	bool initialized() const { return mInitialized; }
@@ -150,21 +193,36 @@ private:
 
 	const GraphFunction* mFunction = nullptr;
 
+	std::optional<size_t> mExecInput;
+
 	LLVMValueRef      mLLFunction = nullptr;
 	LLVMBasicBlockRef mAllocBlock = nullptr;
 
 	std::unordered_map<NodeInstance*, NodeCompiler> mNodeCompilers;
 
+	FunctionOptimizations mOptimizations;
+
+	// what exec outputs that can never be taken branch to, if there are any
+	LLVMBasicBlockRef mUnreachableBlock = nullptr;
+
+	std::unordered_map<const NodeInstance*, std::vector<std::unordered_set<NodeInstance*>>>
+	    mAvailablePures;
+	std::unordered_map<const NodeInstance*, std::vector<std::unordered_set<const NodeInstance*>>>
+	    mAlwaysRunBefore;
+
 	std::unordered_map<unsigned, NodeInstance*> mNodeByLocation;
 	std::unordered_map<NodeInstance*, unsigned> mLocationByNode;
 
+	std::unordered_map<const NodeInstance*, const NodeInstance*> mNodeOrigins;
+
 	bool mInitialized = false;
 	bool mCompiled    = false;
-
-	LLVMValueRef mPostPureBreak = nullptr;
 };
 
 /// Compile the graph to an \c llvm::Function (usually called from JsonModule::generateModule)
+/// Each exec input gets a specialized clone of the function, which calls to it from other graphs
+/// use. The function itself just calls the clone for the exec input it's given. Calls to small
+/// functions are inlined into the clones first, see inlineCalls.
 /// \param func The function to compile
 /// \param mod The module to codgen into, should already be a valid module
 /// \param debugCU The compilation unit that the GraphFunction resides in.
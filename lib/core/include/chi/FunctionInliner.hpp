@@ -0,0 +1,72 @@
+/// \file chi/FunctionInliner.hpp
+/// Defines functions for inlining calls to small GraphFunction objects before they're compiled
+
+#pragma once
+
+#ifndef CHI_FUNCTION_INLINER_HPP
+#define CHI_FUNCTION_INLINER_HPP
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "chi/Fwd.hpp"
+
+namespace chi {
+
+/// A copy of a GraphFunction with calls to other GraphFunction objects spliced into it
+struct InlinedFunction {
+	/// The copy. It's in the same module, with the same name and interface, but isn't one of the
+	/// module's functions
+	std::unique_ptr<GraphFunction> function;
+
+	/// The node in the original function that each node in the copy came from. Nodes that were
+	/// spliced in came from the call they replaced.
+	std::unordered_map<const NodeInstance*, const NodeInstance*> origins;
+
+	/// Every function that was inlined, once for each call that was
+	std::vector<const GraphFunction*> callees;
+};
+
+/// \name Function Inlining
+/// \brief Graph level inlining, done before any IR is generated
+/// \{
+
+/// The most a function can cost (see inlineCost) to be inlined
+constexpr size_t inlineThreshold = 24;
+
+/// The most all the functions inlined into one function can cost together
+constexpr size_t inlineBudget = 1024;
+
+/// How many levels of calls in inlined functions are inlined too
+constexpr size_t maxInlineDepth = 3;
+
+/// Get how much inlining a function costs: about how many nodes it adds to the caller, with nodes
+/// that run costing more than pure ones, and branches and calls costing more than that.
+/// \param func The function
+/// \return The cost
+size_t inlineCost(const GraphFunction& func);
+
+/// Get the functions that would be inlined into a function, without inlining them
+/// \param func The function
+/// \return The functions, once for each call that would be inlined, like InlinedFunction::callees
+std::vector<const GraphFunction*> inlinedCallees(const GraphFunction& func);
+
+/// Splice the GraphFunction objects that func calls into a copy of it when they cost less than
+/// inlineThreshold, as long as that still fits in inlineBudget. Functions in other modules are
+/// inlined the same way, so no link time optimization is needed for them to be. Arguments,
+/// return values and the callee's local variables become local variables of the copy.
+///
+/// Recursive calls, functions in modules with C support and functions that wouldn't validate
+/// aren't inlined.
+/// \param func The function to inline calls into. It isn't changed.
+/// \param[out] toFill The copy. If nothing was inlined, `toFill->function` is null.
+/// \return The Result
+Result inlineCalls(const GraphFunction& func, InlinedFunction* toFill);
+
+/// \}
+
+}  // namespace chi
+
+#endif  // CHI_FUNCTION_INLINER_HPP
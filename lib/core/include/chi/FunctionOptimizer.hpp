@@ -0,0 +1,60 @@
+/// \file chi/FunctionOptimizer.hpp
+/// Defines functions for optimizing GraphFunction objects before they're compiled
+
+#pragma once
+
+#ifndef CHI_FUNCTION_OPTIMIZER_HPP
+#define CHI_FUNCTION_OPTIMIZER_HPP
+
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "chi/Fwd.hpp"
+
+namespace chi {
+
+/// What optimizing a GraphFunction found out about it before it's compiled. The GraphFunction
+/// isn't changed, FunctionCompiler uses this to compile less than what's written.
+struct FunctionOptimizations {
+	/// The pure nodes whose outputs are known before the function runs, with the constant value of
+	/// each output. They aren't compiled, the nodes that use them get the constants.
+	std::unordered_map<const NodeInstance*, std::vector<LLVMValueRef>> constants;
+
+	/// The non-pure nodes that can ever run, with if each of their exec outputs can be taken.
+	/// The rest are never compiled.
+	std::unordered_map<const NodeInstance*, std::vector<bool>> reachableExecOutputs;
+
+	/// Get the constant an output was folded to
+	/// \param node The node
+	/// \param outputID The ID of the data output
+	/// \return The constant, or nullptr if it isn't known before the function runs
+	LLVMValueRef constant(const NodeInstance& node, size_t outputID) const;
+
+	/// Get if an exec output can ever be taken
+	/// \param node The node
+	/// \param execOutputID The ID of the exec output
+	/// \return False if the node can never run or never takes that output
+	bool reachable(const NodeInstance& node, size_t execOutputID) const;
+};
+
+/// \name Function Optimization
+/// \brief Graph level optimizations, done before any IR is generated
+/// \{
+
+/// Optimize a function: fold the pure subgraphs that only depend on constants (see
+/// NodeType::constantFold), then find the exec paths that can never be taken starting from the
+/// entry, like the other side of an if on a folded condition (see NodeType::reachableExecOutputs).
+/// Pure nodes that nothing reachable uses are never compiled, so they're dropped too.
+/// \param func The function to optimize
+/// \param execInput The exec input the function is being specialized for, if it is. Only that
+/// exec output of the entry can be taken.
+/// \return The FunctionOptimizations
+FunctionOptimizations optimizeFunction(const GraphFunction&  func,
+                                       std::optional<size_t> execInput = {});
+
+/// \}
+
+}  // namespace chi
+
+#endif  // CHI_FUNCTION_OPTIMIZER_HPP
@@ -10,6 +10,8 @@
 
 namespace chi {
 struct ChiModule;
+struct CodegenSettings;
+struct CompileSession;
 struct Context;
 struct DataType;
 struct DataType;
@@ -20,11 +22,14 @@ struct GraphModule;
 struct GraphStruct;
 struct LangModule;
 struct ModuleCache;
+struct ModuleSummary;
 struct NamedDataType;
 struct NodeCompiler;
 struct NodeInstance;
 struct NodeType;
 struct PureCompiler;
+struct TargetSettings;
+struct ThinLinkSettings;
 }  // namespace chi
 
 #endif  // CHI_FWD_HPP
@@ -125,6 +125,11 @@ struct GraphFunction {
 	/// \return The function type
 	LLVMTypeRef functionType() const;
 
+	/// Get the LLVM function type for the clones of the function that are specialized for one exec
+	/// input. It's the same as functionType(), without the exec input ID.
+	/// \return The function type
+	LLVMTypeRef specializedFunctionType() const;
+
 	// TODO: check uses and replace to avoid errors
 	/// \name Data input modifiers
 	/// \{
@@ -47,11 +47,22 @@ struct GraphModule : public ChiModule {
 
 	Result addForwardDeclarations(LLVMModuleRef module) const override;
 
+	/// \copydoc ChiModule::generateModule
+	/// With a workspace, each function is compiled into its own module and cached in
+	/// functionCacheDirectory(), keyed on its contents and the module's interface, so only the
+	/// functions that changed since the last compile are regenerated. Modules with C support
+	/// enabled are always compiled all at once.
 	Result generateModule(LLVMModuleRef module) override;
 
 	/////////////////////
 
+	/// The number of lines in debug info that each function gets. Functions are given blocks of
+	/// lines in order of name, so editing one function doesn't move the nodes of any other.
+	static constexpr unsigned linesPerFunction = 1u << 16;
+
 	/// Create the associations from line number and function in debug info
+	/// The nodes of the `n`th function, by name, are on lines `n * linesPerFunction + 1` onwards,
+	/// in order of ID.
 	/// \return A "bimap" of function to line number and vice versa
 	std::pair<std::unordered_map<NodeInstance*, unsigned>,
 	          std::unordered_map<unsigned, NodeInstance*>>
@@ -66,6 +77,11 @@ struct GraphModule : public ChiModule {
 	/// \return The path
 	std::filesystem::path sourceFilePath() const;
 
+	/// Get the directory that compiled functions are cached in
+	/// \pre `context().hasWorkspace()`
+	/// \return `context().workspacePath() / "lib" / (fullName() + ".functions")`
+	std::filesystem::path functionCacheDirectory() const;
+
 	/// \name Function Creation and Manipulation
 	/// \{
 
@@ -0,0 +1,116 @@
+/// \file HashedModuleCache.hpp
+
+#ifndef CHI_HASHED_MODULE_CACHE_HPP
+#define CHI_HASHED_MODULE_CACHE_HPP
+
+#include <string>
+#include <string_view>
+
+#include "chi/ModuleCache.hpp"
+
+namespace chi {
+
+/// A ModuleCache that is keyed on what goes into a module instead of when it was compiled.
+///
+/// The key for a module is a hash of the compiler version, the module's contents, its C sources,
+/// and the interface hashes of its dependencies. Timestamps are never looked at, so caches that are
+/// restored from somewhere else or that survive a checkout are reused as long as their key still
+/// matches, and touching a file without changing it doesn't cause a rebuild.
+///
+/// Caches are stored in `workspace/lib/<module>.<key>.bc`, with the module's ModuleSummary next to
+/// them in `workspace/lib/<module>.<key>.summary.json`. Caching a module removes the caches for
+/// its old keys.
+struct HashedModuleCache : public ModuleCache {
+	/// Constructor
+	/// \param ctx The context to cache for
+	explicit HashedModuleCache(Context& ctx);
+
+	/// Get the hash that a module's cache is keyed on
+	/// \param[in] moduleName The name of the module
+	/// \param[out] toFill The hash, as hex digits
+	/// \pre `toFill != nullptr`
+	/// \return The Result. E36 if the module or one of its dependencies isn't loaded.
+	Result moduleHash(const std::filesystem::path& moduleName, std::string* toFill) const;
+
+	/// Get the hash of everything about a module that can change the code generated for modules
+	/// that depend on it: its types and the signatures of its functions, along with the interface
+	/// hashes of its own dependencies. Function bodies aren't part of it.
+	/// \param[in] moduleName The name of the module
+	/// \param[out] toFill The hash, as hex digits
+	/// \pre `toFill != nullptr`
+	/// \return The Result. E36 if the module or one of its dependencies isn't loaded.
+	Result interfaceHash(const std::filesystem::path& moduleName, std::string* toFill) const;
+
+	/// Get the path of a module's cache for a given key
+	/// \param moduleName The name of the module
+	/// \param hash The key, from moduleHash
+	/// \return `context().workspacePath() / "lib" / moduleName + "." + hash + ".bc"`
+	std::filesystem::path cachePathForModule(const std::filesystem::path& moduleName,
+	                                         std::string_view             hash) const;
+
+	/// Get the path of a module's summary for a given key
+	/// \param moduleName The name of the module
+	/// \param hash The key, from moduleHash
+	/// \return `context().workspacePath() / "lib" / moduleName + "." + hash + ".summary.json"`
+	std::filesystem::path summaryPathForModule(const std::filesystem::path& moduleName,
+	                                           std::string_view             hash) const;
+
+	/// \copydoc ModuleCache::cacheModule
+	/// `timeAtFileRead` is ignored. The module's summary is written too.
+	Result cacheModule(const std::filesystem::path& moduleName, LLVMModuleRef compiledModule,
+	                   time_point timeAtFileRead) override;
+
+	/// \copydoc ModuleCache::invalidateCache
+	/// Removes the caches for every key, not just the current one
+	void invalidateCache(const std::filesystem::path& moduleName) override;
+
+	/// \copydoc ModuleCache::cacheUpdateTime
+	/// Only the cache for the current key counts
+	time_point cacheUpdateTime(const std::filesystem::path& moduleName) const override;
+
+	/// \copydoc ModuleCache::retrieveFromCache
+	/// `atLeastThisNew` is ignored, the cache for the current key is always up to date
+	OwnedLLVMModule retrieveFromCache(const std::filesystem::path& moduleName,
+	                                  time_point                   atLeastThisNew) override;
+
+	/// \copydoc ModuleCache::retrieveFromCacheLazily
+	/// `atLeastThisNew` is ignored
+	OwnedLLVMModule retrieveFromCacheLazily(const std::filesystem::path& moduleName,
+	                                        time_point                   atLeastThisNew) override;
+
+	/// Retrieve the ModuleSummary that was written when a module was cached, so a thin link (see
+	/// Context::compileModuleWithThinLink and computeImports) doesn't have to summarize it again
+	/// \param[in] moduleName The name of the module
+	/// \pre `!moduleName.empty()`
+	/// \param[out] toFill The summary
+	/// \pre `toFill != nullptr`
+	/// \return If there was a summary for the module's current key
+	bool retrieveSummary(const std::filesystem::path& moduleName, ModuleSummary* toFill);
+
+	/// Get the compiler version that's part of every key
+	/// \return The chigraph revision and LLVM version that this was built with
+	static std::string_view compilerVersion();
+
+private:
+	OwnedLLVMModule retrieve(const std::filesystem::path& moduleName, bool lazily);
+};
+
+/// Get the interface hash of a module without a HashedModuleCache.
+/// See HashedModuleCache::interfaceHash for what goes into it
+/// \param[in] ctx The context the module is loaded in
+/// \param[in] moduleName The name of the module
+/// \param[out] toFill The hash, as hex digits
+/// \pre `toFill != nullptr`
+/// \return The Result. E36 if the module or one of its dependencies isn't loaded.
+Result moduleInterfaceHash(Context& ctx, const std::filesystem::path& moduleName,
+                           std::string* toFill);
+
+/// Get the hash of the interfaces of the functions that the nodes in a function call without being
+/// calls to them (see NodeType::referencedFunctions). It's part of the function's cache keys.
+/// \param func The function
+/// \return The hash, as hex digits
+std::string referencedInterfacesHash(const GraphFunction& func);
+
+}  // namespace chi
+
+#endif  // CHI_HASHED_MODULE_CACHE_HPP
@@ -0,0 +1,177 @@
+/// \file chi/JitSession.hpp
+/// Defines the JitSession class
+
+#ifndef CHI_JIT_SESSION_HPP
+#define CHI_JIT_SESSION_HPP
+
+#pragma once
+
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
+#include <llvm-c/TargetMachine.h>
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "chi/Fwd.hpp"
+#include "chi/Owned.hpp"
+
+namespace chi {
+
+/// An ORC LLJIT that lives as long as the process does, and that any number of modules can be
+/// added to and run from.
+///
+/// Functions are compiled the first time they are called, not when their module is added:
+/// every function is reached through a stub that compiles it on the first call. So the time it
+/// takes to start running a program depends on the code that runs, not on how big it is.
+///
+/// Every module that is added is kept apart from the others, so modules that define the same
+/// symbols can be added to the same session. Modules can't call into each other--link them
+/// together before adding them if that's needed. Once a module is done running it can be removed,
+/// which frees the code that was generated for it.
+///
+/// Modules are kept as bitcode, and each function is read into an LLVMContext of its own when it
+/// is compiled, so the Context they were compiled in doesn't need to outlive the session, and
+/// functions can be called for the first time from any thread.
+///
+/// With an object cache directory, the native code for each function is saved there and loaded
+/// from there the next time the same module is added, so programs that haven't changed are run
+/// without generating any code. It is keyed on the module's bitcode, the function, the
+/// optimization level, and the host CPU and its features. Nothing is removed from it until
+/// pruneObjectCache is called.
+struct JitSession {
+	/// Counts of what a session has done
+	struct Stats {
+		/// The number of modules that have been added
+		size_t modulesAdded = 0;
+
+		/// The number of functions that have been compiled or loaded from the object cache, which
+		/// is the number that have been called at least once
+		size_t functionsCompiled = 0;
+
+		/// The number of times native code was loaded from the object cache. Functions and the
+		/// global variables of a module are counted separately.
+		size_t objectCacheHits = 0;
+
+		/// The number of times native code had to be generated for the object cache
+		size_t objectCacheMisses = 0;
+
+		/// The time spent generating code for object cache misses
+		std::chrono::nanoseconds codegenTime{0};
+
+		/// The time it took to generate the code that was loaded from the object cache
+		std::chrono::nanoseconds codegenTimeSaved{0};
+	};
+
+	/// Get the session for an optimization level, creating it the first time it's asked for
+	/// \param[in] optLevel The optimization level to generate code with
+	/// \param[out] toFill The session. It is never destroyed.
+	/// \pre `toFill != nullptr`
+	/// \return The Result. EINT if the native target couldn't be set up.
+	static Result instance(LLVMCodeGenOptLevel optLevel, JitSession** toFill);
+
+	// no copy or move, there's only one per optimization level
+	JitSession(const JitSession&) = delete;
+	JitSession(JitSession&&)      = delete;
+	JitSession& operator=(const JitSession&) = delete;
+	JitSession& operator=(JitSession&&) = delete;
+
+	/// Add a module to the session. None of it is compiled until it is called.
+	/// \param[in] mod The module to add. It is consumed.
+	/// \param[out] toFill The ID of the module in the session, to pass to lookup
+	/// \pre `mod && toFill != nullptr`
+	/// \return The Result. EINT if the module has global aliases, which can't be split up.
+	Result addModule(OwnedLLVMModule mod, size_t* toFill);
+
+	/// Remove a module that was added, and free the code that was generated for it. Nothing from it
+	/// can be running, and its static destructors should have been run already.
+	/// \param moduleID The ID from addModule
+	/// \return The Result. EINT if the module was already removed.
+	Result removeModule(size_t moduleID);
+
+	/// Get the address of a function in a module that was added
+	/// \param[in] moduleID The ID from addModule
+	/// \param[in] name The name of the function in the module that was added
+	/// \param[out] toFill The address. Calling it compiles it if it hasn't been
+	/// \pre `toFill != nullptr`
+	/// \return The Result. EINT if the symbol isn't in the module or the module was removed.
+	Result lookup(size_t moduleID, std::string_view name, void** toFill);
+
+	/// Run the static constructors from a module that was added, in order of priority
+	/// \param moduleID The ID from addModule
+	/// \return The Result
+	Result runStaticConstructors(size_t moduleID);
+
+	/// Run the static destructors from a module that was added, in order of priority
+	/// \param moduleID The ID from addModule
+	/// \return The Result
+	Result runStaticDestructors(size_t moduleID);
+
+	/// Set the directory that native code is cached in. Only modules that are added after it's set
+	/// use it.
+	/// \param dir The directory, which is created if it doesn't exist. Empty to not cache.
+	void setObjectCacheDirectory(std::filesystem::path dir);
+
+	/// Get the directory that native code is cached in
+	/// \return The directory, or empty if it isn't cached
+	std::filesystem::path objectCacheDirectory() const;
+
+	/// Remove the native code in the object cache directory that hasn't been used for a while.
+	/// Code is used when it's generated or loaded, so what was only used by programs that have
+	/// changed since is removed once it's old enough, along with files left half written.
+	/// \param unusedFor How long it has to go unused to be removed
+	/// \return The number of functions and sets of global variables whose code was removed
+	size_t pruneObjectCache(std::chrono::hours unusedFor = std::chrono::hours{24 * 7});
+
+	/// Get the optimization level that code is generated with
+	/// \return The optimization level
+	LLVMCodeGenOptLevel optLevel() const { return mOptLevel; }
+
+	/// Get the counts of what the session has done
+	/// \return The Stats
+	Stats stats() const;
+
+private:
+	struct JitModule;
+	struct Unit;
+
+	explicit JitSession(LLVMCodeGenOptLevel optLevel);
+
+	Result initialize();
+
+	Result extractUnit(const Unit& unit, LLVMContextRef llctx, OwnedLLVMModule* toFill);
+	Result generateObject(const Unit& unit, OwnedLLVMMemoryBuffer* toFill);
+	Result objectForUnit(const Unit& unit, OwnedLLVMMemoryBuffer* toFill);
+
+	static void materializeUnit(void* ctx, LLVMOrcMaterializationResponsibilityRef mr);
+	static void discardUnit(void* ctx, LLVMOrcJITDylibRef jd, LLVMOrcSymbolStringPoolEntryRef sym);
+	static void destroyUnit(void* ctx);
+
+	LLVMCodeGenOptLevel mOptLevel;
+
+	// for generating code, set up the same as the JIT's. A TargetMachine can only generate code for
+	// one module at a time.
+	OwnedTargetMachine mTargetMachine;
+	std::string        mHostCPU;
+	std::string        mHostFeatures;
+	std::mutex         mCodegenMutex;
+
+	LLVMOrcLLJITRef                  mJit         = nullptr;
+	LLVMOrcLazyCallThroughManagerRef mCallThrough = nullptr;
+	LLVMOrcIndirectStubsManagerRef   mStubs       = nullptr;
+
+	mutable std::mutex                       mMutex;
+	std::vector<std::unique_ptr<JitModule>> mModules;
+	std::filesystem::path                    mObjectCacheDirectory;
+	Stats                                    mStats;
+};
+
+}  // namespace chi
+
+#endif  // CHI_JIT_SESSION_HPP
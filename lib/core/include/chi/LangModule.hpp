@@ -36,9 +36,11 @@ struct LangModule : ChiModule {
 		return ret;
 	}
 
-	std::vector<std::string> typeNames() const override {
-		return {"i32", "i1", "float", "i8*"};  // TODO: do i need more?
-	}
+	/// The scalar types, the vector types that fit in vector registers, and buffers of the scalar
+	/// types. The numbers are i8, i16, i32, i64, f32 and f64, and float, which is a double. Vectors
+	/// of numbers or i1 with any power of two lanes up to 64 can be made with typeFromName, like
+	/// `i32x4`, and buffers of any of those, like `i32x4[]`.
+	std::vector<std::string> typeNames() const override;
 
 	LLVMMetadataRef debugType(FunctionCompiler& compiler, const DataType& dType) const override;
 
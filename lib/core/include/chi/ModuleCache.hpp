@@ -56,6 +56,17 @@ struct ModuleCache {
 	virtual OwnedLLVMModule retrieveFromCache(const std::filesystem::path& moduleName,
 	                                          time_point                   atLeastThisNew) = 0;
 
+	/// Retrieve a module from the cache, only loading function bodies when they're materialized.
+	/// The default just calls retrieveFromCache.
+	/// \param moduleName The name of the module to retrieve
+	/// \pre `!moduleName.empty()`
+	/// \param atLeastThisNew Make sure the cache is at least as new as this
+	/// \return A llvm::Module that may be lazily loaded, or nullptr if no suitable cache was found
+	virtual OwnedLLVMModule retrieveFromCacheLazily(const std::filesystem::path& moduleName,
+	                                                time_point                   atLeastThisNew) {
+		return retrieveFromCache(moduleName, atLeastThisNew);
+	}
+
 	/// Get the context this cache is bound to
 	/// \return the `Context`
 	Context& context() const { return *mContext; }
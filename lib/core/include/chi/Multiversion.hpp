@@ -0,0 +1,72 @@
+/// \file chi/Multiversion.hpp
+/// Defines function multiversioning, which compiles functions for several vector instruction sets
+/// and picks one when they're called from what the CPU running them supports
+
+#pragma once
+
+#ifndef CHI_MULTIVERSION_HPP
+#define CHI_MULTIVERSION_HPP
+
+#include <string>
+#include <vector>
+
+#include "chi/Fwd.hpp"
+
+namespace chi {
+
+/// An x86 vector instruction set that functions can have a version for. Each one is an x86-64
+/// microarchitecture level, so a version gets everything that came with it too.
+enum class VectorISA {
+	/// SSE4.2, SSSE3 and POPCNT, which is x86-64-v2
+	SSE42 = 1,
+
+	/// AVX2, FMA and BMI2, which is x86-64-v3
+	AVX2 = 2,
+
+	/// AVX-512 F, BW, CD, DQ and VL, which is x86-64-v4
+	AVX512 = 3,
+};
+
+/// \name Multiversioning
+/// \brief Compiling functions for several instruction sets and dispatching on CPUID
+/// \{
+
+/// Get the name of a VectorISA, which is also the suffix of its versions
+/// \param isa The instruction set
+/// \return `sse4.2`, `avx2` or `avx512`
+const char* vectorISAName(VectorISA isa);
+
+/// Parse a comma separated list of instruction sets, like `sse4.2,avx2,avx512`
+/// \param[in] list The list
+/// \param[out] toFill The instruction sets, without duplicates
+/// \pre `toFill != nullptr`
+/// \return The Result. EUKN if one isn't an instruction set that there are versions for.
+Result parseVectorISAs(const std::string& list, std::vector<VectorISA>* toFill);
+
+/// Give functions a version for each instruction set, and replace them with a dispatcher that
+/// calls the best one for the CPU it's running on. The CPU is checked with CPUID the first time
+/// one is called.
+///
+/// A version gets its own copy of everything it calls, so the code it calls is generated for the
+/// instruction set too--that includes the C functions that c-call nodes call. The other functions
+/// being versioned are called straight from their own version, not through the dispatcher. The
+/// variables they use are shared with the rest of the program. The original function becomes the
+/// version for CPUs without any of the instruction sets.
+///
+/// Functions with a profile that says they never ran (see applyProfile) are left alone.
+///
+/// It should be done before the module is optimized, so each version is optimized for its
+/// instruction set.
+/// \param module The module
+/// \param functionNames The functions to version. Ones that aren't defined in the module are
+/// skipped.
+/// \param isas The instruction sets to make versions for
+/// \return The Result. EUKN if the module doesn't target x86, or it has aliases or ifuncs.
+Result multiversionFunctions(LLVMModuleRef module, const std::vector<std::string>& functionNames,
+                             const std::vector<VectorISA>& isas);
+
+/// \}
+
+}  // namespace chi
+
+#endif  // CHI_MULTIVERSION_HPP
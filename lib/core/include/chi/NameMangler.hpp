@@ -6,6 +6,7 @@
 #ifndef CHI_NAME_MANGLER_HPP
 #define CHI_NAME_MANGLER_HPP
 
+#include <cstddef>
 #include <string>
 #include <utility>
 
@@ -21,7 +22,16 @@ namespace chi {
 /// \return The mangled name
 std::string mangleFunctionName(std::string fullModuleName, const std::string& name);
 
-/// Unmangle a function name
+/// Mangle the name of the clone of a function that's specialized for one of its exec inputs,
+/// which doesn't take the exec input ID. See GraphFunction::specializedFunctionType.
+/// \param fullModuleName The full name of the module
+/// \param name The name of the function
+/// \param execInputID The exec input it's specialized for
+/// \return The mangled name
+std::string mangleSpecializedFunctionName(std::string fullModuleName, const std::string& name,
+                                          size_t execInputID);
+
+/// Unmangle a function name. Specialized clones unmangle to the function they're a clone of.
 /// \param mangled The mangled name
 /// \return The unmangled name; {moduleName, functionName}
 std::pair<std::string, std::string> unmangleFunctionName(std::string mangled);
@@ -0,0 +1,109 @@
+/// \file chi/NativeCodegen.hpp
+/// Defines functions for turning linked modules into native objects and executables, generating
+/// code for parts of a module on their own threads
+
+#pragma once
+
+#ifndef CHI_NATIVE_CODEGEN_HPP
+#define CHI_NATIVE_CODEGEN_HPP
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "chi/Fwd.hpp"
+#include "chi/Target.hpp"
+
+namespace chi {
+
+/// Settings for emitObjectFiles
+struct CodegenSettings {
+	/// The optimization level of the code generator, from 0 to 3. The module isn't optimized any
+	/// further than it already is.
+	unsigned optimizationLevel = 2;
+
+	/// The most partitions to split the module into, each one generated on its own thread
+	unsigned threadCount = 1;
+
+	/// The machine to generate code for
+	TargetSettings target;
+};
+
+/// \name Native Code Generation
+/// \brief Generating native objects from modules and linking them into executables
+/// \{
+
+/// Get the name of a value
+/// \param value The value
+/// \return Its name, which is empty if it doesn't have one
+std::string valueName(LLVMValueRef value);
+
+/// Get if a function or global variable is local to its module, which means it has internal or
+/// private linkage
+/// \param global The function or global variable
+/// \return If it's local
+bool isLocal(LLVMValueRef global);
+
+/// Visit the global values that a constant references, like the functions and variables an
+/// instruction operand refers to, through constant expressions and aggregates
+/// \param value The constant. Anything else, including nullptr, is ignored.
+/// \param visited The constants that have been visited, which are skipped. It's added to.
+/// \pre `visited != nullptr`
+/// \param visitGlobal Called for each global value. If it returns true, what that global value
+/// references is visited too: a variable's initializer, or an alias's aliasee. It isn't for
+/// functions.
+void visitConstantReferences(LLVMValueRef value, std::unordered_set<LLVMValueRef>* visited,
+                             const std::function<bool(LLVMValueRef global)>& visitGlobal);
+
+/// Write a module to bitcode in memory
+/// \param module The module
+/// \return The bitcode
+std::string writeBitcode(LLVMModuleRef module);
+
+/// Replace the definition of a function or global variable with a declaration of it, keeping its
+/// name, visibility and everything that uses it
+/// \param global The function or global variable. It's deleted.
+/// \return The declaration
+LLVMValueRef replaceWithDeclaration(LLVMValueRef global);
+
+/// Generate native objects for a module, on up to `settings.threadCount` threads. The functions
+/// are split between partitions with about the same number of instructions each, and every
+/// partition is generated in its own LLVMContext. The global variables all go in the first one.
+///
+/// The partitions have to reference each other's local (internal or private) functions and
+/// variables, so those are made hidden and renamed to names unique to the module first. Modules
+/// with aliases aren't split.
+/// \param[in] module The module to generate code for. Its locals are renamed.
+/// \param[in] settings The settings
+/// \param[out] toFill The contents of each object file
+/// \pre `toFill != nullptr`
+/// \return The Result
+Result emitObjectFiles(LLVMModuleRef module, const CodegenSettings& settings,
+                       std::vector<std::string>* toFill);
+
+/// Write objects from emitObjectFiles to one object file, doing a relocatable link with the system
+/// linker if there's more than one
+/// \param objects The contents of each object file
+/// \param outpath The object file to write
+/// \pre `!objects.empty()`
+/// \return The Result
+Result writeObjectFile(const std::vector<std::string>& objects,
+                       const std::filesystem::path&    outpath);
+
+/// Link objects from emitObjectFiles into an executable with the system linker
+/// \param objects The contents of each object file
+/// \param inputFiles Other files to link in, like runtimeObjectPath()
+/// \param outpath The executable to write
+/// \pre `!objects.empty()`
+/// \return The Result
+Result linkExecutable(const std::vector<std::string>&           objects,
+                      const std::vector<std::filesystem::path>& inputFiles,
+                      const std::filesystem::path&              outpath);
+
+/// \}
+
+}  // namespace chi
+
+#endif  // CHI_NATIVE_CODEGEN_HPP
@@ -6,7 +6,9 @@
 #define CHI_NODE_COMPILER_HPP
 
 #include <cassert>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "chi/Fwd.hpp"
@@ -17,8 +19,9 @@ namespace chi {
 ///
 /// Nodes are compiled using many `BasicBlock`s
 /// The first are for the dependent pures, one for each.
-/// The idea is that you point the last pure to jump to the next pure,
-/// and when you get to the last pure, then go to the actual block for this node.
+/// Each pure is compiled straight into its block, which falls through to the next pure,
+/// and the last pure falls through to the actual block for this node. So there's no control flow
+/// between a node and its pures that the optimizer can't see through.
 struct NodeCompiler {
 	/// Constructor
 	/// \param functionCompiler The function compiler instance
@@ -47,23 +50,49 @@ struct NodeCompiler {
 	/// \return `node().type().pure()`
 	bool pure() const;
 
-	/// Add the basic blocks and fill the pure blocks, but don't fill the code block
+	/// Add the basic blocks for the pures and the code, but don't fill them
 	/// nop if its already been called with this inputExecID
 	/// \param inputExecID The input exec to compile
 	/// \pre `inputExecID < inputExecs()`
+	/// \pre `!pure()`
 	void compile_stage1(size_t inputExecID);
 
-	/// Fill the codegen block
+	/// Fill the pure blocks and the codegen block
 	/// If compile_stage1 hasn't been called for this inputExecID, then it will be called
 	/// nop if this inputExecID has been compiled before
 	/// \param trailingBlocks The basic blocks to br to when the node is done, one for each exec
 	/// output
-	/// \pre `pure() || (trailingBlock.size() == node().outputExecConnections.size())`
-	/// Either it's pure (in which case `trailingBlock` is ignored) or it must be defined
+	/// \pre `trailingBlock.size() == node().outputExecConnections.size()`
 	/// \param inputExecID The input exec ID to compile
 	/// \pre `inputExecID < inputExecs()`
+	/// \pre `!pure()`
 	Result compile_stage2(std::vector<LLVMBasicBlockRef> trailingBlocks, size_t inputExecID);
 
+	/// The values that pures stored to their outputs, for each pure, by output ID. nullptr if
+	/// it has to be loaded from returnValues() instead
+	using PureValues = std::unordered_map<const NodeInstance*, std::vector<LLVMValueRef>>;
+
+	/// Compile a pure node into a block of a node that uses it. It can be compiled any number of
+	/// times, all of them store to the same returnValues()
+	/// \param block The block to compile it into
+	/// \param trailingBlock The block to br to when it's done
+	/// \param consumer The non-pure node that it's being compiled for
+	/// \param consumerExecID The input exec of `consumer` that it's being compiled for
+	/// \param pureValues The values of the pures that were already compiled for `consumer`, which
+	/// are used instead of loading them. The values of this one are added to it.
+	/// \pre `pure()`
+	/// \pre `pureValues != nullptr`
+	/// \return The Result
+	Result compileInto(LLVMBasicBlockRef block, LLVMBasicBlockRef trailingBlock,
+	                   const NodeInstance& consumer, size_t consumerExecID,
+	                   PureValues* pureValues);
+
+	/// Remove the storage for outputs that are never loaded, because every node that uses them
+	/// got the value directly. The stores to them become debug values, which for pures only last
+	/// until the end of the node they were compiled into.
+	/// Only call once all the nodes in the function have been compiled
+	void removeUnusedStorage();
+
 	/// Get if compile_stage2 has been called for a given inputExecID
 	/// \param inputExecID the ID to check
 	/// \pre `inputExecID < inputExecs()`
@@ -99,42 +128,72 @@ struct NodeCompiler {
 	size_t inputExecs() const;
 
 	/// Get return values
-	/// \return a vector of the return values
+	/// \return a vector of the return values. The ones that removeUnusedStorage() removed are
+	/// nullptr
 	std::vector<LLVMValueRef> returnValues() const { return mReturnValues; }
 
-	/// Get the IndirectBrInst* for the pure
-	/// \pre `pure()`
-	/// \return The indirectbr instance
-	LLVMValueRef jumpBackInst() const {
-		assert(pure() && "Cannot get jump back inst for a nonpure node");
-		return mJumpBackInst;
-	}
-
 private:
+	Result codegenInto(LLVMBasicBlockRef block, size_t inputExecID,
+	                   const std::vector<LLVMBasicBlockRef>& trailingBlocks,
+	                   const NodeInstance& consumer, size_t consumerExecID,
+	                   const PureValues& pureValues, std::vector<LLVMValueRef>* storedValues);
+
 	FunctionCompiler* mCompiler;
 	NodeInstance*     mNode;
 
-	std::vector<std::vector<LLVMBasicBlockRef>> mPureBlocks;
-	std::vector<LLVMBasicBlockRef>              mCodeBlocks;
+	// the pures to evaluate before each input exec, and the blocks they're compiled into
+	std::vector<std::vector<std::pair<NodeInstance*, LLVMBasicBlockRef>>> mPureBlocks;
+	std::vector<LLVMBasicBlockRef>                                        mCodeBlocks;
 
 	std::vector<LLVMValueRef> mReturnValues;
 
-	std::vector<bool> mCompiledInputs;
+	// for each output
+	std::vector<LLVMMetadataRef> mOutputDebugVariables;
+	std::vector<LLVMValueRef>    mOutputDeclares;
 
-	LLVMValueRef mJumpBackInst = nullptr;
+	// the values stored to the outputs by each input exec, see PureValues
+	std::vector<std::vector<LLVMValueRef>> mStoredValues;
+
+	// for pures, the blocks that run after the nodes they were compiled into, where their values
+	// aren't needed anymore
+	std::vector<LLVMBasicBlockRef> mValueEnds;
+
+	std::vector<bool> mCompiledInputs;
 };
 
 /// Get the pures a NodeInstance relies on
 /// These are all the dependent pures (it's fetched recursively)
 /// They are in the order of dependency, for examply if node X depends on node Y, then node Y will
-/// come before node X
-/// \warning Recursive based on how many pures are in a chain. Cyclic pure dependencies will crash.
-/// TODO: make sure they don't crash, and issue a nice error
+/// come before node X. Each one is only in it once.
+/// \warning Recursive based on how many pures are in a chain. Cyclic pure dependencies are cut
+/// off where they loop back, which still won't compile to anything that makes sense.
 /// \param inst The NodeInstance to get the dependent pures for
 /// \return All the directly dependent pures
 /// \post all the elements in the return are pure
 std::vector<NodeInstance*> dependentPuresRecursive(const NodeInstance& inst);
 
+/// Find the pures that don't need to be evaluated again before each non-pure node runs, because
+/// every path to it from the entry has already evaluated them, and nothing they depend on has
+/// changed since.
+///
+/// A pure changes when a non-pure node it depends on runs again, or when a `_set_` node sets a
+/// local variable that it gets. Ones that read memory (see NodeType::readsMemory) change when any
+/// non-pure node runs. Pure nodes are assumed to depend on nothing else.
+/// \param func The function to analyze
+/// \return For each non-pure node that can be reached from the entry, the available pures for
+/// each of its input execs
+std::unordered_map<const NodeInstance*, std::vector<std::unordered_set<NodeInstance*>>>
+availablePures(const GraphFunction& func);
+
+/// Find the non-pure nodes that have run before each non-pure node on every path to it from the
+/// entry. Only nodes that can only be run from one input exec are counted, so their outputs can
+/// be used directly instead of going through memory.
+/// \param func The function to analyze
+/// \return For each non-pure node that can be reached from the entry, the nodes that always run
+/// before each of its input execs
+std::unordered_map<const NodeInstance*, std::vector<std::unordered_set<const NodeInstance*>>>
+nodesThatAlwaysRunBefore(const GraphFunction& func);
+
 }  // namespace chi
 
 #endif  // CHI_NODE_COMPILER_HPP
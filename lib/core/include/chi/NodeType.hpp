@@ -49,6 +49,29 @@ public:
 	                       const std::vector<LLVMValueRef>&      io,
 	                       const std::vector<LLVMBasicBlockRef>& outputBlocks) = 0;
 
+	/// Work out the outputs of a pure node from inputs that are all known before the program runs,
+	/// so it doesn't have to be compiled. The default can't.
+	/// \param inputs The constant values of the inputs, one for each data input
+	/// \param[out] toFill The constant values of the outputs, one for each data output
+	/// \pre `pure()`
+	/// \return If it was folded. If it wasn't, toFill isn't touched.
+	virtual bool constantFold(const std::vector<LLVMValueRef>& inputs,
+	                          std::vector<LLVMValueRef>*       toFill) const {
+		return false;
+	}
+
+	/// Get the exec outputs that can be taken, from what's known about the inputs before the
+	/// program runs
+	/// \param inputs The constant values of the inputs, nullptr for the ones that aren't known
+	/// \return If each exec output can ever be taken. The default is that all of them can.
+	virtual std::vector<bool> reachableExecOutputs(const std::vector<LLVMValueRef>& inputs) const;
+
+	/// Get the graph functions that the code for this node calls without the node being a call to
+	/// them, like the body of a loop it runs. Only their declarations are in the code, so their
+	/// interfaces are part of the cache keys of the functions the node is in. The default is none.
+	/// \return The functions that are still loaded
+	virtual std::vector<const GraphFunction*> referencedFunctions() const { return {}; }
+
 	/// Create the JSON necessary to store the object.
 	/// \return The json obejct
 	virtual nlohmann::json toJSON() const { return {}; }
@@ -83,10 +106,15 @@ public:
 
 	/// Get if this node is pure
 	/// \return If it's pure
-	bool pure() { return mPure; }
+	bool pure() const { return mPure; }
 
 	/// Get if this node is a converter
-	bool converter() { return mConverter; }
+	bool converter() const { return mConverter; }
+
+	/// Get if this pure node reads memory that non-pure nodes can write, like the elements of a
+	/// buffer
+	/// \return If it reads memory
+	bool readsMemory() const { return mReadsMemory; }
 
 protected:
 	/// Set the data inputs for the NodeType
@@ -124,6 +152,11 @@ protected:
 	/// Allows for this node to be created automatically for conversions
 	void makeConverter();
 
+	/// Make this pure node read memory, so it's evaluated again after any non-pure node runs
+	/// instead of only when what it's connected to changes. See availablePures.
+	/// \pre `pure() == true`
+	void makeReadsMemory();
+
 	/// Get the node instance
 	/// \return the node instance
 	NodeInstance* nodeInstance() const;
@@ -141,8 +174,9 @@ private:
 	std::vector<std::string> mExecInputs;
 	std::vector<std::string> mExecOutputs;
 
-	bool mPure      = false;
-	bool mConverter = false;
+	bool mPure        = false;
+	bool mConverter   = false;
+	bool mReadsMemory = false;
 };
 }  // namespace chi
 
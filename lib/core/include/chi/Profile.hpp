@@ -0,0 +1,116 @@
+/// \file chi/Profile.hpp
+/// Defines execution profiles and the functions to collect them from instrumented modules, use
+/// them to optimize, and find the nodes they were spent in
+
+#pragma once
+
+#ifndef CHI_PROFILE_HPP
+#define CHI_PROFILE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "chi/Fwd.hpp"
+#include "chi/Support/json.hpp"
+
+namespace chi {
+
+/// The counts collected for one function of an instrumented module
+struct FunctionProfile {
+	/// The name of the function in the module
+	std::string name;
+
+	/// A hash of the function's control flow graph. A profile only applies to a function with the
+	/// same one.
+	std::string cfgHash;
+
+	/// How many times each basic block ran, in order, followed by how many times each successor of
+	/// each conditional branch or switch was taken, in block order
+	std::vector<uint64_t> counts;
+
+	/// The debug info lines in each basic block. Graph modules put each node on its own line, see
+	/// GraphModule::createLineNumberAssoc.
+	std::vector<std::vector<unsigned>> blockLines;
+};
+
+/// A profile of a program, from running it after instrumentProfiling
+struct Profile {
+	/// The functions it has counts for
+	std::vector<FunctionProfile> functions;
+};
+
+/// How many times a node ran, according to a Profile
+struct NodeCount {
+	/// The node
+	NodeInstance* node;
+
+	/// How many times it ran
+	uint64_t count;
+};
+
+/// \name Profiling
+/// \brief Profile guided optimization, from instrumenting to using profiles
+/// \{
+
+/// Instrument a module to count how many times each basic block runs and each branch is taken.
+/// The counts are written to `rawProfilePath`, relative to the working directory of the program,
+/// when it exits.
+/// \param module The module. It should be linked, but not optimized yet, so the profile applies to
+/// the module applyProfile is given.
+/// \param rawProfilePath Where to write the raw profile, which readProfile reads
+void instrumentProfiling(LLVMModuleRef module, const std::string& rawProfilePath);
+
+/// Read a profile, either a raw one written by an instrumented module or one written as JSON by
+/// profileToJson
+/// \param[in] path The profile
+/// \param[out] toFill The profile
+/// \pre `toFill != nullptr`
+/// \return The Result. E55 if it isn't a profile.
+Result readProfile(const std::filesystem::path& path, Profile* toFill);
+
+/// Add the counts of one profile to another, like from two runs of the same program
+/// \param[in] from The profile to add
+/// \param[in,out] into The profile to add it to
+/// \pre `into != nullptr`
+/// \return The Result. E56 if a function is in both with a different cfgHash.
+Result mergeProfiles(const Profile& from, Profile* into);
+
+/// Serialize a Profile to JSON
+/// \param profile The profile
+/// \return The JSON
+nlohmann::json profileToJson(const Profile& profile);
+
+/// Deserialize a Profile from JSON, as written by profileToJson
+/// \param[in] data The JSON
+/// \param[out] toFill The profile
+/// \pre `toFill != nullptr`
+/// \return The Result. E55 if the JSON isn't a profile.
+Result jsonToProfile(const nlohmann::json& data, Profile* toFill);
+
+/// Annotate a module with the counts from a profile, for the optimizer to use. Functions get their
+/// entry counts, branches and switches get branch weights, and the module gets a profile summary so
+/// hot and cold code can be told apart. It should be the module that was instrumented, compiled
+/// the same way.
+/// \param module The module, not optimized yet
+/// \param profile The profile
+/// \return The Result. There's a warning for each function that changed since it was profiled.
+Result applyProfile(LLVMModuleRef module, const Profile& profile);
+
+/// Find how many times each node ran, from the lines of the blocks it's in. A node runs as many
+/// times as the hottest block with its line in it, added up over the specialized clones of its
+/// function.
+/// \param[in] context The context. The modules in the profile that are loaded in it are used.
+/// \param[in] profile The profile
+/// \param[out] toFill The nodes of each GraphFunction that ran, hottest first
+/// \pre `toFill != nullptr`
+void attributeProfileToNodes(Context& context, const Profile& profile,
+                             std::unordered_map<GraphFunction*, std::vector<NodeCount>>* toFill);
+
+/// \}
+
+}  // namespace chi
+
+#endif  // CHI_PROFILE_HPP
@@ -0,0 +1,63 @@
+/// \file chi/Target.hpp
+/// Defines the machine that modules are compiled for, and functions for making target machines
+/// and modules agree on it
+
+#pragma once
+
+#ifndef CHI_TARGET_HPP
+#define CHI_TARGET_HPP
+
+#include <llvm-c/TargetMachine.h>
+
+#include <string>
+
+#include "chi/Fwd.hpp"
+#include "chi/Owned.hpp"
+
+namespace chi {
+
+/// The machine to generate code for
+struct TargetSettings {
+	/// The target triple, or empty for the host's
+	std::string triple;
+
+	/// The CPU, like `skylake`. Empty for a generic CPU, or `native` for the host's.
+	std::string cpu;
+
+	/// The CPU features to turn on or off on top of the CPU's own, like `+avx2,-fma`. `native`
+	/// for all the features of the host.
+	std::string features;
+};
+
+/// \name Targets
+/// \brief Making target machines and giving modules their triple, data layout, CPU and features
+/// \{
+
+/// Create a target machine
+/// \param[in] settings The target. `native` is resolved to the host CPU or its features.
+/// \param[in] optLevel The optimization level of the code generator
+/// \param[in] relocMode The relocation model
+/// \param[out] toFill The target machine
+/// \pre `toFill != nullptr`
+/// \return The Result. EUKN if the native target couldn't be initialized or the triple isn't a
+/// target chigraph was built with.
+Result createTargetMachine(const TargetSettings& settings, LLVMCodeGenOptLevel optLevel,
+                           LLVMRelocMode relocMode, OwnedTargetMachine* toFill);
+
+/// Get the target a target machine generates code for, with `native` resolved
+/// \param machine The target machine
+/// \return The triple, CPU and features of the machine
+TargetSettings targetMachineSettings(LLVMTargetMachineRef machine);
+
+/// Make a module target a machine. It gets the triple and data layout of the machine, and every
+/// function defined in it gets its CPU and features, like clang does, so they're kept when it's
+/// written as bitcode and generated somewhere else.
+/// \param module The module
+/// \param machine The target machine
+void setModuleTarget(LLVMModuleRef module, LLVMTargetMachineRef machine);
+
+/// \}
+
+}  // namespace chi
+
+#endif  // CHI_TARGET_HPP
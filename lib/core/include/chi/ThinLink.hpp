@@ -0,0 +1,118 @@
+/// \file chi/ThinLink.hpp
+/// Defines module summaries and the thin link, which optimizes the modules of a build on their own
+/// threads before they're linked together
+
+#pragma once
+
+#ifndef CHI_THIN_LINK_HPP
+#define CHI_THIN_LINK_HPP
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "chi/Fwd.hpp"
+#include "chi/Owned.hpp"
+#include "chi/Support/json.hpp"
+#include "chi/Target.hpp"
+
+namespace chi {
+
+/// What the thin link needs to know about a function defined in a module
+struct FunctionSummary {
+	/// The name of the function
+	std::string name;
+
+	/// How many instructions it has, which is what importing it costs
+	size_t instructionCount = 0;
+
+	/// If it can be imported into other modules. Functions that reference local (internal or
+	/// private) functions or variables can't be, because the copy couldn't see them.
+	bool importable = false;
+
+	/// The externally visible functions it references, in the order they're first referenced
+	std::vector<std::string> references;
+};
+
+/// A summary of a compiled module, like the ones ThinLTO makes. It's written next to each module
+/// in the HashedModuleCache, so imports can be planned without reading the modules.
+struct ModuleSummary {
+	/// The name of the module
+	std::string moduleName;
+
+	/// The functions it defines
+	std::vector<FunctionSummary> functions;
+};
+
+/// The functions each module in a thin link imports. For each module, the index of the module to
+/// import from, to the names of the functions to import from it.
+using ImportLists = std::vector<std::map<size_t, std::vector<std::string>>>;
+
+/// Settings for thinLinkModules
+struct ThinLinkSettings {
+	/// The optimization level, from 0 to 3
+	unsigned optimizationLevel = 2;
+
+	/// The number of modules to optimize at once
+	unsigned threadCount = 1;
+
+	/// The machine to optimize for
+	TargetSettings target;
+
+	/// The most instructions a function can have to be imported by the modules that call it
+	size_t importInstructionThreshold = 100;
+};
+
+/// \name Thin Link
+/// \brief Optimizing the modules of a build separately, importing what they need from each other
+/// \{
+
+/// Summarize a compiled module
+/// \param module The module
+/// \param moduleName The name to give the summary
+/// \return The ModuleSummary
+ModuleSummary summarizeModule(LLVMModuleRef module, const std::string& moduleName);
+
+/// Serialize a ModuleSummary to JSON
+/// \param summary The summary
+/// \return The JSON
+nlohmann::json moduleSummaryToJson(const ModuleSummary& summary);
+
+/// Deserialize a ModuleSummary from JSON, as written by moduleSummaryToJson
+/// \param[in] data The JSON
+/// \param[out] toFill The summary
+/// \pre `toFill != nullptr`
+/// \return The Result. E54 if the JSON isn't a module summary.
+Result jsonToModuleSummary(const nlohmann::json& data, ModuleSummary* toFill);
+
+/// Decide what each module imports from the others. A function that a module references but
+/// doesn't define is imported if it's importable and has at most `threshold` instructions. The
+/// functions it references are then considered with a lower threshold, like ThinLTO does.
+/// \param summaries The summaries of every module being linked
+/// \param threshold The most instructions a function referenced directly can have
+/// \return The ImportLists, with one entry for each summary
+ImportLists computeImports(const std::vector<ModuleSummary>& summaries, size_t threshold);
+
+/// Optimize modules on their own, on up to `settings.threadCount` threads, then link them. Each
+/// module gets copies of the functions it imports (see computeImports) first, so they can be
+/// inlined into it, and they're dropped again after optimizing.
+///
+/// Each thread has its own LLVMContext, so the modules are moved between contexts as bitcode.
+/// \param[in] modules The modules, in the order they're linked. They're all destroyed.
+/// \param[in] summaries The summary of each module
+/// \param[in] settings The settings
+/// \param[in] ctx The context to create the linked module in
+/// \param[out] toFill The linked module
+/// \pre `modules.size() == summaries.size()`, `!modules.empty()` and `toFill != nullptr`
+/// \return The Result
+Result thinLinkModules(std::vector<OwnedLLVMModule>       modules,
+                       const std::vector<ModuleSummary>& summaries,
+                       const ThinLinkSettings& settings, LLVMContextRef ctx,
+                       OwnedLLVMModule* toFill);
+
+/// \}
+
+}  // namespace chi
+
+#endif  // CHI_THIN_LINK_HPP
@@ -46,6 +46,35 @@ Result parseBitcodeFile(const std::filesystem::path& file, LLVMContextRef ctx,
 	}
 	return parseBitcodeMemBuff(*buffer, ctx, toFill);
 }  // namespace chi
+Result parseBitcodeFileLazily(const std::filesystem::path& file, LLVMContextRef ctx,
+                              OwnedLLVMModule* toFill) {
+	assert(toFill != nullptr && "Cannot pass a null toFill pointer to parseBitcodeFileLazily");
+
+	Result res;
+
+	OwnedMessage          message;
+	OwnedLLVMMemoryBuffer buffer;
+	if (LLVMCreateMemoryBufferWithContentsOfFile(file.string().c_str(), &*buffer, &*message)) {
+		res.addEntry("EUKN", "Failed to load LLVM module from disk",
+		             {{"File", file.string()}, {"Error Message", *message}});
+
+		return res;
+	}
+
+	// the module takes ownership of the buffer, it reads function bodies from it as needed
+	LLVMModuleRef module;
+	if (LLVMGetBitcodeModuleInContext2(ctx, *buffer, &module)) {
+		res.addEntry("EUKN", "Failed to parse bitcode", {{"File", file.string()}});
+
+		return res;
+	}
+	buffer.take_ownership();
+
+	*toFill = OwnedLLVMModule(module);
+
+	return res;
+}
+
 Result parseBitcodeString(const std::string& bitcode, LLVMContextRef ctx, OwnedLLVMModule* toFill) {
 	return parseBitcodeMemBuff(*OwnedLLVMMemoryBuffer(LLVMCreateMemoryBufferWithMemoryRange(
 	                               bitcode.data(), bitcode.length(), "generated.bc", false)),
@@ -0,0 +1,91 @@
+/// \file CompileSession.cpp
+
+#include "chi/CompileSession.hpp"
+
+#include <llvm-c/Core.h>
+
+#include <cassert>
+#include <deque>
+#include <unordered_set>
+
+#include "chi/ChiModule.hpp"
+#include "chi/Support/Result.hpp"
+
+namespace fs = std::filesystem;
+
+namespace chi {
+
+CompileSession::CompileSession(Context& ctx, Flags<CompileSettings> settings)
+    : mContext{&ctx}, mSettings{settings} {}
+
+OwnedLLVMModule CompileSession::cloneCompiledModule(const ChiModule& mod) {
+	auto iter = mCompiledModules.find(&mod);
+	if (iter == mCompiledModules.end()) {
+		++mStats.moduleMisses;
+		return nullptr;
+	}
+
+	++mStats.moduleHits;
+	return OwnedLLVMModule(LLVMCloneModule(*iter->second));
+}
+
+OwnedLLVMModule CompileSession::addCompiledModule(const ChiModule& mod, OwnedLLVMModule compiled) {
+	assert(compiled && "Cannot add a null module to a CompileSession");
+
+	auto clone = OwnedLLVMModule(LLVMCloneModule(*compiled));
+	mCompiledModules[&mod] = std::move(compiled);
+
+	return clone;
+}
+
+Result CompileSession::transitiveDependencies(ChiModule&                     mod,
+                                              const std::vector<ChiModule*>** toFill) {
+	assert(toFill != nullptr);
+
+	Result res;
+
+	auto iter = mTransitiveDependencies.find(&mod);
+	if (iter != mTransitiveDependencies.end()) {
+		++mStats.dependencyHits;
+		*toFill = &iter->second;
+		return res;
+	}
+	++mStats.dependencyMisses;
+
+	std::vector<ChiModule*>        deps;
+	std::unordered_set<ChiModule*> added;
+
+	// breadth first search, but stop at modules that already have theirs figured out
+	std::deque<const fs::path*> depsToAdd;
+	for (const auto& dep : mod.dependencies()) { depsToAdd.push_back(&dep); }
+
+	while (!depsToAdd.empty()) {
+		const auto& depName = *depsToAdd.front();
+		depsToAdd.pop_front();
+
+		auto depMod = context().moduleByFullName(depName);
+		if (depMod == nullptr) {
+			res.addEntry("E36", "Could not find module", {{"module", depName.generic_string()}});
+			return res;
+		}
+
+		if (!added.insert(depMod).second) { continue; }
+		deps.push_back(depMod);
+
+		auto knownIter = mTransitiveDependencies.find(depMod);
+		if (knownIter != mTransitiveDependencies.end()) {
+			for (auto depOfDep : knownIter->second) {
+				if (added.insert(depOfDep).second) { deps.push_back(depOfDep); }
+			}
+			continue;
+		}
+
+		for (const auto& depOfDep : depMod->dependencies()) { depsToAdd.push_back(&depOfDep); }
+	}
+
+	*toFill = &mTransitiveDependencies.emplace(&mod, std::move(deps)).first->second;
+
+	return res;
+}
+
+}  // namespace chi
@@ -3,31 +3,38 @@
 #include "chi/Context.hpp"
 
 #include <llvm-c/Analysis.h>
+#include <llvm-c/BitWriter.h>
 #include <llvm-c/Core.h>
 #include <llvm-c/DebugInfo.h>
 #include <llvm-c/IRReader.h>
 #include <llvm-c/Linker.h>
 #include <llvm-c/Target.h>
 
+#include <algorithm>
+#include <atomic>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/range.hpp>
-#include <deque>
 #include <filesystem>
 #include <fstream>
-#include <unordered_set>
+#include <set>
+#include <thread>
 
 #include "chi/BitcodeParser.hpp"
-#include "chi/DefaultModuleCache.hpp"
+#include "chi/CompileSession.hpp"
 #include "chi/GraphFunction.hpp"
 #include "chi/GraphModule.hpp"
 #include "chi/GraphStruct.hpp"
+#include "chi/HashedModuleCache.hpp"
+#include "chi/JitSession.hpp"
 #include "chi/JsonDeserializer.hpp"
+#include "chi/JsonSerializer.hpp"
 #include "chi/LangModule.hpp"
 #include "chi/NodeInstance.hpp"
 #include "chi/NodeType.hpp"
 #include "chi/Owned.hpp"
 #include "chi/Support/ExecutablePath.hpp"
 #include "chi/Support/Result.hpp"
+#include "chi/ThinLink.hpp"
 
 namespace fs = std::filesystem;
 
@@ -65,22 +72,93 @@ Result verifyModuleIfDebug(LLVMModuleRef module) {
 #endif
 	return res;
 }
+
+// Link a lazily loaded module into another, only materializing what's reachable from dest.
+// The linker skips linkonce definitions that nothing uses, and it materializes the ones it does
+// link, so every external definition in src is made linkonce_odr while linking and put back after.
+Result linkLazily(LLVMModuleRef dest, OwnedLLVMModule src) {
+	Result res;
+
+	std::vector<std::string> madeLinkOnce;
+
+	auto makeLinkOnce = [&](LLVMValueRef global) {
+		if (LLVMIsDeclaration(global) || LLVMGetLinkage(global) != LLVMExternalLinkage) { return; }
+
+		size_t      nameLen;
+		const char* name = LLVMGetValueName2(global, &nameLen);
+
+		madeLinkOnce.emplace_back(name, nameLen);
+		LLVMSetLinkage(global, LLVMLinkOnceODRLinkage);
+	};
+	for (auto func = LLVMGetFirstFunction(*src); func != nullptr;
+	     func      = LLVMGetNextFunction(func)) {
+		makeLinkOnce(func);
+	}
+	for (auto global = LLVMGetFirstGlobal(*src); global != nullptr;
+	     global      = LLVMGetNextGlobal(global)) {
+		makeLinkOnce(global);
+	}
+
+	// forward declarations that nothing calls would still pull their definitions in
+	for (const auto& name : madeLinkOnce) {
+		auto decl = LLVMGetNamedFunction(dest, name.c_str());
+		if (decl != nullptr && LLVMIsDeclaration(decl) && LLVMGetFirstUse(decl) == nullptr) {
+			LLVMDeleteFunction(decl);
+		}
+	}
+
+	if (LLVMLinkModules2(dest, src.take_ownership())) {
+		res.addEntry("EINT", "Failed to link modules", {});
+		return res;
+	}
+
+	for (const auto& name : madeLinkOnce) {
+		auto global = LLVMGetNamedFunction(dest, name.c_str());
+		if (global == nullptr) { global = LLVMGetNamedGlobal(dest, name.c_str()); }
+
+		if (global != nullptr && LLVMGetLinkage(global) == LLVMLinkOnceODRLinkage) {
+			LLVMSetLinkage(global, LLVMExternalLinkage);
+		}
+	}
+
+	return res;
+}
+
 }  // namespace
 
 Context::Context(const std::filesystem::path& workPath) {
 	mWorkspacePath = workspaceFromChildPath(workPath);
 
-	mModuleCache = std::make_unique<DefaultModuleCache>(*this);
+	mModuleCache = std::make_unique<HashedModuleCache>(*this);
 
 	mLLVMContext = OwnedLLVMContext(LLVMContextCreate());
+
+	// the host can always be targeted
+	setTarget({});
 }
 
 Context::~Context() = default;
 
+Result Context::setTarget(const TargetSettings& settings) {
+	Result res;
+
+	OwnedTargetMachine machine;
+	res += createTargetMachine(settings, LLVMCodeGenLevelDefault, LLVMRelocDefault, &machine);
+	if (!res) { return res; }
+
+	mTargetMachine = std::move(machine);
+	mTarget        = targetMachineSettings(*mTargetMachine);
+
+	return res;
+}
+
+void Context::applyTarget(LLVMModuleRef module) const {
+	if (*mTargetMachine != nullptr) { setModuleTarget(module, *mTargetMachine); }
+}
+
 ChiModule* Context::moduleByFullName(const std::filesystem::path& fullModuleName) const noexcept {
-	for (auto& module : mModules) {
-		if (module->fullName() == fullModuleName) { return module.get(); }
-	}
+	auto iter = mModulesByName.find(fullModuleName.generic_string());
+	if (iter != mModulesByName.end()) { return iter->second; }
 	return nullptr;
 }
 
@@ -243,6 +321,7 @@ bool Context::addModule(std::unique_ptr<ChiModule> modToAdd) noexcept {
 		               [ty->dataOutputs()[0].type.qualifiedName()] = std::move(ty);
 	}
 
+	mModulesByName.emplace(modToAdd->fullName(), modToAdd.get());
 	mModules.push_back(std::move(modToAdd));
 
 	return true;
@@ -250,15 +329,20 @@ bool Context::addModule(std::unique_ptr<ChiModule> modToAdd) noexcept {
 
 bool Context::unloadModule(const fs::path& fullName) {
 	// find the module, and if we see it then delete it
-	for (auto idx = 0ull; idx < mModules.size(); ++idx) {
-		if (mModules[idx]->fullName() == fullName) {
-			mModules.erase(mModules.begin() + idx);
-			return true;
-		}
-	}
+	auto indexIter = mModulesByName.find(fullName.generic_string());
+	if (indexIter == mModulesByName.end()) { return false; }
+
+	auto modToRemove = indexIter->second;
+	mModulesByName.erase(indexIter);
+
+	auto iter = std::find_if(mModules.begin(), mModules.end(),
+	                         [&](const auto& mod) { return mod.get() == modToRemove; });
+	assert(iter != mModules.end() && "Module index is out of sync with the module list");
 
-	// if we get here it wasn't removed
-	return false;
+	if (modToRemove == mLangModule) { mLangModule = nullptr; }
+	mModules.erase(iter);
+
+	return true;
 }
 
 Result Context::typeFromModule(const fs::path& module, std::string_view name,
@@ -324,15 +408,29 @@ Result Context::compileModule(const std::filesystem::path& fullName,
 
 Result Context::compileModule(ChiModule& mod, Flags<CompileSettings> settings,
                               OwnedLLVMModule* toFill) {
+	CompileSession session{*this, settings};
+
+	return compileModule(mod, session, toFill);
+}
+
+Result Context::compileModule(ChiModule& mod, CompileSession& session, OwnedLLVMModule* toFill) {
 	assert(toFill != nullptr);
+	assert(&session.context() == this && "Cannot compile with a session from another Context");
 
 	Result res;
 
 	auto modNameCtx = res.addScopedContext({{"Module Name", mod.fullName()}});
 
-	// generate module or load it from the cache
-	OwnedLLVMModule llmod;
-	{
+	auto settings = session.settings();
+
+	if (!(settings & CompileSettings::LinkDependencies)) {
+		// see if it's already been compiled in this build
+		auto llmod = session.cloneCompiledModule(mod);
+		if (llmod) {
+			*toFill = std::move(llmod);
+			return res;
+		}
+
 		// try to get it from the cache
 		if (settings & CompileSettings::UseCache) {
 			llmod = moduleCache().retrieveFromCache(mod.fullNamePath(), mod.lastEditTime());
@@ -340,111 +438,350 @@ Result Context::compileModule(ChiModule& mod, Flags<CompileSettings> settings,
 
 		// compile it if the cache failed or if
 		if (!llmod) {
-			llmod = OwnedLLVMModule(
-			    LLVMModuleCreateWithNameInContext(mod.fullName().c_str(), llvmContext()));
-
-			// add forward declartions for all dependencies
-			{
-				std::unordered_set<fs::path> added(mod.dependencies().begin(),
-				                                   mod.dependencies().end());
-				std::deque<fs::path>         depsToAdd(mod.dependencies().begin(),
-                                               mod.dependencies().end());
-				while (!depsToAdd.empty()) {
-					auto& depName = depsToAdd[0];
-
-					auto depMod = moduleByFullName(depName);
-					if (depMod == nullptr) {
-						res.addEntry("E36", "Could not find module",
-						             {{"module", depName.generic_string()}});
-						return res;
-					}
-
-					res += depMod->addForwardDeclarations(*llmod);
-					if (!res) { return res; }
-
-					for (const auto& depOfDep : depMod->dependencies()) {
-						if (added.find(depOfDep) == added.end()) {
-							depsToAdd.push_back(depOfDep);
-							added.insert(depOfDep);
-						}
-					}
-					depsToAdd.pop_front();
-				}
-			}
+			res += generateModuleIR(mod, session, &llmod);
 
-			res += mod.generateModule(*llmod);
+			// exit if there's already an error to avoid caching it
+			if (!res) { return res; }
 
-			// set debug info version if it doesn't already have it
-			const char* DIVKey = "Debug Info Version";
-			if (LLVMGetModuleFlag(*llmod, DIVKey, strlen(DIVKey)) == nullptr) {
-				LLVMAddModuleFlag(*llmod, LLVMModuleFlagBehaviorWarning, DIVKey, strlen(DIVKey),
-				                  LLVMValueAsMetadata(constI32(LLVMDebugMetadataVersion())));
-			}
+			// cache the module
+			res += moduleCache().cacheModule(mod.fullNamePath(), *llmod, mod.lastEditTime());
+		}
+
+		*toFill = session.addCompiledModule(mod, std::move(llmod));
+
+		return res;
+	}
+
+	std::vector<ChiModule*>      buildOrder;
+	std::vector<OwnedLLVMModule> compiledModules;
+	std::vector<bool>            loadedLazily;
+	res += compileBuild(mod, session, true, &buildOrder, &compiledModules, &loadedLazily);
+	if (!res) { return res; }
+
+	// link them all into the module being compiled, which is last in the build order. Dependents
+	// go first, so by the time a lazily loaded module is linked everything that uses it is there
+	OwnedLLVMModule llmod = std::move(compiledModules.back());
+	compiledModules.pop_back();
+
+	for (auto idx = compiledModules.size(); idx-- > 0;) {
+		if (loadedLazily[idx]) {
+			res += linkLazily(*llmod, std::move(compiledModules[idx]));
+			if (!res) { return res; }
+
+			continue;
+		}
+
+		if (LLVMLinkModules2(*llmod, compiledModules[idx].take_ownership())) {
+			res.addEntry("EINT", "Failed to link modules", {});
+			return res;
+		}
+	}
+
+	// link in runtime if this is a main module
+	if (mod.shortName() == "main" && !(settings & CompileSettings::NativeRuntime)) {
+		OwnedLLVMModule runtimeMod;
+		res += runtimeModule(&runtimeMod);
+		if (!res) { return res; }
+
+		if (LLVMLinkModules2(*llmod, runtimeMod.take_ownership())) {
+			res.addEntry("EINT", "Failed to link modules", {});
+			return res;
 		}
+
+		res += verifyModuleIfDebug(*llmod);
+		if (!res) return res;
 	}
 
-	// exit if there's already an error to avoid caching it
+	*toFill = std::move(llmod);
+
+	return res;
+}
+
+Result Context::compileModuleWithThinLink(ChiModule& mod, CompileSession& session,
+                                          const ThinLinkSettings& settings,
+                                          OwnedLLVMModule*        toFill) {
+	assert(toFill != nullptr);
+	assert(&session.context() == this && "Cannot compile with a session from another Context");
+	assert((session.settings() & CompileSettings::LinkDependencies) &&
+	       "A thin link needs the dependencies to be linked in");
+
+	Result res;
+
+	auto modNameCtx = res.addScopedContext({{"Module Name", mod.fullName()}});
+
+	// the modules are written to bitcode for the workers anyways, so there's nothing to gain from
+	// loading them lazily
+	std::vector<ChiModule*>      buildOrder;
+	std::vector<OwnedLLVMModule> compiledModules;
+	std::vector<bool>            loadedLazily;
+	res += compileBuild(mod, session, false, &buildOrder, &compiledModules, &loadedLazily);
+	if (!res) { return res; }
+
+	// link them in the same order compileModule does. Every module was cached with its summary
+	// when it was compiled, so they're only summarized here when there's no cache to read from.
+	auto                         hashedCache = dynamic_cast<HashedModuleCache*>(&moduleCache());
+	std::vector<OwnedLLVMModule> toLink;
+	std::vector<ModuleSummary>   summaries;
+	for (auto idx = buildOrder.size(); idx-- > 0;) {
+		ModuleSummary summary;
+		if (hashedCache == nullptr ||
+		    !hashedCache->retrieveSummary(buildOrder[idx]->fullNamePath(), &summary)) {
+			summary = summarizeModule(*compiledModules[idx], buildOrder[idx]->fullName());
+		}
+		summaries.push_back(std::move(summary));
+		toLink.push_back(std::move(compiledModules[idx]));
+	}
+
+	if (mod.shortName() == "main" && !(session.settings() & CompileSettings::NativeRuntime)) {
+		OwnedLLVMModule runtimeMod;
+		res += runtimeModule(&runtimeMod);
+		if (!res) { return res; }
+
+		summaries.push_back(summarizeModule(*runtimeMod, "runtime"));
+		toLink.push_back(std::move(runtimeMod));
+	}
+
+	OwnedLLVMModule llmod;
+	res += thinLinkModules(std::move(toLink), summaries, settings, llvmContext(), &llmod);
 	if (!res) { return res; }
 
 	res += verifyModuleIfDebug(*llmod);
 	if (!res) { return res; }
 
-	// cache the module
-	res += moduleCache().cacheModule(mod.fullNamePath(), *llmod, mod.lastEditTime());
+	*toFill = std::move(llmod);
 
-	// generate dependencies
-	if (settings & CompileSettings::LinkDependencies) {
-		for (const auto& depName : mod.dependencies()) {
-			OwnedLLVMModule compiledDep;
-			res += compileModule(depName, settings,
-			                     &compiledDep);  // TODO(#62): detect circular dependencies
+	return res;
+}
 
-			if (!res) { return res; }
+Result Context::compileBuild(ChiModule& mod, CompileSession& session, bool allowLazy,
+                             std::vector<ChiModule*>*      buildOrder,
+                             std::vector<OwnedLLVMModule>* compiledModules,
+                             std::vector<bool>*            loadedLazily) {
+	assert(buildOrder != nullptr && compiledModules != nullptr && loadedLazily != nullptr);
 
-			if (LLVMLinkModules2(*llmod, compiledDep.take_ownership())) {
-				res.addEntry("EINT", "Failed to link modules", {});
-				return res;
-			}
-		}
+	Result res;
+
+	auto settings = session.settings();
 
-		// link in runtime if this is a main module
-		if (mod.shortName() == "main") {
-			// find the runtime
-			auto runtimebc =
-			    executablePath().parent_path().parent_path() / "lib" / "chigraph" / "runtime.bc";
+	// find everything that needs to be built up front, so circular dependencies are caught before
+	// doing any work
+	res += moduleBuildOrder(mod, buildOrder);
+	if (!res) { return res; }
 
-			// just in case the executable is in a "Debug" folder or something
-			if (!fs::is_regular_file(runtimebc)) {
-				runtimebc = executablePath().parent_path().parent_path().parent_path() / "lib" /
-				            "chigraph" / "runtime.bc";
+	auto& order    = *buildOrder;
+	auto& compiled = *compiledModules;
+
+	// get what we can from this build or the cache. Lazily loaded modules can't be cloned, so they
+	// aren't added to the session
+	compiled.clear();
+	compiled.resize(order.size());
+	loadedLazily->assign(order.size(), false);
+
+	std::vector<ChiModule*> toCompile;
+	for (auto idx = 0ull; idx < order.size(); ++idx) {
+		auto& toBuild = *order[idx];
+
+		compiled[idx] = session.cloneCompiledModule(toBuild);
+		if (compiled[idx]) { continue; }
+
+		bool isRoot = idx == order.size() - 1;
+		if (allowLazy && (settings & CompileSettings::UseCache) &&
+		    (settings & CompileSettings::LazyLoadCache) && !isRoot) {
+			compiled[idx] = moduleCache().retrieveFromCacheLazily(toBuild.fullNamePath(),
+			                                                      toBuild.lastEditTime());
+			if (compiled[idx]) {
+				(*loadedLazily)[idx] = true;
+				continue;
 			}
+		}
 
-			if (!fs::is_regular_file(runtimebc)) {
-				res.addEntry(
-				    "EUKN", "Failed to find runtime.bc in lib/chigraph/runtime.bc",
-				    {{"Install prefix", executablePath().parent_path().parent_path().string()}});
+		if (settings & CompileSettings::UseCache) {
+			auto cached =
+			    moduleCache().retrieveFromCache(toBuild.fullNamePath(), toBuild.lastEditTime());
+			if (cached) {
+				compiled[idx] = session.addCompiledModule(toBuild, std::move(cached));
+				continue;
 			}
+		}
 
-			// load the BC file
-			OwnedLLVMModule runtimeMod;
-			res += parseBitcodeFile(runtimebc, llvmContext(), &runtimeMod);
+		toCompile.push_back(&toBuild);
+	}
+
+	// compile the rest, in parallel if we can
+	std::vector<OwnedLLVMModule> generatedModules(toCompile.size());
+
+	bool canCompileInParallel =
+	    compileThreadCount() > 1 && toCompile.size() > 1 &&
+	    std::all_of(order.begin(), order.end(), [](ChiModule* toBuild) {
+		    return dynamic_cast<GraphModule*>(toBuild) != nullptr ||
+		           dynamic_cast<LangModule*>(toBuild) != nullptr;
+	    });
+	if (canCompileInParallel) {
+		res += generateModuleIRInParallel(order, toCompile, &generatedModules);
+	} else {
+		for (auto idx = 0ull; idx < toCompile.size(); ++idx) {
+			res += generateModuleIR(*toCompile[idx], session, &generatedModules[idx]);
 			if (!res) { return res; }
+		}
+	}
+	if (!res) { return res; }
 
-			if (LLVMLinkModules2(*llmod, runtimeMod.take_ownership())) {
-				res.addEntry("EINT", "Failed to link modules", {});
-				return res;
-			}
+	// cache the new ones
+	for (auto idx = 0ull, generatedIdx = 0ull; idx < order.size(); ++idx) {
+		if (compiled[idx]) { continue; }
+
+		auto& generated = generatedModules[generatedIdx];
+		++generatedIdx;
+
+		res += moduleCache().cacheModule(order[idx]->fullNamePath(), *generated,
+		                                 order[idx]->lastEditTime());
+		compiled[idx] = session.addCompiledModule(*order[idx], std::move(generated));
+	}
 
-			res += verifyModuleIfDebug(*llmod);
-			if (!res) return res;
+	return res;
+}
+
+Result Context::runtimeModule(OwnedLLVMModule* toFill) {
+	assert(toFill != nullptr);
+
+	Result res;
+
+	if (!mRuntimeModule) {
+		auto runtimebc = runtimeBitcodePath();
+		if (runtimebc.empty()) {
+			res.addEntry(
+			    "EUKN", "Failed to find runtime.bc in lib/chigraph/runtime.bc",
+			    {{"Install prefix", executablePath().parent_path().parent_path().string()}});
+			return res;
 		}
+
+		res += parseBitcodeFile(runtimebc, llvmContext(), &mRuntimeModule);
+		if (!res) { return res; }
+	}
+
+	*toFill = OwnedLLVMModule(LLVMCloneModule(*mRuntimeModule));
+
+	// it's linked into modules, so it's compiled for the same machine they are
+	applyTarget(**toFill);
+
+	return res;
+}
+
+Result Context::generateModuleIR(ChiModule& mod, CompileSession& session,
+                                 OwnedLLVMModule* toFill) {
+	assert(toFill != nullptr);
+
+	Result res;
+
+	auto llmod =
+	    OwnedLLVMModule(LLVMModuleCreateWithNameInContext(mod.fullName().c_str(), llvmContext()));
+
+	// add forward declartions for all dependencies
+	const std::vector<ChiModule*>* deps;
+	res += session.transitiveDependencies(mod, &deps);
+	if (!res) { return res; }
+
+	for (auto depMod : *deps) {
+		res += depMod->addForwardDeclarations(*llmod);
+		if (!res) { return res; }
+	}
+
+	res += mod.generateModule(*llmod);
+	applyTarget(*llmod);
+
+	// set debug info version if it doesn't already have it
+	const char* DIVKey = "Debug Info Version";
+	if (LLVMGetModuleFlag(*llmod, DIVKey, strlen(DIVKey)) == nullptr) {
+		LLVMAddModuleFlag(*llmod, LLVMModuleFlagBehaviorWarning, DIVKey, strlen(DIVKey),
+		                  LLVMValueAsMetadata(constI32(LLVMDebugMetadataVersion())));
 	}
 
+	if (!res) { return res; }
+
+	res += verifyModuleIfDebug(*llmod);
+	if (!res) { return res; }
+
 	*toFill = std::move(llmod);
 
 	return res;
 }
 
+Result Context::generateModuleIRInParallel(const std::vector<ChiModule*>& buildOrder,
+                                           const std::vector<ChiModule*>& toCompile,
+                                           std::vector<OwnedLLVMModule>*  toFill) {
+	assert(toFill != nullptr && toFill->size() == toCompile.size());
+
+	Result res;
+
+	// LLVMContexts can't be shared between threads, so each worker gets its own Context with the
+	// graph modules reloaded into it from JSON. Serialize them here, dependencies first so each one
+	// can find its dependencies when it's loaded
+	std::vector<std::pair<fs::path, nlohmann::json>> moduleJsons;
+	for (auto toBuild : buildOrder) {
+		auto graphMod = dynamic_cast<GraphModule*>(toBuild);
+		if (graphMod == nullptr) { continue; }
+
+		moduleJsons.emplace_back(graphMod->fullNamePath(), graphModuleToJson(*graphMod));
+	}
+
+	auto threadCount = std::min<size_t>(compileThreadCount(), toCompile.size());
+
+	std::atomic<size_t>      nextToCompile{0};
+	std::vector<Result>      workerResults(threadCount);
+	std::vector<Result>      moduleResults(toCompile.size());
+	std::vector<std::string> bitcode(toCompile.size());
+
+	auto worker = [&](size_t workerID) {
+		Context        workerCtx{workspacePath()};
+		CompileSession workerSession{workerCtx};
+
+		workerResults[workerID] += workerCtx.setTarget(target());
+		if (!workerResults[workerID]) { return; }
+
+		for (const auto& nameAndJson : moduleJsons) {
+			workerResults[workerID] +=
+			    workerCtx.addModuleFromJson(nameAndJson.first, nameAndJson.second);
+			if (!workerResults[workerID]) { return; }
+		}
+
+		for (auto idx = nextToCompile++; idx < toCompile.size(); idx = nextToCompile++) {
+			auto workerMod = workerCtx.moduleByFullName(toCompile[idx]->fullNamePath());
+			assert(workerMod != nullptr);
+
+			OwnedLLVMModule llmod;
+			moduleResults[idx] += workerCtx.generateModuleIR(*workerMod, workerSession, &llmod);
+			if (!moduleResults[idx]) { continue; }
+
+			// hand it back as bitcode, which can be read into our LLVMContext
+			auto buffer = OwnedLLVMMemoryBuffer(LLVMWriteBitcodeToMemoryBuffer(*llmod));
+			bitcode[idx].assign(LLVMGetBufferStart(*buffer), LLVMGetBufferSize(*buffer));
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (auto workerID = 0ull; workerID < threadCount; ++workerID) {
+		workers.emplace_back(worker, workerID);
+	}
+	for (auto& thread : workers) { thread.join(); }
+
+	for (const auto& workerRes : workerResults) {
+		res += workerRes;
+		if (!res) { return res; }
+	}
+
+	for (auto idx = 0ull; idx < toCompile.size(); ++idx) {
+		auto modNameCtx = res.addScopedContext({{"Module Name", toCompile[idx]->fullName()}});
+
+		res += moduleResults[idx];
+		if (!res) { return res; }
+
+		res += parseBitcodeString(bitcode[idx], llvmContext(), &(*toFill)[idx]);
+		if (!res) { return res; }
+	}
+
+	return res;
+}
+
 std::vector<NodeInstance*> Context::findInstancesOfType(const fs::path&  moduleName,
                                                         std::string_view typeName) const {
 	std::vector<NodeInstance*> ret;
@@ -477,7 +814,95 @@ LLVMValueRef Context::constF64(double value) {
 	return LLVMConstReal(LLVMDoubleTypeInContext(llvmContext()), value);
 }
 
-LLVMValueRef Context::constBool(bool value) { return LLVMConstInt(LLVMInt1Type(), value, false); }
+LLVMValueRef Context::constBool(bool value) {
+	return LLVMConstInt(LLVMInt1TypeInContext(llvmContext()), value, false);
+}
+
+Result moduleBuildOrder(ChiModule& mod, std::vector<ChiModule*>* toFill) {
+	assert(toFill != nullptr);
+
+	Result res;
+
+	toFill->clear();
+
+	// iterative depth first search, so long dependency chains can't overflow the stack
+	enum class Visit { InProgress, Done };
+	std::unordered_map<ChiModule*, Visit> visited;
+
+	// the modules currently being visited, and an iterator to the next dependency to visit of each
+	std::vector<std::pair<ChiModule*, std::set<fs::path>::const_iterator>> stack;
+
+	visited.emplace(&mod, Visit::InProgress);
+	stack.emplace_back(&mod, mod.dependencies().begin());
+
+	while (!stack.empty()) {
+		auto& [current, nextDep] = stack.back();
+
+		// once all the dependencies have been visited it's ready to be built
+		if (nextDep == current->dependencies().end()) {
+			visited[current] = Visit::Done;
+			toFill->push_back(current);
+			stack.pop_back();
+			continue;
+		}
+
+		const auto& depName = *nextDep;
+		++nextDep;
+
+		auto depMod = mod.context().moduleByFullName(depName);
+		if (depMod == nullptr) {
+			res.addEntry("E36", "Could not find module", {{"module", depName.generic_string()}});
+			return res;
+		}
+
+		auto visitIter = visited.find(depMod);
+		if (visitIter == visited.end()) {
+			visited.emplace(depMod, Visit::InProgress);
+			stack.emplace_back(depMod, depMod->dependencies().begin());
+			continue;
+		}
+
+		// a module that is still in progress depends on itself
+		if (visitIter->second == Visit::InProgress) {
+			auto cycle = nlohmann::json::array();
+
+			auto cycleStart = std::find_if(stack.begin(), stack.end(),
+			                               [&](const auto& pair) { return pair.first == depMod; });
+			for (auto iter = cycleStart; iter != stack.end(); ++iter) {
+				cycle.push_back(iter->first->fullName());
+			}
+			cycle.push_back(depMod->fullName());
+
+			res.addEntry("E53", "Circular dependency between modules", {{"Cycle", cycle}});
+			return res;
+		}
+	}
+
+	return res;
+}
+
+namespace {
+
+fs::path findInstalledRuntimeFile(const fs::path& filename) {
+	auto prefix = executablePath().parent_path().parent_path();
+
+	auto path = prefix / "lib" / "chigraph" / filename;
+
+	// just in case the executable is in a "Debug" folder or something
+	if (!fs::is_regular_file(path)) {
+		path = prefix.parent_path() / "lib" / "chigraph" / filename;
+	}
+
+	if (!fs::is_regular_file(path)) { return {}; }
+
+	return path;
+}
+
+}  // anonymous namespace
+
+fs::path runtimeBitcodePath() { return findInstalledRuntimeFile("runtime.bc"); }
+
+fs::path runtimeObjectPath() { return findInstalledRuntimeFile("runtime.o"); }
 
 fs::path workspaceFromChildPath(const fs::path& path) {
 	fs::path ret;
@@ -503,29 +928,129 @@ std::string stringifyLLVMType(LLVMTypeRef ty) {
 
 namespace {
 
-OwnedLLVMExecutionEngine createEE(OwnedLLVMModule mod, LLVMCodeGenOptLevel optLevel,
-                                  std::string& errMsg) {
-	bool failed = LLVMInitializeNativeTarget();
-	failed      = failed || LLVMInitializeNativeAsmPrinter();
-	failed      = failed || LLVMInitializeNativeAsmParser();
+std::string functionName(LLVMValueRef func) {
+	size_t len;
+	auto   name = LLVMGetValueName2(func, &len);
 
-	// this only failes if it wasn't compiled with it, in theory
-	if (failed) {
-		errMsg = "Failed to initialize LLVM JIT";
-		return nullptr;
-	} 
+	return {name, len};
+}
+
+// add a module to the JIT for an optimization level and get the address of a function in it
+Result addToJit(OwnedLLVMModule mod, LLVMCodeGenOptLevel optLevel, const std::string& funcName,
+                JitSession** session, size_t* moduleID, void** address) {
+	Result res;
 
-	OwnedLLVMExecutionEngine engine;
-	OwnedMessage             llErrMsg;
-	if (LLVMCreateJITCompilerForModule(&*engine, mod.take_ownership(), optLevel, &*llErrMsg)) {
-		errMsg = *llErrMsg;
-		return nullptr;
+	res += JitSession::instance(optLevel, session);
+	if (!res) { return res; }
+
+	res += (*session)->addModule(std::move(mod), moduleID);
+	if (!res) { return res; }
+
+	res += (*session)->lookup(*moduleID, funcName, address);
+	if (!res) { (*session)->removeModule(*moduleID); }
+
+	return res;
+}
+
+// run a function with the same signatures that an ExecutionEngine can run
+Result runWithGenericValues(void* address, LLVMTypeRef funcType,
+                            const std::vector<LLVMGenericValueRef>& args,
+                            LLVMGenericValueRef*                    toFill) {
+	Result res;
+
+	auto retType    = LLVMGetReturnType(funcType);
+	auto paramCount = LLVMCountParamTypes(funcType);
+	if (paramCount != args.size()) {
+		res.addEntry("EINT", "Wrong number of arguments to function",
+		             {{"Expected", paramCount}, {"Passed", args.size()}});
+		return res;
+	}
+
+	std::vector<LLVMTypeRef> params(paramCount);
+	LLVMGetParamTypes(funcType, params.data());
+
+	auto isInt = [](LLVMTypeRef ty, unsigned bits) {
+		return LLVMGetTypeKind(ty) == LLVMIntegerTypeKind && LLVMGetIntTypeWidth(ty) == bits;
+	};
+	auto isPointer = [](LLVMTypeRef ty) { return LLVMGetTypeKind(ty) == LLVMPointerTypeKind; };
+
+	// int (int, char**, char**) and the beginnings of it
+	if (isInt(retType, 32) && paramCount >= 1 && paramCount <= 3 && isInt(params[0], 32) &&
+	    (paramCount < 2 || isPointer(params[1])) && (paramCount < 3 || isPointer(params[2]))) {
+		auto argc = static_cast<int>(LLVMGenericValueToInt(args[0], true));
+		auto argv = paramCount >= 2 ? LLVMGenericValueToPointer(args[1]) : nullptr;
+		auto envp = paramCount >= 3 ? LLVMGenericValueToPointer(args[2]) : nullptr;
+
+		int returnValue;
+		switch (paramCount) {
+		case 1: returnValue = reinterpret_cast<int (*)(int)>(address)(argc); break;
+		case 2: returnValue = reinterpret_cast<int (*)(int, void*)>(address)(argc, argv); break;
+		default:
+			returnValue = reinterpret_cast<int (*)(int, void*, void*)>(address)(argc, argv, envp);
+		}
+
+		*toFill = LLVMCreateGenericValueOfInt(retType, static_cast<unsigned>(returnValue), true);
+		return res;
+	}
+
+	if (paramCount == 0) {
+		switch (LLVMGetTypeKind(retType)) {
+		case LLVMVoidTypeKind:
+			reinterpret_cast<void (*)()>(address)();
+			*toFill = LLVMCreateGenericValueOfPointer(nullptr);
+			return res;
+		case LLVMIntegerTypeKind: {
+			unsigned long long returnValue;
+			switch (LLVMGetIntTypeWidth(retType)) {
+			case 1: returnValue = reinterpret_cast<bool (*)()>(address)(); break;
+			case 8: returnValue = reinterpret_cast<uint8_t (*)()>(address)(); break;
+			case 16: returnValue = reinterpret_cast<uint16_t (*)()>(address)(); break;
+			case 32: returnValue = reinterpret_cast<uint32_t (*)()>(address)(); break;
+			case 64: returnValue = reinterpret_cast<uint64_t (*)()>(address)(); break;
+			default: goto unsupported;
+			}
+			*toFill = LLVMCreateGenericValueOfInt(retType, returnValue, false);
+			return res;
+		}
+		case LLVMFloatTypeKind:
+			*toFill =
+			    LLVMCreateGenericValueOfFloat(retType, reinterpret_cast<float (*)()>(address)());
+			return res;
+		case LLVMDoubleTypeKind:
+			*toFill =
+			    LLVMCreateGenericValueOfFloat(retType, reinterpret_cast<double (*)()>(address)());
+			return res;
+		case LLVMPointerTypeKind:
+			*toFill = LLVMCreateGenericValueOfPointer(reinterpret_cast<void* (*)()>(address)());
+			return res;
+		default: break;
+		}
 	}
-	assert(engine);
 
-		return engine;
+unsupported:
+	res.addEntry("EINT", "Functions with this signature can't be run",
+	             {{"Type", stringifyLLVMType(funcType)}});
+	return res;
+}
+
+Result findMain(LLVMModuleRef mod, LLVMValueRef* funcToRun) {
+	Result res;
+
+	if (*funcToRun == nullptr) {
+		*funcToRun = LLVMGetNamedFunction(mod, "main");
+
+		if (*funcToRun == nullptr) {
+			size_t      name_len;
+			const char* id = LLVMGetModuleIdentifier(mod, &name_len);
+
+			res.addEntry("EUKN", "Failed to find main function in module",
+			             {{"Module Name", std::string(id, name_len)}});
+		}
 	}
 
+	return res;
+}
+
 }  // anonymous namespace
 
 Result interpretLLVMIR(OwnedLLVMModule mod, LLVMCodeGenOptLevel optLevel,
@@ -535,32 +1060,42 @@ Result interpretLLVMIR(OwnedLLVMModule mod, LLVMCodeGenOptLevel optLevel,
 
 	Result res;
 
-	if (funcToRun == nullptr) {
-		funcToRun = LLVMGetNamedFunction(*mod, "main");
+	res += findMain(*mod, &funcToRun);
+	if (!res) { return res; }
 
-		if (funcToRun == nullptr) {
-			size_t      name_len;
-			const char* id = LLVMGetModuleIdentifier(*mod, &name_len);
+	// the module is consumed by the JIT, so this has to be found first
+	auto funcType = LLVMGlobalGetValueType(funcToRun);
 
-			res.addEntry("EUKN", "Failed to find main function in module",
-			             {{"Module Name", std::string(id, name_len)}});
-			return res;
-		}
+	JitSession* session;
+	size_t      moduleID;
+	void*       address;
+	res += addToJit(std::move(mod), optLevel, functionName(funcToRun), &session, &moduleID,
+	                &address);
+	if (!res) { return res; }
+
+	res += session->runStaticConstructors(moduleID);
+	if (!res) {
+		session->removeModule(moduleID);
+		return res;
 	}
 
-	std::string errMsg;
-	auto        EE = createEE(std::move(mod), optLevel, errMsg);
-	if (!EE) {
-		res.addEntry("EINT", "Failed to create an LLVM ExecutionEngine", {{"Error", errMsg}});
+	LLVMGenericValueRef returnValue;
+	res += runWithGenericValues(address, funcType, args, &returnValue);
+	if (!res) {
+		session->removeModule(moduleID);
 		return res;
 	}
-	LLVMRunStaticConstructors(*EE);
 
-	auto returnValue = LLVMRunFunction(*EE, funcToRun, args.size(), &args[0]);
+	res += session->runStaticDestructors(moduleID);
 
-	LLVMRunStaticDestructors(*EE);
+	// nothing from it runs after this, so its code can be freed
+	res += session->removeModule(moduleID);
 
-	if (ret != nullptr) { *ret = returnValue; }
+	if (ret != nullptr) {
+		*ret = returnValue;
+	} else {
+		LLVMDisposeGenericValue(returnValue);
+	}
 
 	return res;
 }
@@ -572,33 +1107,48 @@ Result interpretLLVMIRAsMain(OwnedLLVMModule mod, LLVMCodeGenOptLevel optLevel,
 
 	Result res;
 
-	if (funcToRun == nullptr) {
-		funcToRun = LLVMGetNamedFunction(*mod, "main");
+	res += findMain(*mod, &funcToRun);
+	if (!res) { return res; }
 
-		if (funcToRun == nullptr) {
-			size_t      name_len;
-			const char* id = LLVMGetModuleIdentifier(*mod, &name_len);
+	// the module is consumed by the JIT, so this has to be found first
+	auto paramCount = LLVMCountParams(funcToRun);
 
-			res.addEntry("EUKN", "Failed to find main function in module",
-			             {{"Module Name", std::string(id, name_len)}});
-			return res;
-		}
-	}
+	JitSession* session;
+	size_t      moduleID;
+	void*       address;
+	res += addToJit(std::move(mod), optLevel, functionName(funcToRun), &session, &moduleID,
+	                &address);
+	if (!res) { return res; }
 
-	std::string errMsg;
-	auto        EE = createEE(std::move(mod), optLevel, errMsg);
-	if (!EE) {
-		res.addEntry("EINT", "Failed to create an LLVM ExecutionEngine", {{"Error", errMsg}});
+	res += session->runStaticConstructors(moduleID);
+	if (!res) {
+		session->removeModule(moduleID);
 		return res;
 	}
-	LLVMRunStaticConstructors(*EE);
 
-	std::vector<const char*> argv;
-	std::transform(args.begin(), args.end(), std::back_inserter(argv),
-	               [](const std::string& str) { return str.c_str(); });
-	auto returnValue = LLVMRunFunctionAsMain(*EE, funcToRun, argv.size(), argv.data(), nullptr);
+	// main can change its arguments
+	auto               argStrings = args;
+	std::vector<char*> argv;
+	std::transform(argStrings.begin(), argStrings.end(), std::back_inserter(argv),
+	               [](std::string& str) { return str.data(); });
+	argv.push_back(nullptr);
+	char* envp[] = {nullptr};
+
+	auto argc = static_cast<int>(argStrings.size());
+	int  returnValue;
+	switch (paramCount) {
+	case 0: returnValue = reinterpret_cast<int (*)()>(address)(); break;
+	case 1: returnValue = reinterpret_cast<int (*)(int)>(address)(argc); break;
+	case 2: returnValue = reinterpret_cast<int (*)(int, char**)>(address)(argc, argv.data()); break;
+	default:
+		returnValue =
+		    reinterpret_cast<int (*)(int, char**, char**)>(address)(argc, argv.data(), envp);
+	}
+
+	res += session->runStaticDestructors(moduleID);
 
-	LLVMRunStaticDestructors(*EE);
+	// nothing from it runs after this, so its code can be freed
+	res += session->removeModule(moduleID);
 
 	if (ret != nullptr) { *ret = returnValue; }
 
@@ -22,6 +22,9 @@ Result DefaultModuleCache::cacheModule(const std::filesystem::path& moduleName,
 
 	Result res;
 
+	// without a workspace there is no lib directory to cache in
+	if (context().workspacePath().empty()) { return res; }
+
 	auto cachePath = cachePathForModule(moduleName);
 
 	// make the directories
@@ -59,9 +62,21 @@ ModuleCache::time_point DefaultModuleCache::cacheUpdateTime(
 
 OwnedLLVMModule DefaultModuleCache::retrieveFromCache(const std::filesystem::path& moduleName,
                                                       time_point                   atLeastThisNew) {
+	return retrieve(moduleName, atLeastThisNew, false);
+}
+
+OwnedLLVMModule DefaultModuleCache::retrieveFromCacheLazily(const std::filesystem::path& moduleName,
+                                                            time_point atLeastThisNew) {
+	return retrieve(moduleName, atLeastThisNew, true);
+}
+
+OwnedLLVMModule DefaultModuleCache::retrieve(const std::filesystem::path& moduleName,
+                                             time_point atLeastThisNew, bool lazily) {
 	assert(!moduleName.empty() &&
 	       "Cannot pass empty path to DefaultModuleCache::retrieveFromCache");
 
+	if (context().workspacePath().empty()) { return nullptr; }
+
 	auto cachePath = cachePathForModule(moduleName);
 
 	// if there is no cache, then there is nothing to retrieve
@@ -73,7 +88,8 @@ OwnedLLVMModule DefaultModuleCache::retrieveFromCache(const std::filesystem::pat
 
 	// read the cache
 	OwnedLLVMModule fetchedMod;
-	auto            res = parseBitcodeFile(cachePath, context().llvmContext(), &fetchedMod);
+	auto res = lazily ? parseBitcodeFileLazily(cachePath, context().llvmContext(), &fetchedMod)
+	                  : parseBitcodeFile(cachePath, context().llvmContext(), &fetchedMod);
 
 	if (!res) { return nullptr; }
 
@@ -13,6 +13,7 @@
 
 #include "chi/Context.hpp"
 #include "chi/DataType.hpp"
+#include "chi/FunctionInliner.hpp"
 #include "chi/FunctionValidator.hpp"
 #include "chi/GraphFunction.hpp"
 #include "chi/GraphModule.hpp"
@@ -28,12 +29,13 @@ namespace chi {
 
 FunctionCompiler::FunctionCompiler(const GraphFunction& func, LLVMModuleRef moduleToGenInto,
                                    LLVMMetadataRef debugFile, LLVMMetadataRef debugCU,
-                                   LLVMDIBuilderRef debugBuilder)
+                                   LLVMDIBuilderRef debugBuilder, std::optional<size_t> execInput)
     : mModule{moduleToGenInto},
       mDIBuilder{debugBuilder},
       mDIFile{debugFile},
       mDebugCU{debugCU},
-      mFunction{&func} {}
+      mFunction{&func},
+      mExecInput{execInput} {}
 
 Result FunctionCompiler::initialize(bool validate) {
 	assert(initialized() == false && "Cannot initialize a FunctionCompiler more than once");
@@ -57,11 +59,15 @@ Result FunctionCompiler::initialize(bool validate) {
 	}
 
 	// create function
-	auto mangledName = mangleFunctionName(module().fullName(), function().name());
-	mLLFunction      = LLVMGetNamedFunction(llvmModule(), mangledName.c_str());
+	auto mangledName =
+	    mExecInput
+	        ? mangleSpecializedFunctionName(module().fullName(), function().name(), *mExecInput)
+	        : mangleFunctionName(module().fullName(), function().name());
+	mLLFunction = LLVMGetNamedFunction(llvmModule(), mangledName.c_str());
 	if (mLLFunction == nullptr) {
-		mLLFunction = LLVMAddFunction(llvmModule(), mangledName.c_str(),
-		                              function().functionType());  // create the debug file
+		mLLFunction = LLVMAddFunction(
+		    llvmModule(), mangledName.c_str(),
+		    mExecInput ? function().specializedFunctionType() : function().functionType());
 	}
 
 	auto subroutineType = createSubroutineType();
@@ -69,6 +75,14 @@ Result FunctionCompiler::initialize(bool validate) {
 	auto [locationByNode, nodeByLocation] = module().createLineNumberAssoc();
 	mNodeByLocation                       = std::move(nodeByLocation);
 	mLocationByNode                       = std::move(locationByNode);
+
+	// nodes of a copy with calls inlined into it are where the nodes they came from are
+	for (const auto& origin : mNodeOrigins) {
+		auto iter = mLocationByNode.find(const_cast<NodeInstance*>(origin.second));
+		if (iter != mLocationByNode.end()) {
+			mLocationByNode.emplace(const_cast<NodeInstance*>(origin.first), iter->second);
+		}
+	}
 	auto entryLN                          = nodeLineNumber(*entry);
 
 	// TODO(#65): line numbers?
@@ -82,8 +96,8 @@ Result FunctionCompiler::initialize(bool validate) {
 
 	mAllocBlock = LLVMAppendBasicBlockInContext(context().llvmContext(), mLLFunction, "alloc");
 
-	// set argument names
-	auto idx = 0ull;
+	// set argument names. Specialized clones don't take the exec input ID, so they start at 1
+	auto idx = mExecInput ? 1ull : 0ull;
 	for (auto arg = LLVMGetFirstParam(mLLFunction); arg != nullptr; arg = LLVMGetNextParam(arg)) {
 		// the first one is the input exec ID
 		if (idx == 0) {
@@ -133,14 +147,20 @@ Result FunctionCompiler::initialize(bool validate) {
 		++idx;
 	}
 
-	// create mPostPureBreak
+	return res;
+}
+
+Result FunctionCompiler::compile() {
+	assert(initialized() && "You must initialize a FunctionCompiler before you compile it");
+	assert(compiled() == false && "You cannot compile a FunctionCompiler twice");
+
+	// compile the entry
+	auto entry = function().entryNode();
+	assert(entry != nullptr);
+
 	auto allocBuilder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 	LLVMPositionBuilder(*allocBuilder, allocBlock(), nullptr);
 
-	mPostPureBreak = LLVMBuildAlloca(
-	    *allocBuilder, LLVMPointerType(LLVMInt8TypeInContext(context().llvmContext()), 0),
-	    "pure_jumpback");
-
 	// alloc local variables and zero them
 	for (const auto& localVar : function().localVariables()) {
 		mLocalVariables[localVar.name] = LLVMBuildAlloca(*allocBuilder, localVar.type.llvmType(),
@@ -149,35 +169,19 @@ Result FunctionCompiler::initialize(bool validate) {
 		               mLocalVariables[localVar.name]);
 	}
 
-	return res;
-}
+	// fold what can be folded and skip what can't run
+	mOptimizations = optimizeFunction(function(), mExecInput);
 
-Result FunctionCompiler::compile() {
-	assert(initialized() && "You must initialize a FunctionCompiler before you compile it");
-	assert(compiled() == false && "You cannot compile a FunctionCompiler twice");
-
-	// compile the entry
-	auto entry = function().entryNode();
-	assert(entry != nullptr);
+	// so pures that already hold their value can be reused instead of evaluated again, and values
+	// can be passed directly instead of through memory
+	mAvailablePures  = availablePures(function());
+	mAlwaysRunBefore = nodesThatAlwaysRunBefore(function());
 
 	std::deque<std::pair<NodeInstance*, size_t>> nodesToCompile;
 	nodesToCompile.emplace_back(entry, 0);
 
 	Result res;
 
-	auto compilePureDependencies = [this](NodeInstance& node) {
-		Result res;
-
-		auto depPures = dependentPuresRecursive(node);
-		for (auto pure : depPures) {
-			auto compiler = getOrCreateNodeCompiler(*pure);
-			res += compiler->compile_stage2({}, 0);
-
-			if (!res) { return res; }
-		}
-		return res;
-	};
-
 	while (!nodesToCompile.empty()) {
 		auto& node        = *nodesToCompile[0].first;
 		auto  inputExecID = nodesToCompile[0].second;
@@ -191,15 +195,20 @@ Result FunctionCompiler::compile() {
 			continue;
 		}
 
-		// compile dependent pures
-		res += compilePureDependencies(node);
-		if (!res) { return res; }
-
 		std::vector<LLVMBasicBlockRef> outputBlocks;
 		// make sure the output nodes have done stage 1 and collect output blocks
-		for (const auto& conn : node.outputExecConnections) {
-			res += compilePureDependencies(*conn.first);
-			if (!res) { return res; }
+		for (auto id = 0ull; id < node.outputExecConnections.size(); ++id) {
+			const auto& conn = node.outputExecConnections[id];
+
+			// outputs that are never taken don't need anything compiled for them
+			if (!mOptimizations.reachable(node, id)) {
+				if (mUnreachableBlock == nullptr) {
+					mUnreachableBlock = LLVMAppendBasicBlockInContext(context().llvmContext(),
+					                                                  mLLFunction, "unreachable");
+				}
+				outputBlocks.push_back(mUnreachableBlock);
+				continue;
+			}
 
 			auto depCompiler = getOrCreateNodeCompiler(*conn.first);
 			depCompiler->compile_stage1(conn.second);
@@ -212,9 +221,12 @@ Result FunctionCompiler::compile() {
 		if (!res) { return res; }
 
 		// recurse
-		for (const auto& conn : node.outputExecConnections) {
+		for (auto id = 0ull; id < node.outputExecConnections.size(); ++id) {
 			// add them to the end
-			nodesToCompile.emplace_back(conn.first, conn.second);
+			if (mOptimizations.reachable(node, id)) {
+				nodesToCompile.emplace_back(node.outputExecConnections[id].first,
+				                            node.outputExecConnections[id].second);
+			}
 		}
 
 		// pop it off
@@ -223,13 +235,91 @@ Result FunctionCompiler::compile() {
 
 	if (!res) { return res; }
 
-	auto allocBuilder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
-	LLVMPositionBuilder(*allocBuilder, allocBlock(), nullptr);
+	for (auto& compiler : mNodeCompilers) { compiler.second.removeUnusedStorage(); }
+
+	if (mUnreachableBlock != nullptr) {
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, mUnreachableBlock, nullptr);
+		LLVMBuildUnreachable(*builder);
+	}
+
 	LLVMBuildBr(*allocBuilder, nodeCompiler(*entry)->firstBlock(0));
 
 	return res;
 }
 
+Result FunctionCompiler::compileDispatcher() {
+	assert(initialized() && "You must initialize a FunctionCompiler before you compile it");
+	assert(compiled() == false && "You cannot compile a FunctionCompiler twice");
+	assert(!mExecInput && "Specialized clones don't take an exec input ID to dispatch on");
+
+	auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+	LLVMPositionBuilder(*builder, allocBlock(), nullptr);
+	LLVMSetCurrentDebugLocation(
+	    *builder, LLVMMetadataAsValue(context().llvmContext(),
+	                                  LLVMDIBuilderCreateDebugLocation(
+	                                      context().llvmContext(),
+	                                      nodeLineNumber(*function().entryNode()), 1, mDebugFunc,
+	                                      nullptr)));
+
+	// everything but the exec input ID is passed on
+	std::vector<LLVMValueRef> arguments;
+	for (auto arg = LLVMGetNextParam(LLVMGetFirstParam(mLLFunction)); arg != nullptr;
+	     arg      = LLVMGetNextParam(arg)) {
+		arguments.push_back(arg);
+	}
+
+	std::vector<LLVMBasicBlockRef> cloneBlocks;
+	for (auto id = 0ull; id < function().execInputs().size(); ++id) {
+		cloneBlocks.push_back(LLVMAppendBasicBlockInContext(
+		    context().llvmContext(), mLLFunction, ("exec" + std::to_string(id)).c_str()));
+	}
+
+	if (cloneBlocks.empty()) {
+		LLVMBuildRet(*builder, context().constI32(0));
+		return {};
+	}
+
+	// like the entry, anything out of range goes to the first one
+	auto switchInst = LLVMBuildSwitch(*builder, LLVMGetFirstParam(mLLFunction), cloneBlocks[0],
+	                                  cloneBlocks.size());
+	for (auto id = 0ull; id < cloneBlocks.size(); ++id) {
+		LLVMAddCase(switchInst, context().constI32(id), cloneBlocks[id]);
+
+		auto cloneName =
+		    mangleSpecializedFunctionName(module().fullName(), function().name(), id);
+		auto clone = LLVMGetNamedFunction(llvmModule(), cloneName.c_str());
+		if (clone == nullptr) {
+			clone = LLVMAddFunction(llvmModule(), cloneName.c_str(),
+			                        function().specializedFunctionType());
+		}
+
+		LLVMPositionBuilderAtEnd(*builder, cloneBlocks[id]);
+		auto call = LLVMBuildCall2(*builder, function().specializedFunctionType(), clone,
+		                           arguments.data(), arguments.size(), "");
+		LLVMSetTailCall(call, true);
+		LLVMBuildRet(*builder, call);
+	}
+
+	return {};
+}
+
+bool FunctionCompiler::pureAvailable(const NodeInstance& node, size_t inputExecID,
+                                     NodeInstance& pure) const {
+	auto iter = mAvailablePures.find(&node);
+	if (iter == mAvailablePures.end() || inputExecID >= iter->second.size()) { return false; }
+
+	return iter->second[inputExecID].count(&pure) != 0;
+}
+
+bool FunctionCompiler::alwaysRunsBefore(const NodeInstance& before, const NodeInstance& node,
+                                        size_t inputExecID) const {
+	auto iter = mAlwaysRunBefore.find(&node);
+	if (iter == mAlwaysRunBefore.end() || inputExecID >= iter->second.size()) { return false; }
+
+	return iter->second[inputExecID].count(&before) != 0;
+}
+
 LLVMMetadataRef FunctionCompiler::createSubroutineType() {
 	// create param list
 	std::vector<LLVMMetadataRef> params;
@@ -240,8 +330,8 @@ LLVMMetadataRef FunctionCompiler::createSubroutineType() {
 
 		params.push_back(intType.debugType(*this));
 
-		// then first in inputexec id
-		params.push_back(intType.debugType(*this));
+		// then first in inputexec id, which specialized clones don't have
+		if (!mExecInput) { params.push_back(intType.debugType(*this)); }
 
 		// add paramters
 		for (const auto& dType :
@@ -298,12 +388,31 @@ NodeCompiler* FunctionCompiler::getOrCreateNodeCompiler(NodeInstance& node) {
 
 Result compileFunction(const GraphFunction& func, LLVMModuleRef mod, LLVMMetadataRef debugFile,
                        LLVMMetadataRef debugCU, LLVMDIBuilderRef debugBuilder) {
-	FunctionCompiler compiler{func, mod, debugFile, debugCU, debugBuilder};
+	FunctionCompiler dispatcher{func, mod, debugFile, debugCU, debugBuilder};
+
+	auto res = dispatcher.initialize();
+	if (!res) { return res; }
 
-	auto res = compiler.initialize();
+	// the clones are compiled from a copy with the small functions it calls spliced in
+	InlinedFunction inlined;
+	res += inlineCalls(func, &inlined);
 	if (!res) { return res; }
 
-	res += compiler.compile();
+	const auto& toCompile = inlined.function ? *inlined.function : func;
+
+	for (auto id = 0ull; id < func.execInputs().size(); ++id) {
+		FunctionCompiler clone{toCompile, mod, debugFile, debugCU, debugBuilder, id};
+		clone.setNodeOrigins(inlined.origins);
+
+		// it was already validated for the dispatcher
+		res += clone.initialize(false);
+		if (!res) { return res; }
+
+		res += clone.compile();
+		if (!res) { return res; }
+	}
+
+	res += dispatcher.compileDispatcher();
 
 	return res;
 }
@@ -0,0 +1,468 @@
+/// \file FunctionInliner.cpp
+
+#include "chi/FunctionInliner.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "chi/DataType.hpp"
+#include "chi/FunctionValidator.hpp"
+#include "chi/GraphFunction.hpp"
+#include "chi/GraphModule.hpp"
+#include "chi/NodeInstance.hpp"
+#include "chi/NodeType.hpp"
+#include "chi/Support/Result.hpp"
+
+namespace chi {
+
+namespace {
+
+// a call that gets inlined, and the calls in the callee that get inlined along with it
+struct InlineDecision {
+	const NodeInstance*         call;
+	const GraphFunction*        callee;
+	std::vector<InlineDecision> nested;
+};
+
+bool isLangNode(const NodeInstance& node, std::string_view name) {
+	return node.type().module().fullName() == "lang" && node.type().name() == name;
+}
+
+// the function a node calls, or nullptr if it isn't a call to a GraphFunction
+const GraphFunction* calledFunction(const NodeInstance& node) {
+	auto graphMod = dynamic_cast<const GraphModule*>(&node.type().module());
+	if (graphMod == nullptr) { return nullptr; }
+
+	return graphMod->functionFromName(node.type().name());
+}
+
+// the name of the local variable of func that a node gets or sets, or empty if it doesn't
+std::string localVariableOf(const GraphFunction& func, const NodeInstance& node) {
+	if (&node.type().module() != &func.module() || calledFunction(node) != nullptr) { return {}; }
+
+	auto name = node.type().name();
+	if (name.size() <= 5 ||
+	    (name.compare(0, 5, "_get_") != 0 && name.compare(0, 5, "_set_") != 0)) {
+		return {};
+	}
+
+	auto localName = name.substr(5);
+	return func.localVariableFromName(localName).valid() ? localName : std::string{};
+}
+
+// if a node is connected to itself, which splicing in a function can't do
+bool connectedToItself(const NodeInstance& node) {
+	return std::any_of(node.inputDataConnections.begin(), node.inputDataConnections.end(),
+	                   [&](const auto& conn) { return conn.first == &node; }) ||
+	       std::any_of(node.outputExecConnections.begin(), node.outputExecConnections.end(),
+	                   [&](const auto& conn) { return conn.first == &node; });
+}
+
+// the calls in a function, in the same order every time it's compiled
+std::vector<const NodeInstance*> callsInOrder(const GraphFunction& func) {
+	std::vector<const NodeInstance*> calls;
+	for (const auto& node : func.nodes()) {
+		if (calledFunction(*node.second) != nullptr) { calls.push_back(node.second.get()); }
+	}
+
+	std::sort(calls.begin(), calls.end(),
+	          [](const auto& lhs, const auto& rhs) { return lhs->id() < rhs->id(); });
+
+	return calls;
+}
+
+struct InlinePlanner {
+	// if a function could ever be inlined, no matter where it's called from
+	bool inlinable(const GraphFunction& callee) {
+		auto iter = mInlinable.find(&callee);
+		if (iter != mInlinable.end()) { return iter->second; }
+
+		// validating the paths through it is too slow to do for every callee, those are checked
+		// when it's compiled by itself
+		auto ok = !callee.module().cEnabled() && callee.entryNode() != nullptr &&
+		          inlineCost(callee) <= inlineThreshold &&
+		          validateFunctionConnectionsAreTwoWay(callee) &&
+		          validateFunctionExecOutputs(callee) && validateFunctionEntryType(callee) &&
+		          validateFunctionExitTypes(callee);
+
+		mInlinable.emplace(&callee, ok);
+		return ok;
+	}
+
+	std::vector<InlineDecision> plan(const GraphFunction& func, size_t depth) {
+		std::vector<InlineDecision> decisions;
+		if (depth >= maxInlineDepth) { return decisions; }
+
+		for (auto call : callsInOrder(func)) {
+			auto callee = calledFunction(*call);
+
+			// never inline into itself, that would never end
+			if (std::find(mStack.begin(), mStack.end(), callee) != mStack.end()) { continue; }
+			if (connectedToItself(*call) || !inlinable(*callee)) { continue; }
+
+			auto cost = inlineCost(*callee);
+			if (cost > mBudget) { continue; }
+			mBudget -= cost;
+
+			mStack.push_back(callee);
+			decisions.push_back(InlineDecision{call, callee, plan(*callee, depth + 1)});
+			mStack.pop_back();
+		}
+
+		return decisions;
+	}
+
+	std::vector<const GraphFunction*>              mStack;
+	size_t                                         mBudget = inlineBudget;
+	std::unordered_map<const GraphFunction*, bool> mInlinable;
+};
+
+std::vector<InlineDecision> planInlining(const GraphFunction& func) {
+	InlinePlanner planner;
+	planner.mStack.push_back(&func);
+
+	return planner.plan(func, 0);
+}
+
+void flattenCallees(const std::vector<InlineDecision>& decisions,
+                    std::vector<const GraphFunction*>* toFill) {
+	for (const auto& decision : decisions) {
+		toFill->push_back(decision.callee);
+		flattenCallees(decision.nested, toFill);
+	}
+}
+
+using Connection = std::pair<NodeInstance*, size_t>;
+
+struct Splicer {
+	GraphFunction&                                                func;
+	std::unordered_map<const NodeInstance*, const NodeInstance*>& origins;
+	size_t                                                        nextPrefix = 0;
+
+	Result insertNode(std::unique_ptr<NodeType> type, const NodeInstance* origin,
+	                  NodeInstance** toFill, float x = 0, float y = 0) {
+		auto res = func.insertNode(std::move(type), x, y, Uuid::random(), toFill);
+		if (res) { origins[*toFill] = origin; }
+
+		return res;
+	}
+
+	Result insertLocalNode(std::string_view getOrSet, const NamedDataType& local,
+	                       const NodeInstance* origin, NodeInstance** toFill) {
+		std::unique_ptr<NodeType> type;
+		auto res = func.module().nodeTypeFromName(std::string(getOrSet) + local.name,
+		                                          local.type.qualifiedName(), &type);
+		if (!res) { return res; }
+
+		return insertNode(std::move(type), origin, toFill);
+	}
+
+	// a prefix that no local variable of the function starts with yet
+	std::string uniquePrefix() {
+		while (true) {
+			auto prefix = "inline" + std::to_string(nextPrefix++) + ".";
+
+			auto taken = std::any_of(func.localVariables().begin(), func.localVariables().end(),
+			                         [&](const auto& local) {
+				                         return local.name.compare(0, prefix.size(), prefix) == 0;
+			                         });
+			if (!taken) { return prefix; }
+		}
+	}
+
+	Result splice(NodeInstance& call, const GraphFunction& callee,
+	              const std::vector<InlineDecision>& nested, const NodeInstance* origin) {
+		Result res;
+
+		auto prefix = uniquePrefix();
+		auto entry  = callee.entryNode();
+		assert(entry != nullptr);
+
+		// the callee's local variables, each with another one that's never set to reset it to
+		// zero, like it is each time the callee is called
+		std::vector<std::pair<NamedDataType, NamedDataType>> locals;
+		for (const auto& local : callee.localVariables()) {
+			locals.emplace_back(
+			    func.getOrCreateLocalVariable(prefix + "var." + local.name, local.type),
+			    func.getOrCreateLocalVariable(prefix + "zero." + local.name, local.type));
+		}
+
+		std::vector<NamedDataType> inputs, outputs;
+		for (auto id = 0ull; id < callee.dataInputs().size(); ++id) {
+			inputs.push_back(func.getOrCreateLocalVariable(prefix + "in" + std::to_string(id),
+			                                               callee.dataInputs()[id].type));
+		}
+		for (auto id = 0ull; id < callee.dataOutputs().size(); ++id) {
+			outputs.push_back(func.getOrCreateLocalVariable(prefix + "out" + std::to_string(id),
+			                                                callee.dataOutputs()[id].type));
+		}
+
+		// take the call out, remembering what it was connected to
+		auto callInputs    = call.inputDataConnections;
+		auto callExecIns   = call.inputExecConnections;
+		auto callExecOuts  = call.outputExecConnections;
+		auto callConsumers = call.outputDataConnections;
+		origins.erase(&call);
+		res += func.removeNode(call);
+		if (!res) { return res; }
+
+		// copy the body
+		std::unordered_map<const NodeInstance*, NodeInstance*> copies;
+		for (const auto& node : callee.nodes()) {
+			if (isLangNode(*node.second, "entry") || isLangNode(*node.second, "exit")) {
+				continue;
+			}
+
+			std::unique_ptr<NodeType> type;
+			auto                      localName = localVariableOf(callee, *node.second);
+			if (localName.empty()) {
+				type = node.second->type().clone();
+			} else {
+				res += func.module().nodeTypeFromName(
+				    node.second->type().name().substr(0, 5) + prefix + "var." + localName,
+				    node.second->type().toJSON(), &type);
+				if (!res) { return res; }
+			}
+
+			res += insertNode(std::move(type), origin, &copies[node.second.get()],
+			                  node.second->x(), node.second->y());
+			if (!res) { return res; }
+		}
+
+		// the entry's outputs are the arguments
+		std::vector<NodeInstance*> inputGetters(inputs.size(), nullptr);
+		auto dataSource = [&](const NodeInstance* node, size_t id, Connection* toFill) -> Result {
+			if (node != entry) {
+				*toFill = {copies.at(node), id};
+				return {};
+			}
+
+			if (inputGetters[id] == nullptr) {
+				auto getRes = insertLocalNode("_get_", inputs[id], origin, &inputGetters[id]);
+				if (!getRes) { return getRes; }
+			}
+			*toFill = {inputGetters[id], 0};
+			return {};
+		};
+
+		// exits set the return values and go where the call would have
+		std::map<std::pair<const NodeInstance*, size_t>, Connection> exitChains;
+		auto execTarget = [&](const std::pair<NodeInstance*, size_t>& target,
+		                      Connection*                             toFill) -> Result {
+			if (!isLangNode(*target.first, "exit")) {
+				*toFill = {copies.at(target.first), target.second};
+				return {};
+			}
+
+			auto chainIter = exitChains.find(target);
+			if (chainIter != exitChains.end()) {
+				*toFill = chainIter->second;
+				return {};
+			}
+
+			Result     chainRes;
+			Connection next = callExecOuts[target.second];
+			for (auto id = outputs.size(); id-- > 0;) {
+				NodeInstance* set;
+				chainRes += insertLocalNode("_set_", outputs[id], origin, &set);
+				if (!chainRes) { return chainRes; }
+
+				Connection source;
+				const auto& sourceConn = target.first->inputDataConnections[id];
+				chainRes += dataSource(sourceConn.first, sourceConn.second, &source);
+				if (!chainRes) { return chainRes; }
+
+				chainRes += connectData(*source.first, source.second, *set, 0);
+				chainRes += connectExec(*set, 0, *next.first, next.second);
+				next = {set, 0};
+			}
+
+			exitChains.emplace(target, next);
+			*toFill = next;
+			return chainRes;
+		};
+
+		for (const auto& copy : copies) {
+			auto id = 0ull;
+			for (const auto& conn : copy.first->inputDataConnections) {
+				Connection source;
+				res += dataSource(conn.first, conn.second, &source);
+				if (!res) { return res; }
+
+				res += connectData(*source.first, source.second, *copy.second, id);
+				++id;
+			}
+
+			id = 0ull;
+			for (const auto& conn : copy.first->outputExecConnections) {
+				Connection target;
+				res += execTarget(conn, &target);
+				if (!res) { return res; }
+
+				res += connectExec(*copy.second, id, *target.first, target.second);
+				++id;
+			}
+		}
+		if (!res) { return res; }
+
+		// whatever called it now sets the arguments, resets the locals and goes into the body
+		for (auto execID = 0ull; execID < callExecIns.size(); ++execID) {
+			if (callExecIns[execID].empty()) { continue; }
+
+			Connection next;
+			res += execTarget(entry->outputExecConnections[execID], &next);
+			if (!res) { return res; }
+
+			for (auto id = locals.size(); id-- > 0;) {
+				NodeInstance *get, *set;
+				res += insertLocalNode("_get_", locals[id].second, origin, &get);
+				res += insertLocalNode("_set_", locals[id].first, origin, &set);
+				if (!res) { return res; }
+
+				res += connectData(*get, 0, *set, 0);
+				res += connectExec(*set, 0, *next.first, next.second);
+				next = {set, 0};
+			}
+			for (auto id = inputs.size(); id-- > 0;) {
+				NodeInstance* set;
+				res += insertLocalNode("_set_", inputs[id], origin, &set);
+				if (!res) { return res; }
+
+				res += connectData(*callInputs[id].first, callInputs[id].second, *set, 0);
+				res += connectExec(*set, 0, *next.first, next.second);
+				next = {set, 0};
+			}
+
+			for (const auto& caller : callExecIns[execID]) {
+				res += connectExec(*caller.first, caller.second, *next.first, next.second);
+			}
+		}
+
+		// and what used its outputs gets the return values
+		for (auto id = 0ull; id < callConsumers.size(); ++id) {
+			if (callConsumers[id].empty()) { continue; }
+
+			NodeInstance* get;
+			res += insertLocalNode("_get_", outputs[id], origin, &get);
+			if (!res) { return res; }
+
+			for (const auto& consumer : callConsumers[id]) {
+				res += connectData(*get, 0, *consumer.first, consumer.second);
+			}
+		}
+		if (!res) { return res; }
+
+		for (const auto& decision : nested) {
+			res += splice(*copies.at(decision.call), *decision.callee, decision.nested, origin);
+			if (!res) { return res; }
+		}
+
+		return res;
+	}
+};
+
+}  // anonymous namespace
+
+size_t inlineCost(const GraphFunction& func) {
+	size_t cost = 0;
+	for (const auto& node : func.nodes()) {
+		const auto& type = node.second->type();
+
+		// the entry and exits turn into setting the arguments and return values
+		if (isLangNode(*node.second, "entry")) {
+			cost += type.dataOutputs().size();
+		} else if (isLangNode(*node.second, "exit")) {
+			cost += type.dataInputs().size();
+		} else if (type.pure()) {
+			cost += 1;
+		} else {
+			cost += 2;
+
+			// branches make it harder to optimize the caller
+			if (!type.execOutputs().empty()) { cost += 2 * (type.execOutputs().size() - 1); }
+
+			// and calls can be inlined too
+			if (calledFunction(*node.second) != nullptr) { cost += 4; }
+		}
+	}
+
+	return cost;
+}
+
+std::vector<const GraphFunction*> inlinedCallees(const GraphFunction& func) {
+	std::vector<const GraphFunction*> callees;
+	flattenCallees(planInlining(func), &callees);
+
+	return callees;
+}
+
+Result inlineCalls(const GraphFunction& func, InlinedFunction* toFill) {
+	assert(toFill != nullptr);
+
+	Result res;
+
+	*toFill   = {};
+	auto plan = planInlining(func);
+	if (plan.empty()) { return res; }
+
+	flattenCallees(plan, &toFill->callees);
+
+	// building the copy isn't an edit to the module
+	auto editTime = func.module().lastEditTime();
+
+	auto copy = std::make_unique<GraphFunction>(func.module(), func.name(), func.dataInputs(),
+	                                            func.dataOutputs(), func.execInputs(),
+	                                            func.execOutputs());
+	copy->setDescription(func.description());
+	for (const auto& local : func.localVariables()) {
+		copy->getOrCreateLocalVariable(local.name, local.type);
+	}
+
+	// the nodes keep their IDs, so they're named the same as in the function itself
+	std::unordered_map<const NodeInstance*, NodeInstance*> copies;
+	for (const auto& node : func.nodes()) {
+		NodeInstance* nodeCopy;
+		res += copy->insertNode(node.second->type().clone(), node.second->x(), node.second->y(),
+		                        node.second->id(), &nodeCopy);
+		if (!res) { return res; }
+
+		copies.emplace(node.second.get(), nodeCopy);
+		toFill->origins.emplace(nodeCopy, node.second.get());
+	}
+	for (const auto& node : copies) {
+		auto id = 0ull;
+		for (const auto& conn : node.first->inputDataConnections) {
+			if (conn.first != nullptr) {
+				res += connectData(*copies.at(conn.first), conn.second, *node.second, id);
+			}
+			++id;
+		}
+
+		id = 0ull;
+		for (const auto& conn : node.first->outputExecConnections) {
+			if (conn.first != nullptr) {
+				res += connectExec(*node.second, id, *copies.at(conn.first), conn.second);
+			}
+			++id;
+		}
+	}
+	if (!res) { return res; }
+
+	Splicer splicer{*copy, toFill->origins};
+	for (const auto& decision : plan) {
+		res += splicer.splice(*copies.at(decision.call), *decision.callee, decision.nested,
+		                      decision.call);
+		if (!res) { return res; }
+	}
+
+	func.module().updateLastEditTime(editTime);
+
+	toFill->function = std::move(copy);
+
+	return res;
+}
+
+}  // namespace chi
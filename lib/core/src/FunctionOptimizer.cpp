@@ -0,0 +1,109 @@
+/// \file FunctionOptimizer.cpp
+
+#include "chi/FunctionOptimizer.hpp"
+
+#include <cassert>
+#include <deque>
+#include <unordered_set>
+
+#include "chi/DataType.hpp"
+#include "chi/GraphFunction.hpp"
+#include "chi/NodeInstance.hpp"
+#include "chi/NodeType.hpp"
+
+namespace chi {
+
+namespace {
+
+// fold a pure and the pures it depends on, returning if it was folded
+bool foldPure(const NodeInstance& pure, FunctionOptimizations* opts,
+              std::unordered_set<const NodeInstance*>* tried) {
+	if (!tried->insert(&pure).second) { return opts->constants.count(&pure) != 0; }
+
+	std::vector<LLVMValueRef> inputs;
+	for (const auto& conn : pure.inputDataConnections) {
+		if (conn.first == nullptr || !conn.first->type().pure() ||
+		    !foldPure(*conn.first, opts, tried)) {
+			return false;
+		}
+		inputs.push_back(opts->constants[conn.first][conn.second]);
+	}
+
+	std::vector<LLVMValueRef> outputs;
+	if (!pure.type().constantFold(inputs, &outputs)) { return false; }
+
+	assert(outputs.size() == pure.type().dataOutputs().size() &&
+	       "Folding a node has to give a value for each output");
+	opts->constants[&pure] = std::move(outputs);
+
+	return true;
+}
+
+}  // anonymous namespace
+
+LLVMValueRef FunctionOptimizations::constant(const NodeInstance& node, size_t outputID) const {
+	auto iter = constants.find(&node);
+	if (iter == constants.end()) { return nullptr; }
+
+	assert(outputID < iter->second.size());
+	return iter->second[outputID];
+}
+
+bool FunctionOptimizations::reachable(const NodeInstance& node, size_t execOutputID) const {
+	auto iter = reachableExecOutputs.find(&node);
+	if (iter == reachableExecOutputs.end()) { return false; }
+
+	assert(execOutputID < iter->second.size());
+	return iter->second[execOutputID];
+}
+
+FunctionOptimizations optimizeFunction(const GraphFunction&  func,
+                                       std::optional<size_t> execInput) {
+	FunctionOptimizations ret;
+
+	// fold the pures, each one after the ones it depends on
+	std::unordered_set<const NodeInstance*> tried;
+	for (const auto& node : func.nodes()) {
+		if (node.second->type().pure()) { foldPure(*node.second, &ret, &tried); }
+	}
+
+	// then go through the exec graph from the entry, only following outputs that can be taken
+	auto entry = func.entryNode();
+	if (entry == nullptr) { return ret; }
+
+	std::deque<const NodeInstance*> toVisit{entry};
+	while (!toVisit.empty()) {
+		auto node = toVisit.front();
+		toVisit.pop_front();
+
+		if (ret.reachableExecOutputs.count(node) != 0) { continue; }
+
+		std::vector<LLVMValueRef> inputs;
+		for (const auto& conn : node->inputDataConnections) {
+			inputs.push_back(conn.first == nullptr ? nullptr
+			                                       : ret.constant(*conn.first, conn.second));
+		}
+
+		auto reachable = node->type().reachableExecOutputs(inputs);
+		assert(reachable.size() == node->outputExecConnections.size());
+
+		if (node == entry && execInput) {
+			assert(*execInput < reachable.size());
+
+			reachable.assign(reachable.size(), false);
+			reachable[*execInput] = true;
+		}
+
+		for (auto id = 0ull; id < reachable.size(); ++id) {
+			if (reachable[id] && node->outputExecConnections[id].first != nullptr) {
+				toVisit.push_back(node->outputExecConnections[id].first);
+			}
+		}
+
+		ret.reachableExecOutputs.emplace(node, std::move(reachable));
+	}
+
+	return ret;
+}
+
+}  // namespace chi
@@ -285,6 +285,15 @@ LLVMTypeRef GraphFunction::functionType() const {
 	                        arguments.size(), false);
 }
 
+LLVMTypeRef GraphFunction::specializedFunctionType() const {
+	auto                     general = functionType();
+	std::vector<LLVMTypeRef> arguments(LLVMCountParamTypes(general));
+	LLVMGetParamTypes(general, arguments.data());
+
+	return LLVMFunctionType(LLVMGetReturnType(general), arguments.data() + 1,
+	                        arguments.size() - 1, false);
+}
+
 void GraphFunction::addExecInput(std::string name, size_t addBefore) {
 	// invalidate the cache
 	module().updateLastEditTime();
@@ -2,6 +2,7 @@
 
 #include "chi/GraphModule.hpp"
 
+#include <llvm-c/BitWriter.h>
 #include <llvm-c/Core.h>
 #include <llvm-c/DebugInfo.h>
 #include <llvm-c/Linker.h>
@@ -11,18 +12,23 @@
 #include <boost/uuid/uuid_io.hpp>
 #include <filesystem>
 #include <fstream>
+#include <unordered_set>
 
+#include "chi/BitcodeParser.hpp"
 #include "chi/CCompiler.hpp"
 #include "chi/ClangFinder.hpp"
 #include "chi/Context.hpp"
 #include "chi/FunctionCompiler.hpp"
+#include "chi/FunctionInliner.hpp"
 #include "chi/GraphFunction.hpp"
 #include "chi/GraphStruct.hpp"
+#include "chi/HashedModuleCache.hpp"
 #include "chi/JsonDeserializer.hpp"
 #include "chi/JsonSerializer.hpp"
 #include "chi/NameMangler.hpp"
 #include "chi/NodeInstance.hpp"
 #include "chi/NodeType.hpp"
+#include "chi/Support/ContentHash.hpp"
 #include "chi/Support/LibCLocator.hpp"
 #include "chi/Support/Result.hpp"
 #include "chi/Support/Subprocess.hpp"
@@ -66,6 +72,9 @@ struct CFuncNode : NodeType {
 			args.push_back("-I");
 			args.push_back(mGraphModule->pathToCSources().string());
 
+			// so it links into the module without changing its target
+			args.push_back("--target=" + context().target().triple);
+
 			// find clang
 			auto clangExe = findClang();
 			if (clangExe.empty()) {
@@ -87,12 +96,11 @@ struct CFuncNode : NodeType {
 			res.addEntry("EUKN", "Failed to link modules", {});
 			return res;
 		}
-		LLVMSetDataLayout(parentModule, "");
 
 		auto llfunc = LLVMGetNamedFunction(parentModule, mFunctionName.c_str());
 		assert(llfunc != nullptr);
 
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 
 		size_t ioSize = io.size();
@@ -195,13 +203,15 @@ struct GraphFuncCallType : public NodeType {
 	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
 		Result res = {};
 
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
 
-		auto func = LLVMGetNamedFunction(compiler.funcCompiler().llvmModule(),
-		                                 mangleFunctionName(module().fullName(), name()).c_str());
+		// call the clone that's specialized for this exec input, so it doesn't have to switch on it
+		auto func = LLVMGetNamedFunction(
+		    compiler.funcCompiler().llvmModule(),
+		    mangleSpecializedFunctionName(module().fullName(), name(), execInputID).c_str());
 
 		if (func == nullptr) {
 			res.addEntry("EINT", "Could not find function in llvm module",
@@ -209,14 +219,16 @@ struct GraphFuncCallType : public NodeType {
 			return res;
 		}
 
-		// add the execInputID to the argument list
-		std::vector<LLVMValueRef> passingIO;
-		passingIO.push_back(context().constI32(execInputID));
-
-		std::copy(io.begin(), io.end(), std::back_inserter(passingIO));
+		auto funcType = JModule->functionFromName(name())->specializedFunctionType();
+		auto ret      = LLVMBuildCall2(*builder, funcType, func,
+		                               const_cast<LLVMValueRef*>(io.data()), io.size(),
+		                               "call_function");
 
-		auto ret =
-		    LLVMBuildCall2(*builder, JModule->functionFromName(name())->functionType(), func, passingIO.data(), passingIO.size(), "call_function");
+		// with only one place to go, it doesn't matter what it returned
+		if (outputBlocks.size() == 1) {
+			LLVMBuildBr(*builder, outputBlocks[0]);
+			return res;
+		}
 
 		// create switch on return
 		auto switchInst = LLVMBuildSwitch(*builder, ret, outputBlocks[0],
@@ -257,7 +269,7 @@ struct MakeStructNodeType : public NodeType {
 	               size_t /*execInputID*/, LLVMMetadataRef       nodeLocation,
 	               const std::vector<LLVMValueRef>&      io,
 	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
@@ -298,7 +310,7 @@ struct BreakStructNodeType : public NodeType {
 	               size_t /*execInputID*/, LLVMMetadataRef       nodeLocation,
 	               const std::vector<LLVMValueRef>&      io,
 	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
@@ -341,7 +353,7 @@ struct SetLocalNodeType : public NodeType {
 	Result codegen(NodeCompiler& compiler, LLVMBasicBlockRef codegenInto, size_t /*execInputID*/,
 	               LLVMMetadataRef nodeLocation, const std::vector<LLVMValueRef>& io,
 	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
@@ -378,7 +390,7 @@ struct GetLocalNodeType : public NodeType {
 	Result codegen(NodeCompiler& compiler, LLVMBasicBlockRef codegenInto, size_t execInputID,
 	               LLVMMetadataRef nodeLocation, const std::vector<LLVMValueRef>& io,
 	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
@@ -401,6 +413,98 @@ struct GetLocalNodeType : public NodeType {
 	NamedDataType mDataType;
 };
 
+// the functions of a module in the order that they get their blocks of line numbers in
+std::vector<const GraphFunction*> functionsInLineOrder(const GraphModule& mod) {
+	std::vector<const GraphFunction*> funcs;
+	for (const auto& func : mod.functions()) { funcs.push_back(func.get()); }
+
+	std::sort(funcs.begin(), funcs.end(),
+	          [](const auto& lhs, const auto& rhs) { return lhs->name() < rhs->name(); });
+
+	return funcs;
+}
+
+// compile functions into a module, with one compile unit for all of them
+Result compileFunctionsWithDebugInfo(const GraphModule&                       mod,
+                                     const std::vector<const GraphFunction*>& funcs,
+                                     LLVMModuleRef                            module) {
+	Result res;
+
+	auto debugBuilder = OwnedLLVMDIBuilder(LLVMCreateDIBuilder(module));
+
+	auto srcFile    = mod.sourceFilePath().filename();
+	auto srcPath    = mod.sourceFilePath().parent_path();
+	auto compilerID = "Chigraph Compiler";
+	auto diFile =
+	    LLVMDIBuilderCreateFile(*debugBuilder, srcFile.string().c_str(), srcFile.string().size(),
+	                            srcPath.string().c_str(), srcPath.string().size());
+	auto compileUnit = LLVMDIBuilderCreateCompileUnit(
+	    *debugBuilder, LLVMDWARFSourceLanguageC, diFile, compilerID, strlen(compilerID), false, "",
+	    0, 0, "", 0, LLVMDWARFEmissionFull, 0, true, false
+#if LLVM_VERSION_MAJOR > 10
+	    ,
+	    "", 0, "", 0
+#endif
+	);  // TODO: resarch these parameters, these are defaults
+
+	for (auto func : funcs) {
+		res += compileFunction(*func, module, diFile, compileUnit, *debugBuilder);
+	}
+
+	LLVMDIBuilderFinalize(*debugBuilder);
+
+	return res;
+}
+
+// compile a single function into its own module, declaring everything that's declared in
+// `declarationsFrom` so calls to dependencies and other functions in the module resolve
+Result compileFunctionModule(const GraphModule& mod, const GraphFunction& func,
+                             LLVMModuleRef declarationsFrom, OwnedLLVMModule* toFill) {
+	Result res;
+
+	auto funcModule = OwnedLLVMModule(
+	    LLVMModuleCreateWithNameInContext(mod.fullName().c_str(), mod.context().llvmContext()));
+
+	for (auto decl = LLVMGetFirstFunction(declarationsFrom); decl != nullptr;
+	     decl      = LLVMGetNextFunction(decl)) {
+		size_t nameLen;
+		auto   name = LLVMGetValueName2(decl, &nameLen);
+		if (LLVMGetNamedFunction(*funcModule, name) != nullptr) { continue; }
+
+		LLVMAddFunction(*funcModule, name, LLVMGlobalGetValueType(decl));
+	}
+
+	res += compileFunctionsWithDebugInfo(mod, {&func}, *funcModule);
+	if (!res) { return res; }
+
+	mod.context().applyTarget(*funcModule);
+
+	// without this the debug info would be stripped when it's read back from the cache
+	const char* DIVKey = "Debug Info Version";
+	LLVMAddModuleFlag(*funcModule, LLVMModuleFlagBehaviorWarning, DIVKey, strlen(DIVKey),
+	                  LLVMValueAsMetadata(mod.context().constI32(LLVMDebugMetadataVersion())));
+
+	*toFill = std::move(funcModule);
+
+	return res;
+}
+
+// write a compiled function to its place in the cache. Failing to is fine, it'll just be compiled
+// again next time
+void cacheFunctionModule(LLVMModuleRef funcModule, const fs::path& cachePath) {
+	std::error_code ec;
+	fs::create_directories(cachePath.parent_path(), ec);
+	if (ec) { return; }
+
+	// write it somewhere else first so a half written cache never has a valid name
+	auto partialPath = cachePath;
+	partialPath += ".partial";
+	if (LLVMWriteBitcodeToFile(funcModule, partialPath.string().c_str()) != 0) { return; }
+
+	fs::rename(partialPath, cachePath, ec);
+	if (ec) { fs::remove(partialPath, ec); }
+}
+
 }  // namespace
 
 GraphModule::GraphModule(Context& cont, std::filesystem::path fullName,
@@ -427,10 +531,16 @@ LLVMMetadataRef GraphModule::debugType(FunctionCompiler& compiler, const DataTyp
 }
 
 Result GraphModule::addForwardDeclarations(LLVMModuleRef module) const {
-	// create prototypes
+	// create prototypes, for each function and its specialized clones
 	for (auto& graph : mFunctions) {
 		LLVMAddFunction(module, mangleFunctionName(fullName(), graph->name()).c_str(),
 		                graph->functionType());
+
+		for (auto id = 0ull; id < graph->execInputs().size(); ++id) {
+			LLVMAddFunction(module,
+			                mangleSpecializedFunctionName(fullName(), graph->name(), id).c_str(),
+			                graph->specializedFunctionType());
+		}
 	}
 
 	return {};
@@ -466,8 +576,9 @@ Result GraphModule::generateModule(LLVMModuleRef module) {
 
 				// compile it
 				OwnedLLVMModule generatedModule;
-				res += compileCToLLVM(clangExe, context().llvmContext(), {CFile.string()}, "",
-				                      &generatedModule);
+				res += compileCToLLVM(clangExe, context().llvmContext(),
+				                      {"--target=" + context().target().triple, CFile.string()},
+				                      "", &generatedModule);
 
 				if (!res) { return res; }
 
@@ -480,32 +591,79 @@ Result GraphModule::generateModule(LLVMModuleRef module) {
 		}
 	}
 
-	// debug info
-	auto debugBuilder = OwnedLLVMDIBuilder(LLVMCreateDIBuilder(module));
-
-	auto srcFile    = sourceFilePath().filename();
-	auto srcPath    = sourceFilePath().parent_path();
-	auto compilerID = "Chigraph Compiler";
-	auto diFile =
-	    LLVMDIBuilderCreateFile(*debugBuilder, srcFile.string().c_str(), srcFile.string().size(),
-	                            srcPath.string().c_str(), srcPath.string().size());
-	auto compileUnit = LLVMDIBuilderCreateCompileUnit(
-	    *debugBuilder, LLVMDWARFSourceLanguageC, diFile, compilerID, strlen(compilerID), false, "",
-	    0, 0, "", 0, LLVMDWARFEmissionFull, 0, true, false
-#if LLVM_VERSION_MAJOR > 10
-	    ,
-	    "", 0, "", 0
-#endif
-	);  // TODO: resarch these parameters, these are defaults
-
 	// create prototypes
 	addForwardDeclarations(module);
 
-	for (auto& graph : mFunctions) {
-		res += compileFunction(*graph, module, diFile, compileUnit, *debugBuilder);
+	auto funcs = functionsInLineOrder(*this);
+
+	// without a workspace there's nowhere to cache functions, and c-call nodes link their C into
+	// the function's module, so the same C function could be defined by more than one of them
+	if (!context().hasWorkspace() || cEnabled()) {
+		res += compileFunctionsWithDebugInfo(*this, funcs, module);
+		return res;
 	}
 
-	LLVMDIBuilderFinalize(*debugBuilder);
+	// everything outside of the function that can change what it compiles to
+	std::string interfaceHash;
+	res += moduleInterfaceHash(context(), fullName(), &interfaceHash);
+	if (!res) { return res; }
+
+	auto cacheDir = functionCacheDirectory();
+
+	const auto& target = context().target();
+
+	std::unordered_set<std::string> usedCaches;
+	for (size_t funcIdx = 0; funcIdx < funcs.size(); ++funcIdx) {
+		const auto& func = *funcs[funcIdx];
+
+		ContentHasher hasher;
+		hasher.add("function")
+		    .add(HashedModuleCache::compilerVersion())
+		    .add(fullName())
+		    .add(sourceFilePath().generic_string())
+		    .add(std::to_string(funcIdx * linesPerFunction))
+		    .add(interfaceHash)
+		    .add(target.triple)
+		    .add(target.cpu)
+		    .add(target.features)
+		    .add(graphFunctionToJson(func).dump())
+		    .add(referencedInterfacesHash(func));
+
+		// the functions inlined into it are compiled with it
+		for (auto callee : inlinedCallees(func)) {
+			hasher.add(callee->qualifiedName())
+			    .add(graphFunctionToJson(*callee).dump())
+			    .add(referencedInterfacesHash(*callee));
+		}
+
+		auto cachePath = cacheDir / (hasher.hexDigest() + ".bc");
+		usedCaches.insert(cachePath.filename().string());
+
+		OwnedLLVMModule funcModule;
+		if (fs::is_regular_file(cachePath)) {
+			// a cache that doesn't parse is just compiled again
+			parseBitcodeFile(cachePath, context().llvmContext(), &funcModule);
+		}
+		if (!funcModule) {
+			res += compileFunctionModule(*this, func, module, &funcModule);
+			if (!res) { return res; }
+
+			cacheFunctionModule(*funcModule, cachePath);
+		}
+
+		if (LLVMLinkModules2(module, funcModule.take_ownership())) {
+			res.addEntry("EUKN", "Failed to link modules", {{"Function", func.name()}});
+			return res;
+		}
+	}
+
+	// functions that were removed or changed won't be compiled to those again
+	std::error_code ec;
+	for (const auto& entry : fs::directory_iterator{cacheDir, ec}) {
+		if (usedCaches.count(entry.path().filename().string()) == 0) {
+			fs::remove(entry.path(), ec);
+		}
+	}
 
 	return res;
 }
@@ -791,25 +949,27 @@ std::vector<std::string> GraphModule::nodeTypeNames() const {
 
 std::pair<std::unordered_map<NodeInstance*, unsigned>, std::unordered_map<unsigned, NodeInstance*>>
 GraphModule::createLineNumberAssoc() const {
-	// create a sorted list of GraphFunctions
-	std::vector<NodeInstance*> nodes;
-	for (const auto& f : functions()) {
-		for (const auto& node : f->nodes()) {
+	std::unordered_map<NodeInstance*, unsigned> lineByNode;
+	std::unordered_map<unsigned, NodeInstance*> nodeByLine;
+
+	auto funcs = functionsInLineOrder(*this);
+	for (unsigned funcIdx = 0; funcIdx < funcs.size(); ++funcIdx) {
+		std::vector<NodeInstance*> nodes;
+		for (const auto& node : funcs[funcIdx]->nodes()) {
 			assert(node.second != nullptr);
 			nodes.push_back(node.second.get());
 		}
-	}
+		assert(nodes.size() < linesPerFunction && "Too many nodes in a function for debug info");
 
-	std::sort(nodes.begin(), nodes.end(), [](const auto& lhs, const auto& rhs) {
-		return (lhs->function().name() + ":" + lhs->stringId()) <
-		       (rhs->function().name() + ":" + rhs->stringId());
-	});
+		std::sort(nodes.begin(), nodes.end(), [](const auto& lhs, const auto& rhs) {
+			return lhs->stringId() < rhs->stringId();
+		});
 
-	std::unordered_map<NodeInstance*, unsigned> lineByNode;
-	std::unordered_map<unsigned, NodeInstance*> nodeByLine;
-	for (unsigned i = 0; i < nodes.size(); ++i) {
-		lineByNode.insert({nodes[i], i + 1});
-		nodeByLine.insert({i + 1, nodes[i]});
+		for (unsigned nodeIdx = 0; nodeIdx < nodes.size(); ++nodeIdx) {
+			auto line = funcIdx * linesPerFunction + nodeIdx + 1;
+			lineByNode.insert({nodes[nodeIdx], line});
+			nodeByLine.insert({line, nodes[nodeIdx]});
+		}
 	}
 
 	return {lineByNode, nodeByLine};
@@ -864,6 +1024,10 @@ std::filesystem::path GraphModule::sourceFilePath() const {
 	return context().workspacePath() / "src" / (fullName() + ".chimod");
 }
 
+std::filesystem::path GraphModule::functionCacheDirectory() const {
+	return context().workspacePath() / "lib" / (fullName() + ".functions");
+}
+
 Result GraphModule::createNodeTypeFromCCode(std::string_view code, std::string_view functionName,
                                             std::vector<std::string>   clangArgs,
                                             std::unique_ptr<NodeType>* toFill) {
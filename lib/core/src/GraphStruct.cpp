@@ -113,7 +113,8 @@ DataType GraphStruct::dataType() {
 
 	for (const auto& type : types()) { llTypes.push_back(type.type.llvmType()); }
 
-	auto llType = LLVMStructType(llTypes.data(), llTypes.size(), false);
+	auto llType =
+	    LLVMStructTypeInContext(context().llvmContext(), llTypes.data(), llTypes.size(), false);
 
 	mDataType = DataType(&module(), name(), llType);
 
@@ -0,0 +1,376 @@
+/// \file HashedModuleCache.cpp
+
+#include "chi/HashedModuleCache.hpp"
+
+#include <llvm-c/BitWriter.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "chi/BitcodeParser.hpp"
+#include "chi/ChiModule.hpp"
+#include "chi/Context.hpp"
+#include "chi/FunctionInliner.hpp"
+#include "chi/GraphFunction.hpp"
+#include "chi/GraphModule.hpp"
+#include "chi/JsonSerializer.hpp"
+#include "chi/NodeInstance.hpp"
+#include "chi/NodeType.hpp"
+#include "chi/Support/ContentHash.hpp"
+#include "chi/Support/Result.hpp"
+#include "chi/ThinLink.hpp"
+
+#ifndef CHI_COMPILER_VERSION
+#define CHI_COMPILER_VERSION "unknown"
+#endif
+
+namespace fs = std::filesystem;
+
+namespace chi {
+
+namespace {
+
+constexpr size_t hashLength = 40;
+
+std::string readFile(const fs::path& path) {
+	std::ifstream stream{path, std::ios::binary};
+	return {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+}
+
+constexpr std::string_view summarySuffix = ".summary.json";
+
+// see if a file in the cache directory is a cache or a summary of a module with this short name,
+// for any key
+bool isCacheFileFor(const std::string& filename, const std::string& shortName) {
+	// <shortname>.<hash>.bc or <shortname>.<hash>.summary.json
+	auto prefixLength = shortName.size() + 1 + hashLength;
+	if (filename.size() < prefixLength) { return false; }
+
+	auto suffixLength = filename.size() - prefixLength;
+	if (suffixLength != 3 && suffixLength != summarySuffix.size()) { return false; }
+	if (filename.compare(0, shortName.size() + 1, shortName + ".") != 0) { return false; }
+	if (filename.compare(filename.size() - suffixLength, suffixLength,
+	                     suffixLength == 3 ? ".bc" : summarySuffix) != 0) {
+		return false;
+	}
+
+	auto hashBegin = filename.begin() + shortName.size() + 1;
+	return std::all_of(hashBegin, hashBegin + hashLength,
+	                   [](char c) { return std::isxdigit(static_cast<unsigned char>(c)) != 0; });
+}
+
+// the parts of a function's JSON that other functions' code depends on
+nlohmann::json functionInterfaceJson(const nlohmann::json& funcJson) {
+	return {{"name", funcJson["name"]},
+	        {"data_inputs", funcJson["data_inputs"]},
+	        {"data_outputs", funcJson["data_outputs"]},
+	        {"exec_inputs", funcJson["exec_inputs"]},
+	        {"exec_outputs", funcJson["exec_outputs"]}};
+}
+
+// known is keyed on module name, and is empty while that module's hash is being found so circular
+// dependencies don't recurse forever
+Result interfaceHashImpl(Context& ctx, const fs::path& moduleName,
+                         std::unordered_map<std::string, std::string>& known, std::string* toFill) {
+	Result res;
+
+	auto knownIter = known.find(moduleName.generic_string());
+	if (knownIter != known.end()) {
+		*toFill = knownIter->second;
+		return res;
+	}
+
+	auto mod = ctx.moduleByFullName(moduleName);
+	if (mod == nullptr) {
+		res.addEntry("E36", "Could not find module", {{"module", moduleName.generic_string()}});
+		return res;
+	}
+	known[mod->fullName()] = "";
+
+	ContentHasher hasher;
+	hasher.add("interface").add(HashedModuleCache::compilerVersion()).add(mod->fullName());
+
+	if (auto graphMod = dynamic_cast<GraphModule*>(mod)) {
+		auto modJson = graphModuleToJson(*graphMod);
+
+		auto interfaceJson     = nlohmann::json::object();
+		interfaceJson["types"] = modJson["types"];
+
+		auto& functionsJson = interfaceJson["functions"];
+		functionsJson       = nlohmann::json::array();
+		for (const auto& funcJson : modJson["graphs"]) {
+			functionsJson.push_back(functionInterfaceJson(funcJson));
+		}
+
+		hasher.add(interfaceJson.dump());
+	}
+
+	// the types of this module can contain types from its dependencies
+	for (const auto& dep : mod->dependencies()) {
+		std::string depHash;
+		res += interfaceHashImpl(ctx, dep, known, &depHash);
+		if (!res) { return res; }
+
+		hasher.add(dep.generic_string()).add(depHash);
+	}
+
+	*toFill = hasher.hexDigest();
+	known[mod->fullName()] = *toFill;
+
+	return res;
+}
+
+}  // anonymous namespace
+
+HashedModuleCache::HashedModuleCache(Context& ctx) : ModuleCache{ctx} {}
+
+std::string_view HashedModuleCache::compilerVersion() { return CHI_COMPILER_VERSION; }
+
+Result HashedModuleCache::moduleHash(const fs::path& moduleName, std::string* toFill) const {
+	assert(toFill != nullptr);
+
+	Result res;
+
+	auto mod = context().moduleByFullName(moduleName);
+	if (mod == nullptr) {
+		res.addEntry("E36", "Could not find module", {{"module", moduleName.generic_string()}});
+		return res;
+	}
+
+	ContentHasher hasher;
+	hasher.add("module").add(compilerVersion()).add(mod->fullName());
+
+	// modules are compiled for a target
+	const auto& target = context().target();
+	hasher.add(target.triple).add(target.cpu).add(target.features);
+
+	if (auto graphMod = dynamic_cast<GraphModule*>(mod)) {
+		hasher.add(graphModuleToJson(*graphMod).dump());
+
+		// functions from other modules that are inlined into it are compiled with it, and the
+		// functions its nodes reference are declared in it
+		for (const auto& func : graphMod->functions()) {
+			for (auto callee : inlinedCallees(*func)) {
+				if (&callee->module() == graphMod) { continue; }
+
+				hasher.add(callee->qualifiedName())
+				    .add(graphFunctionToJson(*callee).dump())
+				    .add(referencedInterfacesHash(*callee));
+			}
+
+			hasher.add(referencedInterfacesHash(*func));
+		}
+
+		// every file in the C directory, headers included, in a stable order
+		auto cPath = graphMod->pathToCSources();
+		if (graphMod->cEnabled() && fs::is_directory(cPath)) {
+			std::vector<fs::path> cFiles;
+			for (const auto& entry : fs::recursive_directory_iterator{
+			         cPath, fs::directory_options::follow_directory_symlink}) {
+				if (entry.is_regular_file()) { cFiles.push_back(entry.path()); }
+			}
+			std::sort(cFiles.begin(), cFiles.end());
+
+			for (const auto& cFile : cFiles) {
+				hasher.add(fs::relative(cFile, cPath).generic_string()).add(readFile(cFile));
+			}
+		}
+	}
+
+	std::unordered_map<std::string, std::string> knownInterfaces;
+	for (const auto& dep : mod->dependencies()) {
+		std::string depHash;
+		res += interfaceHashImpl(context(), dep, knownInterfaces, &depHash);
+		if (!res) { return res; }
+
+		hasher.add(dep.generic_string()).add(depHash);
+	}
+
+	*toFill = hasher.hexDigest();
+
+	return res;
+}
+
+Result HashedModuleCache::interfaceHash(const fs::path& moduleName, std::string* toFill) const {
+	return moduleInterfaceHash(context(), moduleName, toFill);
+}
+
+fs::path HashedModuleCache::cachePathForModule(const fs::path& moduleName,
+                                               std::string_view hash) const {
+	return context().workspacePath() / "lib" /
+	       (moduleName.string() + "." + std::string(hash) + ".bc");
+}
+
+fs::path HashedModuleCache::summaryPathForModule(const fs::path& moduleName,
+                                                 std::string_view hash) const {
+	return context().workspacePath() / "lib" /
+	       (moduleName.string() + "." + std::string(hash) + std::string(summarySuffix));
+}
+
+Result HashedModuleCache::cacheModule(const fs::path& moduleName, LLVMModuleRef compiledModule,
+                                      time_point /*timeAtFileRead*/) {
+	assert(!moduleName.empty() &&
+	       "Cannot pass a empty module name to HashedModuleCache::cacheModule");
+
+	Result res;
+
+	// without a workspace there is no lib directory to cache in
+	if (context().workspacePath().empty()) { return res; }
+
+	std::string hash;
+	res += moduleHash(moduleName, &hash);
+	if (!res) { return res; }
+
+	auto cachePath = cachePathForModule(moduleName, hash);
+
+	// the caches for the old keys are never going to be used
+	invalidateCache(moduleName);
+
+	std::filesystem::create_directories(cachePath.parent_path());
+
+	// write it somewhere else first so a half written cache never has a valid name
+	auto partialPath = cachePath;
+	partialPath += ".partial";
+	if (LLVMWriteBitcodeToFile(compiledModule, partialPath.string().c_str()) != 0) {
+		res.addEntry("EUKN", "Failed to open file", {{"Path", partialPath.string()}});
+		return res;
+	}
+
+	std::error_code ec;
+	fs::rename(partialPath, cachePath, ec);
+	if (ec) {
+		res.addEntry("EUKN", "Failed to move cache into place",
+		             {{"Path", cachePath.string()}, {"Error", ec.message()}});
+		return res;
+	}
+
+	// the summary goes in the same way, so it's never read half written either
+	auto summaryPath        = summaryPathForModule(moduleName, hash);
+	auto partialSummaryPath = summaryPath;
+	partialSummaryPath += ".partial";
+	{
+		std::ofstream stream{partialSummaryPath};
+		auto summary = summarizeModule(compiledModule, moduleName.generic_string());
+		stream << moduleSummaryToJson(summary);
+		if (!stream) {
+			res.addEntry("EUKN", "Failed to open file", {{"Path", partialSummaryPath.string()}});
+			return res;
+		}
+	}
+
+	fs::rename(partialSummaryPath, summaryPath, ec);
+	if (ec) {
+		res.addEntry("EUKN", "Failed to move summary into place",
+		             {{"Path", summaryPath.string()}, {"Error", ec.message()}});
+	}
+
+	return res;
+}
+
+void HashedModuleCache::invalidateCache(const fs::path& moduleName) {
+	assert(!moduleName.empty() && "Cannot pass empty path to HashedModuleCache::invalidateCache");
+
+	if (context().workspacePath().empty()) { return; }
+
+	auto cacheDir = (context().workspacePath() / "lib" / moduleName).parent_path();
+	if (!fs::is_directory(cacheDir)) { return; }
+
+	auto shortName = moduleName.filename().string();
+
+	std::error_code ec;
+	for (const auto& entry : fs::directory_iterator{cacheDir, ec}) {
+		if (isCacheFileFor(entry.path().filename().string(), shortName)) {
+			fs::remove(entry.path(), ec);
+		}
+	}
+}
+
+ModuleCache::time_point HashedModuleCache::cacheUpdateTime(const fs::path& moduleName) const {
+	std::string hash;
+	if (context().workspacePath().empty() || !moduleHash(moduleName, &hash)) { return {}; }
+
+	std::error_code ec;
+	auto            time = fs::last_write_time(cachePathForModule(moduleName, hash), ec);
+	if (ec) { return {}; }
+
+	return time;
+}
+
+OwnedLLVMModule HashedModuleCache::retrieveFromCache(const fs::path& moduleName,
+                                                     time_point /*atLeastThisNew*/) {
+	return retrieve(moduleName, false);
+}
+
+OwnedLLVMModule HashedModuleCache::retrieveFromCacheLazily(const fs::path& moduleName,
+                                                           time_point /*atLeastThisNew*/) {
+	return retrieve(moduleName, true);
+}
+
+OwnedLLVMModule HashedModuleCache::retrieve(const fs::path& moduleName, bool lazily) {
+	assert(!moduleName.empty() &&
+	       "Cannot pass empty path to HashedModuleCache::retrieveFromCache");
+
+	if (context().workspacePath().empty()) { return nullptr; }
+
+	std::string hash;
+	if (!moduleHash(moduleName, &hash)) { return nullptr; }
+
+	auto cachePath = cachePathForModule(moduleName, hash);
+	if (!fs::is_regular_file(cachePath)) { return nullptr; }
+
+	OwnedLLVMModule fetchedMod;
+	auto res = lazily ? parseBitcodeFileLazily(cachePath, context().llvmContext(), &fetchedMod)
+	                  : parseBitcodeFile(cachePath, context().llvmContext(), &fetchedMod);
+	if (!res) { return nullptr; }
+
+	return fetchedMod;
+}
+
+bool HashedModuleCache::retrieveSummary(const fs::path& moduleName, ModuleSummary* toFill) {
+	assert(!moduleName.empty() &&
+	       "Cannot pass empty path to HashedModuleCache::retrieveSummary");
+	assert(toFill != nullptr);
+
+	if (context().workspacePath().empty()) { return false; }
+
+	std::string hash;
+	if (!moduleHash(moduleName, &hash)) { return false; }
+
+	std::ifstream stream{summaryPathForModule(moduleName, hash)};
+	if (!stream) { return false; }
+
+	auto summaryJson = nlohmann::json::parse(stream, nullptr, false);
+	return !summaryJson.is_discarded() && jsonToModuleSummary(summaryJson, toFill);
+}
+
+Result moduleInterfaceHash(Context& ctx, const fs::path& moduleName, std::string* toFill) {
+	assert(toFill != nullptr);
+
+	std::unordered_map<std::string, std::string> known;
+	return interfaceHashImpl(ctx, moduleName, known, toFill);
+}
+
+std::string referencedInterfacesHash(const GraphFunction& func) {
+	// the nodes aren't in a stable order
+	std::map<std::string, std::string> interfaces;
+	for (const auto& node : func.nodes()) {
+		for (auto referenced : node.second->type().referencedFunctions()) {
+			interfaces.emplace(referenced->qualifiedName(),
+			                   functionInterfaceJson(graphFunctionToJson(*referenced)).dump());
+		}
+	}
+
+	ContentHasher hasher;
+	hasher.add("referenced");
+	for (const auto& interface : interfaces) { hasher.add(interface.first).add(interface.second); }
+
+	return hasher.hexDigest();
+}
+
+}  // namespace chi
@@ -0,0 +1,770 @@
+/// \file JitSession.cpp
+
+#include "chi/JitSession.hpp"
+
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/Error.h>
+#include <llvm-c/Linker.h>
+#include <llvm-c/Target.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "chi/HashedModuleCache.hpp"
+#include "chi/NativeCodegen.hpp"
+#include "chi/Support/ContentHash.hpp"
+#include "chi/Support/Result.hpp"
+
+namespace fs = std::filesystem;
+
+namespace chi {
+
+namespace {
+
+std::string consumeError(LLVMErrorRef err) {
+	auto        message = LLVMGetErrorMessage(err);
+	std::string ret     = message;
+	LLVMDisposeErrorMessage(message);
+
+	return ret;
+}
+
+// called instead of a function that failed to compile. The error was already reported.
+void lazyCompileFailed() {
+	std::cerr << "Failed to compile a function the first time it was called" << std::endl;
+	std::abort();
+}
+
+void reportError(void* /*ctx*/, LLVMErrorRef err) {
+	std::cerr << "JIT error: " << consumeError(err) << std::endl;
+}
+
+LLVMJITSymbolFlags symbolFlags(uint8_t genericFlags) {
+	LLVMJITSymbolFlags flags;
+	flags.GenericFlags = genericFlags;
+	flags.TargetFlags  = 0;
+
+	return flags;
+}
+
+bool isIntrinsic(LLVMValueRef global) { return valueName(global).compare(0, 5, "llvm.") == 0; }
+
+// replace a function or global variable with a declaration of the same name and type. If it's a
+// function that hasn't been read from the bitcode yet, it never will be.
+void replaceWithDeclaration(LLVMModuleRef mod, LLVMValueRef global) {
+	auto name = valueName(global);
+
+	LLVMValueRef decl;
+	if (LLVMIsAFunction(global) != nullptr) {
+		decl = LLVMAddFunction(mod, "", LLVMGlobalGetValueType(global));
+		LLVMSetFunctionCallConv(decl, LLVMGetFunctionCallConv(global));
+
+		// parameter and return attributes are part of the ABI, for byval and the like
+		std::vector<LLVMAttributeIndex> indices = {LLVMAttributeReturnIndex};
+		for (unsigned idx = 1; idx <= LLVMCountParams(global); ++idx) { indices.push_back(idx); }
+		for (auto idx : indices) {
+			std::vector<LLVMAttributeRef> attrs(LLVMGetAttributeCountAtIndex(global, idx));
+			LLVMGetAttributesAtIndex(global, idx, attrs.data());
+			for (auto attr : attrs) { LLVMAddAttributeAtIndex(decl, idx, attr); }
+		}
+	} else {
+		decl = LLVMAddGlobalInAddressSpace(mod, LLVMGlobalGetValueType(global), "",
+		                                   LLVMGetPointerAddressSpace(LLVMTypeOf(global)));
+		LLVMSetThreadLocal(decl, LLVMIsThreadLocal(global));
+		LLVMSetGlobalConstant(decl, LLVMIsGlobalConstant(global));
+		LLVMSetAlignment(decl, LLVMGetAlignment(global));
+	}
+
+	LLVMReplaceAllUsesWith(global, decl);
+	if (LLVMIsAFunction(global) != nullptr) {
+		LLVMDeleteFunction(global);
+	} else {
+		LLVMDeleteGlobal(global);
+	}
+	LLVMSetValueName2(decl, name.c_str(), name.size());
+}
+
+// remove llvm.global_ctors or llvm.global_dtors, returning the functions in it in order of
+// priority
+std::vector<LLVMValueRef> takeStructors(LLVMModuleRef mod, const char* arrayName) {
+	auto array = LLVMGetNamedGlobal(mod, arrayName);
+	if (array == nullptr) { return {}; }
+
+	std::vector<std::pair<unsigned long long, LLVMValueRef>> structors;
+
+	auto init = LLVMGetInitializer(array);
+	if (init != nullptr && LLVMIsAConstantArray(init) != nullptr) {
+		for (auto idx = 0; idx < LLVMGetNumOperands(init); ++idx) {
+			// { i32 priority, void ()* function, i8* data }
+			auto entry    = LLVMGetOperand(init, idx);
+			auto priority = LLVMConstIntGetZExtValue(LLVMGetOperand(entry, 0));
+			auto func     = LLVMGetOperand(entry, 1);
+			if (LLVMIsAConstantExpr(func) != nullptr) { func = LLVMGetOperand(func, 0); }
+
+			if (LLVMIsAFunction(func) != nullptr) { structors.emplace_back(priority, func); }
+		}
+	}
+	LLVMDeleteGlobal(array);
+
+	std::stable_sort(structors.begin(), structors.end(),
+	                 [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+	std::vector<LLVMValueRef> ret;
+	for (const auto& structor : structors) { ret.push_back(structor.second); }
+
+	return ret;
+}
+
+Result runFunctions(JitSession& session, size_t moduleID, const std::vector<std::string>& names) {
+	Result res;
+
+	for (const auto& name : names) {
+		void* address;
+		res += session.lookup(moduleID, name, &address);
+		if (!res) { return res; }
+
+		reinterpret_cast<void (*)()>(address)();
+	}
+
+	return res;
+}
+
+}  // anonymous namespace
+
+/// A module that was added, with everything in it renamed to be unique to it
+struct JitSession::JitModule {
+	/// What every symbol in the module starts with
+	std::string prefix;
+
+	/// The module, which the units are read from
+	OwnedLLVMMemoryBuffer bitcode;
+
+	/// Where the native code for the module is cached, or empty to not cache it
+	fs::path objectCacheDirectory;
+
+	/// The hash of the module as it was added, if it's cached
+	std::string bitcodeHash;
+
+	/// The names of the static constructors and destructors
+	std::vector<std::string> constructors;
+	std::vector<std::string> destructors;
+
+	/// Where the module's code is defined, or nullptr once it's been removed
+	LLVMOrcJITDylibRef dylib = nullptr;
+};
+
+/// What gets compiled at once: either a single function, or all the global variables in a module
+struct JitSession::Unit {
+	JitSession*      session;
+	const JitModule* module;
+
+	/// The name of the function in the module that was added, or empty for the global variables
+	std::string name;
+};
+
+JitSession::JitSession(LLVMCodeGenOptLevel optLevel) : mOptLevel{optLevel} {}
+
+Result JitSession::instance(LLVMCodeGenOptLevel optLevel, JitSession** toFill) {
+	assert(toFill != nullptr);
+
+	// sessions are never destroyed: the programs that were run could have left things around that
+	// point into the code, like atexit handlers
+	static std::mutex sessionsMutex;
+	static auto       sessions = new std::map<LLVMCodeGenOptLevel, JitSession*>;
+
+	std::lock_guard<std::mutex> lock{sessionsMutex};
+
+	Result res;
+
+	auto& session = (*sessions)[optLevel];
+	if (session == nullptr) {
+		auto created = std::unique_ptr<JitSession>(new JitSession{optLevel});
+		res += created->initialize();
+		if (!res) { return res; }
+
+		session = created.release();
+	}
+	*toFill = session;
+
+	return res;
+}
+
+Result JitSession::initialize() {
+	Result res;
+
+	bool failed = LLVMInitializeNativeTarget();
+	failed      = failed || LLVMInitializeNativeAsmPrinter();
+	failed      = failed || LLVMInitializeNativeAsmParser();
+
+	// this only failes if it wasn't compiled with it, in theory
+	if (failed) {
+		res.addEntry("EINT", "Failed to initialize LLVM JIT", {});
+		return res;
+	}
+
+	// a target machine for the host, so the optimization level can be set
+	auto          triple = OwnedMessage(LLVMGetDefaultTargetTriple());
+	LLVMTargetRef target;
+	OwnedMessage  errMsg;
+	if (LLVMGetTargetFromTriple(*triple, &target, &*errMsg)) {
+		res.addEntry("EINT", "Failed to find the host target", {{"Error", *errMsg}});
+		return res;
+	}
+
+	mHostCPU          = *OwnedMessage(LLVMGetHostCPUName());
+	mHostFeatures     = *OwnedMessage(LLVMGetHostCPUFeatures());
+	auto makeMachine = [&] {
+		return LLVMCreateTargetMachine(target, *triple, mHostCPU.c_str(), mHostFeatures.c_str(),
+		                               mOptLevel, LLVMRelocDefault, LLVMCodeModelJITDefault);
+	};
+	auto targetMachine = makeMachine();
+	mTargetMachine     = OwnedTargetMachine(makeMachine());
+
+	auto builder = LLVMOrcCreateLLJITBuilder();
+	LLVMOrcLLJITBuilderSetJITTargetMachineBuilder(
+	    builder, LLVMOrcJITTargetMachineBuilderCreateFromTargetMachine(targetMachine));
+
+	if (auto err = LLVMOrcCreateLLJIT(&mJit, builder)) {
+		res.addEntry("EINT", "Failed to create LLJIT", {{"Error", consumeError(err)}});
+		return res;
+	}
+
+	auto session = LLVMOrcLLJITGetExecutionSession(mJit);
+	LLVMOrcExecutionSessionSetErrorReporter(session, &reportError, nullptr);
+
+	auto jitTriple = LLVMOrcLLJITGetTripleString(mJit);
+	if (auto err = LLVMOrcCreateLocalLazyCallThroughManager(
+	        jitTriple, session, reinterpret_cast<LLVMOrcJITTargetAddress>(&lazyCompileFailed),
+	        &mCallThrough)) {
+		res.addEntry("EINT", "Failed to create lazy call through manager",
+		             {{"Error", consumeError(err)}});
+		return res;
+	}
+	mStubs = LLVMOrcCreateLocalIndirectStubsManager(jitTriple);
+
+	return res;
+}
+
+Result JitSession::addModule(OwnedLLVMModule mod, size_t* toFill) {
+	assert(mod && toFill != nullptr);
+
+	Result res;
+
+	// aliases would have to be in every unit that uses them
+	if (LLVMGetFirstGlobalAlias(*mod) != nullptr) {
+		res.addEntry("EINT", "Modules with global aliases can't be added to a JitSession", {});
+		return res;
+	}
+
+	std::lock_guard<std::mutex> lock{mMutex};
+
+	auto moduleID  = mModules.size();
+	auto jitModule = std::make_unique<JitModule>();
+
+	// they are run by name, instead of by a platform
+	auto constructors = takeStructors(*mod, "llvm.global_ctors");
+	auto destructors  = takeStructors(*mod, "llvm.global_dtors");
+
+	// these would keep things that aren't called from being left out
+	for (auto usedName : {"llvm.used", "llvm.compiler.used"}) {
+		if (auto used = LLVMGetNamedGlobal(*mod, usedName)) { LLVMDeleteGlobal(used); }
+	}
+
+	if (strlen(LLVMGetDataLayoutStr(*mod)) == 0) {
+		LLVMSetDataLayout(*mod, LLVMOrcLLJITGetDataLayoutStr(mJit));
+	}
+	if (strlen(LLVMGetTarget(*mod)) == 0) { LLVMSetTarget(*mod, LLVMOrcLLJITGetTripleString(mJit)); }
+
+	// the names of the symbols end up in the native code, so for it to be cached they have to be
+	// the same every time the module is added, and still be different from the other modules'
+	jitModule->objectCacheDirectory = mObjectCacheDirectory;
+	if (jitModule->objectCacheDirectory.empty()) {
+		jitModule->prefix = "chi.jit." + std::to_string(moduleID) + ".";
+	} else {
+		auto bitcode = OwnedLLVMMemoryBuffer(LLVMWriteBitcodeToMemoryBuffer(*mod));
+		jitModule->bitcodeHash =
+		    ContentHasher{}
+		        .add({LLVMGetBufferStart(*bitcode), LLVMGetBufferSize(*bitcode)})
+		        .hexDigest();
+
+		auto copies = std::count_if(mModules.begin(), mModules.end(), [&](const auto& added) {
+			return added->bitcodeHash == jitModule->bitcodeHash;
+		});
+		jitModule->prefix =
+		    "chi.jit." + jitModule->bitcodeHash + "." + std::to_string(copies) + ".";
+	}
+
+	// every definition gets a name that's unique to this module and becomes external, so each
+	// function can be compiled on its own and still call the rest
+	auto   symPrefix = jitModule->prefix + "sym.";
+	size_t anonCount = 0;
+	auto   rename    = [&](LLVMValueRef global, std::vector<std::string>* defined) {
+		if (LLVMIsDeclaration(global) || isIntrinsic(global)) { return; }
+
+		auto name = valueName(global);
+		if (name.empty()) { name = "anon." + std::to_string(anonCount++); }
+
+		auto symName = symPrefix + name;
+		LLVMSetValueName2(global, symName.c_str(), symName.size());
+		LLVMSetLinkage(global, LLVMExternalLinkage);
+		LLVMSetVisibility(global, LLVMDefaultVisibility);
+
+		// it could have been renamed again if the name was taken
+		defined->push_back(valueName(global).substr(symPrefix.size()));
+	};
+
+	std::vector<std::string> functions;
+	for (auto func = LLVMGetFirstFunction(*mod); func != nullptr; func = LLVMGetNextFunction(func)) {
+		rename(func, &functions);
+	}
+	std::vector<std::string> globals;
+	for (auto global = LLVMGetFirstGlobal(*mod); global != nullptr;
+	     global      = LLVMGetNextGlobal(global)) {
+		rename(global, &globals);
+	}
+
+	for (auto ctor : constructors) {
+		jitModule->constructors.push_back(valueName(ctor).substr(symPrefix.size()));
+	}
+	for (auto dtor : destructors) {
+		jitModule->destructors.push_back(valueName(dtor).substr(symPrefix.size()));
+	}
+
+	jitModule->bitcode = OwnedLLVMMemoryBuffer(LLVMWriteBitcodeToMemoryBuffer(*mod));
+
+	// the module gets its own JITDylib, so everything the JIT has for it can be removed with it
+	auto mainDylib = LLVMOrcLLJITGetMainJITDylib(mJit);
+	auto dylib     = LLVMOrcExecutionSessionCreateBareJITDylib(
+	    LLVMOrcLLJITGetExecutionSession(mJit), jitModule->prefix.c_str());
+
+	// symbols that aren't in the module come from the process, like the C library
+	LLVMOrcDefinitionGeneratorRef processSymbols;
+	if (auto err = LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(
+	        &processSymbols, LLVMOrcLLJITGetGlobalPrefix(mJit), nullptr, nullptr)) {
+		res.addEntry("EINT", "Failed to search the process for symbols",
+		             {{"Error", consumeError(err)}});
+		return res;
+	}
+	LLVMOrcJITDylibAddGenerator(dylib, processSymbols);
+
+	auto define = [&](LLVMOrcJITDylibRef defineIn, LLVMOrcMaterializationUnitRef mu) {
+		if (auto err = LLVMOrcJITDylibDefine(defineIn, mu)) {
+			LLVMOrcDisposeMaterializationUnit(mu);
+			res.addEntry("EINT", "Failed to define symbols in JIT", {{"Error", consumeError(err)}});
+		}
+		if (!res) { LLVMOrcJITDylibClear(dylib); }
+	};
+
+	// each function is compiled by itself, the first time its stub is called. The functions are
+	// called from outside the module through stubs in the main JITDylib, which is the only one the
+	// JIT looks symbols up in.
+	std::vector<LLVMOrcCSymbolAliasMapPair> stubs;
+	std::vector<LLVMOrcCSymbolAliasMapPair> entries;
+	for (const auto& name : functions) {
+		auto bodySym = LLVMOrcLLJITMangleAndIntern(
+		    mJit, (jitModule->prefix + "body." + name).c_str());
+
+		// one reference for the unit and one for each stub
+		LLVMOrcRetainSymbolStringPoolEntry(bodySym);
+		LLVMOrcRetainSymbolStringPoolEntry(bodySym);
+
+		LLVMOrcCSymbolFlagsMapPair bodyFlags{
+		    bodySym, symbolFlags(LLVMJITSymbolGenericFlagsExported |
+		                         LLVMJITSymbolGenericFlagsCallable)};
+		define(dylib, LLVMOrcCreateCustomMaterializationUnit(
+		                  name.c_str(), new Unit{this, jitModule.get(), name}, &bodyFlags, 1,
+		                  nullptr, &materializeUnit, &discardUnit, &destroyUnit));
+		if (!res) { return res; }
+
+		stubs.push_back({LLVMOrcLLJITMangleAndIntern(mJit, (symPrefix + name).c_str()),
+		                 {bodySym, symbolFlags(LLVMJITSymbolGenericFlagsExported |
+		                                       LLVMJITSymbolGenericFlagsCallable)}});
+		entries.push_back(
+		    {LLVMOrcLLJITMangleAndIntern(mJit, (jitModule->prefix + "entry." + name).c_str()),
+		     {bodySym, symbolFlags(LLVMJITSymbolGenericFlagsExported |
+		                           LLVMJITSymbolGenericFlagsCallable)}});
+	}
+	if (!stubs.empty()) {
+		define(dylib,
+		       LLVMOrcLazyReexports(mCallThrough, mStubs, dylib, stubs.data(), stubs.size()));
+		if (!res) { return res; }
+	}
+
+	// and the global variables are compiled together, the first time one is used
+	if (!globals.empty()) {
+		std::vector<LLVMOrcCSymbolFlagsMapPair> globalFlags;
+		for (const auto& name : globals) {
+			globalFlags.push_back({LLVMOrcLLJITMangleAndIntern(mJit, (symPrefix + name).c_str()),
+			                       symbolFlags(LLVMJITSymbolGenericFlagsExported)});
+		}
+
+		define(dylib, LLVMOrcCreateCustomMaterializationUnit(
+		                  "globals", new Unit{this, jitModule.get(), ""}, globalFlags.data(),
+		                  globalFlags.size(), nullptr, &materializeUnit, &discardUnit,
+		                  &destroyUnit));
+		if (!res) { return res; }
+	}
+
+	// these are left behind when the module is removed, but they only take up a stub each
+	if (!entries.empty()) {
+		define(mainDylib, LLVMOrcLazyReexports(mCallThrough, mStubs, dylib, entries.data(),
+		                                       entries.size()));
+		if (!res) { return res; }
+	}
+
+	jitModule->dylib = dylib;
+	mModules.push_back(std::move(jitModule));
+	++mStats.modulesAdded;
+
+	*toFill = moduleID;
+
+	return res;
+}
+
+Result JitSession::removeModule(size_t moduleID) {
+	Result res;
+
+	LLVMOrcJITDylibRef dylib;
+	{
+		std::lock_guard<std::mutex> lock{mMutex};
+		if (moduleID >= mModules.size() || mModules[moduleID]->dylib == nullptr) {
+			res.addEntry("EINT", "No module with that ID in the JitSession",
+			             {{"Module ID", moduleID}});
+			return res;
+		}
+
+		dylib                     = mModules[moduleID]->dylib;
+		mModules[moduleID]->dylib = nullptr;
+	}
+
+	// the units that were never compiled are destroyed with it, so only then can the bitcode go
+	if (auto err = LLVMOrcJITDylibClear(dylib)) {
+		res.addEntry("EINT", "Failed to remove module from JIT", {{"Error", consumeError(err)}});
+	}
+
+	std::lock_guard<std::mutex> lock{mMutex};
+	mModules[moduleID]->bitcode = {};
+	mModules[moduleID]->constructors.clear();
+	mModules[moduleID]->destructors.clear();
+
+	return res;
+}
+
+Result JitSession::lookup(size_t moduleID, std::string_view name, void** toFill) {
+	assert(toFill != nullptr);
+
+	Result res;
+
+	std::string symName;
+	{
+		std::lock_guard<std::mutex> lock{mMutex};
+		if (moduleID >= mModules.size() || mModules[moduleID]->dylib == nullptr) {
+			res.addEntry("EINT", "No module with that ID in the JitSession",
+			             {{"Module ID", moduleID}});
+			return res;
+		}
+		symName = mModules[moduleID]->prefix + "entry." + std::string(name);
+	}
+
+	// looking it up makes its stub, which can look up other symbols, so the lock can't be held
+	LLVMOrcExecutorAddress address;
+	if (auto err = LLVMOrcLLJITLookup(mJit, &address, symName.c_str())) {
+		res.addEntry("EINT", "Failed to find symbol in JIT",
+		             {{"Symbol", std::string(name)}, {"Error", consumeError(err)}});
+		return res;
+	}
+	*toFill = reinterpret_cast<void*>(static_cast<uintptr_t>(address));
+
+	return res;
+}
+
+Result JitSession::runStaticConstructors(size_t moduleID) {
+	std::vector<std::string> constructors;
+	{
+		std::lock_guard<std::mutex> lock{mMutex};
+		assert(moduleID < mModules.size());
+		constructors = mModules[moduleID]->constructors;
+	}
+
+	return runFunctions(*this, moduleID, constructors);
+}
+
+Result JitSession::runStaticDestructors(size_t moduleID) {
+	std::vector<std::string> destructors;
+	{
+		std::lock_guard<std::mutex> lock{mMutex};
+		assert(moduleID < mModules.size());
+		destructors = mModules[moduleID]->destructors;
+	}
+
+	return runFunctions(*this, moduleID, destructors);
+}
+
+void JitSession::setObjectCacheDirectory(fs::path dir) {
+	std::lock_guard<std::mutex> lock{mMutex};
+	mObjectCacheDirectory = std::move(dir);
+}
+
+fs::path JitSession::objectCacheDirectory() const {
+	std::lock_guard<std::mutex> lock{mMutex};
+	return mObjectCacheDirectory;
+}
+
+size_t JitSession::pruneObjectCache(std::chrono::hours unusedFor) {
+	auto dir = objectCacheDirectory();
+	if (dir.empty()) { return 0; }
+
+	auto cutoff = fs::file_time_type::clock::now() - unusedFor;
+	auto isOld  = [&](const fs::path& path) {
+		std::error_code ec;
+		auto            time = fs::last_write_time(path, ec);
+		return !ec && time < cutoff;
+	};
+
+	// the times go with their objects, which are the ones marked as used
+	size_t          removed = 0;
+	std::error_code ec;
+	for (const auto& entry : fs::directory_iterator{dir, ec}) {
+		auto path = entry.path();
+
+		std::error_code removeEC;
+		if (path.extension() == ".o" && isOld(path)) {
+			fs::remove(path, removeEC);
+			fs::remove(fs::path{path}.replace_extension(".time"), removeEC);
+			++removed;
+		} else if (path.extension() == ".time" &&
+		           !fs::exists(fs::path{path}.replace_extension(".o"), removeEC) && isOld(path)) {
+			fs::remove(path, removeEC);
+		} else if (path.extension() == ".partial" && isOld(path)) {
+			fs::remove(path, removeEC);
+		}
+	}
+
+	return removed;
+}
+
+JitSession::Stats JitSession::stats() const {
+	std::lock_guard<std::mutex> lock{mMutex};
+	return mStats;
+}
+
+Result JitSession::extractUnit(const Unit& unit, LLVMContextRef llctx, OwnedLLVMModule* toFill) {
+	assert(llctx != nullptr && toFill != nullptr);
+
+	Result res;
+
+	const auto& prefix = unit.module->prefix;
+
+	// read it lazily, so the bodies of the functions that aren't in this unit are never read. The
+	// buffer is just a view of the module's bitcode, and the module is taken by the reader.
+	auto view = LLVMCreateMemoryBufferWithMemoryRange(LLVMGetBufferStart(*unit.module->bitcode),
+	                                                  LLVMGetBufferSize(*unit.module->bitcode),
+	                                                  prefix.c_str(), false);
+	LLVMModuleRef lazyModule;
+	if (LLVMGetBitcodeModuleInContext2(llctx, view, &lazyModule)) {
+		res.addEntry("EINT", "Failed to read module in JIT", {{"Module", prefix}});
+		return res;
+	}
+	auto unitModule = OwnedLLVMModule(lazyModule);
+
+	auto symName = prefix + "sym." + unit.name;
+	for (auto func = LLVMGetFirstFunction(*unitModule); func != nullptr;) {
+		auto next = LLVMGetNextFunction(func);
+		if (!LLVMIsDeclaration(func) && (unit.name.empty() || valueName(func) != symName)) {
+			replaceWithDeclaration(*unitModule, func);
+		}
+		func = next;
+	}
+	if (!unit.name.empty()) {
+		for (auto global = LLVMGetFirstGlobal(*unitModule); global != nullptr;) {
+			auto next = LLVMGetNextGlobal(global);
+			if (!LLVMIsDeclaration(global) && !isIntrinsic(global)) {
+				replaceWithDeclaration(*unitModule, global);
+			}
+			global = next;
+		}
+	}
+
+	// linking it into an empty module reads what's left
+	auto extracted = OwnedLLVMModule(LLVMModuleCreateWithNameInContext(prefix.c_str(), llctx));
+	LLVMSetTarget(*extracted, LLVMGetTarget(*unitModule));
+	LLVMSetDataLayout(*extracted, LLVMGetDataLayoutStr(*unitModule));
+	if (LLVMLinkModules2(*extracted, unitModule.take_ownership())) {
+		res.addEntry("EINT", "Failed to link unit in JIT", {{"Module", prefix}});
+		return res;
+	}
+
+	// the stub has the function's name, the body gets its own
+	if (!unit.name.empty()) {
+		auto func = LLVMGetNamedFunction(*extracted, symName.c_str());
+		assert(func != nullptr);
+
+		auto bodyName = prefix + "body." + unit.name;
+		LLVMSetValueName2(func, bodyName.c_str(), bodyName.size());
+	}
+
+	*toFill = std::move(extracted);
+
+	return res;
+}
+
+Result JitSession::generateObject(const Unit& unit, OwnedLLVMMemoryBuffer* toFill) {
+	assert(toFill != nullptr);
+
+	Result res;
+
+	// units can be materialized on any thread that calls them first, so each one gets its own
+	// context. It's declared first so it outlives the module.
+	auto            llctx = OwnedLLVMContext(LLVMContextCreate());
+	OwnedLLVMModule extracted;
+	res += extractUnit(unit, *llctx, &extracted);
+	if (!res) { return res; }
+
+	LLVMMemoryBufferRef object;
+	OwnedMessage        errMsg;
+	{
+		std::lock_guard<std::mutex> lock{mCodegenMutex};
+		if (LLVMTargetMachineEmitToMemoryBuffer(*mTargetMachine, *extracted, LLVMObjectFile,
+		                                        &*errMsg, &object)) {
+			res.addEntry("EINT", "Failed to generate code in JIT", {{"Error", *errMsg}});
+			return res;
+		}
+	}
+	*toFill = OwnedLLVMMemoryBuffer(object);
+
+	return res;
+}
+
+Result JitSession::objectForUnit(const Unit& unit, OwnedLLVMMemoryBuffer* toFill) {
+	assert(toFill != nullptr);
+
+	Result res;
+
+	ContentHasher hasher;
+	hasher.add("jit object")
+	    .add(HashedModuleCache::compilerVersion())
+	    .add(unit.module->prefix)
+	    .add(unit.name)
+	    .add(std::to_string(mOptLevel))
+	    .add(mHostCPU)
+	    .add(mHostFeatures);
+
+	auto objectPath = unit.module->objectCacheDirectory / (hasher.hexDigest() + ".o");
+	auto timePath   = objectPath;
+	timePath.replace_extension(".time");
+
+	if (fs::is_regular_file(objectPath)) {
+		OwnedLLVMMemoryBuffer object;
+		OwnedMessage          errMsg;
+		if (!LLVMCreateMemoryBufferWithContentsOfFile(objectPath.string().c_str(), &*object,
+		                                              &*errMsg)) {
+			// it's used, so pruneObjectCache keeps it
+			std::error_code ec;
+			fs::last_write_time(objectPath, fs::file_time_type::clock::now(), ec);
+
+			// how long it took to generate it, for the stats
+			std::ifstream       timeStream{timePath};
+			long long           nanoseconds = 0;
+			timeStream >> nanoseconds;
+
+			std::lock_guard<std::mutex> lock{mMutex};
+			++mStats.objectCacheHits;
+			mStats.codegenTimeSaved += std::chrono::nanoseconds{nanoseconds};
+
+			*toFill = std::move(object);
+			return res;
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	OwnedLLVMMemoryBuffer object;
+	res += generateObject(unit, &object);
+	if (!res) { return res; }
+
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+	    std::chrono::steady_clock::now() - start);
+
+	{
+		std::lock_guard<std::mutex> lock{mMutex};
+		++mStats.objectCacheMisses;
+		mStats.codegenTime += elapsed;
+	}
+
+	// failing to cache it is fine, it'll just be generated again next time. Each file is written
+	// somewhere else first, so a half written one never has a valid name.
+	std::error_code ec;
+	fs::create_directories(objectPath.parent_path(), ec);
+
+	auto partialTimePath = timePath;
+	partialTimePath += ".partial";
+	{ std::ofstream{partialTimePath} << elapsed.count(); }
+	fs::rename(partialTimePath, timePath, ec);
+	if (ec) { fs::remove(partialTimePath, ec); }
+
+	auto partialPath = objectPath;
+	partialPath += ".partial";
+	{
+		std::ofstream stream{partialPath, std::ios::binary};
+		stream.write(LLVMGetBufferStart(*object), LLVMGetBufferSize(*object));
+	}
+	fs::rename(partialPath, objectPath, ec);
+	if (ec) { fs::remove(partialPath, ec); }
+
+	*toFill = std::move(object);
+
+	return res;
+}
+
+void JitSession::materializeUnit(void* ctx, LLVMOrcMaterializationResponsibilityRef mr) {
+	auto  unit    = std::unique_ptr<Unit>(static_cast<Unit*>(ctx));
+	auto& session = *unit->session;
+
+	auto fail = [&](const Result& res) {
+		std::cerr << res << std::endl;
+
+		LLVMOrcMaterializationResponsibilityFailMaterialization(mr);
+		LLVMOrcDisposeMaterializationResponsibility(mr);
+	};
+
+	if (!unit->name.empty()) {
+		std::lock_guard<std::mutex> lock{session.mMutex};
+		++session.mStats.functionsCompiled;
+	}
+
+	// the code is generated here instead of by the JIT's IR layers, which share one TargetMachine
+	// between the threads that call functions for the first time
+	OwnedLLVMMemoryBuffer object;
+	Result                res;
+	if (unit->module->objectCacheDirectory.empty()) {
+		res += session.generateObject(*unit, &object);
+	} else {
+		res += session.objectForUnit(*unit, &object);
+	}
+	if (!res) {
+		fail(res);
+		return;
+	}
+
+	LLVMOrcObjectLayerEmit(LLVMOrcLLJITGetObjLinkingLayer(session.mJit), mr,
+	                       object.take_ownership());
+}
+
+void JitSession::discardUnit(void* /*ctx*/, LLVMOrcJITDylibRef /*jd*/,
+                             LLVMOrcSymbolStringPoolEntryRef /*sym*/) {
+	// the symbols are never weak, so they are never overridden
+}
+
+void JitSession::destroyUnit(void* ctx) { delete static_cast<Unit*>(ctx); }
+
+}  // namespace chi
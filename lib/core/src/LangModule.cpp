@@ -4,12 +4,25 @@
 
 #include <llvm-c/Core.h>
 #include <llvm-c/DebugInfo.h>
+#include <llvm-c/Target.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_set>
 
 #include "chi/Context.hpp"
 #include "chi/DataType.hpp"
 #include "chi/Dwarf.hpp"
 #include "chi/FunctionCompiler.hpp"
+#include "chi/GraphFunction.hpp"
+#include "chi/GraphModule.hpp"
+#include "chi/NameMangler.hpp"
 #include "chi/NodeType.hpp"
+#include "chi/Owned.hpp"
 #include "chi/Support/Result.hpp"
 
 using namespace std::string_literals;
@@ -31,17 +44,33 @@ struct IfNodeType : NodeType {
 	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
 		assert(io.size() == 1 && outputBlocks.size() == 2);
 
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
 
-		LLVMBuildCondBr(*builder, io[0], outputBlocks[0], outputBlocks[1]);
+		// a condition that was folded only ever goes one way
+		if (LLVMIsConstant(io[0])) {
+			LLVMBuildBr(*builder,
+			            LLVMConstIntGetZExtValue(io[0]) != 0 ? outputBlocks[0] : outputBlocks[1]);
+		} else {
+			LLVMBuildCondBr(*builder, io[0], outputBlocks[0], outputBlocks[1]);
+		}
 
 		return {};
 	}
 
+	std::vector<bool> reachableExecOutputs(
+	    const std::vector<LLVMValueRef>& inputs) const override {
+		assert(inputs.size() == 1);
+
+		if (inputs[0] == nullptr) { return {true, true}; }
+
+		bool condition = LLVMConstIntGetZExtValue(inputs[0]) != 0;
+		return {condition, !condition};
+	}
+
 	std::unique_ptr<NodeType> clone() const override { return std::make_unique<IfNodeType>(*this); }
 };
 
@@ -59,21 +88,27 @@ struct EntryNodeType : NodeType {
 	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
 		assert(io.size() == dataOutputs().size() && outputBlocks.size() == execOutputs().size());
 
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
 
-		// store the arguments
-		auto function = LLVMGetBasicBlockParent(codegenInto);
-
-		auto current_arg = LLVMGetParam(function, 1);
+		// store the arguments, which come after the exec input ID if there is one
+		auto function    = LLVMGetBasicBlockParent(codegenInto);
+		auto execInput   = compiler.funcCompiler().specializedExecInput();
+		auto current_arg = LLVMGetParam(function, execInput ? 0 : 1);
 		for (const auto& iovalue : io) {
 			LLVMBuildStore(*builder, current_arg, iovalue);
 
 			current_arg = LLVMGetNextParam(current_arg);
 		}
 
+		// a clone that's specialized for an exec input always starts there
+		if (execInput) {
+			LLVMBuildBr(*builder, outputBlocks[*execInput]);
+			return {};
+		}
+
 		auto inExecID   = LLVMGetFirstParam(function);
 		auto switchInst = LLVMBuildSwitch(*builder, inExecID, outputBlocks[0], outputBlocks.size());
 
@@ -117,7 +152,7 @@ struct ConstIntNodeType : NodeType {
 	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
 		assert(io.size() == 1 && outputBlocks.size() == 1);
 
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
@@ -128,6 +163,12 @@ struct ConstIntNodeType : NodeType {
 		return {};
 	}
 
+	bool constantFold(const std::vector<LLVMValueRef>& /*inputs*/,
+	                  std::vector<LLVMValueRef>* toFill) const override {
+		*toFill = {context().constI32(number)};
+		return true;
+	}
+
 	std::unique_ptr<NodeType> clone() const override {
 		return std::make_unique<ConstIntNodeType>(*this);
 	}
@@ -149,7 +190,7 @@ struct ConstFloatNodeType : NodeType {
 	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
 		assert(io.size() == 1 && outputBlocks.size() == 1);
 
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
@@ -160,6 +201,12 @@ struct ConstFloatNodeType : NodeType {
 		return {};
 	}
 
+	bool constantFold(const std::vector<LLVMValueRef>& /*inputs*/,
+	                  std::vector<LLVMValueRef>* toFill) const override {
+		*toFill = {context().constF64(number)};
+		return true;
+	}
+
 	std::unique_ptr<NodeType> clone() const override {
 		return std::make_unique<ConstFloatNodeType>(*this);
 	}
@@ -181,7 +228,7 @@ struct ConstBoolNodeType : NodeType {
 	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
 		assert(io.size() == 1 && outputBlocks.size() == 1);
 
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
@@ -192,6 +239,12 @@ struct ConstBoolNodeType : NodeType {
 		return {};
 	}
 
+	bool constantFold(const std::vector<LLVMValueRef>& /*inputs*/,
+	                  std::vector<LLVMValueRef>* toFill) const override {
+		*toFill = {context().constBool(value)};
+		return true;
+	}
+
 	std::unique_ptr<NodeType> clone() const override {
 		return std::make_unique<ConstBoolNodeType>(*this);
 	}
@@ -216,7 +269,7 @@ struct ExitNodeType : NodeType {
 		assert(execInputID < execInputs().size() && io.size() == dataInputs().size());
 
 		// assign the return types
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
@@ -270,7 +323,7 @@ struct StringLiteralNodeType : NodeType {
 	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
 		assert(io.size() == 1 && outputBlocks.size() == 1);
 
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
@@ -292,7 +345,16 @@ struct StringLiteralNodeType : NodeType {
 	std::string    literalString;
 };
 
-struct IntToFloatNodeType : NodeType {
+// a lang node that's one operation on its inputs, so buffer nodes can run it on each element
+struct LaneOperation {
+	virtual ~LaneOperation() = default;
+
+	// build the operation on values of the node's input types, and get its output
+	virtual LLVMValueRef buildOperation(LLVMBuilderRef                   builder,
+	                                    const std::vector<LLVMValueRef>& inputs) const = 0;
+};
+
+struct IntToFloatNodeType : NodeType, LaneOperation {
 	IntToFloatNodeType(LangModule& mod) : NodeType(mod, "inttofloat", "Float -> Integer") {
 		makePure();
 
@@ -308,26 +370,38 @@ struct IntToFloatNodeType : NodeType {
 	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
 		assert(io.size() == 2 && outputBlocks.size() == 1);
 
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
 
-		auto casted = LLVMBuildCast(*builder, LLVMSIToFP, io[0],
-		                            LLVMDoubleTypeInContext(context().llvmContext()), "");
-		LLVMBuildStore(*builder, casted, io[1]);
+		LLVMBuildStore(*builder, buildOperation(*builder, {io[0]}), io[1]);
 
 		LLVMBuildBr(*builder, outputBlocks[0]);
 
 		return {};
 	}
 
+	LLVMValueRef buildOperation(LLVMBuilderRef                   builder,
+	                            const std::vector<LLVMValueRef>& inputs) const override {
+		return LLVMBuildCast(builder, LLVMSIToFP, inputs[0],
+		                     LLVMDoubleTypeInContext(context().llvmContext()), "");
+	}
+
+	bool constantFold(const std::vector<LLVMValueRef>& inputs,
+	                  std::vector<LLVMValueRef>* toFill) const override {
+		assert(inputs.size() == 1);
+
+		*toFill = {LLVMConstSIToFP(inputs[0], LLVMDoubleTypeInContext(context().llvmContext()))};
+		return true;
+	}
+
 	std::unique_ptr<NodeType> clone() const override {
 		return std::make_unique<IntToFloatNodeType>(*this);
 	}
 };
 
-struct FloatToIntNodeType : NodeType {
+struct FloatToIntNodeType : NodeType, LaneOperation {
 	FloatToIntNodeType(LangModule& mod) : NodeType(mod, "floattoint", "Float -> Integer") {
 		makePure();
 
@@ -342,29 +416,134 @@ struct FloatToIntNodeType : NodeType {
 	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
 		assert(io.size() == 2 && outputBlocks.size() == 1);
 
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
 
-		auto casted = LLVMBuildCast(*builder, LLVMFPToSI, io[0],
-		                            LLVMInt32TypeInContext(context().llvmContext()), "");
-		LLVMBuildStore(*builder, casted, io[1]);
+		LLVMBuildStore(*builder, buildOperation(*builder, {io[0]}), io[1]);
 
 		LLVMBuildBr(*builder, outputBlocks[0]);
 
 		return {};
 	}
 
+	LLVMValueRef buildOperation(LLVMBuilderRef                   builder,
+	                            const std::vector<LLVMValueRef>& inputs) const override {
+		return LLVMBuildCast(builder, LLVMFPToSI, inputs[0],
+		                     LLVMInt32TypeInContext(context().llvmContext()), "");
+	}
+
+	bool constantFold(const std::vector<LLVMValueRef>& inputs,
+	                  std::vector<LLVMValueRef>* toFill) const override {
+		assert(inputs.size() == 1);
+
+		// out of range is undefined, leave it to run and do whatever it does
+		LLVMBool losesInfo;
+		auto     value = LLVMConstRealGetDouble(inputs[0], &losesInfo);
+		if (!(value > -2147483649.0 && value < 2147483648.0)) { return false; }
+
+		*toFill = {LLVMConstFPToSI(inputs[0], LLVMInt32TypeInContext(context().llvmContext()))};
+		return true;
+	}
+
 	std::unique_ptr<NodeType> clone() const override {
 		return std::make_unique<FloatToIntNodeType>(*this);
 	}
 };
 
+// if a type is an integer, or a vector of them
+bool isIntegral(const DataType& ty) {
+	auto llType = ty.llvmType();
+	if (LLVMGetTypeKind(llType) == LLVMVectorTypeKind) { llType = LLVMGetElementType(llType); }
+	return LLVMGetTypeKind(llType) == LLVMIntegerTypeKind;
+}
+
+/// NodeType for converting between the number types, which sign extends, truncates or rounds
+/// toward zero
+struct ConvertNodeType : NodeType, LaneOperation {
+	ConvertNodeType(LangModule& mod, DataType from, DataType to)
+	    : NodeType(mod, from.unqualifiedName() + "to" + to.unqualifiedName(),
+	               from.unqualifiedName() + " -> " + to.unqualifiedName()) {
+		makePure();
+
+		setDataInputs({{"", from}});
+		setDataOutputs({{"", to}});
+
+		makeConverter();
+	}
+
+	Result codegen(NodeCompiler& /*compiler*/, LLVMBasicBlockRef codegenInto,
+	               size_t /*execInputID*/, LLVMMetadataRef       nodeLocation,
+	               const std::vector<LLVMValueRef>&      io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 2 && outputBlocks.size() == 1);
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		LLVMBuildStore(*builder, buildOperation(*builder, {io[0]}), io[1]);
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return {};
+	}
+
+	LLVMValueRef buildOperation(LLVMBuilderRef                   builder,
+	                            const std::vector<LLVMValueRef>& inputs) const override {
+		auto to = dataOutputs()[0].type.llvmType();
+
+		// float and f64 are both doubles
+		if (LLVMTypeOf(inputs[0]) == to) { return inputs[0]; }
+
+		auto fromIntegral = isIntegral(dataInputs()[0].type);
+		auto toIntegral   = isIntegral(dataOutputs()[0].type);
+		if (fromIntegral && toIntegral) {
+			return LLVMBuildIntCast2(builder, inputs[0], to, true, "");
+		} else if (fromIntegral) {
+			return LLVMBuildSIToFP(builder, inputs[0], to, "");
+		} else if (toIntegral) {
+			return LLVMBuildFPToSI(builder, inputs[0], to, "");
+		}
+		return LLVMBuildFPCast(builder, inputs[0], to, "");
+	}
+
+	bool constantFold(const std::vector<LLVMValueRef>& inputs,
+	                  std::vector<LLVMValueRef>* toFill) const override {
+		assert(inputs.size() == 1);
+
+		auto from = dataInputs()[0].type;
+		auto to   = dataOutputs()[0].type;
+
+		if (isIntegral(from) && isIntegral(to)) {
+			*toFill = {LLVMConstIntCast(inputs[0], to.llvmType(), true)};
+		} else if (isIntegral(from)) {
+			*toFill = {LLVMConstSIToFP(inputs[0], to.llvmType())};
+		} else if (!isIntegral(to)) {
+			*toFill = {LLVMConstFPCast(inputs[0], to.llvmType())};
+		} else {
+			// out of range is undefined, leave it to run and do whatever it does
+			LLVMBool losesInfo;
+			auto     value = LLVMConstRealGetDouble(inputs[0], &losesInfo);
+			auto     limit = std::ldexp(1.0, LLVMGetIntTypeWidth(to.llvmType()) - 1);
+			if (!(value > -limit - 1.0 && value < limit)) { return false; }
+
+			*toFill = {LLVMConstFPToSI(inputs[0], to.llvmType())};
+		}
+		return true;
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<ConvertNodeType>(*this);
+	}
+};
+
 /// \internal
 enum class BinOp { Add, Subtract, Multiply, Divide };
 
-struct BinaryOperationNodeType : NodeType {
+struct BinaryOperationNodeType : NodeType, LaneOperation {
 	BinaryOperationNodeType(LangModule& mod, DataType ty, BinOp binaryOperation)
 	    : NodeType(mod), mBinOp(binaryOperation), mType{ty} {
 		makePure();
@@ -405,42 +584,78 @@ struct BinaryOperationNodeType : NodeType {
 	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
 		assert(io.size() == 3 && outputBlocks.size() == 1);
 
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
 
-		LLVMValueRef result = nullptr;
-		if (mType.unqualifiedName() == "i32") {
-			result = [&](BinOp b) {
-				switch (b) {
-				case BinOp::Add: return LLVMBuildAdd(*builder, io[0], io[1], "");
-				case BinOp::Subtract: return LLVMBuildSub(*builder, io[0], io[1], "");
-				case BinOp::Multiply: return LLVMBuildMul(*builder, io[0], io[1], "");
-				case BinOp::Divide: return LLVMBuildSDiv(*builder, io[0], io[1], "");
-				default: return (LLVMValueRef) nullptr;
-				}
-				return (LLVMValueRef) nullptr;
-			}(mBinOp);
+		LLVMBuildStore(*builder, buildOperation(*builder, {io[0], io[1]}), io[2]);
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
 
+		return {};
+	}
+
+	LLVMValueRef buildOperation(LLVMBuilderRef                   builder,
+	                            const std::vector<LLVMValueRef>& inputs) const override {
+		if (isIntegral(mType)) {
+			switch (mBinOp) {
+			case BinOp::Add: return LLVMBuildAdd(builder, inputs[0], inputs[1], "");
+			case BinOp::Subtract: return LLVMBuildSub(builder, inputs[0], inputs[1], "");
+			case BinOp::Multiply: return LLVMBuildMul(builder, inputs[0], inputs[1], "");
+			case BinOp::Divide: return LLVMBuildSDiv(builder, inputs[0], inputs[1], "");
+			}
 		} else {
-			result = [&](BinOp b) {
-				switch (b) {
-				case BinOp::Add: return LLVMBuildFAdd(*builder, io[0], io[1], "");
-				case BinOp::Subtract: return LLVMBuildFSub(*builder, io[0], io[1], "");
-				case BinOp::Multiply: return LLVMBuildFMul(*builder, io[0], io[1], "");
-				case BinOp::Divide: return LLVMBuildFDiv(*builder, io[0], io[1], "");
-				default: return (LLVMValueRef) nullptr;
-				}
-				return (LLVMValueRef) nullptr;
-			}(mBinOp);
+			switch (mBinOp) {
+			case BinOp::Add: return LLVMBuildFAdd(builder, inputs[0], inputs[1], "");
+			case BinOp::Subtract: return LLVMBuildFSub(builder, inputs[0], inputs[1], "");
+			case BinOp::Multiply: return LLVMBuildFMul(builder, inputs[0], inputs[1], "");
+			case BinOp::Divide: return LLVMBuildFDiv(builder, inputs[0], inputs[1], "");
+			}
 		}
+		assert(false);
+		return nullptr;
+	}
 
-		LLVMBuildStore(*builder, result, io[2]);
+	bool constantFold(const std::vector<LLVMValueRef>& inputs,
+	                  std::vector<LLVMValueRef>* toFill) const override {
+		assert(inputs.size() == 2);
 
-		LLVMBuildBr(*builder, outputBlocks[0]);
+		LLVMValueRef result = nullptr;
+		if (isIntegral(mType)) {
+			switch (mBinOp) {
+			case BinOp::Add: result = LLVMConstAdd(inputs[0], inputs[1]); break;
+			case BinOp::Subtract: result = LLVMConstSub(inputs[0], inputs[1]); break;
+			case BinOp::Multiply: result = LLVMConstMul(inputs[0], inputs[1]); break;
+			case BinOp::Divide: {
+				// dividing by zero or overflowing is undefined, leave it to run. That's checked for
+				// each lane of a vector when it runs.
+				if (LLVMGetTypeKind(mType.llvmType()) == LLVMVectorTypeKind) { return false; }
+
+				auto width   = LLVMGetIntTypeWidth(mType.llvmType());
+				auto minimum = width == 64 ? INT64_MIN : -(int64_t(1) << (width - 1));
+				auto divisor = LLVMConstIntGetSExtValue(inputs[1]);
+				if (divisor == 0 ||
+				    (divisor == -1 && LLVMConstIntGetSExtValue(inputs[0]) == minimum)) {
+					return false;
+				}
+				result = LLVMConstSDiv(inputs[0], inputs[1]);
+				break;
+			}
+			default: return false;
+			}
+		} else {
+			switch (mBinOp) {
+			case BinOp::Add: result = LLVMConstFAdd(inputs[0], inputs[1]); break;
+			case BinOp::Subtract: result = LLVMConstFSub(inputs[0], inputs[1]); break;
+			case BinOp::Multiply: result = LLVMConstFMul(inputs[0], inputs[1]); break;
+			case BinOp::Divide: result = LLVMConstFDiv(inputs[0], inputs[1]); break;
+			default: return false;
+			}
+		}
 
-		return {};
+		*toFill = {result};
+		return true;
 	}
 
 	std::unique_ptr<NodeType> clone() const override {
@@ -453,7 +668,7 @@ struct BinaryOperationNodeType : NodeType {
 
 enum class CmpOp { Lt, Gt, Let, Get, Eq, Neq };
 
-struct CompareNodeType : NodeType {
+struct CompareNodeType : NodeType, LaneOperation {
 	CompareNodeType(LangModule& mod, DataType ty, CmpOp op)
 	    : NodeType(mod), mCompOp(op), mType{ty} {
 		makePure();
@@ -474,8 +689,14 @@ struct CompareNodeType : NodeType {
 		setName(ty.unqualifiedName() + opStr + ty.unqualifiedName());
 		setDescription(ty.unqualifiedName() + opStr + ty.unqualifiedName());
 
+		// vectors are compared lane by lane
+		std::string boolType = "i1";
+		if (LLVMGetTypeKind(ty.llvmType()) == LLVMVectorTypeKind) {
+			boolType += "x" + std::to_string(LLVMGetVectorSize(ty.llvmType()));
+		}
+
 		setDataInputs({{"a", ty}, {"b", ty}});
-		setDataOutputs({{"", mod.typeFromName("i1")}});
+		setDataOutputs({{"", mod.typeFromName(boolType)}});
 	}
 
 	Result codegen(NodeCompiler& /*compiler*/, LLVMBasicBlockRef codegenInto,
@@ -484,44 +705,62 @@ struct CompareNodeType : NodeType {
 	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
 		assert(io.size() == 3 && outputBlocks.size() == 1);
 
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilder());
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
 		LLVMPositionBuilder(*builder, codegenInto, nullptr);
 		LLVMSetCurrentDebugLocation(*builder,
 		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
 
-		LLVMValueRef result = nullptr;
-		if (mType.unqualifiedName() == "i32") {
-			LLVMIntPredicate pred;
-			switch (mCompOp) {
-			case CmpOp::Lt: pred = LLVMIntSLT; break;
-			case CmpOp::Gt: pred = LLVMIntSGT; break;
-			case CmpOp::Let: pred = LLVMIntSLE; break;
-			case CmpOp::Get: pred = LLVMIntSGE; break;
-			case CmpOp::Eq: pred = LLVMIntEQ; break;
-			case CmpOp::Neq: pred = LLVMIntNE; break;
-			default: assert(false); return {};
-			}
-			result = LLVMBuildICmp(*builder, pred, io[0], io[1], "");
+		LLVMBuildStore(*builder, buildOperation(*builder, {io[0], io[1]}), io[2]);
 
-		} else {
-			LLVMRealPredicate pred;
-			switch (mCompOp) {
-			case CmpOp::Lt: pred = LLVMRealOLT; break;
-			case CmpOp::Gt: pred = LLVMRealOGT; break;
-			case CmpOp::Let: pred = LLVMRealOLE; break;
-			case CmpOp::Get: pred = LLVMRealOGE; break;
-			case CmpOp::Eq: pred = LLVMRealOEQ; break;
-			case CmpOp::Neq: pred = LLVMRealONE; break;
-			default: assert(false); return {};
-			}
-			result = LLVMBuildFCmp(*builder, pred, io[0], io[1], "");
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return {};
+	}
+
+	LLVMValueRef buildOperation(LLVMBuilderRef                   builder,
+	                            const std::vector<LLVMValueRef>& inputs) const override {
+		if (isIntegral(mType)) {
+			return LLVMBuildICmp(builder, intPredicate(), inputs[0], inputs[1], "");
 		}
+		return LLVMBuildFCmp(builder, realPredicate(), inputs[0], inputs[1], "");
+	}
 
-		LLVMBuildStore(*builder, result, io[2]);
+	bool constantFold(const std::vector<LLVMValueRef>& inputs,
+	                  std::vector<LLVMValueRef>* toFill) const override {
+		assert(inputs.size() == 2);
 
-		LLVMBuildBr(*builder, outputBlocks[0]);
+		if (isIntegral(mType)) {
+			*toFill = {LLVMConstICmp(intPredicate(), inputs[0], inputs[1])};
+		} else {
+			*toFill = {LLVMConstFCmp(realPredicate(), inputs[0], inputs[1])};
+		}
+		return true;
+	}
 
-		return {};
+	LLVMIntPredicate intPredicate() const {
+		switch (mCompOp) {
+		case CmpOp::Lt: return LLVMIntSLT;
+		case CmpOp::Gt: return LLVMIntSGT;
+		case CmpOp::Let: return LLVMIntSLE;
+		case CmpOp::Get: return LLVMIntSGE;
+		case CmpOp::Eq: return LLVMIntEQ;
+		case CmpOp::Neq: return LLVMIntNE;
+		}
+		assert(false);
+		return LLVMIntEQ;
+	}
+
+	LLVMRealPredicate realPredicate() const {
+		switch (mCompOp) {
+		case CmpOp::Lt: return LLVMRealOLT;
+		case CmpOp::Gt: return LLVMRealOGT;
+		case CmpOp::Let: return LLVMRealOLE;
+		case CmpOp::Get: return LLVMRealOGE;
+		case CmpOp::Eq: return LLVMRealOEQ;
+		case CmpOp::Neq: return LLVMRealONE;
+		}
+		assert(false);
+		return LLVMRealOEQ;
 	}
 
 	std::unique_ptr<NodeType> clone() const override {
@@ -532,152 +771,1699 @@ struct CompareNodeType : NodeType {
 	DataType mType;
 };
 
-}  // anonymous namespace
+// split a vector type name like i32x4 into its element type and lane count
+bool parseVectorTypeName(std::string_view name, std::string* element, unsigned* lanes) {
+	auto separator = name.rfind('x');
+	if (separator == std::string_view::npos || separator == 0 || separator + 1 == name.size()) {
+		return false;
+	}
 
-LangModule::LangModule(Context& ctx) : ChiModule(ctx, "lang") {
-	// populate them
-	nodes = {
-	    {"if"s,
-	     [this](const nlohmann::json&, Result&) { return std::make_unique<IfNodeType>(*this); }},
-	    {"i32+i32"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<BinaryOperationNodeType>(
-		         *this, LangModule::typeFromName("i32"), BinOp::Add);
-	     }},
-	    {"i32-i32"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<BinaryOperationNodeType>(
-		         *this, LangModule::typeFromName("i32"), BinOp::Subtract);
-	     }},
-	    {"i32*i32"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<BinaryOperationNodeType>(
-		         *this, LangModule::typeFromName("i32"), BinOp::Multiply);
-	     }},
-	    {"i32/i32"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<BinaryOperationNodeType>(
-		         *this, LangModule::typeFromName("i32"), BinOp::Divide);
-	     }},
-	    {"float+float"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<BinaryOperationNodeType>(
-		         *this, LangModule::typeFromName("float"), BinOp::Add);
-	     }},
-	    {"float-float"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<BinaryOperationNodeType>(
-		         *this, LangModule::typeFromName("float"), BinOp::Subtract);
-	     }},
-	    {"float*float"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<BinaryOperationNodeType>(
-		         *this, LangModule::typeFromName("float"), BinOp::Multiply);
-	     }},
-	    {"float/float"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<BinaryOperationNodeType>(
-		         *this, LangModule::typeFromName("float"), BinOp::Divide);
-	     }},
-	    {"i32<i32"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("i32"),
-		                                              CmpOp::Lt);
-	     }},
-	    {"i32>i32"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("i32"),
-		                                              CmpOp::Gt);
-	     }},
-	    {"i32<=i32"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("i32"),
-		                                              CmpOp::Let);
-	     }},
-	    {"i32>=i32"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("i32"),
-		                                              CmpOp::Get);
-	     }},
-	    {"i32==i32"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("i32"),
-		                                              CmpOp::Eq);
-	     }},
-	    {"i32!=i32"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("i32"),
-		                                              CmpOp::Neq);
-	     }},
-	    {"float<float"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("float"),
-		                                              CmpOp::Lt);
-	     }},
-	    {"float>float"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("float"),
-		                                              CmpOp::Gt);
-	     }},
-	    {"float<=float"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("float"),
-		                                              CmpOp::Let);
-	     }},
-	    {"float>=float"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("float"),
-		                                              CmpOp::Get);
-	     }},
-	    {"float==float"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("float"),
-		                                              CmpOp::Eq);
-	     }},
-	    {"float!=float"s,
-	     [this](const nlohmann::json&, Result&) {
-		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("float"),
-		                                              CmpOp::Neq);
-	     }},
-	    {"inttofloat"s, [this](const nlohmann::json&,
-	                           Result&) { return std::make_unique<IntToFloatNodeType>(*this); }},
-	    {"floattoint"s, [this](const nlohmann::json&,
-	                           Result&) { return std::make_unique<FloatToIntNodeType>(*this); }},
-	    {"entry"s,
-	     [this](const nlohmann::json& injson, Result& res) {
-		     // transform the JSON data into this data structure
-		     std::vector<NamedDataType> dataInputs;
+	auto laneString = name.substr(separator + 1);
+	if (!std::all_of(laneString.begin(), laneString.end(),
+	                 [](char c) { return c >= '0' && c <= '9'; }) ||
+	    laneString.size() > 2) {
+		return false;
+	}
 
-		     if (injson.find("data") != injson.end()) {
-			     auto& data = injson["data"];
+	// vectors are as wide as registers get, in powers of two
+	*lanes = std::stoul(std::string(laneString));
+	if (*lanes < 2 || *lanes > 64 || (*lanes & (*lanes - 1)) != 0) { return false; }
 
-			     if (data.is_array()) {
-				     for (const auto& input : data) {
-					     std::string docString;
-					     std::string qualifiedType;
-					     for (auto iter = input.begin(); iter != input.end(); ++iter) {
-						     docString     = iter.key();
-						     qualifiedType = iter.value();
-					     }
+	*element = std::string(name.substr(0, separator));
+	return true;
+}
 
-					     std::string module = qualifiedType.substr(0, qualifiedType.find(':'));
-					     std::string type   = qualifiedType.substr(qualifiedType.find(':') + 1);
+bool isVector(const DataType& ty) { return LLVMGetTypeKind(ty.llvmType()) == LLVMVectorTypeKind; }
 
-					     DataType cty;
-					     res += context().typeFromModule(module, type, &cty);
+// the type of one lane of a vector type
+DataType elementType(LangModule& mod, const DataType& vectorType) {
+	std::string element;
+	unsigned    lanes;
+	parseVectorTypeName(vectorType.unqualifiedName(), &element, &lanes);
 
-					     if (!res) { continue; }
+	return mod.typeFromName(element);
+}
 
-					     dataInputs.emplace_back(docString, cty);
-				     }
+// read the vector type from the data of a vector node, which is an object with a type element
+DataType vectorTypeFromJSON(LangModule& mod, const nlohmann::json& data, const char* nodeName,
+                            Result& res) {
+	if (!data.is_object() || data.find("type") == data.end() || !data["type"].is_string()) {
+		res.addEntry("EUKN", "Data for a vector node must be an object with a type",
+		             {{"Node Type", nodeName}, {"Given Data", data}});
+		return {};
+	}
 
-			     } else {
-				     res.addEntry("WUKN", "Data for lang:entry must be an array",
-				                  {{"Given Data", data}});
-			     }
+	auto ty = mod.typeFromName(data["type"].get<std::string>());
+	if (!ty.valid() || !isVector(ty)) {
+		res.addEntry("EUKN", "Type for a vector node isn't a vector type",
+		             {{"Node Type", nodeName}, {"Given Type", data["type"]}});
+		return {};
+	}
+	return ty;
+}
 
-		     } else {
-			     res.addEntry("WUKN", "Data for lang:entry must have a data element",
+// read a lane index from the data of a vector node
+unsigned laneFromJSON(const DataType& vectorType, const nlohmann::json& data,
+                      const char* nodeName, Result& res) {
+	if (data.find("lane") == data.end() || !data["lane"].is_number_integer() ||
+	    data["lane"].get<int64_t>() < 0 ||
+	    data["lane"].get<int64_t>() >= LLVMGetVectorSize(vectorType.llvmType())) {
+		res.addEntry("EUKN", "Data for a vector node must have a lane in the vector",
+		             {{"Node Type", nodeName}, {"Given Data", data}});
+		return 0;
+	}
+	return data["lane"];
+}
+
+/// NodeType for filling every lane of a vector with one value
+struct VectorSplatNodeType : NodeType {
+	VectorSplatNodeType(LangModule& mod, DataType ty)
+	    : NodeType(mod, "vector-splat", "Make a vector with every lane set to a value"),
+	      mType{std::move(ty)} {
+		makePure();
+
+		setDataInputs({{"value", elementType(mod, mType)}});
+		setDataOutputs({{"", mType}});
+	}
+
+	Result codegen(NodeCompiler& /*compiler*/, LLVMBasicBlockRef codegenInto,
+	               size_t /*execInputID*/, LLVMMetadataRef       nodeLocation,
+	               const std::vector<LLVMValueRef>&      io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 2 && outputBlocks.size() == 1);
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		// insert it into the first lane and shuffle that into all of them, which is what
+		// instruction selection recognizes as a broadcast
+		auto poison = LLVMGetPoison(mType.llvmType());
+		auto lanes  = LLVMGetVectorSize(mType.llvmType());
+		auto zeroes =
+		    LLVMConstNull(LLVMVectorType(LLVMInt32TypeInContext(context().llvmContext()), lanes));
+
+		auto first = LLVMBuildInsertElement(*builder, poison, io[0], context().constI32(0), "");
+		auto splat = LLVMBuildShuffleVector(*builder, first, poison, zeroes, "");
+		LLVMBuildStore(*builder, splat, io[1]);
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return {};
+	}
+
+	bool constantFold(const std::vector<LLVMValueRef>& inputs,
+	                  std::vector<LLVMValueRef>* toFill) const override {
+		assert(inputs.size() == 1);
+
+		std::vector<LLVMValueRef> lanes(LLVMGetVectorSize(mType.llvmType()), inputs[0]);
+		*toFill = {LLVMConstVector(lanes.data(), lanes.size())};
+		return true;
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<VectorSplatNodeType>(*this);
+	}
+
+	nlohmann::json toJSON() const override { return {{"type", mType.unqualifiedName()}}; }
+
+	DataType mType;
+};
+
+/// NodeType for getting one lane of a vector
+struct VectorExtractNodeType : NodeType {
+	VectorExtractNodeType(LangModule& mod, DataType ty, unsigned lane)
+	    : NodeType(mod, "vector-extract", "Get a lane of a vector"),
+	      mType{std::move(ty)},
+	      mLane{lane} {
+		makePure();
+
+		setDataInputs({{"vector", mType}});
+		setDataOutputs({{"", elementType(mod, mType)}});
+	}
+
+	Result codegen(NodeCompiler& /*compiler*/, LLVMBasicBlockRef codegenInto,
+	               size_t /*execInputID*/, LLVMMetadataRef       nodeLocation,
+	               const std::vector<LLVMValueRef>&      io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 2 && outputBlocks.size() == 1);
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		LLVMBuildStore(*builder,
+		               LLVMBuildExtractElement(*builder, io[0], context().constI32(mLane), ""),
+		               io[1]);
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return {};
+	}
+
+	bool constantFold(const std::vector<LLVMValueRef>& inputs,
+	                  std::vector<LLVMValueRef>* toFill) const override {
+		assert(inputs.size() == 1);
+
+		*toFill = {LLVMConstExtractElement(inputs[0], context().constI32(mLane))};
+		return true;
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<VectorExtractNodeType>(*this);
+	}
+
+	nlohmann::json toJSON() const override {
+		return {{"type", mType.unqualifiedName()}, {"lane", mLane}};
+	}
+
+	DataType mType;
+	unsigned mLane;
+};
+
+/// NodeType for setting one lane of a vector
+struct VectorInsertNodeType : NodeType {
+	VectorInsertNodeType(LangModule& mod, DataType ty, unsigned lane)
+	    : NodeType(mod, "vector-insert", "Set a lane of a vector"),
+	      mType{std::move(ty)},
+	      mLane{lane} {
+		makePure();
+
+		setDataInputs({{"vector", mType}, {"value", elementType(mod, mType)}});
+		setDataOutputs({{"", mType}});
+	}
+
+	Result codegen(NodeCompiler& /*compiler*/, LLVMBasicBlockRef codegenInto,
+	               size_t /*execInputID*/, LLVMMetadataRef       nodeLocation,
+	               const std::vector<LLVMValueRef>&      io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 3 && outputBlocks.size() == 1);
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		LLVMBuildStore(
+		    *builder,
+		    LLVMBuildInsertElement(*builder, io[0], io[1], context().constI32(mLane), ""), io[2]);
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return {};
+	}
+
+	bool constantFold(const std::vector<LLVMValueRef>& inputs,
+	                  std::vector<LLVMValueRef>* toFill) const override {
+		assert(inputs.size() == 2);
+
+		*toFill = {LLVMConstInsertElement(inputs[0], inputs[1], context().constI32(mLane))};
+		return true;
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<VectorInsertNodeType>(*this);
+	}
+
+	nlohmann::json toJSON() const override {
+		return {{"type", mType.unqualifiedName()}, {"lane", mLane}};
+	}
+
+	DataType mType;
+	unsigned mLane;
+};
+
+/// NodeType for picking each lane from one of two vectors
+struct VectorSelectNodeType : NodeType {
+	VectorSelectNodeType(LangModule& mod, DataType ty)
+	    : NodeType(mod, "vector-select",
+	               "Pick each lane from the first vector where the mask is true, and from the "
+	               "second where it's false"),
+	      mType{std::move(ty)} {
+		makePure();
+
+		auto lanes = LLVMGetVectorSize(mType.llvmType());
+		setDataInputs({{"mask", mod.typeFromName("i1x" + std::to_string(lanes))},
+		               {"true", mType},
+		               {"false", mType}});
+		setDataOutputs({{"", mType}});
+	}
+
+	Result codegen(NodeCompiler& /*compiler*/, LLVMBasicBlockRef codegenInto,
+	               size_t /*execInputID*/, LLVMMetadataRef       nodeLocation,
+	               const std::vector<LLVMValueRef>&      io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 4 && outputBlocks.size() == 1);
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		LLVMBuildStore(*builder, LLVMBuildSelect(*builder, io[0], io[1], io[2], ""), io[3]);
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return {};
+	}
+
+	bool constantFold(const std::vector<LLVMValueRef>& inputs,
+	                  std::vector<LLVMValueRef>* toFill) const override {
+		assert(inputs.size() == 3);
+
+		*toFill = {LLVMConstSelect(inputs[0], inputs[1], inputs[2])};
+		return true;
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<VectorSelectNodeType>(*this);
+	}
+
+	nlohmann::json toJSON() const override { return {{"type", mType.unqualifiedName()}}; }
+
+	DataType mType;
+};
+
+/// NodeType for rearranging the lanes of two vectors. Lane i of the result is lane mask[i] of
+/// the two vectors one after the other.
+struct VectorShuffleNodeType : NodeType {
+	VectorShuffleNodeType(LangModule& mod, DataType ty, DataType resultType,
+	                      std::vector<unsigned> mask)
+	    : NodeType(mod, "vector-shuffle", "Rearrange the lanes of two vectors"),
+	      mType{std::move(ty)},
+	      mMask{std::move(mask)} {
+		makePure();
+
+		setDataInputs({{"a", mType}, {"b", mType}});
+		setDataOutputs({{"", std::move(resultType)}});
+	}
+
+	Result codegen(NodeCompiler& /*compiler*/, LLVMBasicBlockRef codegenInto,
+	               size_t /*execInputID*/, LLVMMetadataRef       nodeLocation,
+	               const std::vector<LLVMValueRef>&      io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 3 && outputBlocks.size() == 1);
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		LLVMBuildStore(*builder, LLVMBuildShuffleVector(*builder, io[0], io[1], maskValue(), ""),
+		               io[2]);
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return {};
+	}
+
+	bool constantFold(const std::vector<LLVMValueRef>& inputs,
+	                  std::vector<LLVMValueRef>* toFill) const override {
+		assert(inputs.size() == 2);
+
+		*toFill = {LLVMConstShuffleVector(inputs[0], inputs[1], maskValue())};
+		return true;
+	}
+
+	LLVMValueRef maskValue() const {
+		std::vector<LLVMValueRef> lanes;
+		for (auto lane : mMask) { lanes.push_back(context().constI32(lane)); }
+		return LLVMConstVector(lanes.data(), lanes.size());
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<VectorShuffleNodeType>(*this);
+	}
+
+	nlohmann::json toJSON() const override {
+		return {{"type", mType.unqualifiedName()}, {"mask", mMask}};
+	}
+
+	DataType              mType;
+	std::vector<unsigned> mMask;
+};
+
+enum class ReduceOp { Add, Multiply, Min, Max, And, Or };
+
+/// NodeType for combining the lanes of a vector into one value
+struct VectorReduceNodeType : NodeType {
+	VectorReduceNodeType(LangModule& mod, DataType ty, ReduceOp op, std::string opName)
+	    : NodeType(mod, "vector-reduce", "Combine all the lanes of a vector with " + opName),
+	      mType{std::move(ty)},
+	      mOp{op},
+	      mOpName{std::move(opName)} {
+		makePure();
+
+		setDataInputs({{"vector", mType}});
+		setDataOutputs({{"", elementType(mod, mType)}});
+	}
+
+	Result codegen(NodeCompiler& compiler, LLVMBasicBlockRef codegenInto,
+	               size_t /*execInputID*/, LLVMMetadataRef nodeLocation,
+	               const std::vector<LLVMValueRef>&      io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 2 && outputBlocks.size() == 1);
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		LLVMValueRef result = nullptr;
+		if (!isIntegral(mType) && (mOp == ReduceOp::Add || mOp == ReduceOp::Multiply)) {
+			// the intrinsics add floats up in order unless they can be reassociated, which can't
+			// be set from the C API, so it's done in halves instead
+			result = io[0];
+			for (auto lanes = LLVMGetVectorSize(mType.llvmType()); lanes > 1; lanes /= 2) {
+				auto half = [&](unsigned first) {
+					std::vector<LLVMValueRef> mask;
+					for (auto lane = 0u; lane < lanes / 2; ++lane) {
+						mask.push_back(context().constI32(first + lane));
+					}
+					return LLVMBuildShuffleVector(*builder, result,
+					                              LLVMGetPoison(LLVMTypeOf(result)),
+					                              LLVMConstVector(mask.data(), mask.size()), "");
+				};
+
+				auto low  = half(0);
+				auto high = half(lanes / 2);
+				result = mOp == ReduceOp::Add ? LLVMBuildFAdd(*builder, low, high, "")
+				                              : LLVMBuildFMul(*builder, low, high, "");
+			}
+			result = LLVMBuildExtractElement(*builder, result, context().constI32(0), "");
+		} else {
+			auto intrinsicName = "llvm.vector.reduce."s + intrinsicSuffix();
+			auto intrinsicID   = LLVMLookupIntrinsicID(intrinsicName.c_str(), intrinsicName.size());
+			auto vectorType    = mType.llvmType();
+			auto vector        = io[0];
+
+			auto intrinsic =
+			    LLVMGetIntrinsicDeclaration(compiler.llvmModule(), intrinsicID, &vectorType, 1);
+			auto intrinsicType =
+			    LLVMIntrinsicGetType(context().llvmContext(), intrinsicID, &vectorType, 1);
+			result = LLVMBuildCall2(*builder, intrinsicType, intrinsic, &vector, 1, "");
+		}
+		LLVMBuildStore(*builder, result, io[1]);
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return {};
+	}
+
+	const char* intrinsicSuffix() const {
+		bool integral = isIntegral(mType);
+		switch (mOp) {
+		case ReduceOp::Add: return "add";
+		case ReduceOp::Multiply: return "mul";
+		case ReduceOp::Min: return integral ? "smin" : "fmin";
+		case ReduceOp::Max: return integral ? "smax" : "fmax";
+		case ReduceOp::And: return "and";
+		case ReduceOp::Or: return "or";
+		}
+		assert(false);
+		return "";
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<VectorReduceNodeType>(*this);
+	}
+
+	nlohmann::json toJSON() const override {
+		return {{"type", mType.unqualifiedName()}, {"op", mOpName}};
+	}
+
+	DataType    mType;
+	ReduceOp    mOp;
+	std::string mOpName;
+};
+
+// the operators in node names, like the + in i32+i32. The longer comparisons are first, so names
+// are matched against them before < and >.
+const std::pair<const char*, BinOp> binOps[] = {{"+", BinOp::Add},
+                                                {"-", BinOp::Subtract},
+                                                {"*", BinOp::Multiply},
+                                                {"/", BinOp::Divide}};
+const std::pair<const char*, CmpOp> cmpOps[] = {{"<=", CmpOp::Let}, {">=", CmpOp::Get},
+                                                {"==", CmpOp::Eq},  {"!=", CmpOp::Neq},
+                                                {"<", CmpOp::Lt},   {">", CmpOp::Gt}};
+
+// make the node for an element-wise operation on vectors, which are named like the scalar ones,
+// like i32x4+i32x4
+std::unique_ptr<NodeType> vectorOperationFromName(LangModule& mod, std::string_view name) {
+
+	// get the type if the name is that type on both sides of op
+	auto operandType = [&](std::string_view op) -> DataType {
+		if (name.size() <= op.size() || (name.size() - op.size()) % 2 != 0) { return {}; }
+
+		auto typeLength = (name.size() - op.size()) / 2;
+		auto typeName   = name.substr(0, typeLength);
+		if (name.substr(typeLength, op.size()) != op ||
+		    name.substr(typeLength + op.size()) != typeName) {
+			return {};
+		}
+
+		auto ty = mod.typeFromName(typeName);
+		if (!ty.valid() || !isVector(ty)) { return {}; }
+		return ty;
+	};
+
+	// masks only have to be compared for equality
+	for (const auto& op : binOps) {
+		auto ty = operandType(op.first);
+		if (ty.valid() && elementType(mod, ty).unqualifiedName() != "i1") {
+			return std::make_unique<BinaryOperationNodeType>(mod, ty, op.second);
+		}
+	}
+	for (const auto& op : cmpOps) {
+		auto ty = operandType(op.first);
+		if (ty.valid() && (elementType(mod, ty).unqualifiedName() != "i1" ||
+		                   op.second == CmpOp::Eq || op.second == CmpOp::Neq)) {
+			return std::make_unique<CompareNodeType>(mod, ty, op.second);
+		}
+	}
+
+	return nullptr;
+}
+
+// if a type is a buffer, like i32[]
+bool isBuffer(const DataType& ty) {
+	const auto& name = ty.unqualifiedName();
+	return name.size() > 2 && name.compare(name.size() - 2, 2, "[]") == 0;
+}
+
+// the type of the elements of a buffer type
+DataType bufferElementType(LangModule& mod, const DataType& bufferType) {
+	const auto& name = bufferType.unqualifiedName();
+	return mod.typeFromName(std::string_view(name).substr(0, name.size() - 2));
+}
+
+// read the buffer type from the data of a buffer node, which is an object with a type element
+DataType bufferTypeFromJSON(LangModule& mod, const nlohmann::json& data, const char* nodeName,
+                            Result& res) {
+	if (!data.is_object() || data.find("type") == data.end() || !data["type"].is_string()) {
+		res.addEntry("EUKN", "Data for a buffer node must be an object with a type",
+		             {{"Node Type", nodeName}, {"Given Data", data}});
+		return {};
+	}
+
+	auto ty = mod.typeFromName(data["type"].get<std::string>());
+	if (!ty.valid() || !isBuffer(ty)) {
+		res.addEntry("EUKN", "Type for a buffer node isn't a buffer type",
+		             {{"Node Type", nodeName}, {"Given Type", data["type"]}});
+		return {};
+	}
+	return ty;
+}
+
+// hints for how LLVM should optimize a loop, which go in its !llvm.loop metadata. The ones that
+// aren't set are left to LLVM.
+struct LoopHints {
+	std::optional<bool> vectorize;
+	unsigned            width      = 0;
+	unsigned            interleave = 0;
+	unsigned            unroll     = 0;
+};
+
+// read the hints in the data of a loop node, like {"vectorize": true, "unroll": 4}. Ones that
+// aren't the right type are warned about and left out.
+LoopHints loopHintsFromJSON(const nlohmann::json& data, const char* nodeName, Result& res) {
+	LoopHints hints;
+	if (!data.is_object()) { return hints; }
+
+	auto iter = data.find("vectorize");
+	if (iter != data.end()) {
+		if (iter->is_boolean()) {
+			hints.vectorize = iter->get<bool>();
+		} else {
+			res.addEntry("WUKN", "Loop hint must be a boolean",
+			             {{"Node Type", nodeName}, {"Hint", "vectorize"}, {"Given Data", *iter}});
+		}
+	}
+
+	for (auto count : {std::make_pair("width", &hints.width),
+	                   std::make_pair("interleave", &hints.interleave),
+	                   std::make_pair("unroll", &hints.unroll)}) {
+		iter = data.find(count.first);
+		if (iter == data.end()) { continue; }
+
+		if (iter->is_number_integer() && iter->get<int64_t>() > 0 &&
+		    iter->get<int64_t>() <= UINT32_MAX) {
+			*count.second = iter->get<unsigned>();
+		} else {
+			res.addEntry("WUKN", "Loop hint must be a positive integer",
+			             {{"Node Type", nodeName}, {"Hint", count.first}, {"Given Data", *iter}});
+		}
+	}
+
+	return hints;
+}
+
+// add the hints that are set to the data of a loop node
+void loopHintsToJSON(const LoopHints& hints, nlohmann::json* data) {
+	if (hints.vectorize) { (*data)["vectorize"] = *hints.vectorize; }
+	if (hints.width != 0) { (*data)["width"] = hints.width; }
+	if (hints.interleave != 0) { (*data)["interleave"] = hints.interleave; }
+	if (hints.unroll != 0) { (*data)["unroll"] = hints.unroll; }
+}
+
+// give the branch at the end of a loop, back to its start, its !llvm.loop metadata
+void setLoopHints(LLVMValueRef branch, const LoopHints& hints) {
+	auto ctx = LLVMGetTypeContext(LLVMTypeOf(branch));
+
+	// !llvm.loop is a distinct node that refers to itself, followed by the hints
+	auto                         temporary = LLVMTemporaryMDNode(ctx, nullptr, 0);
+	std::vector<LLVMMetadataRef> operands  = {temporary};
+
+	auto addHint = [&](const std::string& name, LLVMValueRef value) {
+		LLVMMetadataRef hint[] = {LLVMMDStringInContext2(ctx, name.c_str(), name.size()),
+		                          LLVMValueAsMetadata(value)};
+		operands.push_back(LLVMMDNodeInContext2(ctx, hint, 2));
+	};
+	auto i1  = LLVMInt1TypeInContext(ctx);
+	auto i32 = LLVMInt32TypeInContext(ctx);
+	if (hints.vectorize) {
+		addHint("llvm.loop.vectorize.enable", LLVMConstInt(i1, *hints.vectorize, false));
+	}
+	if (hints.width != 0) {
+		addHint("llvm.loop.vectorize.width", LLVMConstInt(i32, hints.width, false));
+	}
+	if (hints.interleave != 0) {
+		addHint("llvm.loop.interleave.count", LLVMConstInt(i32, hints.interleave, false));
+	}
+	if (hints.unroll != 0) {
+		addHint("llvm.loop.unroll.count", LLVMConstInt(i32, hints.unroll, false));
+	}
+
+	auto loopID = LLVMMDNodeInContext2(ctx, operands.data(), operands.size());
+	LLVMMetadataReplaceAllUsesWith(temporary, loopID);
+	LLVMSetMetadata(branch, LLVMGetMDKindIDInContext(ctx, "llvm.loop", 9),
+	                LLVMMetadataAsValue(ctx, loopID));
+}
+
+// builds the body of a loop, taking the index and the values carried from the last iteration and
+// returning the ones for the next
+using LoopBody = std::function<std::vector<LLVMValueRef>(
+    LLVMValueRef index, const std::vector<LLVMValueRef>& carried)>;
+
+// Build a loop that runs body for each index from 0 to length, which is an i32 or an i64, and
+// leave the builder after it. The values in carried are passed from each iteration to the next,
+// starting with initial, and the last ones are returned. It's marked to be vectorized, which also
+// lets the vectorizer reorder floating point reductions.
+std::vector<LLVMValueRef> buildLoop(LLVMBuilderRef builder, LLVMValueRef length,
+                                    const std::vector<LLVMValueRef>& initial,
+                                    const LoopBody&                  body) {
+	auto before = LLVMGetInsertBlock(builder);
+	auto func   = LLVMGetBasicBlockParent(before);
+	auto ctx    = LLVMGetTypeContext(LLVMTypeOf(length));
+	auto i64    = LLVMInt64TypeInContext(ctx);
+
+	auto loop  = LLVMAppendBasicBlockInContext(ctx, func, "loop");
+	auto after = LLVMAppendBasicBlockInContext(ctx, func, "loop_end");
+
+	// 64 bit indices don't have to be extended for each address
+	auto count = LLVMBuildSExtOrBitCast(builder, length, i64, "count");
+	auto any   = LLVMBuildICmp(builder, LLVMIntSGT, count, LLVMConstInt(i64, 0, false), "");
+	LLVMBuildCondBr(builder, any, loop, after);
+
+	LLVMPositionBuilderAtEnd(builder, loop);
+	auto index = LLVMBuildPhi(builder, i64, "index");
+
+	std::vector<LLVMValueRef> carried;
+	for (auto value : initial) {
+		auto phi = LLVMBuildPhi(builder, LLVMTypeOf(value), "");
+		LLVMAddIncoming(phi, &value, &before, 1);
+		carried.push_back(phi);
+	}
+
+	auto next = body(index, carried);
+	assert(next.size() == initial.size());
+
+	auto latch     = LLVMGetInsertBlock(builder);
+	auto nextIndex = LLVMBuildNUWAdd(builder, index, LLVMConstInt(i64, 1, false), "");
+	auto more      = LLVMBuildICmp(builder, LLVMIntSLT, nextIndex, count, "");
+	auto branch    = LLVMBuildCondBr(builder, more, loop, after);
+
+	auto zero = LLVMConstInt(i64, 0, false);
+	LLVMAddIncoming(index, &zero, &before, 1);
+	LLVMAddIncoming(index, &nextIndex, &latch, 1);
+	for (auto idx = 0ull; idx < carried.size(); ++idx) {
+		LLVMAddIncoming(carried[idx], &next[idx], &latch, 1);
+	}
+
+	LoopHints hints;
+	hints.vectorize = true;
+	setLoopHints(branch, hints);
+
+	LLVMPositionBuilderAtEnd(builder, after);
+
+	std::vector<LLVMValueRef> ret;
+	for (auto idx = 0ull; idx < initial.size(); ++idx) {
+		auto phi = LLVMBuildPhi(builder, LLVMTypeOf(initial[idx]), "");
+		LLVMAddIncoming(phi, const_cast<LLVMValueRef*>(&initial[idx]), &before, 1);
+		LLVMAddIncoming(phi, &next[idx], &latch, 1);
+		ret.push_back(phi);
+	}
+	return ret;
+}
+
+// the address of an element of a buffer
+LLVMValueRef buildElementAddress(LLVMBuilderRef builder, LLVMValueRef buffer, LLVMValueRef index) {
+	auto data        = LLVMBuildExtractValue(builder, buffer, 0, "");
+	auto elementType = LLVMGetElementType(LLVMTypeOf(data));
+	return LLVMBuildInBoundsGEP2(builder, elementType, data, &index, 1, "");
+}
+
+// the smallest length of some buffers
+LLVMValueRef buildMinLength(LLVMBuilderRef builder, const std::vector<LLVMValueRef>& buffers) {
+	LLVMValueRef ret = nullptr;
+	for (auto buffer : buffers) {
+		auto length = LLVMBuildExtractValue(builder, buffer, 1, "");
+		ret         = ret == nullptr ? length
+		                     : LLVMBuildSelect(builder,
+		                                       LLVMBuildICmp(builder, LLVMIntSLT, length, ret, ""),
+		                                       length, ret, "");
+	}
+	return ret;
+}
+
+// allocate memory at the start of the function builder is in, so it only happens once
+LLVMValueRef buildEntryAlloca(LLVMBuilderRef builder, LLVMTypeRef ty, const char* name) {
+	auto func = LLVMGetBasicBlockParent(LLVMGetInsertBlock(builder));
+
+	auto entryBuilder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(LLVMGetTypeContext(ty)));
+	auto entry        = LLVMGetEntryBasicBlock(func);
+	if (auto first = LLVMGetFirstInstruction(entry)) {
+		LLVMPositionBuilderBefore(*entryBuilder, first);
+	} else {
+		LLVMPositionBuilderAtEnd(*entryBuilder, entry);
+	}
+	return LLVMBuildAlloca(*entryBuilder, ty, name);
+}
+
+// Build a call to the clone of a graph function for its first exec input, which is declared if
+// it's from a dependency, and mark it to be inlined. args are its data inputs and pointers to its
+// data outputs.
+LLVMValueRef buildInlinedCall(Context& ctx, LLVMBuilderRef builder, const std::string& moduleName,
+                              const std::string& functionName, const GraphFunction& graphFunc,
+                              std::vector<LLVMValueRef> args) {
+	auto llMod      = LLVMGetGlobalParent(LLVMGetBasicBlockParent(LLVMGetInsertBlock(builder)));
+	auto calleeName = mangleSpecializedFunctionName(moduleName, functionName, 0);
+	auto callee     = LLVMGetNamedFunction(llMod, calleeName.c_str());
+	if (callee == nullptr) {
+		callee = LLVMAddFunction(llMod, calleeName.c_str(), graphFunc.specializedFunctionType());
+	}
+
+	auto call = LLVMBuildCall2(builder, graphFunc.specializedFunctionType(), callee, args.data(),
+	                           args.size(), "");
+
+	const char inlineName[] = "alwaysinline";
+	LLVMAddCallSiteAttribute(
+	    call, LLVMAttributeFunctionIndex,
+	    LLVMCreateEnumAttribute(ctx.llvmContext(),
+	                            LLVMGetEnumAttributeKindForName(inlineName, sizeof(inlineName) - 1),
+	                            0));
+	return call;
+}
+
+// if a module is mod or one of the modules mod depends on, directly or through its dependencies.
+// Functions from other modules can't be referenced by nodes in mod, since their interfaces aren't
+// part of its cache keys.
+bool inDependencies(Context& ctx, const ChiModule& mod, const std::string& moduleName) {
+	std::vector<std::string>        toVisit = {mod.fullName()};
+	std::unordered_set<std::string> visited;
+	while (!toVisit.empty()) {
+		auto name = std::move(toVisit.back());
+		toVisit.pop_back();
+
+		if (name == moduleName) { return true; }
+		if (!visited.insert(name).second) { continue; }
+
+		if (auto visiting = ctx.moduleByFullName(name)) {
+			for (const auto& dep : visiting->dependencies()) {
+				toVisit.push_back(dep.generic_string());
+			}
+		}
+	}
+
+	return false;
+}
+
+// what the bulk buffer nodes run on each element: a lang operation, like lang:i32+i32, or a graph
+// function, which gets inlined into the loop
+struct BufferKernel {
+	std::string                     qualifiedName;
+	std::shared_ptr<const NodeType> langOperation;
+	std::string                     moduleName;
+	std::string                     functionName;
+
+	std::vector<DataType> inputs;
+	DataType              output;
+
+	// the graph function it runs, or nullptr if it's a lang operation or it's been removed
+	GraphFunction* graphFunction(Context& ctx) const {
+		auto graphMod = dynamic_cast<GraphModule*>(ctx.moduleByFullName(moduleName));
+		return graphMod == nullptr ? nullptr : graphMod->functionFromName(functionName);
+	}
+
+	// check that the graph function it runs is still there, and that it can be used from callerMod
+	Result validate(Context& ctx, const ChiModule& callerMod, const char* nodeName) const {
+		Result res;
+		if (langOperation != nullptr) { return res; }
+
+		if (graphFunction(ctx) == nullptr) {
+			res.addEntry("EUKN", "Kernel for a buffer node isn't loaded anymore",
+			             {{"Node Type", nodeName}, {"Kernel", qualifiedName}});
+		} else if (!inDependencies(ctx, callerMod, moduleName)) {
+			res.addEntry("EUKN",
+			             "Kernel for a buffer node must be in the module it's used in or one of "
+			             "its dependencies",
+			             {{"Node Type", nodeName},
+			              {"Kernel", qualifiedName},
+			              {"Module", callerMod.fullName()}});
+		}
+		return res;
+	}
+
+	// the graph function it runs, for NodeType::referencedFunctions
+	std::vector<const GraphFunction*> referencedFunctions(Context& ctx) const {
+		auto graphFunc = langOperation == nullptr ? graphFunction(ctx) : nullptr;
+		if (graphFunc == nullptr) { return {}; }
+
+		return {graphFunc};
+	}
+
+	// build running the kernel on values of its input types, getting its output
+	LLVMValueRef build(Context& ctx, LLVMBuilderRef builder,
+	                   const std::vector<LLVMValueRef>& args) const {
+		if (langOperation != nullptr) {
+			return dynamic_cast<const LaneOperation&>(*langOperation).buildOperation(builder, args);
+		}
+
+		// the output is returned through memory, which becomes a register again once it's inlined
+		auto outputSlot = buildEntryAlloca(builder, output.llvmType(), "kernel_output");
+
+		auto callArgs = args;
+		callArgs.push_back(outputSlot);
+		buildInlinedCall(ctx, builder, moduleName, functionName, *graphFunction(ctx), callArgs);
+
+		return LLVMBuildLoad2(builder, output.llvmType(), outputSlot, "");
+	}
+};
+
+// find the kernel named in the data of a bulk buffer node, which has to take inputCount elements
+bool kernelFromJSON(LangModule& mod, const nlohmann::json& data, const char* nodeName,
+                    size_t inputCount, Result& res, BufferKernel* toFill) {
+	if (!data.is_object() || data.find("kernel") == data.end() || !data["kernel"].is_string()) {
+		res.addEntry("EUKN", "Data for a buffer node must be an object with a kernel",
+		             {{"Node Type", nodeName}, {"Given Data", data}});
+		return false;
+	}
+
+	toFill->qualifiedName = data["kernel"];
+	auto colon            = toFill->qualifiedName.find(':');
+	auto moduleName       = toFill->qualifiedName.substr(0, colon);
+	auto name = colon == std::string::npos ? "" : toFill->qualifiedName.substr(colon + 1);
+
+	if (moduleName == "lang") {
+		std::unique_ptr<NodeType> op;
+		Result                    opRes = mod.nodeTypeFromName(name, {}, &op);
+		if (opRes && dynamic_cast<LaneOperation*>(op.get()) != nullptr) {
+			for (const auto& input : op->dataInputs()) { toFill->inputs.push_back(input.type); }
+			toFill->output        = op->dataOutputs()[0].type;
+			toFill->langOperation = std::move(op);
+		}
+	} else if (auto graphMod = dynamic_cast<GraphModule*>(
+	               mod.context().moduleByFullName(moduleName))) {
+		auto func = graphMod->functionFromName(name);
+		if (func != nullptr && !func->execInputs().empty() && func->dataOutputs().size() == 1) {
+			for (const auto& input : func->dataInputs()) { toFill->inputs.push_back(input.type); }
+			toFill->output       = func->dataOutputs()[0].type;
+			toFill->moduleName   = moduleName;
+			toFill->functionName = name;
+		}
+	}
+
+	if (!toFill->output.valid()) {
+		res.addEntry("EUKN",
+		             "Kernel for a buffer node must be a lang operation or a graph function with "
+		             "one output in a loaded module",
+		             {{"Node Type", nodeName}, {"Kernel", toFill->qualifiedName}});
+		return false;
+	}
+
+	// the elements have to go in buffers
+	bool langTypes = &toFill->output.module() == &mod;
+	for (const auto& input : toFill->inputs) { langTypes = langTypes && &input.module() == &mod; }
+	if (toFill->inputs.size() != inputCount || !langTypes) {
+		res.addEntry("EUKN", "Kernel for a buffer node takes the wrong number or types of inputs",
+		             {{"Node Type", nodeName},
+		              {"Kernel", toFill->qualifiedName},
+		              {"Expected Inputs", inputCount}});
+		return false;
+	}
+
+	return true;
+}
+
+// the buffer type for an element type of the lang module
+DataType bufferOf(LangModule& mod, const DataType& element) {
+	return mod.typeFromName(element.unqualifiedName() + "[]");
+}
+
+/// NodeType for allocating a buffer. Its elements aren't set.
+struct BufferAllocNodeType : NodeType {
+	BufferAllocNodeType(LangModule& mod, DataType ty)
+	    : NodeType(mod, "buffer-alloc", "Allocate a buffer, which has to be freed"),
+	      mType{std::move(ty)} {
+		setExecInputs({""});
+		setExecOutputs({""});
+
+		setDataInputs({{"length", mod.typeFromName("i32")}});
+		setDataOutputs({{"", mType}});
+	}
+
+	Result codegen(NodeCompiler& /*compiler*/, LLVMBasicBlockRef codegenInto,
+	               size_t /*execInputID*/, LLVMMetadataRef       nodeLocation,
+	               const std::vector<LLVMValueRef>&      io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 2 && outputBlocks.size() == 1);
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		auto elementType = LLVMStructGetTypeAtIndex(mType.llvmType(), 0);
+		auto data = LLVMBuildArrayMalloc(*builder, LLVMGetElementType(elementType), io[0], "");
+
+		auto buffer = LLVMBuildInsertValue(*builder, LLVMGetUndef(mType.llvmType()), data, 0, "");
+		buffer      = LLVMBuildInsertValue(*builder, buffer, io[0], 1, "");
+		LLVMBuildStore(*builder, buffer, io[1]);
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return {};
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<BufferAllocNodeType>(*this);
+	}
+
+	nlohmann::json toJSON() const override { return {{"type", mType.unqualifiedName()}}; }
+
+	DataType mType;
+};
+
+/// NodeType for freeing a buffer from lang:buffer-alloc
+struct BufferFreeNodeType : NodeType {
+	BufferFreeNodeType(LangModule& mod, DataType ty)
+	    : NodeType(mod, "buffer-free", "Free a buffer"), mType{std::move(ty)} {
+		setExecInputs({""});
+		setExecOutputs({""});
+
+		setDataInputs({{"buffer", mType}});
+	}
+
+	Result codegen(NodeCompiler& /*compiler*/, LLVMBasicBlockRef codegenInto,
+	               size_t /*execInputID*/, LLVMMetadataRef       nodeLocation,
+	               const std::vector<LLVMValueRef>&      io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 1 && outputBlocks.size() == 1);
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		LLVMBuildFree(*builder, LLVMBuildExtractValue(*builder, io[0], 0, ""));
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return {};
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<BufferFreeNodeType>(*this);
+	}
+
+	nlohmann::json toJSON() const override { return {{"type", mType.unqualifiedName()}}; }
+
+	DataType mType;
+};
+
+/// NodeType for getting the number of elements in a buffer
+struct BufferLengthNodeType : NodeType {
+	BufferLengthNodeType(LangModule& mod, DataType ty)
+	    : NodeType(mod, "buffer-length", "Get the number of elements in a buffer"),
+	      mType{std::move(ty)} {
+		makePure();
+
+		setDataInputs({{"buffer", mType}});
+		setDataOutputs({{"", mod.typeFromName("i32")}});
+	}
+
+	Result codegen(NodeCompiler& /*compiler*/, LLVMBasicBlockRef codegenInto,
+	               size_t /*execInputID*/, LLVMMetadataRef       nodeLocation,
+	               const std::vector<LLVMValueRef>&      io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 2 && outputBlocks.size() == 1);
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		LLVMBuildStore(*builder, LLVMBuildExtractValue(*builder, io[0], 1, ""), io[1]);
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return {};
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<BufferLengthNodeType>(*this);
+	}
+
+	nlohmann::json toJSON() const override { return {{"type", mType.unqualifiedName()}}; }
+
+	DataType mType;
+};
+
+/// NodeType for getting an element of a buffer
+struct BufferGetNodeType : NodeType {
+	BufferGetNodeType(LangModule& mod, DataType ty)
+	    : NodeType(mod, "buffer-get", "Get an element of a buffer"), mType{std::move(ty)} {
+		makePure();
+		makeReadsMemory();
+
+		setDataInputs({{"buffer", mType}, {"index", mod.typeFromName("i32")}});
+		setDataOutputs({{"", bufferElementType(mod, mType)}});
+	}
+
+	Result codegen(NodeCompiler& /*compiler*/, LLVMBasicBlockRef codegenInto,
+	               size_t /*execInputID*/, LLVMMetadataRef       nodeLocation,
+	               const std::vector<LLVMValueRef>&      io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 3 && outputBlocks.size() == 1);
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		auto address = buildElementAddress(*builder, io[0], io[1]);
+		LLVMBuildStore(*builder,
+		               LLVMBuildLoad2(*builder, dataOutputs()[0].type.llvmType(), address, ""),
+		               io[2]);
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return {};
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<BufferGetNodeType>(*this);
+	}
+
+	nlohmann::json toJSON() const override { return {{"type", mType.unqualifiedName()}}; }
+
+	DataType mType;
+};
+
+/// NodeType for setting an element of a buffer
+struct BufferSetNodeType : NodeType {
+	BufferSetNodeType(LangModule& mod, DataType ty)
+	    : NodeType(mod, "buffer-set", "Set an element of a buffer"), mType{std::move(ty)} {
+		setExecInputs({""});
+		setExecOutputs({""});
+
+		setDataInputs({{"buffer", mType},
+		               {"index", mod.typeFromName("i32")},
+		               {"value", bufferElementType(mod, mType)}});
+	}
+
+	Result codegen(NodeCompiler& /*compiler*/, LLVMBasicBlockRef codegenInto,
+	               size_t /*execInputID*/, LLVMMetadataRef       nodeLocation,
+	               const std::vector<LLVMValueRef>&      io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 3 && outputBlocks.size() == 1);
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		LLVMBuildStore(*builder, io[2], buildElementAddress(*builder, io[0], io[1]));
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return {};
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<BufferSetNodeType>(*this);
+	}
+
+	nlohmann::json toJSON() const override { return {{"type", mType.unqualifiedName()}}; }
+
+	DataType mType;
+};
+
+/// NodeType for setting every element of a buffer to a value
+struct BufferFillNodeType : NodeType {
+	BufferFillNodeType(LangModule& mod, DataType ty)
+	    : NodeType(mod, "buffer-fill", "Set every element of a buffer to a value"),
+	      mType{std::move(ty)} {
+		setExecInputs({""});
+		setExecOutputs({""});
+
+		setDataInputs({{"buffer", mType}, {"value", bufferElementType(mod, mType)}});
+	}
+
+	Result codegen(NodeCompiler& /*compiler*/, LLVMBasicBlockRef codegenInto,
+	               size_t /*execInputID*/, LLVMMetadataRef       nodeLocation,
+	               const std::vector<LLVMValueRef>&      io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 2 && outputBlocks.size() == 1);
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		buildLoop(*builder, buildMinLength(*builder, {io[0]}), {},
+		          [&](LLVMValueRef index, const std::vector<LLVMValueRef>&) {
+			          LLVMBuildStore(*builder, io[1], buildElementAddress(*builder, io[0], index));
+			          return std::vector<LLVMValueRef>{};
+		          });
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return {};
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<BufferFillNodeType>(*this);
+	}
+
+	nlohmann::json toJSON() const override { return {{"type", mType.unqualifiedName()}}; }
+
+	DataType mType;
+};
+
+/// NodeType for running a kernel on the elements at each index of some buffers, and putting the
+/// results in another. It's lang:buffer-map with one input buffer, and lang:buffer-zip with two.
+/// It stops at the end of the shortest buffer.
+struct BufferMapNodeType : NodeType {
+	BufferMapNodeType(LangModule& mod, BufferKernel kernel)
+	    : NodeType(mod), mKernel{std::move(kernel)} {
+		setExecInputs({""});
+		setExecOutputs({""});
+
+		if (mKernel.inputs.size() == 1) {
+			setName("buffer-map");
+			setDescription("Run " + mKernel.qualifiedName +
+			               " on each element of a buffer, into another buffer");
+			setDataInputs({{"source", bufferOf(mod, mKernel.inputs[0])},
+			               {"destination", bufferOf(mod, mKernel.output)}});
+		} else {
+			setName("buffer-zip");
+			setDescription("Run " + mKernel.qualifiedName +
+			               " on the elements of two buffers at each index, into another buffer");
+			setDataInputs({{"a", bufferOf(mod, mKernel.inputs[0])},
+			               {"b", bufferOf(mod, mKernel.inputs[1])},
+			               {"destination", bufferOf(mod, mKernel.output)}});
+		}
+	}
+
+	Result codegen(NodeCompiler& compiler, LLVMBasicBlockRef codegenInto, size_t /*execInputID*/,
+	               LLVMMetadataRef nodeLocation, const std::vector<LLVMValueRef>& io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == mKernel.inputs.size() + 1 && outputBlocks.size() == 1);
+
+		Result res =
+		    mKernel.validate(context(), compiler.funcCompiler().module(), "lang:buffer-map");
+		if (!res) { return res; }
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		buildLoop(*builder, buildMinLength(*builder, io), {},
+		          [&](LLVMValueRef index, const std::vector<LLVMValueRef>&) {
+			          std::vector<LLVMValueRef> elements;
+			          for (auto idx = 0ull; idx < mKernel.inputs.size(); ++idx) {
+				          elements.push_back(
+				              LLVMBuildLoad2(*builder, mKernel.inputs[idx].llvmType(),
+				                             buildElementAddress(*builder, io[idx], index), ""));
+			          }
+
+			          LLVMBuildStore(*builder, mKernel.build(context(), *builder, elements),
+			                         buildElementAddress(*builder, io.back(), index));
+			          return std::vector<LLVMValueRef>{};
+		          });
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return res;
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<BufferMapNodeType>(*this);
+	}
+
+	std::vector<const GraphFunction*> referencedFunctions() const override {
+		return mKernel.referencedFunctions(context());
+	}
+
+	nlohmann::json toJSON() const override { return {{"kernel", mKernel.qualifiedName}}; }
+
+	BufferKernel mKernel;
+};
+
+/// NodeType for combining the elements of a buffer with a kernel, which takes what it's combined
+/// so far and an element
+struct BufferReduceNodeType : NodeType {
+	BufferReduceNodeType(LangModule& mod, BufferKernel kernel)
+	    : NodeType(mod, "buffer-reduce", ""), mKernel{std::move(kernel)} {
+		makePure();
+		makeReadsMemory();
+
+		setDescription("Combine the elements of a buffer with " + mKernel.qualifiedName);
+
+		setDataInputs({{"buffer", bufferOf(mod, mKernel.inputs[1])}, {"initial", mKernel.output}});
+		setDataOutputs({{"", mKernel.output}});
+	}
+
+	Result codegen(NodeCompiler& compiler, LLVMBasicBlockRef codegenInto, size_t /*execInputID*/,
+	               LLVMMetadataRef nodeLocation, const std::vector<LLVMValueRef>& io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 3 && outputBlocks.size() == 1);
+
+		Result res =
+		    mKernel.validate(context(), compiler.funcCompiler().module(), "lang:buffer-reduce");
+		if (!res) { return res; }
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		auto result = buildLoop(
+		    *builder, buildMinLength(*builder, {io[0]}), {io[1]},
+		    [&](LLVMValueRef index, const std::vector<LLVMValueRef>& carried) {
+			    auto element = LLVMBuildLoad2(*builder, mKernel.inputs[1].llvmType(),
+			                                  buildElementAddress(*builder, io[0], index), "");
+			    return std::vector<LLVMValueRef>{
+			        mKernel.build(context(), *builder, {carried[0], element})};
+		    });
+		LLVMBuildStore(*builder, result[0], io[2]);
+
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return res;
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<BufferReduceNodeType>(*this);
+	}
+
+	std::vector<const GraphFunction*> referencedFunctions() const override {
+		return mKernel.referencedFunctions(context());
+	}
+
+	nlohmann::json toJSON() const override { return {{"kernel", mKernel.qualifiedName}}; }
+
+	BufferKernel mKernel;
+};
+
+/// NodeType for counting from begin up to end, running body with each index. The end of the body
+/// should go back to next, which moves on to the next index or to completed when it's done.
+///
+/// start checks that the loop runs at all, and next is the only way back to the start of body, so
+/// the loop has a single latch at next that has the hints
+struct ForNodeType : NodeType {
+	ForNodeType(LangModule& mod, DataType ty, LoopHints hints)
+	    : NodeType(mod, "for", "Run body for each index from begin up to, but not including, end"),
+	      mType{std::move(ty)},
+	      mHints{hints} {
+		setExecInputs({"start", "next"});
+		setExecOutputs({"body", "completed"});
+
+		setDataInputs({{"begin", mType}, {"end", mType}});
+		setDataOutputs({{"index", mType}});
+	}
+
+	Result codegen(NodeCompiler& /*compiler*/, LLVMBasicBlockRef codegenInto, size_t execInputID,
+	               LLVMMetadataRef nodeLocation, const std::vector<LLVMValueRef>& io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 3 && outputBlocks.size() == 2);
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		// the index is kept in its output, which becomes a phi once it's in registers
+		LLVMValueRef index;
+		if (execInputID == 0) {
+			index = io[0];
+		} else {
+			auto last = LLVMBuildLoad2(*builder, mType.llvmType(), io[2], "");
+			auto one  = LLVMConstInt(mType.llvmType(), 1, false);
+			index     = LLVMBuildNSWAdd(*builder, last, one, "");
+		}
+		LLVMBuildStore(*builder, index, io[2]);
+
+		auto more   = LLVMBuildICmp(*builder, LLVMIntSLT, index, io[1], "");
+		auto branch = LLVMBuildCondBr(*builder, more, outputBlocks[0], outputBlocks[1]);
+		if (execInputID == 1) { setLoopHints(branch, mHints); }
+
+		return {};
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<ForNodeType>(*this);
+	}
+
+	nlohmann::json toJSON() const override {
+		nlohmann::json ret = {{"type", mType.unqualifiedName()}};
+		loopHintsToJSON(mHints, &ret);
+		return ret;
+	}
+
+	DataType  mType;
+	LoopHints mHints;
+};
+
+/// NodeType for running body while condition is true. The end of the body should go back to
+/// next, which checks the condition again.
+struct WhileNodeType : NodeType {
+	WhileNodeType(LangModule& mod, LoopHints hints)
+	    : NodeType(mod, "while", "Run body while condition is true"), mHints{hints} {
+		setExecInputs({"start", "next"});
+		setExecOutputs({"body", "completed"});
+
+		setDataInputs({{"condition", mod.typeFromName("i1")}});
+	}
+
+	Result codegen(NodeCompiler& /*compiler*/, LLVMBasicBlockRef codegenInto, size_t execInputID,
+	               LLVMMetadataRef nodeLocation, const std::vector<LLVMValueRef>& io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == 1 && outputBlocks.size() == 2);
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder,
+		                            LLVMMetadataAsValue(context().llvmContext(), nodeLocation));
+
+		auto branch = LLVMBuildCondBr(*builder, io[0], outputBlocks[0], outputBlocks[1]);
+		if (execInputID == 1) { setLoopHints(branch, mHints); }
+
+		return {};
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<WhileNodeType>(*this);
+	}
+
+	nlohmann::json toJSON() const override {
+		auto ret = nlohmann::json::object();
+		loopHintsToJSON(mHints, &ret);
+		return ret;
+	}
+
+	LoopHints mHints;
+};
+
+/// NodeType for running a graph function for each index from begin up to end on the runtime's
+/// thread pool, going to completed once they've all run. The function takes the index as its
+/// first input, and the node passes its other inputs along to every call.
+///
+/// The calls are outlined into a task function that runs a range of indices, which
+/// chi_parallel_for splits between the workers. The inputs are passed to it in a struct.
+struct ParallelForNodeType : NodeType {
+	ParallelForNodeType(LangModule& mod, std::string qualifiedName, std::string moduleName,
+	                    std::string functionName, std::vector<NamedDataType> captures)
+	    : NodeType(mod, "parallel-for", ""),
+	      mQualifiedName{std::move(qualifiedName)},
+	      mModuleName{std::move(moduleName)},
+	      mFunctionName{std::move(functionName)},
+	      mCaptures{std::move(captures)} {
+		setDescription("Run " + mQualifiedName +
+		               " for each index from begin up to, but not including, end in parallel");
+
+		setExecInputs({""});
+		setExecOutputs({"completed"});
+
+		auto inputs = std::vector<NamedDataType>{{"begin", mod.typeFromName("i32")},
+		                                         {"end", mod.typeFromName("i32")}};
+		inputs.insert(inputs.end(), mCaptures.begin(), mCaptures.end());
+		setDataInputs(std::move(inputs));
+	}
+
+	Result codegen(NodeCompiler& compiler, LLVMBasicBlockRef codegenInto, size_t /*execInputID*/,
+	               LLVMMetadataRef nodeLocation, const std::vector<LLVMValueRef>& io,
+	               const std::vector<LLVMBasicBlockRef>& outputBlocks) override {
+		assert(io.size() == mCaptures.size() + 2 && outputBlocks.size() == 1);
+
+		Result res;
+
+		auto graphMod  = dynamic_cast<GraphModule*>(context().moduleByFullName(mModuleName));
+		auto graphFunc = graphMod == nullptr ? nullptr : graphMod->functionFromName(mFunctionName);
+		if (graphFunc == nullptr) {
+			res.addEntry("EUKN", "Body for lang:parallel-for isn't loaded anymore",
+			             {{"Body", mQualifiedName}});
+			return res;
+		}
+
+		const auto& callerMod = compiler.funcCompiler().module();
+		if (!inDependencies(context(), callerMod, mModuleName)) {
+			res.addEntry("EUKN",
+			             "Body for lang:parallel-for must be in the module it's used in or one of "
+			             "its dependencies",
+			             {{"Body", mQualifiedName}, {"Module", callerMod.fullName()}});
+			return res;
+		}
+
+		auto ctx    = context().llvmContext();
+		auto caller = LLVMGetBasicBlockParent(codegenInto);
+		auto llMod  = LLVMGetGlobalParent(caller);
+		auto i32    = LLVMInt32TypeInContext(ctx);
+		auto i64    = LLVMInt64TypeInContext(ctx);
+		auto i8Ptr  = LLVMPointerType(LLVMInt8TypeInContext(ctx), 0);
+
+		std::vector<LLVMTypeRef> captureTypes;
+		for (const auto& capture : mCaptures) { captureTypes.push_back(capture.type.llvmType()); }
+		auto contextType =
+		    LLVMStructTypeInContext(ctx, captureTypes.data(), captureTypes.size(), false);
+
+		// void task(i8* context, i64 begin, i64 end)
+		LLVMTypeRef taskParams[] = {i8Ptr, i64, i64};
+		auto taskType = LLVMFunctionType(LLVMVoidTypeInContext(ctx), taskParams, 3, false);
+		auto taskName = std::string(LLVMGetValueName(caller)) + "_parallel_for";
+		auto task     = LLVMAddFunction(llMod, taskName.c_str(), taskType);
+		LLVMSetLinkage(task, LLVMInternalLinkage);
+
+		// it needs its own debug info for the call to be inlined into it
+		auto& funcCompiler  = compiler.funcCompiler();
+		auto  line          = LLVMDILocationGetLine(nodeLocation);
+		auto  taskDebugFunc = LLVMDIBuilderCreateFunction(
+		    funcCompiler.diBuilder(), funcCompiler.debugFile(), taskName.c_str(), taskName.size(),
+		    taskName.c_str(), taskName.size(), funcCompiler.debugFile(), line,
+		    LLVMDIBuilderCreateSubroutineType(funcCompiler.diBuilder(), funcCompiler.debugFile(),
+		                                      nullptr, 0, LLVMDIFlagZero),
+		    true, true, line, LLVMDIFlagZero, false);
+		LLVMSetSubprogram(task, taskDebugFunc);
+
+		{
+			auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(ctx));
+			LLVMPositionBuilderAtEnd(*builder, LLVMAppendBasicBlockInContext(ctx, task, "entry"));
+			LLVMSetCurrentDebugLocation(
+			    *builder,
+			    LLVMMetadataAsValue(ctx, LLVMDIBuilderCreateDebugLocation(
+			                                 ctx, line, LLVMDILocationGetColumn(nodeLocation),
+			                                 taskDebugFunc, nullptr)));
+
+			auto contextPtr = LLVMBuildBitCast(*builder, LLVMGetParam(task, 0),
+			                                   LLVMPointerType(contextType, 0), "");
+			std::vector<LLVMValueRef> captured;
+			for (auto idx = 0u; idx < mCaptures.size(); ++idx) {
+				auto address = LLVMBuildStructGEP2(*builder, contextType, contextPtr, idx, "");
+				captured.push_back(LLVMBuildLoad2(*builder, captureTypes[idx], address,
+				                                  mCaptures[idx].name.c_str()));
+			}
+
+			auto begin  = LLVMGetParam(task, 1);
+			auto length = LLVMBuildSub(*builder, LLVMGetParam(task, 2), begin, "");
+			buildLoop(*builder, length, {},
+			          [&](LLVMValueRef index, const std::vector<LLVMValueRef>&) {
+				          auto args = std::vector<LLVMValueRef>{LLVMBuildTrunc(
+				              *builder, LLVMBuildNSWAdd(*builder, begin, index, ""), i32, "")};
+				          args.insert(args.end(), captured.begin(), captured.end());
+
+				          buildInlinedCall(context(), *builder, mModuleName, mFunctionName,
+				                           *graphFunc, args);
+				          return std::vector<LLVMValueRef>{};
+			          });
+
+			LLVMBuildRetVoid(*builder);
+		}
+
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(ctx));
+		LLVMPositionBuilder(*builder, codegenInto, nullptr);
+		LLVMSetCurrentDebugLocation(*builder, LLVMMetadataAsValue(ctx, nodeLocation));
+
+		auto contextSlot = buildEntryAlloca(*builder, contextType, "parallel_for_context");
+		for (auto idx = 0u; idx < mCaptures.size(); ++idx) {
+			LLVMBuildStore(*builder, io[idx + 2],
+			               LLVMBuildStructGEP2(*builder, contextType, contextSlot, idx, ""));
+		}
+
+		// void chi_parallel_for(task, i8* context, i64 begin, i64 end) from the runtime
+		LLVMTypeRef parallelForParams[] = {LLVMPointerType(taskType, 0), i8Ptr, i64, i64};
+		auto        parallelForType =
+		    LLVMFunctionType(LLVMVoidTypeInContext(ctx), parallelForParams, 4, false);
+		auto parallelFor = LLVMGetNamedFunction(llMod, "chi_parallel_for");
+		if (parallelFor == nullptr) {
+			parallelFor = LLVMAddFunction(llMod, "chi_parallel_for", parallelForType);
+		}
+
+		LLVMValueRef args[] = {task, LLVMBuildBitCast(*builder, contextSlot, i8Ptr, ""),
+		                       LLVMBuildSExt(*builder, io[0], i64, ""),
+		                       LLVMBuildSExt(*builder, io[1], i64, "")};
+		LLVMBuildCall2(*builder, parallelForType, parallelFor, args, 4, "");
+
+		// it's returned once they're all done
+		LLVMBuildBr(*builder, outputBlocks[0]);
+
+		return res;
+	}
+
+	std::unique_ptr<NodeType> clone() const override {
+		return std::make_unique<ParallelForNodeType>(*this);
+	}
+
+	std::vector<const GraphFunction*> referencedFunctions() const override {
+		auto graphMod  = dynamic_cast<GraphModule*>(context().moduleByFullName(mModuleName));
+		auto graphFunc = graphMod == nullptr ? nullptr : graphMod->functionFromName(mFunctionName);
+		if (graphFunc == nullptr) { return {}; }
+
+		return {graphFunc};
+	}
+
+	nlohmann::json toJSON() const override { return {{"body", mQualifiedName}}; }
+
+	std::string                mQualifiedName;
+	std::string                mModuleName;
+	std::string                mFunctionName;
+	std::vector<NamedDataType> mCaptures;
+};
+
+}  // anonymous namespace
+
+LangModule::LangModule(Context& ctx) : ChiModule(ctx, "lang") {
+	// populate them
+	nodes = {
+	    {"if"s,
+	     [this](const nlohmann::json&, Result&) { return std::make_unique<IfNodeType>(*this); }},
+	    {"i32+i32"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<BinaryOperationNodeType>(
+		         *this, LangModule::typeFromName("i32"), BinOp::Add);
+	     }},
+	    {"i32-i32"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<BinaryOperationNodeType>(
+		         *this, LangModule::typeFromName("i32"), BinOp::Subtract);
+	     }},
+	    {"i32*i32"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<BinaryOperationNodeType>(
+		         *this, LangModule::typeFromName("i32"), BinOp::Multiply);
+	     }},
+	    {"i32/i32"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<BinaryOperationNodeType>(
+		         *this, LangModule::typeFromName("i32"), BinOp::Divide);
+	     }},
+	    {"float+float"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<BinaryOperationNodeType>(
+		         *this, LangModule::typeFromName("float"), BinOp::Add);
+	     }},
+	    {"float-float"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<BinaryOperationNodeType>(
+		         *this, LangModule::typeFromName("float"), BinOp::Subtract);
+	     }},
+	    {"float*float"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<BinaryOperationNodeType>(
+		         *this, LangModule::typeFromName("float"), BinOp::Multiply);
+	     }},
+	    {"float/float"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<BinaryOperationNodeType>(
+		         *this, LangModule::typeFromName("float"), BinOp::Divide);
+	     }},
+	    {"i32<i32"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("i32"),
+		                                              CmpOp::Lt);
+	     }},
+	    {"i32>i32"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("i32"),
+		                                              CmpOp::Gt);
+	     }},
+	    {"i32<=i32"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("i32"),
+		                                              CmpOp::Let);
+	     }},
+	    {"i32>=i32"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("i32"),
+		                                              CmpOp::Get);
+	     }},
+	    {"i32==i32"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("i32"),
+		                                              CmpOp::Eq);
+	     }},
+	    {"i32!=i32"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("i32"),
+		                                              CmpOp::Neq);
+	     }},
+	    {"float<float"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("float"),
+		                                              CmpOp::Lt);
+	     }},
+	    {"float>float"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("float"),
+		                                              CmpOp::Gt);
+	     }},
+	    {"float<=float"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("float"),
+		                                              CmpOp::Let);
+	     }},
+	    {"float>=float"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("float"),
+		                                              CmpOp::Get);
+	     }},
+	    {"float==float"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("float"),
+		                                              CmpOp::Eq);
+	     }},
+	    {"float!=float"s,
+	     [this](const nlohmann::json&, Result&) {
+		     return std::make_unique<CompareNodeType>(*this, LangModule::typeFromName("float"),
+		                                              CmpOp::Neq);
+	     }},
+	    {"inttofloat"s, [this](const nlohmann::json&,
+	                           Result&) { return std::make_unique<IntToFloatNodeType>(*this); }},
+	    {"floattoint"s, [this](const nlohmann::json&,
+	                           Result&) { return std::make_unique<FloatToIntNodeType>(*this); }},
+	    {"for"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     // counts in i32 unless it's given another integer type
+		     auto ty = typeFromName("i32");
+		     if (data.is_object() && data.find("type") != data.end()) {
+			     ty = data["type"].is_string() ? typeFromName(data["type"].get<std::string>())
+			                                   : DataType{};
+			     if (!ty.valid() || LLVMGetTypeKind(ty.llvmType()) != LLVMIntegerTypeKind ||
+			         ty.unqualifiedName() == "i1") {
+				     res.addEntry("EUKN", "Type for lang:for must be an integer type",
+				                  {{"Given Data", data}});
+				     return nullptr;
+			     }
+		     }
+
+		     return std::make_unique<ForNodeType>(*this, ty,
+		                                          loopHintsFromJSON(data, "lang:for", res));
+	     }},
+	    {"while"s,
+	     [this](const nlohmann::json& data, Result& res) {
+		     return std::make_unique<WhileNodeType>(*this,
+		                                            loopHintsFromJSON(data, "lang:while", res));
+	     }},
+	    {"parallel-for"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     if (!data.is_object() || data.find("body") == data.end() ||
+		         !data["body"].is_string()) {
+			     res.addEntry("EUKN", "Data for lang:parallel-for must be an object with a body",
+			                  {{"Given Data", data}});
+			     return nullptr;
+		     }
+
+		     std::string qualifiedName = data["body"];
+		     auto        colon         = qualifiedName.find(':');
+		     auto        moduleName    = qualifiedName.substr(0, colon);
+		     auto name = colon == std::string::npos ? "" : qualifiedName.substr(colon + 1);
+
+		     // the index comes first, and the rest are passed through from the node
+		     auto graphMod = dynamic_cast<GraphModule*>(context().moduleByFullName(moduleName));
+		     auto func     = graphMod == nullptr ? nullptr : graphMod->functionFromName(name);
+		     if (func == nullptr || func->execInputs().empty() || func->dataInputs().empty() ||
+		         func->dataInputs()[0].type != typeFromName("i32") ||
+		         !func->dataOutputs().empty()) {
+			     res.addEntry("EUKN",
+			                  "Body for lang:parallel-for must be a graph function in a loaded "
+			                  "module that takes an i32 index first and has no outputs",
+			                  {{"Body", qualifiedName}});
+			     return nullptr;
+		     }
+
+		     return std::make_unique<ParallelForNodeType>(
+		         *this, qualifiedName, moduleName, name,
+		         std::vector<NamedDataType>(func->dataInputs().begin() + 1,
+		                                    func->dataInputs().end()));
+	     }},
+	    {"entry"s,
+	     [this](const nlohmann::json& injson, Result& res) {
+		     // transform the JSON data into this data structure
+		     std::vector<NamedDataType> dataInputs;
+
+		     if (injson.find("data") != injson.end()) {
+			     auto& data = injson["data"];
+
+			     if (data.is_array()) {
+				     for (const auto& input : data) {
+					     std::string docString;
+					     std::string qualifiedType;
+					     for (auto iter = input.begin(); iter != input.end(); ++iter) {
+						     docString     = iter.key();
+						     qualifiedType = iter.value();
+					     }
+
+					     std::string module = qualifiedType.substr(0, qualifiedType.find(':'));
+					     std::string type   = qualifiedType.substr(qualifiedType.find(':') + 1);
+
+					     DataType cty;
+					     res += context().typeFromModule(module, type, &cty);
+
+					     if (!res) { continue; }
+
+					     dataInputs.emplace_back(docString, cty);
+				     }
+
+			     } else {
+				     res.addEntry("WUKN", "Data for lang:entry must be an array",
+				                  {{"Given Data", data}});
+			     }
+
+		     } else {
+			     res.addEntry("WUKN", "Data for lang:entry must have a data element",
 			                  {{"Data JSON", injson}});
 		     }
 
@@ -793,6 +2579,175 @@ LangModule::LangModule(Context& ctx) : ChiModule(ctx, "lang") {
 
 		     return std::make_unique<ConstBoolNodeType>(*this, val);
 	     }},
+	    {"vector-splat"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     auto ty = vectorTypeFromJSON(*this, data, "lang:vector-splat", res);
+		     if (!res) { return nullptr; }
+
+		     return std::make_unique<VectorSplatNodeType>(*this, ty);
+	     }},
+	    {"vector-extract"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     auto ty = vectorTypeFromJSON(*this, data, "lang:vector-extract", res);
+		     if (!res) { return nullptr; }
+		     auto lane = laneFromJSON(ty, data, "lang:vector-extract", res);
+		     if (!res) { return nullptr; }
+
+		     return std::make_unique<VectorExtractNodeType>(*this, ty, lane);
+	     }},
+	    {"vector-insert"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     auto ty = vectorTypeFromJSON(*this, data, "lang:vector-insert", res);
+		     if (!res) { return nullptr; }
+		     auto lane = laneFromJSON(ty, data, "lang:vector-insert", res);
+		     if (!res) { return nullptr; }
+
+		     return std::make_unique<VectorInsertNodeType>(*this, ty, lane);
+	     }},
+	    {"vector-select"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     auto ty = vectorTypeFromJSON(*this, data, "lang:vector-select", res);
+		     if (!res) { return nullptr; }
+
+		     return std::make_unique<VectorSelectNodeType>(*this, ty);
+	     }},
+	    {"vector-shuffle"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     auto ty = vectorTypeFromJSON(*this, data, "lang:vector-shuffle", res);
+		     if (!res) { return nullptr; }
+
+		     // the lanes of both inputs can be picked from
+		     auto                  lanes = LLVMGetVectorSize(ty.llvmType());
+		     std::vector<unsigned> mask;
+		     if (data.find("mask") != data.end() && data["mask"].is_array()) {
+			     for (const auto& lane : data["mask"]) {
+				     if (!lane.is_number_integer() || lane.get<int64_t>() < 0 ||
+				         lane.get<int64_t>() >= 2 * lanes) {
+					     mask.clear();
+					     break;
+				     }
+				     mask.push_back(lane);
+			     }
+		     }
+
+		     std::string element;
+		     parseVectorTypeName(ty.unqualifiedName(), &element, &lanes);
+		     auto resultType = typeFromName(element + "x" + std::to_string(mask.size()));
+		     if (!resultType.valid()) {
+			     res.addEntry("EUKN",
+			                  "Mask for lang:vector-shuffle must be a power of two lanes of the "
+			                  "inputs",
+			                  {{"Given Data", data}});
+			     return nullptr;
+		     }
+
+		     return std::make_unique<VectorShuffleNodeType>(*this, ty, resultType,
+		                                                    std::move(mask));
+	     }},
+	    {"vector-reduce"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     auto ty = vectorTypeFromJSON(*this, data, "lang:vector-reduce", res);
+		     if (!res) { return nullptr; }
+
+		     static const std::pair<const char*, ReduceOp> ops[] = {
+		         {"+", ReduceOp::Add}, {"*", ReduceOp::Multiply}, {"min", ReduceOp::Min},
+		         {"max", ReduceOp::Max}, {"and", ReduceOp::And},  {"or", ReduceOp::Or}};
+
+		     std::string opName = data.find("op") != data.end() && data["op"].is_string()
+		                              ? data["op"].get<std::string>()
+		                              : "";
+		     auto op = std::find_if(std::begin(ops), std::end(ops),
+		                            [&](const auto& pair) { return opName == pair.first; });
+
+		     // masks can only be checked for any or all, and floats can't be and-ed
+		     bool isMask   = elementType(*this, ty).unqualifiedName() == "i1";
+		     bool bitwise  = op != std::end(ops) &&
+		                    (op->second == ReduceOp::And || op->second == ReduceOp::Or);
+		     if (op == std::end(ops) || (isMask && !bitwise) || (!isIntegral(ty) && bitwise)) {
+			     res.addEntry("EUKN", "Op for lang:vector-reduce isn't one for the vector type",
+			                  {{"Given Data", data}, {"Type", ty.unqualifiedName()}});
+			     return nullptr;
+		     }
+
+		     return std::make_unique<VectorReduceNodeType>(*this, ty, op->second, opName);
+	     }},
+	    {"buffer-alloc"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     auto ty = bufferTypeFromJSON(*this, data, "lang:buffer-alloc", res);
+		     if (!res) { return nullptr; }
+
+		     return std::make_unique<BufferAllocNodeType>(*this, ty);
+	     }},
+	    {"buffer-free"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     auto ty = bufferTypeFromJSON(*this, data, "lang:buffer-free", res);
+		     if (!res) { return nullptr; }
+
+		     return std::make_unique<BufferFreeNodeType>(*this, ty);
+	     }},
+	    {"buffer-length"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     auto ty = bufferTypeFromJSON(*this, data, "lang:buffer-length", res);
+		     if (!res) { return nullptr; }
+
+		     return std::make_unique<BufferLengthNodeType>(*this, ty);
+	     }},
+	    {"buffer-get"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     auto ty = bufferTypeFromJSON(*this, data, "lang:buffer-get", res);
+		     if (!res) { return nullptr; }
+
+		     return std::make_unique<BufferGetNodeType>(*this, ty);
+	     }},
+	    {"buffer-set"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     auto ty = bufferTypeFromJSON(*this, data, "lang:buffer-set", res);
+		     if (!res) { return nullptr; }
+
+		     return std::make_unique<BufferSetNodeType>(*this, ty);
+	     }},
+	    {"buffer-fill"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     auto ty = bufferTypeFromJSON(*this, data, "lang:buffer-fill", res);
+		     if (!res) { return nullptr; }
+
+		     return std::make_unique<BufferFillNodeType>(*this, ty);
+	     }},
+	    {"buffer-map"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     BufferKernel kernel;
+		     if (!kernelFromJSON(*this, data, "lang:buffer-map", 1, res, &kernel)) {
+			     return nullptr;
+		     }
+
+		     return std::make_unique<BufferMapNodeType>(*this, std::move(kernel));
+	     }},
+	    {"buffer-zip"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     BufferKernel kernel;
+		     if (!kernelFromJSON(*this, data, "lang:buffer-zip", 2, res, &kernel)) {
+			     return nullptr;
+		     }
+
+		     return std::make_unique<BufferMapNodeType>(*this, std::move(kernel));
+	     }},
+	    {"buffer-reduce"s,
+	     [this](const nlohmann::json& data, Result& res) -> std::unique_ptr<NodeType> {
+		     BufferKernel kernel;
+		     if (!kernelFromJSON(*this, data, "lang:buffer-reduce", 2, res, &kernel)) {
+			     return nullptr;
+		     }
+
+		     // what's combined so far is passed back in
+		     if (kernel.inputs[0] != kernel.output) {
+			     res.addEntry("EUKN",
+			                  "Kernel for lang:buffer-reduce must take what it returns first",
+			                  {{"Kernel", kernel.qualifiedName}});
+			     return nullptr;
+		     }
+
+		     return std::make_unique<BufferReduceNodeType>(*this, std::move(kernel));
+	     }},
 	    {"strliteral"s, [this](const nlohmann::json& data, Result& res) {
 		     std::string str;
 		     if (data.is_string()) {
@@ -804,6 +2759,41 @@ LangModule::LangModule(Context& ctx) : ChiModule(ctx, "lang") {
 
 		     return std::make_unique<StringLiteralNodeType>(*this, str);
 	     }}};
+
+	// the other number types get their operations and converters here, i32 and float have theirs
+	// above because they were first
+	for (std::string ty : {"i8", "i16", "i64", "f32", "f64"}) {
+		for (const auto& op : binOps) {
+			nodes.emplace(ty + op.first + ty,
+			              [this, ty, op = op.second](const nlohmann::json&, Result&) {
+				              return std::make_unique<BinaryOperationNodeType>(
+				                  *this, typeFromName(ty), op);
+			              });
+		}
+		for (const auto& op : cmpOps) {
+			nodes.emplace(ty + op.first + ty,
+			              [this, ty, op = op.second](const nlohmann::json&, Result&) {
+				              return std::make_unique<CompareNodeType>(*this, typeFromName(ty), op);
+			              });
+		}
+	}
+
+	// every number type converts to every other, inttofloat and floattoint are i32tofloat and
+	// floattoi32
+	static const char* numberTypes[] = {"i8", "i16", "i32", "i64", "f32", "f64", "float"};
+	for (std::string from : numberTypes) {
+		for (std::string to : numberTypes) {
+			if (from == to || (from == "i32" && to == "float") ||
+			    (from == "float" && to == "i32")) {
+				continue;
+			}
+
+			nodes.emplace(from + "to" + to, [this, from, to](const nlohmann::json&, Result&) {
+				return std::make_unique<ConvertNodeType>(*this, typeFromName(from),
+				                                         typeFromName(to));
+			});
+		}
+	}
 }
 
 Result LangModule::nodeTypeFromName(std::string_view name, const nlohmann::json& jsonData,
@@ -816,6 +2806,11 @@ Result LangModule::nodeTypeFromName(std::string_view name, const nlohmann::json&
 		return res;
 	}
 
+	if (auto vectorNode = vectorOperationFromName(*this, name)) {
+		*toFill = std::move(vectorNode);
+		return res;
+	}
+
 	res.addEntry("E37", "Failed to find node in module",
 	             {{"Module", "lang"}, {"Requested Node Type", name}});
 
@@ -831,17 +2826,68 @@ DataType LangModule::typeFromName(std::string_view name) {
 		ty = LLVMInt32TypeInContext(context().llvmContext());
 	} else if (name == "i1") {
 		ty = LLVMInt1TypeInContext(context().llvmContext());
-	} else if (name == "float") {
+	} else if (name == "i8") {
+		ty = LLVMInt8TypeInContext(context().llvmContext());
+	} else if (name == "i16") {
+		ty = LLVMInt16TypeInContext(context().llvmContext());
+	} else if (name == "i64") {
+		ty = LLVMInt64TypeInContext(context().llvmContext());
+	} else if (name == "float" || name == "f64") {
+		// float was here before f32 and f64, and is a double
 		ty = LLVMDoubleTypeInContext(context().llvmContext());
+	} else if (name == "f32") {
+		ty = LLVMFloatTypeInContext(context().llvmContext());
 	} else if (name == "i8*") {
 		ty = LLVMPointerType(LLVMInt8TypeInContext(context().llvmContext()), 0);
+	} else if (name.size() > 2 && name.substr(name.size() - 2) == "[]") {
+		// buffers of numbers or vectors, like float[], which are a pointer to the first element and
+		// the number of elements
+		auto elementType = typeFromName(name.substr(0, name.size() - 2));
+		if (!elementType.valid() || elementType.unqualifiedName() == "i8*" ||
+		    isBuffer(elementType)) {
+			return {};
+		}
+
+		LLVMTypeRef members[] = {LLVMPointerType(elementType.llvmType(), 0),
+		                         LLVMInt32TypeInContext(context().llvmContext())};
+		ty = LLVMStructTypeInContext(context().llvmContext(), members, 2, false);
 	} else {
-		return {};
+		// vectors of numbers or bools, like i32x4
+		std::string element;
+		unsigned    lanes;
+		if (!parseVectorTypeName(name, &element, &lanes)) { return {}; }
+
+		auto elementType = typeFromName(element);
+		if (!elementType.valid()) { return {}; }
+
+		auto kind = LLVMGetTypeKind(elementType.llvmType());
+		if (kind != LLVMIntegerTypeKind && kind != LLVMFloatTypeKind &&
+		    kind != LLVMDoubleTypeKind) {
+			return {};
+		}
+
+		ty = LLVMVectorType(elementType.llvmType(), lanes);
 	}
 
 	return DataType{this, std::string(name), ty};
 }  // namespace chi
 
+std::vector<std::string> LangModule::typeNames() const {
+	std::vector<std::string> ret = {"i32", "i1", "float", "i8*", "i8", "i16", "i64", "f32", "f64"};
+
+	// any power of two lanes works, these are the ones that fit in vector registers
+	for (const auto& element : {"i32", "float", "i1", "i8", "i16", "i64", "f32"}) {
+		for (auto lanes : {2, 4, 8, 16}) { ret.push_back(element + "x"s + std::to_string(lanes)); }
+	}
+
+	// a buffer can hold any of them but i8*, these are the ones without vectors
+	for (const auto& element : {"i32", "float", "i1", "i8", "i16", "i64", "f32", "f64"}) {
+		ret.push_back(element + "[]"s);
+	}
+
+	return ret;
+}
+
 LLVMMetadataRef LangModule::debugType(FunctionCompiler& compiler, const DataType& dType) const {
 	auto getDebugType = [&](const char* name, size_t size, DwarfEncoding encoding) {
 		auto full_name = "lang:"s + name;
@@ -850,12 +2896,67 @@ LLVMMetadataRef LangModule::debugType(FunctionCompiler& compiler, const DataType
 		                                    LLVMDIFlagZero);
 	};
 
-	if (dType.unqualifiedName() == "i32") {
-		return getDebugType("i32", 32, DwarfEncoding::Signed);
-	} else if (dType.unqualifiedName() == "i1") {
-		return getDebugType("i1", 8, DwarfEncoding::Boolean);
-	} else if (dType.unqualifiedName() == "float") {
-		return getDebugType("float", 64, DwarfEncoding::Float);
+	auto getScalarDebugType = [&](const std::string& name) -> LLVMMetadataRef {
+		if (name == "i32") {
+			return getDebugType("i32", 32, DwarfEncoding::Signed);
+		} else if (name == "i1") {
+			return getDebugType("i1", 8, DwarfEncoding::Boolean);
+		} else if (name == "float") {
+			return getDebugType("float", 64, DwarfEncoding::Float);
+		} else if (name == "i8") {
+			return getDebugType("i8", 8, DwarfEncoding::Signed);
+		} else if (name == "i16") {
+			return getDebugType("i16", 16, DwarfEncoding::Signed);
+		} else if (name == "i64") {
+			return getDebugType("i64", 64, DwarfEncoding::Signed);
+		} else if (name == "f32") {
+			return getDebugType("f32", 32, DwarfEncoding::Float);
+		} else if (name == "f64") {
+			return getDebugType("f64", 64, DwarfEncoding::Float);
+		}
+		return nullptr;
+	};
+
+	if (auto scalar = getScalarDebugType(dType.unqualifiedName())) {
+		return scalar;
+	} else if (isVector(dType)) {
+		std::string element;
+		unsigned    lanes;
+		parseVectorTypeName(dType.unqualifiedName(), &element, &lanes);
+
+		auto dataLayout = LLVMGetModuleDataLayout(compiler.llvmModule());
+		auto subrange   = LLVMDIBuilderGetOrCreateSubrange(compiler.diBuilder(), 0, lanes);
+		return LLVMDIBuilderCreateVectorType(
+		    compiler.diBuilder(), LLVMStoreSizeOfType(dataLayout, dType.llvmType()) * 8,
+		    LLVMABIAlignmentOfType(dataLayout, dType.llvmType()) * 8, getScalarDebugType(element),
+		    &subrange, 1);
+	} else if (isBuffer(dType)) {
+		auto dataLayout  = LLVMGetModuleDataLayout(compiler.llvmModule());
+		const auto& name        = dType.unqualifiedName();
+		auto        elementType = DataType{
+		    const_cast<LangModule*>(this), name.substr(0, name.size() - 2),
+		    LLVMGetElementType(LLVMStructGetTypeAtIndex(dType.llvmType(), 0))};
+
+		auto pointerSize = LLVMPointerSize(dataLayout) * 8;
+		auto dataType    = LLVMDIBuilderCreatePointerType(
+		    compiler.diBuilder(), elementType.debugType(compiler), pointerSize, 0, 0, "", 0);
+		auto lengthType = getDebugType("i32", 32, DwarfEncoding::Signed);
+
+		LLVMMetadataRef members[] = {
+		    LLVMDIBuilderCreateMemberType(compiler.diBuilder(), compiler.debugFile(), "data", 4,
+		                                  compiler.debugFile(), 0, pointerSize, 0, 0,
+		                                  LLVMDIFlagZero, dataType),
+		    LLVMDIBuilderCreateMemberType(compiler.diBuilder(), compiler.debugFile(), "length", 6,
+		                                  compiler.debugFile(), 0, 32, 0,
+		                                  LLVMOffsetOfElement(dataLayout, dType.llvmType(), 1) * 8,
+		                                  LLVMDIFlagZero, lengthType)};
+
+		auto qualifiedName = dType.qualifiedName();
+		return LLVMDIBuilderCreateStructType(
+		    compiler.diBuilder(), compiler.debugFile(), qualifiedName.c_str(), qualifiedName.size(),
+		    compiler.debugFile(), 0, LLVMStoreSizeOfType(dataLayout, dType.llvmType()) * 8, 0,
+		    LLVMDIFlagZero, nullptr, members, 2, 0, nullptr, qualifiedName.c_str(),
+		    qualifiedName.size());
 	} else if (dType.unqualifiedName() == "i8*") {
 		auto charType = LLVMDIBuilderCreateBasicType(
 		    compiler.diBuilder(), "lang:i8", strlen("lang:i8"), 8,
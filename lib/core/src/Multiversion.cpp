@@ -0,0 +1,599 @@
+/// \file Multiversion.cpp
+
+#include "chi/Multiversion.hpp"
+
+#include <llvm-c/Comdat.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/Linker.h>
+#include <llvm-c/TargetMachine.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <unordered_set>
+
+#include "chi/NativeCodegen.hpp"
+#include "chi/Owned.hpp"
+#include "chi/Support/Result.hpp"
+
+namespace chi {
+
+namespace {
+
+constexpr const char* cpuLevelName  = "__chi_cpu_level";
+constexpr const char* cpuDetectName = "__chi_cpu_detect";
+
+// the CPU an instruction set's versions are generated for
+const char* vectorISACPU(VectorISA isa) {
+	switch (isa) {
+	case VectorISA::SSE42: return "x86-64-v2";
+	case VectorISA::AVX2: return "x86-64-v3";
+	case VectorISA::AVX512: return "x86-64-v4";
+	}
+	assert(false && "Unknown VectorISA");
+	return "";
+}
+
+LLVMAttributeRef enumAttribute(LLVMContextRef ctx, const char* name) {
+	return LLVMCreateEnumAttribute(ctx, LLVMGetEnumAttributeKindForName(name, strlen(name)), 0);
+}
+
+// if a function was profiled and never ran
+bool neverRan(LLVMValueRef func) {
+	auto ctx      = LLVMGetModuleContext(LLVMGetGlobalParent(func));
+	auto profKind = LLVMGetMDKindIDInContext(ctx, "prof", 4);
+
+	bool   ret = false;
+	size_t count;
+	auto   entries = LLVMGlobalCopyAllMetadata(func, &count);
+	for (auto idx = 0u; idx < count; ++idx) {
+		if (LLVMValueMetadataEntriesGetKind(entries, idx) != profKind) { continue; }
+
+		// !{!"function_entry_count", i64 count}
+		auto prof = LLVMMetadataAsValue(ctx, LLVMValueMetadataEntriesGetMetadata(entries, idx));
+		if (LLVMGetMDNodeNumOperands(prof) != 2) { continue; }
+
+		LLVMValueRef operands[2];
+		LLVMGetMDNodeOperands(prof, operands);
+		ret = LLVMIsAConstantInt(operands[1]) != nullptr &&
+		      LLVMConstIntGetZExtValue(operands[1]) == 0;
+	}
+	if (entries != nullptr) { LLVMDisposeValueMetadataEntries(entries); }
+
+	return ret;
+}
+
+// the functions and variables that functions can reach, through what they call or take the
+// address of, and the initializers of the variables they use
+struct ReachableGlobals {
+	void add(LLVMValueRef func) { visit(func); }
+
+	void walk() {
+		while (!mToWalk.empty()) {
+			auto func = mToWalk.back();
+			mToWalk.pop_back();
+
+			if (LLVMHasPersonalityFn(func)) { visit(LLVMGetPersonalityFn(func)); }
+			for (auto block = LLVMGetFirstBasicBlock(func); block != nullptr;
+			     block      = LLVMGetNextBasicBlock(block)) {
+				for (auto inst = LLVMGetFirstInstruction(block); inst != nullptr;
+				     inst      = LLVMGetNextInstruction(inst)) {
+					for (auto idx = 0; idx < LLVMGetNumOperands(inst); ++idx) {
+						visit(LLVMGetOperand(inst, idx));
+					}
+				}
+			}
+		}
+	}
+
+	bool contains(LLVMValueRef global) const { return mGlobals.count(global) != 0; }
+
+private:
+	void visit(LLVMValueRef value) {
+		visitConstantReferences(value, &mVisited, [this](LLVMValueRef global) {
+			if (LLVMIsAFunction(global) != nullptr) {
+				if (!LLVMIsDeclaration(global)) {
+					mGlobals.insert(global);
+					mToWalk.push_back(global);
+				}
+				return false;
+			}
+
+			if (LLVMIsAGlobalVariable(global) != nullptr) { mGlobals.insert(global); }
+			return true;
+		});
+	}
+
+	std::unordered_set<LLVMValueRef> mGlobals;
+	std::unordered_set<LLVMValueRef> mVisited;
+	std::vector<LLVMValueRef>        mToWalk;
+};
+
+std::vector<LLVMValueRef> functionsOf(LLVMModuleRef module) {
+	std::vector<LLVMValueRef> ret;
+	for (auto func = LLVMGetFirstFunction(module); func != nullptr;
+	     func      = LLVMGetNextFunction(func)) {
+		ret.push_back(func);
+	}
+	return ret;
+}
+
+std::vector<LLVMValueRef> variablesOf(LLVMModuleRef module) {
+	std::vector<LLVMValueRef> ret;
+	for (auto global = LLVMGetFirstGlobal(module); global != nullptr;
+	     global      = LLVMGetNextGlobal(global)) {
+		ret.push_back(global);
+	}
+	return ret;
+}
+
+// delete the declarations nothing uses anymore
+void deleteUnusedDeclarations(LLVMModuleRef module) {
+	for (auto func : functionsOf(module)) {
+		if (LLVMIsDeclaration(func) && LLVMGetFirstUse(func) == nullptr) {
+			LLVMDeleteFunction(func);
+		}
+	}
+	for (auto global : variablesOf(module)) {
+		if (LLVMIsDeclaration(global) && LLVMGetFirstUse(global) == nullptr) {
+			LLVMDeleteGlobal(global);
+		}
+	}
+}
+
+// turn a copy of the module into one version of the functions being versioned, with its own copy
+// of everything they reach. Globals are matched up with the original module by position, because
+// cloning keeps the order and some don't have names.
+void makeVersion(LLVMModuleRef copy, VectorISA isa, const std::vector<bool>& versionedFunctions,
+                 const std::vector<bool>& reachableFunctions,
+                 const std::vector<bool>& reachableVariables) {
+	auto ctx = LLVMGetModuleContext(copy);
+
+	auto functions = functionsOf(copy);
+	auto variables = variablesOf(copy);
+
+	for (auto idx = 0ull; idx < functions.size(); ++idx) {
+		auto func = functions[idx];
+		if (LLVMIsDeclaration(func)) { continue; }
+
+		if (versionedFunctions[idx]) {
+			auto name = valueName(func) + "." + vectorISAName(isa);
+			LLVMSetValueName2(func, name.c_str(), name.size());
+			LLVMSetLinkage(func, LLVMExternalLinkage);
+			LLVMSetVisibility(func, LLVMHiddenVisibility);
+		} else if (reachableFunctions[idx]) {
+			LLVMSetLinkage(func, LLVMInternalLinkage);
+			LLVMSetVisibility(func, LLVMDefaultVisibility);
+		} else {
+			replaceWithDeclaration(func);
+			continue;
+		}
+		LLVMSetComdat(func, nullptr);
+		LLVMSetDLLStorageClass(func, LLVMDefaultStorageClass);
+
+		// the CPU brings the instruction set, and features from the module's own target could
+		// turn parts of it off
+		auto cpu = vectorISACPU(isa);
+		LLVMAddAttributeAtIndex(func, LLVMAttributeFunctionIndex,
+		                        LLVMCreateStringAttribute(ctx, "target-cpu", 10, cpu, strlen(cpu)));
+		LLVMRemoveStringAttributeAtIndex(func, LLVMAttributeFunctionIndex, "target-features",
+		                                 15);
+	}
+
+	for (auto idx = 0ull; idx < variables.size(); ++idx) {
+		auto global = variables[idx];
+
+		// the original module has the constructors and the used lists
+		if (LLVMGetLinkage(global) == LLVMAppendingLinkage) {
+			LLVMDeleteGlobal(global);
+			continue;
+		}
+		if (LLVMIsDeclaration(global)) { continue; }
+
+		// a copy of a local constant is as good as the original, but the rest have to be shared
+		if (reachableVariables[idx] && isLocal(global) && LLVMIsGlobalConstant(global)) {
+			continue;
+		}
+		replaceWithDeclaration(global);
+	}
+
+	deleteUnusedDeclarations(copy);
+}
+
+// Get the first x86-64 level the CPU supports all of, from 0 for none to 3 for x86-64-v4. See
+// the "Processor Identification" chapter of the Intel SDM for the bits.
+LLVMValueRef buildCPUDetect(LLVMModuleRef module) {
+	auto ctx     = LLVMGetModuleContext(module);
+	auto i32     = LLVMInt32TypeInContext(ctx);
+	auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(ctx));
+
+	auto detect = LLVMAddFunction(module, cpuDetectName, LLVMFunctionType(i32, nullptr, 0, false));
+	LLVMSetLinkage(detect, LLVMInternalLinkage);
+	for (auto attr : {"noinline", "cold", "nounwind"}) {
+		LLVMAddAttributeAtIndex(detect, LLVMAttributeFunctionIndex, enumAttribute(ctx, attr));
+	}
+
+	auto constant = [&](uint32_t value) { return LLVMConstInt(i32, value, false); };
+	auto hasBits  = [&](LLVMValueRef value, uint32_t mask) {
+		auto masked = LLVMBuildAnd(*builder, value, constant(mask), "");
+		return LLVMBuildICmp(*builder, LLVMIntEQ, masked, constant(mask), "");
+	};
+
+	// returns eax, ebx, ecx and edx for a leaf
+	LLVMTypeRef cpuidFields[] = {i32, i32, i32, i32};
+	LLVMTypeRef cpuidParams[] = {i32, i32};
+	auto        cpuidRegs   = LLVMStructTypeInContext(ctx, cpuidFields, 4, false);
+	auto        cpuidType   = LLVMFunctionType(cpuidRegs, cpuidParams, 2, false);
+	std::string cpuidAsm    = "cpuid";
+	std::string cpuidConstraints =
+	    "={ax},={bx},={cx},={dx},{ax},{cx},~{dirflag},~{fpsr},~{flags}";
+	auto cpuid = LLVMGetInlineAsm(cpuidType, cpuidAsm.data(), cpuidAsm.size(),
+	                              cpuidConstraints.data(), cpuidConstraints.size(), false, false,
+	                              LLVMInlineAsmDialectATT, false);
+	auto cpuidRegister = [&](uint32_t leaf, unsigned reg) {
+		LLVMValueRef args[] = {constant(leaf), constant(0)};
+		auto         regs   = LLVMBuildCall2(*builder, cpuidType, cpuid, args, 2, "");
+		return LLVMBuildExtractValue(*builder, regs, reg, "");
+	};
+
+	// returns the low and high halves of an extended control register
+	LLVMTypeRef xgetbvFields[] = {i32, i32};
+	auto        xgetbvRegs = LLVMStructTypeInContext(ctx, xgetbvFields, 2, false);
+	auto        xgetbvType = LLVMFunctionType(xgetbvRegs, &i32, 1, false);
+	std::string xgetbvAsm  = "xgetbv";
+	std::string xgetbvConstraints = "={ax},={dx},{cx},~{dirflag},~{fpsr},~{flags}";
+	auto        xgetbv = LLVMGetInlineAsm(xgetbvType, xgetbvAsm.data(), xgetbvAsm.size(),
+	                                      xgetbvConstraints.data(), xgetbvConstraints.size(), false,
+	                                      false, LLVMInlineAsmDialectATT, false);
+
+	auto entry      = LLVMAppendBasicBlockInContext(ctx, detect, "entry");
+	auto readXCR0   = LLVMAppendBasicBlockInContext(ctx, detect, "xgetbv");
+	auto checkLevel = LLVMAppendBasicBlockInContext(ctx, detect, "levels");
+
+	// leaves that don't exist return garbage instead of faulting, so they're read either way and
+	// checked against the highest leaf
+	LLVMPositionBuilderAtEnd(*builder, entry);
+	auto maxLeaf    = cpuidRegister(0, 0);
+	auto ecx1       = cpuidRegister(1, 2);
+	auto ebx7       = cpuidRegister(7, 1);
+	auto maxExtLeaf = cpuidRegister(0x80000000, 0);
+	auto ecxExt1    = cpuidRegister(0x80000001, 2);
+
+	// xgetbv faults unless the OS turned it on
+	auto osxsave = hasBits(ecx1, 1u << 27);
+	LLVMBuildCondBr(*builder, osxsave, readXCR0, checkLevel);
+
+	LLVMPositionBuilderAtEnd(*builder, readXCR0);
+	auto zero     = constant(0);
+	auto xcr0Regs = LLVMBuildCall2(*builder, xgetbvType, xgetbv, &zero, 1, "");
+	auto xcr0Read = LLVMBuildExtractValue(*builder, xcr0Regs, 0, "");
+	LLVMBuildBr(*builder, checkLevel);
+
+	LLVMPositionBuilderAtEnd(*builder, checkLevel);
+	auto              xcr0         = LLVMBuildPhi(*builder, i32, "xcr0");
+	LLVMValueRef      xcr0Values[] = {zero, xcr0Read};
+	LLVMBasicBlockRef xcr0Blocks[] = {entry, readXCR0};
+	LLVMAddIncoming(xcr0, xcr0Values, xcr0Blocks, 2);
+
+	// SSE3, SSSE3, CMPXCHG16B, SSE4.1, SSE4.2 and POPCNT
+	auto v2 = hasBits(ecx1, (1u << 0) | (1u << 9) | (1u << 13) | (1u << 19) | (1u << 20) |
+	                            (1u << 23));
+
+	// FMA, MOVBE, AVX and F16C, the OS saving the SSE and AVX registers, BMI1, AVX2, BMI2 and
+	// LZCNT
+	auto v3 = v2;
+	for (auto check :
+	     {hasBits(ecx1, (1u << 12) | (1u << 22) | (1u << 28) | (1u << 29)), hasBits(xcr0, 0x6),
+	      LLVMBuildICmp(*builder, LLVMIntUGE, maxLeaf, constant(7), ""),
+	      hasBits(ebx7, (1u << 3) | (1u << 5) | (1u << 8)),
+	      LLVMBuildICmp(*builder, LLVMIntUGE, maxExtLeaf, constant(0x80000001), ""),
+	      hasBits(ecxExt1, 1u << 5)}) {
+		v3 = LLVMBuildAnd(*builder, v3, check, "");
+	}
+
+	// AVX-512 F, DQ, CD, BW and VL, and the OS saving the opmask and ZMM registers
+	auto v4 = LLVMBuildAnd(
+	    *builder, v3,
+	    LLVMBuildAnd(*builder,
+	                 hasBits(ebx7, (1u << 16) | (1u << 17) | (1u << 28) | (1u << 30) | (1u << 31)),
+	                 hasBits(xcr0, 0xe6), ""),
+	    "");
+
+	// each level implies the ones before it
+	auto level = LLVMBuildZExt(*builder, v2, i32, "");
+	level      = LLVMBuildAdd(*builder, level, LLVMBuildZExt(*builder, v3, i32, ""), "");
+	level      = LLVMBuildAdd(*builder, level, LLVMBuildZExt(*builder, v4, i32, ""), "");
+	LLVMBuildRet(*builder, level);
+
+	return detect;
+}
+
+// get the function that returns the x86-64 level of the CPU, which only checks it the first time
+LLVMValueRef cpuLevelFunction(LLVMModuleRef module) {
+	if (auto existing = LLVMGetNamedFunction(module, cpuLevelName)) { return existing; }
+
+	auto ctx     = LLVMGetModuleContext(module);
+	auto i32     = LLVMInt32TypeInContext(ctx);
+	auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(ctx));
+
+	auto detect = buildCPUDetect(module);
+
+	auto cached = LLVMAddGlobal(module, i32, (std::string(cpuLevelName) + ".cached").c_str());
+	LLVMSetLinkage(cached, LLVMInternalLinkage);
+	LLVMSetInitializer(cached, LLVMConstInt(i32, -1, true));
+	LLVMSetAlignment(cached, 4);
+
+	auto level = LLVMAddFunction(module, cpuLevelName, LLVMFunctionType(i32, nullptr, 0, false));
+	LLVMSetLinkage(level, LLVMInternalLinkage);
+	LLVMAddAttributeAtIndex(level, LLVMAttributeFunctionIndex, enumAttribute(ctx, "nounwind"));
+
+	auto entry      = LLVMAppendBasicBlockInContext(ctx, level, "entry");
+	auto detectCPU  = LLVMAppendBasicBlockInContext(ctx, level, "detect");
+	auto knownLevel = LLVMAppendBasicBlockInContext(ctx, level, "known");
+
+	// every thread that gets there first finds the same thing, so it's fine if they race
+	LLVMPositionBuilderAtEnd(*builder, entry);
+	auto loaded = LLVMBuildLoad2(*builder, i32, cached, "");
+	LLVMSetOrdering(loaded, LLVMAtomicOrderingMonotonic);
+	LLVMSetAlignment(loaded, 4);
+	auto isKnown = LLVMBuildICmp(*builder, LLVMIntSGE, loaded, LLVMConstInt(i32, 0, false), "");
+	LLVMBuildCondBr(*builder, isKnown, knownLevel, detectCPU);
+
+	LLVMPositionBuilderAtEnd(*builder, detectCPU);
+	auto detected =
+	    LLVMBuildCall2(*builder, LLVMGlobalGetValueType(detect), detect, nullptr, 0, "");
+	auto store = LLVMBuildStore(*builder, detected, cached);
+	LLVMSetOrdering(store, LLVMAtomicOrderingMonotonic);
+	LLVMSetAlignment(store, 4);
+	LLVMBuildBr(*builder, knownLevel);
+
+	LLVMPositionBuilderAtEnd(*builder, knownLevel);
+	auto              ret         = LLVMBuildPhi(*builder, i32, "");
+	LLVMValueRef      retValues[] = {loaded, detected};
+	LLVMBasicBlockRef retBlocks[] = {entry, detectCPU};
+	LLVMAddIncoming(ret, retValues, retBlocks, 2);
+	LLVMBuildRet(*builder, ret);
+
+	return level;
+}
+
+// copy the attributes of a function at an index to another, leaving out some enum attributes
+void copyAttributes(LLVMValueRef from, LLVMValueRef to, LLVMAttributeIndex idx,
+                    const std::unordered_set<unsigned>& leaveOut) {
+	std::vector<LLVMAttributeRef> attrs(LLVMGetAttributeCountAtIndex(from, idx));
+	LLVMGetAttributesAtIndex(from, idx, attrs.data());
+
+	for (auto attr : attrs) {
+		if (LLVMIsEnumAttribute(attr) && leaveOut.count(LLVMGetEnumAttributeKind(attr)) != 0) {
+			continue;
+		}
+		LLVMAddAttributeAtIndex(to, idx, attr);
+	}
+}
+
+// replace a function with a dispatcher to its versions, keeping it as the version for CPUs that
+// don't have any of the instruction sets. isas has to be sorted from the best one down.
+void buildDispatcher(LLVMValueRef func, const std::vector<VectorISA>& isas) {
+	auto module  = LLVMGetGlobalParent(func);
+	auto ctx     = LLVMGetModuleContext(module);
+	auto i32     = LLVMInt32TypeInContext(ctx);
+	auto funcTy  = LLVMGlobalGetValueType(func);
+	auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(ctx));
+
+	auto name       = valueName(func);
+	auto dispatcher = LLVMAddFunction(module, "", funcTy);
+
+	// it checks the CPU, which reads and writes memory, whatever the versions do
+	std::unordered_set<unsigned> memoryAttrs;
+	for (auto attr : {"readnone", "readonly", "writeonly", "argmemonly", "inaccessiblememonly",
+	                  "inaccessiblemem_or_argmemonly", "nosync", "speculatable"}) {
+		memoryAttrs.insert(LLVMGetEnumAttributeKindForName(attr, strlen(attr)));
+	}
+	copyAttributes(func, dispatcher, LLVMAttributeFunctionIndex, memoryAttrs);
+	copyAttributes(func, dispatcher, LLVMAttributeReturnIndex, {});
+	for (auto idx = 1u; idx <= LLVMCountParams(func); ++idx) {
+		copyAttributes(func, dispatcher, idx, {});
+	}
+
+	LLVMSetLinkage(dispatcher, LLVMGetLinkage(func));
+	LLVMSetVisibility(dispatcher, LLVMGetVisibility(func));
+	LLVMSetDLLStorageClass(dispatcher, LLVMGetDLLStorageClass(func));
+	LLVMSetUnnamedAddress(dispatcher, LLVMGetUnnamedAddress(func));
+	LLVMSetFunctionCallConv(dispatcher, LLVMGetFunctionCallConv(func));
+	LLVMSetAlignment(dispatcher, LLVMGetAlignment(func));
+	LLVMSetComdat(dispatcher, LLVMGetComdat(func));
+	if (auto section = LLVMGetSection(func)) { LLVMSetSection(dispatcher, section); }
+
+	// everything that used it gets the dispatcher, and it becomes the default version
+	LLVMReplaceAllUsesWith(func, dispatcher);
+	auto defaultName = name + ".default";
+	LLVMSetValueName2(func, defaultName.c_str(), defaultName.size());
+	LLVMSetValueName2(dispatcher, name.c_str(), name.size());
+	LLVMSetLinkage(func, LLVMInternalLinkage);
+	LLVMSetVisibility(func, LLVMDefaultVisibility);
+	LLVMSetDLLStorageClass(func, LLVMDefaultStorageClass);
+	LLVMSetComdat(func, nullptr);
+
+	std::vector<LLVMValueRef> args(LLVMCountParams(dispatcher));
+	LLVMGetParams(dispatcher, args.data());
+
+	auto callVersion = [&](LLVMValueRef version) {
+		auto call = LLVMBuildCall2(*builder, funcTy, version, args.data(), args.size(), "");
+		LLVMSetInstructionCallConv(call, LLVMGetFunctionCallConv(dispatcher));
+		LLVMSetTailCall(call, true);
+
+		if (LLVMGetTypeKind(LLVMGetReturnType(funcTy)) == LLVMVoidTypeKind) {
+			LLVMBuildRetVoid(*builder);
+		} else {
+			LLVMBuildRet(*builder, call);
+		}
+	};
+
+	LLVMPositionBuilderAtEnd(*builder, LLVMAppendBasicBlockInContext(ctx, dispatcher, "entry"));
+	auto level = LLVMBuildCall2(*builder, LLVMFunctionType(i32, nullptr, 0, false),
+	                            cpuLevelFunction(module), nullptr, 0, "level");
+
+	for (auto isa : isas) {
+		auto versionName = name + "." + vectorISAName(isa);
+		auto version     = LLVMGetNamedFunction(module, versionName.c_str());
+		assert(version != nullptr);
+
+		LLVMSetLinkage(version, LLVMInternalLinkage);
+		LLVMSetVisibility(version, LLVMDefaultVisibility);
+
+		auto supported = LLVMAppendBasicBlockInContext(ctx, dispatcher, vectorISAName(isa));
+		auto next      = LLVMAppendBasicBlockInContext(ctx, dispatcher, "");
+
+		auto hasLevel = LLVMBuildICmp(*builder, LLVMIntUGE, level,
+		                              LLVMConstInt(i32, static_cast<unsigned>(isa), false), "");
+		LLVMBuildCondBr(*builder, hasLevel, supported, next);
+
+		LLVMPositionBuilderAtEnd(*builder, supported);
+		callVersion(version);
+
+		LLVMPositionBuilderAtEnd(*builder, next);
+	}
+	callVersion(func);
+}
+
+}  // anonymous namespace
+
+const char* vectorISAName(VectorISA isa) {
+	switch (isa) {
+	case VectorISA::SSE42: return "sse4.2";
+	case VectorISA::AVX2: return "avx2";
+	case VectorISA::AVX512: return "avx512";
+	}
+	assert(false && "Unknown VectorISA");
+	return "";
+}
+
+Result parseVectorISAs(const std::string& list, std::vector<VectorISA>* toFill) {
+	assert(toFill != nullptr);
+
+	Result res;
+
+	toFill->clear();
+
+	std::istringstream stream{list};
+	std::string        name;
+	while (std::getline(stream, name, ',')) {
+		VectorISA isa;
+		if (name == "sse4.2") {
+			isa = VectorISA::SSE42;
+		} else if (name == "avx2") {
+			isa = VectorISA::AVX2;
+		} else if (name == "avx512") {
+			isa = VectorISA::AVX512;
+		} else {
+			res.addEntry("EUKN", "Unknown instruction set to make versions for",
+			             {{"Instruction Set", name}, {"Known", {"sse4.2", "avx2", "avx512"}}});
+			return res;
+		}
+
+		if (std::find(toFill->begin(), toFill->end(), isa) == toFill->end()) {
+			toFill->push_back(isa);
+		}
+	}
+
+	return res;
+}
+
+Result multiversionFunctions(LLVMModuleRef module, const std::vector<std::string>& functionNames,
+                             const std::vector<VectorISA>& isas) {
+	Result res;
+
+	std::string triple = LLVMGetTarget(module);
+	if (triple.empty()) { triple = *OwnedMessage(LLVMGetDefaultTargetTriple()); }
+	auto arch = triple.substr(0, triple.find('-'));
+	if (arch != "x86_64" && arch != "i386" && arch != "i486" && arch != "i586" &&
+	    arch != "i686") {
+		res.addEntry("EUKN", "Functions can only have versions for instruction sets on x86",
+		             {{"Triple", triple}});
+		return res;
+	}
+
+	// they'd have to be in every version
+	if (LLVMGetFirstGlobalAlias(module) != nullptr || LLVMGetFirstGlobalIFunc(module) != nullptr) {
+		res.addEntry("EUKN", "Modules with aliases or ifuncs can't have functions with versions",
+		             {});
+		return res;
+	}
+
+	std::vector<LLVMValueRef> toVersion;
+	for (const auto& name : functionNames) {
+		auto func = LLVMGetNamedFunction(module, name.c_str());
+		if (func == nullptr || LLVMIsDeclaration(func) || neverRan(func)) { continue; }
+		if (std::find(toVersion.begin(), toVersion.end(), func) != toVersion.end()) { continue; }
+
+		toVersion.push_back(func);
+	}
+	if (toVersion.empty() || isas.empty()) { return res; }
+
+	// the best instruction set is checked for first
+	auto sortedISAs = isas;
+	std::sort(sortedISAs.begin(), sortedISAs.end(),
+	          [](VectorISA lhs, VectorISA rhs) { return lhs > rhs; });
+
+	ReachableGlobals reachable;
+	for (auto func : toVersion) { reachable.add(func); }
+	reachable.walk();
+
+	// the variables the versions use are shared with the rest of the program, so the local ones
+	// have to be visible to them
+	auto variables = variablesOf(module);
+	for (auto global : variables) {
+		if (!reachable.contains(global) || !isLocal(global) || LLVMIsGlobalConstant(global)) {
+			continue;
+		}
+
+		auto base = valueName(global);
+		if (base.empty()) { base = "anon"; }
+		base += ".shared";
+
+		auto name = base;
+		for (auto idx = 1; LLVMGetNamedGlobal(module, name.c_str()) != nullptr; ++idx) {
+			name = base + "." + std::to_string(idx);
+		}
+
+		LLVMSetValueName2(global, name.c_str(), name.size());
+		LLVMSetLinkage(global, LLVMExternalLinkage);
+		LLVMSetVisibility(global, LLVMHiddenVisibility);
+		LLVMSetComdat(global, nullptr);
+	}
+
+	auto functions = functionsOf(module);
+
+	std::vector<bool> versionedFunctions(functions.size()), reachableFunctions(functions.size());
+	for (auto idx = 0ull; idx < functions.size(); ++idx) {
+		versionedFunctions[idx] = std::find(toVersion.begin(), toVersion.end(), functions[idx]) !=
+		                          toVersion.end();
+		reachableFunctions[idx] = reachable.contains(functions[idx]);
+	}
+	std::vector<bool> reachableVariables(variables.size());
+	for (auto idx = 0ull; idx < variables.size(); ++idx) {
+		reachableVariables[idx] = reachable.contains(variables[idx]);
+	}
+
+	// every version is copied from the module before any of them are linked into it
+	std::vector<OwnedLLVMModule> versions;
+	for (auto isa : sortedISAs) {
+		versions.emplace_back(LLVMCloneModule(module));
+		makeVersion(*versions.back(), isa, versionedFunctions, reachableFunctions,
+		            reachableVariables);
+	}
+	for (auto idx = 0ull; idx < versions.size(); ++idx) {
+		if (LLVMLinkModules2(module, versions[idx].take_ownership())) {
+			res.addEntry("EINT", "Failed to link in the versions for an instruction set",
+			             {{"Instruction Set", vectorISAName(sortedISAs[idx])}});
+			return res;
+		}
+	}
+
+	for (auto func : toVersion) { buildDispatcher(func, sortedISAs); }
+
+	return res;
+}
+
+}  // namespace chi
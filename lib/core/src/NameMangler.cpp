@@ -42,9 +42,22 @@ std::string mangleFunctionName(std::string modName, const std::string& name) {
 	return modName + "_m" + name;
 }
 
+std::string mangleSpecializedFunctionName(std::string fullModuleName, const std::string& name,
+                                          size_t execInputID) {
+	return mangleFunctionName(std::move(fullModuleName), name) + ".exec" +
+	       std::to_string(execInputID);
+}
+
 std::pair<std::string, std::string> unmangleFunctionName(std::string mangled) {
 	if (mangled == "main") { return {"main", "main"}; }
 
+	// strip the exec input from specialized clones
+	auto specialized = mangled.rfind(".exec");
+	if (specialized != std::string::npos && specialized + 5 < mangled.size() &&
+	    mangled.find_first_not_of("0123456789", specialized + 5) == std::string::npos) {
+		mangled.erase(specialized);
+	}
+
 	size_t      splitter = mangled.find("_m");
 	std::string modName  = mangled.substr(0, splitter);
 	std::string typeName = mangled.substr(splitter + 2);
@@ -0,0 +1,403 @@
+/// \file NativeCodegen.cpp
+
+#include "chi/NativeCodegen.hpp"
+
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/Comdat.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/TargetMachine.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+
+#include "chi/BitcodeParser.hpp"
+#include "chi/Owned.hpp"
+#include "chi/Support/ContentHash.hpp"
+#include "chi/Support/FindProgram.hpp"
+#include "chi/Support/Result.hpp"
+#include "chi/Support/Subprocess.hpp"
+#include "chi/Support/TempFile.hpp"
+
+namespace fs = std::filesystem;
+
+namespace chi {
+
+namespace {
+
+size_t instructionCount(LLVMValueRef func) {
+	size_t count = 0;
+	for (auto block = LLVMGetFirstBasicBlock(func); block != nullptr;
+	     block      = LLVMGetNextBasicBlock(block)) {
+		for (auto inst = LLVMGetFirstInstruction(block); inst != nullptr;
+		     inst      = LLVMGetNextInstruction(inst)) {
+			++count;
+		}
+	}
+	return count;
+}
+
+// the functions a partition defines. available_externally ones are left out, they're never
+// emitted anyways
+bool isPartitioned(LLVMValueRef func) {
+	return !LLVMIsDeclaration(func) && LLVMGetLinkage(func) != LLVMAvailableExternallyLinkage;
+}
+
+// make every local visible to the other partitions. The new names get a hash of the module's
+// definitions, so they don't clash with the promoted locals of other modules
+void promoteLocals(LLVMModuleRef module) {
+	std::vector<LLVMValueRef> globals;
+	ContentHasher             hasher;
+	{
+		size_t      length;
+		const char* identifier = LLVMGetModuleIdentifier(module, &length);
+		hasher.add({identifier, length});
+	}
+
+	for (auto func = LLVMGetFirstFunction(module); func != nullptr;
+	     func      = LLVMGetNextFunction(func)) {
+		if (LLVMIsDeclaration(func)) { continue; }
+		globals.push_back(func);
+	}
+	for (auto global = LLVMGetFirstGlobal(module); global != nullptr;
+	     global      = LLVMGetNextGlobal(global)) {
+		if (LLVMIsDeclaration(global) || LLVMGetLinkage(global) == LLVMAppendingLinkage) {
+			continue;
+		}
+		globals.push_back(global);
+	}
+	for (auto global : globals) {
+		if (!isLocal(global)) { hasher.add(valueName(global)); }
+	}
+
+	auto suffix = ".chi." + hasher.hexDigest().substr(0, 12);
+
+	auto anonymousID = 0;
+	for (auto global : globals) {
+		auto linkage = LLVMGetLinkage(global);
+
+		// a partition that doesn't use its copy of a linkonce function wouldn't emit it
+		if (linkage == LLVMLinkOnceAnyLinkage) { LLVMSetLinkage(global, LLVMWeakAnyLinkage); }
+		if (linkage == LLVMLinkOnceODRLinkage) { LLVMSetLinkage(global, LLVMWeakODRLinkage); }
+
+		if (!isLocal(global)) { continue; }
+
+		auto name = valueName(global);
+		if (name.empty()) { name = "anon." + std::to_string(anonymousID++); }
+		name += suffix;
+
+		LLVMSetValueName2(global, name.c_str(), name.size());
+		LLVMSetLinkage(global, LLVMExternalLinkage);
+		LLVMSetVisibility(global, LLVMHiddenVisibility);
+
+		// the rest of its comdat might be discarded for another module's copy, which wouldn't
+		// have it
+		LLVMSetComdat(global, nullptr);
+	}
+}
+
+// split the functions into `count` partitions with about the same number of instructions, biggest
+// first
+std::unordered_map<std::string, size_t> assignPartitions(LLVMModuleRef module, size_t count) {
+	std::vector<std::pair<size_t, std::string>> functions;
+	for (auto func = LLVMGetFirstFunction(module); func != nullptr;
+	     func      = LLVMGetNextFunction(func)) {
+		if (isPartitioned(func)) {
+			functions.emplace_back(instructionCount(func), valueName(func));
+		}
+	}
+	std::stable_sort(functions.begin(), functions.end(),
+	                 [](const auto& lhs, const auto& rhs) { return lhs.first > rhs.first; });
+
+	std::unordered_map<std::string, size_t> ret;
+	std::vector<size_t>                     sizes(count, 0);
+	for (const auto& [size, name] : functions) {
+		auto smallest = std::min_element(sizes.begin(), sizes.end()) - sizes.begin();
+
+		ret[name] = smallest;
+		sizes[smallest] += size;
+	}
+	return ret;
+}
+
+// strip a copy of the module down to one partition
+void keepPartition(LLVMModuleRef module, const std::unordered_map<std::string, size_t>& assignment,
+                   size_t partition) {
+	std::vector<LLVMValueRef> toDeclare, toDelete;
+	for (auto func = LLVMGetFirstFunction(module); func != nullptr;
+	     func      = LLVMGetNextFunction(func)) {
+		if (LLVMIsDeclaration(func)) { continue; }
+
+		auto iter = assignment.find(valueName(func));
+		if (iter == assignment.end() || iter->second != partition) { toDeclare.push_back(func); }
+	}
+
+	if (partition != 0) {
+		for (auto global = LLVMGetFirstGlobal(module); global != nullptr;
+		     global      = LLVMGetNextGlobal(global)) {
+			if (LLVMIsDeclaration(global)) { continue; }
+
+			// like llvm.global_ctors, which the first partition has
+			if (LLVMGetLinkage(global) == LLVMAppendingLinkage) {
+				toDelete.push_back(global);
+			} else {
+				toDeclare.push_back(global);
+			}
+		}
+	}
+
+	for (auto global : toDelete) { LLVMDeleteGlobal(global); }
+	for (auto global : toDeclare) { replaceWithDeclaration(global); }
+}
+
+fs::path findLinker() {
+	for (auto name : {"cc", "clang", "gcc"}) {
+		auto path = findProgram(name);
+		if (!path.empty()) { return path; }
+	}
+	return {};
+}
+
+// write the objects to temporary files and run the linker with `arguments` followed by them
+Result runLinker(std::vector<std::string> arguments, const std::vector<std::string>& objects,
+                 const std::vector<fs::path>& inputFiles) {
+	Result res;
+
+	auto linkerPath = findLinker();
+	if (linkerPath.empty()) {
+		res.addEntry("EUKN", "Failed to find a linker (cc, clang, or gcc) in PATH", {});
+		return res;
+	}
+
+	std::vector<fs::path> objectPaths;
+	for (const auto& object : objects) {
+		objectPaths.push_back(makeTempPath(".o"));
+
+		std::ofstream stream{objectPaths.back(), std::ios::binary};
+		stream.write(object.data(), object.size());
+		if (!stream) {
+			res.addEntry("EUKN", "Failed to write object file",
+			             {{"Path", objectPaths.back().string()}});
+			break;
+		}
+	}
+
+	if (res) {
+		for (const auto& path : objectPaths) { arguments.push_back(path.string()); }
+		for (const auto& path : inputFiles) { arguments.push_back(path.string()); }
+
+		auto argumentsContext = res.addScopedContext({{"Linker arguments", arguments}});
+
+		std::string output, errors;
+		{
+			Subprocess linker{linkerPath};
+			linker.setArguments(arguments);
+			linker.attachStringToStdOut(output);
+			linker.attachStringToStdErr(errors);
+
+			res += linker.start();
+			if (res) { res += linker.closeStdIn(); }
+
+			if (res && linker.exitCode() != 0) {
+				res.addEntry("EUKN", "Failed to link", {{"Output", output}, {"Error", errors}});
+			}
+		}
+	}
+
+	for (const auto& path : objectPaths) {
+		std::error_code ec;
+		fs::remove(path, ec);
+	}
+
+	return res;
+}
+
+}  // anonymous namespace
+
+std::string valueName(LLVMValueRef value) {
+	size_t      length;
+	const char* name = LLVMGetValueName2(value, &length);
+	return {name, length};
+}
+
+bool isLocal(LLVMValueRef global) {
+	auto linkage = LLVMGetLinkage(global);
+	return linkage == LLVMInternalLinkage || linkage == LLVMPrivateLinkage;
+}
+
+void visitConstantReferences(LLVMValueRef value, std::unordered_set<LLVMValueRef>* visited,
+                             const std::function<bool(LLVMValueRef global)>& visitGlobal) {
+	assert(visited != nullptr);
+
+	if (value == nullptr || !LLVMIsAConstant(value) || !visited->insert(value).second) { return; }
+
+	if (LLVMIsAGlobalValue(value) != nullptr) {
+		if (!visitGlobal(value) || LLVMIsAFunction(value) != nullptr) { return; }
+
+		if (LLVMIsAGlobalVariable(value) != nullptr) {
+			if (auto init = LLVMGetInitializer(value)) {
+				visitConstantReferences(init, visited, visitGlobal);
+			}
+			return;
+		}
+	}
+
+	// constant expressions, aggregates and aliases
+	for (auto idx = 0; idx < LLVMGetNumOperands(value); ++idx) {
+		visitConstantReferences(LLVMGetOperand(value, idx), visited, visitGlobal);
+	}
+}
+
+std::string writeBitcode(LLVMModuleRef module) {
+	auto buffer = OwnedLLVMMemoryBuffer(LLVMWriteBitcodeToMemoryBuffer(module));
+	return {LLVMGetBufferStart(*buffer), LLVMGetBufferSize(*buffer)};
+}
+
+LLVMValueRef replaceWithDeclaration(LLVMValueRef global) {
+	assert(LLVMIsAFunction(global) != nullptr || LLVMIsAGlobalVariable(global) != nullptr);
+
+	auto name = valueName(global);
+	LLVMSetValueName2(global, "", 0);
+
+	LLVMValueRef decl;
+	if (LLVMIsAFunction(global) != nullptr) {
+		decl = LLVMAddFunction(LLVMGetGlobalParent(global), name.c_str(),
+		                       LLVMGlobalGetValueType(global));
+		LLVMSetFunctionCallConv(decl, LLVMGetFunctionCallConv(global));
+	} else {
+		decl = LLVMAddGlobalInAddressSpace(LLVMGetGlobalParent(global),
+		                                   LLVMGlobalGetValueType(global), name.c_str(),
+		                                   LLVMGetPointerAddressSpace(LLVMTypeOf(global)));
+		LLVMSetThreadLocal(decl, LLVMIsThreadLocal(global));
+		LLVMSetGlobalConstant(decl, LLVMIsGlobalConstant(global));
+	}
+	LLVMSetAlignment(decl, LLVMGetAlignment(global));
+	LLVMSetVisibility(decl, LLVMGetVisibility(global));
+
+	LLVMReplaceAllUsesWith(global, decl);
+	if (LLVMIsAFunction(global) != nullptr) {
+		LLVMDeleteFunction(global);
+	} else {
+		LLVMDeleteGlobal(global);
+	}
+
+	return decl;
+}
+
+Result emitObjectFiles(LLVMModuleRef module, const CodegenSettings& settings,
+                       std::vector<std::string>* toFill) {
+	assert(toFill != nullptr);
+	assert(settings.optimizationLevel <= 3);
+
+	Result res;
+
+	auto optLevel = LLVMCodeGenOptLevel(LLVMCodeGenLevelNone + settings.optimizationLevel);
+
+	// each worker makes its own, this makes sure they can
+	OwnedTargetMachine checkMachine;
+	res += createTargetMachine(settings.target, optLevel, LLVMRelocPIC, &checkMachine);
+	if (!res) { return res; }
+
+	size_t functionCount = 0;
+	for (auto func = LLVMGetFirstFunction(module); func != nullptr;
+	     func      = LLVMGetNextFunction(func)) {
+		if (isPartitioned(func)) { ++functionCount; }
+	}
+
+	auto partitionCount =
+	    std::max<size_t>(1, std::min<size_t>(settings.threadCount, functionCount));
+
+	// an alias has to be in the same object as what it aliases
+	if (LLVMGetFirstGlobalAlias(module) != nullptr || LLVMGetFirstGlobalIFunc(module) != nullptr) {
+		partitionCount = 1;
+	}
+
+	std::unordered_map<std::string, size_t> assignment;
+	if (partitionCount > 1) {
+		promoteLocals(module);
+		assignment = assignPartitions(module, partitionCount);
+	}
+
+	// LLVMContexts can't be shared between threads, so the partitions go to the workers as bitcode
+	auto bitcode = partitionCount > 1 ? writeBitcode(module) : std::string{};
+
+	std::atomic<size_t>      nextToEmit{0};
+	std::vector<Result>      partitionResults(partitionCount);
+	std::vector<std::string> objects(partitionCount);
+
+	auto worker = [&] {
+		OwnedTargetMachine targetMachine;
+		createTargetMachine(settings.target, optLevel, LLVMRelocPIC, &targetMachine);
+
+		for (auto idx = nextToEmit++; idx < partitionCount; idx = nextToEmit++) {
+			auto& partRes = partitionResults[idx];
+
+			OwnedLLVMContext llctx;
+			OwnedLLVMModule  partition;
+			auto             toEmit = module;
+			if (partitionCount > 1) {
+				llctx = OwnedLLVMContext(LLVMContextCreate());
+				partRes += parseBitcodeString(bitcode, *llctx, &partition);
+				if (!partRes) { continue; }
+
+				keepPartition(*partition, assignment, idx);
+				toEmit = *partition;
+			}
+
+			LLVMMemoryBufferRef buffer = nullptr;
+			OwnedMessage        emitError;
+			if (LLVMTargetMachineEmitToMemoryBuffer(*targetMachine, toEmit, LLVMObjectFile,
+			                                        &*emitError, &buffer) != 0) {
+				partRes.addEntry("EUKN", "Failed to generate object file",
+				                 {{"Partition", idx}, {"Error", *emitError}});
+				continue;
+			}
+			auto owned   = OwnedLLVMMemoryBuffer(buffer);
+			objects[idx] = std::string(LLVMGetBufferStart(*owned), LLVMGetBufferSize(*owned));
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (auto workerID = 1ull; workerID < partitionCount; ++workerID) {
+		workers.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : workers) { thread.join(); }
+
+	for (auto& partRes : partitionResults) { res += partRes; }
+	if (!res) { return res; }
+
+	*toFill = std::move(objects);
+
+	return res;
+}
+
+Result writeObjectFile(const std::vector<std::string>& objects, const fs::path& outpath) {
+	assert(!objects.empty());
+
+	Result res;
+
+	if (objects.size() == 1) {
+		std::ofstream stream{outpath, std::ios::binary};
+		stream.write(objects[0].data(), objects[0].size());
+		if (!stream) {
+			res.addEntry("EUKN", "Failed to write object file", {{"Path", outpath.string()}});
+		}
+		return res;
+	}
+
+	return runLinker({"-r", "-nostdlib", "-o", outpath.string()}, objects, {});
+}
+
+Result linkExecutable(const std::vector<std::string>& objects,
+                      const std::vector<fs::path>& inputFiles, const fs::path& outpath) {
+	assert(!objects.empty());
+
+	// the runtime's thread pool uses pthreads
+	return runLinker({"-pthread", "-o", outpath.string()}, objects, inputFiles);
+}
+
+}  // namespace chi
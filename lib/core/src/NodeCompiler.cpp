@@ -2,11 +2,18 @@
 
 #include <llvm-c/Core.h>
 
+#include <boost/dynamic_bitset.hpp>
+
+#include <algorithm>
 #include <cassert>
+#include <deque>
+#include <map>
 
 #include "chi/Context.hpp"
 #include "chi/DataType.hpp"
 #include "chi/FunctionCompiler.hpp"
+#include "chi/GraphFunction.hpp"
+#include "chi/GraphModule.hpp"
 #include "chi/NodeInstance.hpp"
 #include "chi/NodeType.hpp"
 #include "chi/Support/Result.hpp"
@@ -15,6 +22,36 @@ namespace fs = std::filesystem;
 
 namespace chi {
 
+namespace {
+
+// depth first, so each pure comes after the pures it depends on, and only the first time it's
+// reached
+void addDependentPures(const NodeInstance& inst, std::unordered_set<const NodeInstance*>* visited,
+                       std::vector<NodeInstance*>* toFill) {
+	for (const auto& conn : inst.inputDataConnections) {
+		// if it isn't connected (this really shouldn't happen because that would fail validation),
+		// then skip.
+		if (conn.first == nullptr || !conn.first->type().pure()) { continue; }
+
+		if (!visited->insert(conn.first).second) { continue; }
+
+		addDependentPures(*conn.first, visited, toFill);
+		toFill->push_back(conn.first);
+	}
+}
+
+// the name of the local variable that a node gets or sets, or empty if it doesn't
+std::string localVariableName(const NodeInstance& inst, std::string_view prefix) {
+	auto name = inst.type().name();
+	if (&inst.type().module() != &inst.function().module() || name.size() <= prefix.size() ||
+	    name.compare(0, prefix.size(), prefix) != 0) {
+		return {};
+	}
+	return name.substr(prefix.size());
+}
+
+}  // anonymous namespace
+
 NodeCompiler::NodeCompiler(FunctionCompiler& functionCompiler, NodeInstance& inst)
     : mCompiler{&functionCompiler}, mNode{&inst} {
 	// alloca the outputs
@@ -39,12 +76,15 @@ NodeCompiler::NodeCompiler(FunctionCompiler& functionCompiler, NodeInstance& ins
 			    funcCompiler().diBuilder(), funcCompiler().diFunction(), name.c_str(),
 			    name.length(), funcCompiler().debugFile(), 1, dType, false, LLVMDIFlagZero, 0);
 
-			LLVMDIBuilderInsertDeclareAtEnd(
+			auto declare = LLVMDIBuilderInsertDeclareAtEnd(
 			    funcCompiler().diBuilder(), alloca, debugVar,
 			    LLVMDIBuilderCreateExpression(funcCompiler().diBuilder(), nullptr, 0),
 			    LLVMDIBuilderCreateDebugLocation(context().llvmContext(), 1, 1,
 			                                     funcCompiler().diFunction(), nullptr),
 			    funcCompiler().allocBlock());
+
+			mOutputDebugVariables.push_back(debugVar);
+			mOutputDeclares.push_back(declare);
 		}
 
 		mReturnValues.push_back(alloca);
@@ -55,6 +95,7 @@ NodeCompiler::NodeCompiler(FunctionCompiler& functionCompiler, NodeInstance& ins
 	// resize the inputexec specific variables
 	mPureBlocks.resize(size);
 	mCodeBlocks.resize(size, nullptr);
+	mStoredValues.resize(size);
 
 	mCompiledInputs.resize(size, false);
 }
@@ -64,6 +105,7 @@ bool NodeCompiler::pure() const { return node().type().pure(); }
 void NodeCompiler::compile_stage1(size_t inputExecID) {
 	assert(inputExecID < inputExecs() &&
 	       "Cannot compile_stage1 for a inputexec that doesn't exist");
+	assert(!pure() && "Pure nodes are compiled into the nodes that use them");
 
 	// create the code block
 	auto& codeBlock = mCodeBlocks[inputExecID];
@@ -75,68 +117,147 @@ void NodeCompiler::compile_stage1(size_t inputExecID) {
 	    context().llvmContext(), funcCompiler().llFunction(),
 	    ("node_" + node().stringId() + "__" + std::to_string(inputExecID)).c_str());
 
-	// only do this for non-pure nodes because pure nodes don't call their dependencies, they are
-	// called by the non-pure
-	if (!pure()) {
-		// generate code for all the dependent pures
-		auto depPures = dependentPuresRecursive(node());
+	// the ones that were folded aren't compiled, and all the pures they depend on were folded too
+	auto depPures = dependentPuresRecursive(node());
+	depPures.erase(std::remove_if(depPures.begin(), depPures.end(),
+	                              [&](NodeInstance* pure) {
+		                              return funcCompiler().optimizations().constants.count(pure) !=
+		                                     0;
+	                              }),
+	               depPures.end());
+
+	// all of them need somewhere to store their outputs, even the ones that aren't evaluated here
+	for (auto pure : depPures) { funcCompiler().getOrCreateNodeCompiler(*pure); }
+
+	// the ones that were already evaluated before this and still hold the same value are reused
+	depPures.erase(std::remove_if(depPures.begin(), depPures.end(),
+	                              [&](NodeInstance* pure) {
+		                              return funcCompiler().pureAvailable(node(), inputExecID,
+		                                                                  *pure);
+	                              }),
+	               depPures.end());
+
+	// each of the rest gets a block before the code block, in the order they depend on each other
+	auto& pureBlocks = mPureBlocks[inputExecID];
+	for (auto pure : depPures) {
+		auto name = "node_" + node().stringId() + "__" + std::to_string(inputExecID) + "__" +
+		            pure->stringId();
+
+		pureBlocks.emplace_back(pure, LLVMInsertBasicBlockInContext(context().llvmContext(),
+		                                                             codeBlock, name.c_str()));
+	}
+}
+
+Result NodeCompiler::compile_stage2(std::vector<LLVMBasicBlockRef> trailingBlocks,
+                                    size_t                         inputExecID) {
+	assert(!pure() && "Pure nodes are compiled into the nodes that use them");
+	assert(trailingBlocks.size() == node().outputExecConnections.size() &&
+	       "Trailing blocks is the wrong size");
+	assert(inputExecID < inputExecs());
 
-		// set our vector to be the same length
-		auto& pureBlocks = mPureBlocks[inputExecID];
-		pureBlocks.resize(depPures.size());
+	// skip if we've already compiled
+	if (compiled(inputExecID)) { return {}; }
 
-		// create the first pure block--the loop only creates the next one
-		if (!depPures.empty()) {
-			auto name = "node_" + node().stringId() + "__" + std::to_string(inputExecID) + "__" +
-			            depPures[0]->stringId();
+	// if we haven't done stage 1, then do it
+	if (mCodeBlocks[inputExecID] == nullptr) { compile_stage1(inputExecID); }
 
-			pureBlocks[0] = LLVMAppendBasicBlockInContext(
-			    context().llvmContext(), funcCompiler().llFunction(), name.c_str());
-		}
+	Result res;
 
-		for (auto id = 0ull; id < depPures.size(); ++id) {
-			// create a BasicBlock for the next one to br to--if we're on the last one, use the code
-			// block
-			LLVMBasicBlockRef nextBlock = [&] {
-				if (id == depPures.size() - 1) { return codeBlock; }
-				auto name = "node_" + node().stringId() + "__" + std::to_string(inputExecID) +
-				            "__" + depPures[id + 1]->stringId();
-				pureBlocks[id + 1] = LLVMAppendBasicBlockInContext(
-				    context().llvmContext(), funcCompiler().llFunction(), name.c_str());
-				return pureBlocks[id + 1];
-			}();
+	// evaluate the pures right before the node, each falling through to the next
+	PureValues  pureValues;
+	const auto& pureBlocks = mPureBlocks[inputExecID];
+	for (auto id = 0ull; id < pureBlocks.size(); ++id) {
+		auto nextBlock =
+		    id == pureBlocks.size() - 1 ? codeBlock(inputExecID) : pureBlocks[id + 1].second;
 
-			// add nextBlock to the list of possible locations for the indirectbr
-			LLVMAddDestination(funcCompiler().nodeCompiler(*depPures[id])->jumpBackInst(),
-			                   nextBlock);
+		auto pureCompiler = funcCompiler().nodeCompiler(*pureBlocks[id].first);
+		res += pureCompiler->compileInto(pureBlocks[id].second, nextBlock, node(), inputExecID,
+		                                 &pureValues);
+		if (!res) { return res; }
+	}
 
-			// set post-pure break to go to the next one
-			auto irBuilder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
-			LLVMPositionBuilder(*irBuilder, pureBlocks[id], nullptr);
-			LLVMBuildStore(*irBuilder, LLVMBlockAddress(funcCompiler().llFunction(), nextBlock),
-			               funcCompiler().postPureBreak());
+	res += codegenInto(codeBlock(inputExecID), inputExecID, trailingBlocks, node(), inputExecID,
+	                   pureValues, &mStoredValues[inputExecID]);
 
-			// br to the pure, terminating that BasicBlock
-			LLVMBuildBr(*irBuilder, funcCompiler().nodeCompiler(*depPures[id])->firstBlock(0));
+	for (const auto& pure : pureBlocks) {
+		auto& ends = funcCompiler().nodeCompiler(*pure.first)->mValueEnds;
+		for (auto block : trailingBlocks) {
+			if (std::find(ends.begin(), ends.end(), block) == ends.end()) { ends.push_back(block); }
 		}
 	}
+
+	mCompiledInputs[inputExecID] = true;
+
+	return res;
 }
 
-Result NodeCompiler::compile_stage2(std::vector<LLVMBasicBlockRef> trailingBlocks,
-                                    size_t                         inputExecID) {
-	assert((pure() || trailingBlocks.size() == node().outputExecConnections.size()) &&
-	       "Trailing blocks is the wrong size");
-	assert(inputExecID < inputExecs());
+Result NodeCompiler::compileInto(LLVMBasicBlockRef block, LLVMBasicBlockRef trailingBlock,
+                                 const NodeInstance& consumer, size_t consumerExecID,
+                                 PureValues* pureValues) {
+	assert(pure() && "Only pure nodes can be compiled into other nodes");
+	assert(pureValues != nullptr);
 
-	auto& codeBlock = mCodeBlocks[inputExecID];
+	std::vector<LLVMValueRef> stored;
+	auto res = codegenInto(block, 0, {trailingBlock}, consumer, consumerExecID, *pureValues, &stored);
 
-	// skip if we've already compiled
-	if (compiled(inputExecID)) { return {}; }
+	(*pureValues)[&node()] = std::move(stored);
 
-	// if we haven't done stage 1, then do it
-	if (codeBlock == nullptr) { compile_stage1(inputExecID); }
+	return res;
+}
+
+void NodeCompiler::removeUnusedStorage() {
+	for (auto idx = 0ull; idx < mReturnValues.size(); ++idx) {
+		auto alloca = mReturnValues[idx];
+
+		// it's only needed if something reads it
+		std::vector<LLVMValueRef> stores;
+		bool                      onlyStores = true;
+		for (auto use = LLVMGetFirstUse(alloca); use != nullptr; use = LLVMGetNextUse(use)) {
+			auto user = LLVMGetUser(use);
+			if (LLVMIsAStoreInst(user) == nullptr || LLVMGetOperand(user, 1) != alloca) {
+				onlyStores = false;
+				break;
+			}
+			stores.push_back(user);
+		}
+		if (!onlyStores) { continue; }
+
+		// keep the values visible in the debugger, but only until they're done with: otherwise
+		// every one of them is tracked through the rest of the function, which makes generating
+		// code for big functions really slow. Constants are left out, they're in the graph.
+		auto debugValues = std::any_of(stores.begin(), stores.end(), [](LLVMValueRef store) {
+			return !LLVMIsConstant(LLVMGetOperand(store, 0));
+		});
+		auto debugValue = [&](LLVMValueRef value, LLVMValueRef before) {
+			if (!debugValues) { return; }
+			LLVMDIBuilderInsertDbgValueBefore(
+			    funcCompiler().diBuilder(), value, mOutputDebugVariables[idx],
+			    LLVMDIBuilderCreateExpression(funcCompiler().diBuilder(), nullptr, 0),
+			    LLVMDIBuilderCreateDebugLocation(context().llvmContext(), 1, 1,
+			                                     funcCompiler().diFunction(), nullptr),
+			    before);
+		};
+		for (auto store : stores) {
+			debugValue(LLVMGetOperand(store, 0), store);
+			LLVMInstructionEraseFromParent(store);
+		}
+		for (auto block : mValueEnds) {
+			debugValue(LLVMGetUndef(LLVMGetAllocatedType(alloca)), LLVMGetFirstInstruction(block));
+		}
+
+		LLVMInstructionEraseFromParent(mOutputDeclares[idx]);
+		LLVMInstructionEraseFromParent(alloca);
+		mReturnValues[idx] = nullptr;
+	}
+}
+
+Result NodeCompiler::codegenInto(LLVMBasicBlockRef block, size_t inputExecID,
+                                 const std::vector<LLVMBasicBlockRef>& trailingBlocks,
+                                 const NodeInstance& consumer, size_t consumerExecID,
+                                 const PureValues&          pureValues,
+                                 std::vector<LLVMValueRef>* storedValues) {
 	auto codeBuilder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
-	LLVMPositionBuilder(*codeBuilder, codeBlock, nullptr);
+	LLVMPositionBuilder(*codeBuilder, block, nullptr);
 
 	// inputs and outputs (inputs followed by outputs)
 	std::vector<LLVMValueRef> io;
@@ -147,12 +268,36 @@ Result NodeCompiler::compile_stage2(std::vector<LLVMBasicBlockRef> trailingBlock
 		auto& remoteNode = *connection.first;
 		auto  remoteID   = connection.second;
 
-		assert(remoteID < funcCompiler().nodeCompiler(remoteNode)->returnValues().size() &&
+		// folded before anything was compiled
+		auto constant = funcCompiler().optimizations().constant(remoteNode, remoteID);
+		if (constant != nullptr) {
+			io.push_back(constant);
+			continue;
+		}
+
+		auto remoteCompiler = funcCompiler().nodeCompiler(remoteNode);
+
+		assert(remoteID < remoteCompiler->returnValues().size() &&
 		       "Internal error: connection to a value doesn't exist");
 
-		auto retVal = funcCompiler().nodeCompiler(remoteNode)->returnValues()[remoteID];
-		auto loaded      = LLVMBuildLoad2(*codeBuilder, node().type().dataInputs()[idx].type.llvmType(), retVal, "");
-		io.push_back(loaded);
+		// use the value directly if the code that made it always runs before this, and fall back
+		// to loading it if it doesn't: pures that were evaluated for the same node come right
+		// before, and non-pure nodes can run before every path to the node
+		LLVMValueRef value = nullptr;
+		auto         pureValue = pureValues.find(&remoteNode);
+		if (pureValue != pureValues.end()) {
+			value = pureValue->second[remoteID];
+		} else if (!remoteNode.type().pure() &&
+		           funcCompiler().alwaysRunsBefore(remoteNode, consumer, consumerExecID)) {
+			for (const auto& stored : remoteCompiler->mStoredValues) {
+				if (!stored.empty() && stored[remoteID] != nullptr) { value = stored[remoteID]; }
+			}
+		}
+		if (value == nullptr) {
+			value = LLVMBuildLoad2(*codeBuilder, node().type().dataInputs()[idx].type.llvmType(),
+			                       remoteCompiler->returnValues()[remoteID], "");
+		}
+		io.push_back(value);
 
 		assert(LLVMTypeOf(io[io.size() - 1]) == node().type().dataInputs()[idx].type.llvmType() &&
 		       "Internal error: types do not match");
@@ -161,34 +306,48 @@ Result NodeCompiler::compile_stage2(std::vector<LLVMBasicBlockRef> trailingBlock
 	// add outputs
 	std::copy(mReturnValues.begin(), mReturnValues.end(), std::back_inserter(io));
 
-	// on pure, jump to the set loc
-	if (pure()) {
-		auto brBlock =
-		    LLVMAppendBasicBlockInContext(context().llvmContext(), funcCompiler().llFunction(),
-		                                  ("node_" + node().stringId() + "_jumpback").c_str());
-		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(context().llvmContext()));
-		LLVMPositionBuilder(*builder, brBlock, nullptr);
-
-		auto postPureBreak = funcCompiler().postPureBreak();
-
-		
-		
-		mJumpBackInst    = LLVMBuildIndirectBr(*builder, LLVMBuildLoad2(*builder,  LLVMPointerType(LLVMInt8TypeInContext(context().llvmContext()), 0), postPureBreak, ""),
-		                                       10);  // 10 is just the default
-
-		trailingBlocks.resize(1);
-		trailingBlocks[0] = brBlock;
+	// codegen
+	auto res = node().type().codegen(
+	    *this, block, inputExecID,
+	    LLVMDIBuilderCreateDebugLocation(context().llvmContext(),
+	                                     funcCompiler().nodeLineNumber(node()), 1,
+	                                     funcCompiler().diFunction(), nullptr),
+	    io, trailingBlocks);
+
+	// find the values it stored to its outputs, which can be used directly by anything that runs
+	// after it. Only if all of its code is in the one block, so they can't be stored again later.
+	storedValues->assign(mReturnValues.size(), nullptr);
+
+	auto terminator = LLVMGetBasicBlockTerminator(block);
+	if (terminator == nullptr) { return res; }
+	for (auto successor = 0u; successor < LLVMGetNumSuccessors(terminator); ++successor) {
+		if (std::find(trailingBlocks.begin(), trailingBlocks.end(),
+		              LLVMGetSuccessor(terminator, successor)) == trailingBlocks.end()) {
+			return res;
+		}
 	}
 
-	// codegen
-	Result res =
-	    node().type().codegen(*this, codeBlock, inputExecID,
-	                          LLVMDIBuilderCreateDebugLocation(
-	                              context().llvmContext(), funcCompiler().nodeLineNumber(node()), 1,
-	                              funcCompiler().diFunction(), nullptr),
-	                          io, trailingBlocks);
+	for (auto outputID = 0ull; outputID < mReturnValues.size(); ++outputID) {
+		LLVMValueRef store    = nullptr;
+		auto         useCount = 0;
+		for (auto use = LLVMGetFirstUse(mReturnValues[outputID]); use != nullptr;
+		     use      = LLVMGetNextUse(use)) {
+			auto user = LLVMGetUser(use);
+			if (LLVMIsAInstruction(user) == nullptr || LLVMGetInstructionParent(user) != block) {
+				continue;
+			}
+
+			++useCount;
+			if (LLVMIsAStoreInst(user) != nullptr &&
+			    LLVMGetOperand(user, 1) == mReturnValues[outputID]) {
+				store = user;
+			}
+		}
 
-	mCompiledInputs[inputExecID] = true;
+		if (useCount == 1 && store != nullptr) {
+			(*storedValues)[outputID] = LLVMGetOperand(store, 0);
+		}
+	}
 
 	return res;
 }
@@ -197,7 +356,7 @@ LLVMBasicBlockRef NodeCompiler::firstBlock(size_t inputExecID) const {
 	assert(inputExecID < inputExecs());
 
 	if (mPureBlocks[inputExecID].empty()) { return codeBlock(inputExecID); }
-	return mPureBlocks[inputExecID][0];
+	return mPureBlocks[inputExecID][0].second;
 }
 
 LLVMBasicBlockRef NodeCompiler::codeBlock(size_t inputExecID) const {
@@ -224,19 +383,215 @@ size_t NodeCompiler::inputExecs() const {
 }
 
 std::vector<NodeInstance*> dependentPuresRecursive(const NodeInstance& inst) {
-	std::vector<NodeInstance*> ret;
+	std::vector<NodeInstance*>              ret;
+	std::unordered_set<const NodeInstance*> visited;
+	addDependentPures(inst, &visited, &ret);
 
-	// TODO: remove duplicates in some intellegent way
-	for (const auto& conn : inst.inputDataConnections) {
-		// if it isn't connected (this really shouldn't happen because that would fail validation),
-		// then skip.
-		if (conn.first == nullptr) { continue; }
+	return ret;
+}
+
+std::unordered_map<const NodeInstance*, std::vector<std::unordered_set<NodeInstance*>>>
+availablePures(const GraphFunction& func) {
+	std::unordered_map<const NodeInstance*, std::vector<std::unordered_set<NodeInstance*>>> ret;
+
+	auto entry = func.entryNode();
+	if (entry == nullptr) { return ret; }
+
+	std::vector<NodeInstance*>                     pures;
+	std::unordered_map<const NodeInstance*, size_t> pureIDs;
+	for (const auto& node : func.nodes()) {
+		if (node.second->type().pure()) {
+			pureIDs[node.second.get()] = pures.size();
+			pures.push_back(node.second.get());
+		}
+	}
+
+	// the pures that each non-pure node changes the value of when it runs: the ones that depend on
+	// its outputs, for _set_ nodes, the ones that depend on the local variable, and for all of
+	// them, the ones that read memory
+	std::unordered_map<const NodeInstance*, boost::dynamic_bitset<>> kills;
+	std::unordered_map<std::string, boost::dynamic_bitset<>>         localReaders;
+	boost::dynamic_bitset<>                                          memoryReaders(pures.size());
+	for (auto pure : pures) {
+		auto id = pureIDs[pure];
+
+		auto closure = dependentPuresRecursive(*pure);
+		closure.push_back(pure);
+		for (auto dependency : closure) {
+			if (dependency->type().readsMemory()) { memoryReaders.set(id); }
+
+			auto local = localVariableName(*dependency, "_get_");
+			if (!local.empty()) {
+				auto& readers = localReaders[local];
+				readers.resize(pures.size());
+				readers.set(id);
+			}
+
+			for (const auto& conn : dependency->inputDataConnections) {
+				if (conn.first == nullptr || conn.first->type().pure()) { continue; }
+
+				auto& killed = kills[conn.first];
+				killed.resize(pures.size());
+				killed.set(id);
+			}
+		}
+	}
+
+	struct Point {
+		boost::dynamic_bitset<> available;
+		bool                    visited = false;
+	};
+	std::unordered_map<const NodeInstance*, std::vector<Point>> points;
+
+	auto pointsFor = [&](NodeInstance* node) -> std::vector<Point>& {
+		auto iter = points.find(node);
+		if (iter != points.end()) { return iter->second; }
+
+		auto inputExecs = node == entry ? 1 : node->inputExecConnections.size();
+
+		// everything is available until a path that doesn't make it available is found
+		auto& nodePoints = points[node];
+		nodePoints.resize(inputExecs, Point{boost::dynamic_bitset<>(pures.size()).set()});
+
+		// nothing has run before the entry
+		if (node == entry) { nodePoints[0].available.reset(); }
+
+		return nodePoints;
+	};
+
+	std::unordered_map<const NodeInstance*, boost::dynamic_bitset<>> evaluatedByNode;
+	auto evaluated = [&](NodeInstance* node) -> const boost::dynamic_bitset<>& {
+		auto iter = evaluatedByNode.find(node);
+		if (iter != evaluatedByNode.end()) { return iter->second; }
+
+		auto& bits = evaluatedByNode[node];
+		bits.resize(pures.size());
+		for (auto pure : dependentPuresRecursive(*node)) { bits.set(pureIDs[pure]); }
+		return bits;
+	};
+
+	std::deque<std::pair<NodeInstance*, size_t>> worklist;
+	worklist.emplace_back(entry, 0);
+	pointsFor(entry)[0].visited = true;
+
+	while (!worklist.empty()) {
+		auto node        = worklist.front().first;
+		auto inputExecID = worklist.front().second;
+		worklist.pop_front();
+
+		// the pures this node evaluates, less the ones it changes by running
+		auto available = pointsFor(node)[inputExecID].available;
+		available |= evaluated(node);
+
+		auto local = localVariableName(*node, "_set_");
+		if (!local.empty() && localReaders.find(local) != localReaders.end()) {
+			available -= localReaders[local];
+		}
+		auto killed = kills.find(node);
+		if (killed != kills.end()) { available -= killed->second; }
+		if (node != entry) { available -= memoryReaders; }
+
+		for (const auto& conn : node->outputExecConnections) {
+			if (conn.first == nullptr) { continue; }
+
+			auto& point   = pointsFor(conn.first)[conn.second];
+			auto  meet    = point.available & available;
+			auto  changed = meet != point.available;
+
+			if (changed || !point.visited) {
+				point.available = std::move(meet);
+				point.visited   = true;
+				worklist.emplace_back(conn.first, conn.second);
+			}
+		}
+	}
+
+	for (const auto& nodePoints : points) {
+		auto& sets = ret[nodePoints.first];
+		sets.resize(nodePoints.second.size());
+
+		for (auto inputExecID = 0ull; inputExecID < sets.size(); ++inputExecID) {
+			const auto& point = nodePoints.second[inputExecID];
+			if (!point.visited) { continue; }
+
+			for (auto id = point.available.find_first(); id != point.available.npos;
+			     id      = point.available.find_next(id)) {
+				sets[inputExecID].insert(pures[id]);
+			}
+		}
+	}
+
+	return ret;
+}
+
+std::unordered_map<const NodeInstance*, std::vector<std::unordered_set<const NodeInstance*>>>
+nodesThatAlwaysRunBefore(const GraphFunction& func) {
+	std::unordered_map<const NodeInstance*, std::vector<std::unordered_set<const NodeInstance*>>>
+	    ret;
+
+	auto entry = func.entryNode();
+	if (entry == nullptr) { return ret; }
+
+	// find every input exec that can be reached, in breadth first order
+	std::vector<std::pair<NodeInstance*, size_t>>                 points;
+	std::map<std::pair<const NodeInstance*, size_t>, size_t>      pointIDs;
+	std::vector<std::vector<size_t>>                              predecessors;
+	std::unordered_map<const NodeInstance*, size_t>               pointsPerNode;
+	points.emplace_back(entry, 0);
+	pointIDs[{entry, 0}] = 0;
+	predecessors.emplace_back();
+	++pointsPerNode[entry];
+	for (auto id = 0ull; id < points.size(); ++id) {
+		for (const auto& conn : points[id].first->outputExecConnections) {
+			if (conn.first == nullptr) { continue; }
+
+			auto inserted = pointIDs.emplace(std::make_pair(conn.first, conn.second), points.size());
+			if (inserted.second) {
+				points.emplace_back(conn.first, conn.second);
+				predecessors.emplace_back();
+				++pointsPerNode[conn.first];
+			}
+			predecessors[inserted.first->second].push_back(id);
+		}
+	}
+
+	// the classic iterative dominator algorithm, on input execs instead of blocks
+	std::vector<boost::dynamic_bitset<>> dominators(points.size(),
+	                                                boost::dynamic_bitset<>(points.size()).set());
+	dominators[0].reset();
+	dominators[0].set(0);
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (auto id = 1ull; id < points.size(); ++id) {
+			boost::dynamic_bitset<> dominating(points.size());
+			dominating.set();
+			for (auto predecessor : predecessors[id]) { dominating &= dominators[predecessor]; }
+			dominating.set(id);
+
+			if (dominating != dominators[id]) {
+				dominators[id] = std::move(dominating);
+				changed        = true;
+			}
+		}
+	}
+
+	for (auto id = 0ull; id < points.size(); ++id) {
+		auto node        = points[id].first;
+		auto inputExecID = points[id].second;
+
+		auto& sets = ret[node];
+		if (sets.size() <= inputExecID) { sets.resize(inputExecID + 1); }
 
-		if (conn.first->type().pure()) {
-			auto deps = dependentPuresRecursive(*conn.first);
-			std::copy(deps.begin(), deps.end(), std::back_inserter(ret));
+		for (auto dominator = dominators[id].find_first(); dominator != dominators[id].npos;
+		     dominator      = dominators[id].find_next(dominator)) {
+			auto dominatingNode = points[dominator].first;
 
-			ret.push_back(conn.first);
+			// it has to be the only way to run that node, or it could have run some other way since
+			if (dominatingNode != node && pointsPerNode[dominatingNode] == 1) {
+				sets[inputExecID].insert(dominatingNode);
+			}
 		}
 	}
 
@@ -17,6 +17,11 @@ NodeType::~NodeType() = default;
 
 std::string NodeType::qualifiedName() const { return module().fullName() + ":" + name(); }
 
+std::vector<bool> NodeType::reachableExecOutputs(
+    const std::vector<LLVMValueRef>& /*inputs*/) const {
+	return std::vector<bool>(execOutputs().size(), true);
+}
+
 void NodeType::setDataInputs(
     std::vector<chi::NamedDataType, std::allocator<chi::NamedDataType> > newInputs) {
 	mDataInputs = std::move(newInputs);
@@ -50,6 +55,12 @@ void NodeType::makeConverter() {
 	mConverter = true;
 }
 
+void NodeType::makeReadsMemory() {
+	assert(pure() && "Only pure nodes have to say they read memory");
+
+	mReadsMemory = true;
+}
+
 NodeInstance* NodeType::nodeInstance() const { return mNodeInstance; }
 
 void NodeType::setName(std::string newName) { mName = std::move(newName); }
@@ -0,0 +1,667 @@
+/// \file Profile.cpp
+
+#include "chi/Profile.hpp"
+
+#include <llvm-c/Core.h>
+#include <llvm-c/DebugInfo.h>
+#include <llvm-c/Target.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <unordered_set>
+
+#include "chi/Context.hpp"
+#include "chi/GraphFunction.hpp"
+#include "chi/GraphModule.hpp"
+#include "chi/NameMangler.hpp"
+#include "chi/NativeCodegen.hpp"
+#include "chi/NodeInstance.hpp"
+#include "chi/Owned.hpp"
+#include "chi/Support/ContentHash.hpp"
+#include "chi/Support/Result.hpp"
+
+namespace fs = std::filesystem;
+
+namespace chi {
+
+namespace {
+
+constexpr const char* rawProfileMagic = "CHIPROFRAW1\n";
+
+constexpr const char* countersName = "__chi_profile_counters";
+constexpr const char* writerName   = "__chi_profile_write";
+
+// the functions that are instrumented and profiles are applied to
+bool isProfiled(LLVMValueRef func) {
+	return !LLVMIsDeclaration(func) &&
+	       LLVMGetLinkage(func) != LLVMAvailableExternallyLinkage && valueName(func) != writerName;
+}
+
+// the branches that get a counter for each successor
+bool isCountedBranch(LLVMValueRef terminator) {
+	auto opcode = LLVMGetInstructionOpcode(terminator);
+	return (opcode == LLVMBr && LLVMIsConditional(terminator)) || opcode == LLVMSwitch;
+}
+
+// what the counters of a function count, which is the same for the module that's instrumented and
+// the one the profile is applied to
+struct FunctionLayout {
+	std::vector<LLVMBasicBlockRef> blocks;
+
+	/// The branches that are counted and the index of their first successor's counter
+	std::vector<std::pair<LLVMValueRef, size_t>> branches;
+
+	size_t counterCount = 0;
+
+	std::string cfgHash;
+};
+
+FunctionLayout layoutFunction(LLVMValueRef func) {
+	FunctionLayout layout;
+
+	std::unordered_map<LLVMBasicBlockRef, size_t> blockIndices;
+	for (auto block = LLVMGetFirstBasicBlock(func); block != nullptr;
+	     block      = LLVMGetNextBasicBlock(block)) {
+		blockIndices.emplace(block, layout.blocks.size());
+		layout.blocks.push_back(block);
+	}
+	layout.counterCount = layout.blocks.size();
+
+	ContentHasher hasher;
+	hasher.add(std::to_string(layout.blocks.size()));
+	for (auto block : layout.blocks) {
+		auto terminator = LLVMGetBasicBlockTerminator(block);
+		if (terminator == nullptr) { continue; }
+
+		hasher.add(std::to_string(LLVMGetInstructionOpcode(terminator)));
+		for (auto idx = 0u; idx < LLVMGetNumSuccessors(terminator); ++idx) {
+			hasher.add(std::to_string(blockIndices[LLVMGetSuccessor(terminator, idx)]));
+		}
+
+		if (isCountedBranch(terminator)) {
+			layout.branches.emplace_back(terminator, layout.counterCount);
+			layout.counterCount += LLVMGetNumSuccessors(terminator);
+		}
+	}
+	layout.cfgHash = hasher.hexDigest();
+
+	return layout;
+}
+
+std::vector<unsigned> blockLines(LLVMBasicBlockRef block) {
+	std::vector<unsigned> lines;
+	for (auto inst = LLVMGetFirstInstruction(block); inst != nullptr;
+	     inst      = LLVMGetNextInstruction(inst)) {
+		auto line = LLVMGetDebugLocLine(inst);
+		if (line != 0) { lines.push_back(line); }
+	}
+	std::sort(lines.begin(), lines.end());
+	lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+	return lines;
+}
+
+// get a C library function, casting it if the module already declares it with another type
+LLVMValueRef libcFunction(LLVMModuleRef module, const char* name, LLVMTypeRef type) {
+	auto func = LLVMGetNamedFunction(module, name);
+	if (func == nullptr) { return LLVMAddFunction(module, name, type); }
+
+	if (LLVMGlobalGetValueType(func) == type) { return func; }
+	return LLVMConstBitCast(func, LLVMPointerType(type, 0));
+}
+
+LLVMValueRef constantString(LLVMModuleRef module, const std::string& str, const char* name) {
+	auto ctx  = LLVMGetModuleContext(module);
+	auto init = LLVMConstStringInContext(ctx, str.data(), str.size(), false);
+
+	auto global = LLVMAddGlobal(module, LLVMTypeOf(init), name);
+	LLVMSetInitializer(global, init);
+	LLVMSetGlobalConstant(global, true);
+	LLVMSetLinkage(global, LLVMPrivateLinkage);
+
+	return LLVMConstPointerCast(global, LLVMPointerType(LLVMInt8TypeInContext(ctx), 0));
+}
+
+// increment counters[index] at the builder
+void buildIncrement(LLVMBuilderRef builder, LLVMValueRef counters, LLVMValueRef index) {
+	auto i64 = LLVMInt64TypeInContext(LLVMGetTypeContext(LLVMTypeOf(index)));
+
+	LLVMValueRef indices[] = {LLVMConstInt(i64, 0, false), index};
+	auto         counter =
+	    LLVMBuildInBoundsGEP2(builder, LLVMGlobalGetValueType(counters), counters, indices, 2, "");
+	auto count = LLVMBuildLoad2(builder, i64, counter, "");
+	LLVMBuildStore(builder, LLVMBuildAdd(builder, count, LLVMConstInt(i64, 1, false), ""),
+	               counter);
+}
+
+// define the function that writes the raw profile: the magic, the layout, then the counters
+LLVMValueRef buildWriter(LLVMModuleRef module, LLVMValueRef counters, size_t counterCount,
+                         const std::string& header, const std::string& rawProfilePath) {
+	auto ctx     = LLVMGetModuleContext(module);
+	auto i8Ptr   = LLVMPointerType(LLVMInt8TypeInContext(ctx), 0);
+	auto sizeTy  = LLVMIntPtrTypeInContext(ctx, LLVMGetModuleDataLayout(module));
+	auto voidTy  = LLVMVoidTypeInContext(ctx);
+	auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(ctx));
+
+	LLVMTypeRef fopenArgs[]  = {i8Ptr, i8Ptr};
+	LLVMTypeRef fwriteArgs[] = {i8Ptr, sizeTy, sizeTy, i8Ptr};
+	auto        fopenTy      = LLVMFunctionType(i8Ptr, fopenArgs, 2, false);
+	auto        fwriteTy     = LLVMFunctionType(sizeTy, fwriteArgs, 4, false);
+	auto        fcloseTy     = LLVMFunctionType(LLVMInt32TypeInContext(ctx), &i8Ptr, 1, false);
+
+	auto writer = LLVMAddFunction(module, writerName, LLVMFunctionType(voidTy, nullptr, 0, false));
+	LLVMSetLinkage(writer, LLVMInternalLinkage);
+
+	auto entry = LLVMAppendBasicBlockInContext(ctx, writer, "entry");
+	auto write = LLVMAppendBasicBlockInContext(ctx, writer, "write");
+	auto exit  = LLVMAppendBasicBlockInContext(ctx, writer, "exit");
+
+	LLVMPositionBuilderAtEnd(*builder, entry);
+	LLVMValueRef openArgs[] = {constantString(module, rawProfilePath + '\0', "__chi_profile_path"),
+	                           constantString(module, std::string("wb") + '\0', "")};
+	auto file = LLVMBuildCall2(*builder, fopenTy, libcFunction(module, "fopen", fopenTy), openArgs,
+	                           2, "");
+	LLVMBuildCondBr(*builder, LLVMBuildIsNull(*builder, file, ""), exit, write);
+
+	LLVMPositionBuilderAtEnd(*builder, write);
+	auto         fwrite       = libcFunction(module, "fwrite", fwriteTy);
+	LLVMValueRef headerArgs[] = {constantString(module, header, "__chi_profile_layout"),
+	                             LLVMConstInt(sizeTy, 1, false),
+	                             LLVMConstInt(sizeTy, header.size(), false), file};
+	LLVMBuildCall2(*builder, fwriteTy, fwrite, headerArgs, 4, "");
+	LLVMValueRef counterArgs[] = {LLVMConstPointerCast(counters, i8Ptr),
+	                              LLVMConstInt(sizeTy, sizeof(uint64_t), false),
+	                              LLVMConstInt(sizeTy, counterCount, false), file};
+	LLVMBuildCall2(*builder, fwriteTy, fwrite, counterArgs, 4, "");
+	LLVMBuildCall2(*builder, fcloseTy, libcFunction(module, "fclose", fcloseTy), &file, 1, "");
+	LLVMBuildBr(*builder, exit);
+
+	LLVMPositionBuilderAtEnd(*builder, exit);
+	LLVMBuildRetVoid(*builder);
+
+	return writer;
+}
+
+// add a function to llvm.global_dtors, so it's run when the program exits
+void addDestructor(LLVMModuleRef module, LLVMValueRef func) {
+	auto ctx   = LLVMGetModuleContext(module);
+	auto i8Ptr = LLVMPointerType(LLVMInt8TypeInContext(ctx), 0);
+
+	std::vector<LLVMValueRef> entries;
+	LLVMTypeRef               entryType;
+
+	auto existing = LLVMGetNamedGlobal(module, "llvm.global_dtors");
+	if (existing != nullptr) {
+		auto init = LLVMGetInitializer(existing);
+		entryType = LLVMGetElementType(LLVMTypeOf(init));
+		for (auto idx = 0; idx < LLVMGetNumOperands(init); ++idx) {
+			entries.push_back(LLVMGetOperand(init, idx));
+		}
+		LLVMDeleteGlobal(existing);
+	} else {
+		LLVMTypeRef fields[] = {LLVMInt32TypeInContext(ctx), LLVMTypeOf(func), i8Ptr};
+		entryType            = LLVMStructTypeInContext(ctx, fields, 3, false);
+	}
+
+	LLVMValueRef fields[] = {LLVMConstInt(LLVMInt32TypeInContext(ctx), 65535, false), func,
+	                         LLVMConstNull(i8Ptr)};
+	entries.push_back(LLVMConstNamedStruct(entryType, fields, 3));
+
+	auto init   = LLVMConstArray(entryType, entries.data(), entries.size());
+	auto dtors  = LLVMAddGlobal(module, LLVMTypeOf(init), "llvm.global_dtors");
+	LLVMSetInitializer(dtors, init);
+	LLVMSetLinkage(dtors, LLVMAppendingLinkage);
+}
+
+nlohmann::json functionJson(const FunctionProfile& func) {
+	return {{"name", func.name}, {"hash", func.cfgHash}, {"blockLines", func.blockLines}};
+}
+
+LLVMMetadataRef metadataPair(LLVMContextRef ctx, const char* key, LLVMValueRef value) {
+	LLVMMetadataRef operands[] = {LLVMMDStringInContext2(ctx, key, std::strlen(key)),
+	                              LLVMValueAsMetadata(value)};
+	return LLVMMDNodeInContext2(ctx, operands, 2);
+}
+
+// the profile summary the optimizer reads to tell hot code from cold, like llvm-profdata writes
+LLVMMetadataRef buildProfileSummary(LLVMContextRef ctx, std::vector<uint64_t> blockCounts,
+                                    uint64_t maxFunctionCount, uint64_t maxInternalCount,
+                                    size_t functionCount) {
+	auto i32 = LLVMInt32TypeInContext(ctx);
+	auto i64 = LLVMInt64TypeInContext(ctx);
+
+	std::sort(blockCounts.begin(), blockCounts.end(), std::greater<>{});
+
+	uint64_t total = 0;
+	for (auto count : blockCounts) { total += count; }
+
+	constexpr uint32_t scale     = 1000000;
+	const uint32_t     cutoffs[] = {10000,  100000, 200000, 300000, 400000, 500000,
+                                600000, 700000, 800000, 900000, 950000, 990000,
+                                999000, 999900, 999990, 999999};
+
+	std::vector<LLVMMetadataRef> detailed;
+	uint64_t                     sum  = 0;
+	size_t                       seen = 0;
+	for (auto cutoff : cutoffs) {
+		auto desired = static_cast<uint64_t>(static_cast<long double>(total) * cutoff / scale);
+		while (sum < desired && seen < blockCounts.size()) { sum += blockCounts[seen++]; }
+
+		LLVMMetadataRef entry[] = {
+		    LLVMValueAsMetadata(LLVMConstInt(i32, cutoff, false)),
+		    LLVMValueAsMetadata(LLVMConstInt(i64, seen == 0 ? 0 : blockCounts[seen - 1], false)),
+		    LLVMValueAsMetadata(LLVMConstInt(i32, seen, false))};
+		detailed.push_back(LLVMMDNodeInContext2(ctx, entry, 3));
+	}
+
+	auto maxCount = blockCounts.empty() ? 0 : blockCounts.front();
+
+	LLVMMetadataRef detailedPair[] = {
+	    LLVMMDStringInContext2(ctx, "DetailedSummary", 15),
+	    LLVMMDNodeInContext2(ctx, detailed.data(), detailed.size())};
+
+	LLVMMetadataRef formatPair[] = {LLVMMDStringInContext2(ctx, "ProfileFormat", 13),
+	                                LLVMMDStringInContext2(ctx, "InstrProf", 9)};
+
+	LLVMMetadataRef summary[] = {
+	    LLVMMDNodeInContext2(ctx, formatPair, 2),
+	    metadataPair(ctx, "TotalCount", LLVMConstInt(i64, total, false)),
+	    metadataPair(ctx, "MaxCount", LLVMConstInt(i64, maxCount, false)),
+	    metadataPair(ctx, "MaxInternalCount", LLVMConstInt(i64, maxInternalCount, false)),
+	    metadataPair(ctx, "MaxFunctionCount", LLVMConstInt(i64, maxFunctionCount, false)),
+	    metadataPair(ctx, "NumCounts", LLVMConstInt(i64, blockCounts.size(), false)),
+	    metadataPair(ctx, "NumFunctions", LLVMConstInt(i64, functionCount, false)),
+	    LLVMMDNodeInContext2(ctx, detailedPair, 2)};
+
+	return LLVMMDNodeInContext2(ctx, summary, std::size(summary));
+}
+
+}  // anonymous namespace
+
+void instrumentProfiling(LLVMModuleRef module, const std::string& rawProfilePath) {
+	auto ctx = LLVMGetModuleContext(module);
+	auto i64 = LLVMInt64TypeInContext(ctx);
+
+	std::vector<std::pair<LLVMValueRef, FunctionLayout>> functions;
+	nlohmann::json                                       layoutJson = nlohmann::json::array();
+	size_t                                               counterCount = 0;
+	for (auto func = LLVMGetFirstFunction(module); func != nullptr;
+	     func      = LLVMGetNextFunction(func)) {
+		if (!isProfiled(func)) { continue; }
+
+		auto layout = layoutFunction(func);
+
+		FunctionProfile funcProfile;
+		funcProfile.name    = valueName(func);
+		funcProfile.cfgHash = layout.cfgHash;
+		for (auto block : layout.blocks) { funcProfile.blockLines.push_back(blockLines(block)); }
+
+		auto funcJson        = functionJson(funcProfile);
+		funcJson["counters"] = layout.counterCount;
+		layoutJson.push_back(std::move(funcJson));
+
+		counterCount += layout.counterCount;
+		functions.emplace_back(func, std::move(layout));
+	}
+	if (counterCount == 0) { return; }
+
+	auto countersType = LLVMArrayType(i64, counterCount);
+	auto counters     = LLVMAddGlobal(module, countersType, countersName);
+	LLVMSetInitializer(counters, LLVMConstNull(countersType));
+	LLVMSetLinkage(counters, LLVMInternalLinkage);
+
+	auto   builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(ctx));
+	size_t base    = 0;
+	for (const auto& [func, layout] : functions) {
+		for (auto blockIdx = 0ull; blockIdx < layout.blocks.size(); ++blockIdx) {
+			// after the phis, which have to be first
+			auto insertPoint = LLVMGetFirstInstruction(layout.blocks[blockIdx]);
+			while (insertPoint != nullptr && LLVMGetInstructionOpcode(insertPoint) == LLVMPHI) {
+				insertPoint = LLVMGetNextInstruction(insertPoint);
+			}
+			if (insertPoint == nullptr) { continue; }
+
+			LLVMPositionBuilderBefore(*builder, insertPoint);
+			buildIncrement(*builder, counters, LLVMConstInt(i64, base + blockIdx, false));
+		}
+
+		// count the successor taken, at the branch
+		for (const auto& [branch, firstCounter] : layout.branches) {
+			LLVMPositionBuilderBefore(*builder, branch);
+
+			// the condition is the first operand of both
+			auto first = LLVMConstInt(i64, base + firstCounter, false);
+			auto cond  = LLVMGetOperand(branch, 0);
+
+			LLVMValueRef index;
+			if (LLVMGetInstructionOpcode(branch) == LLVMBr) {
+				index = LLVMBuildSelect(*builder, cond, first,
+				                        LLVMConstInt(i64, base + firstCounter + 1, false), "");
+			} else {
+				// the default destination is successor 0, then the cases follow as operand pairs
+				index = first;
+				for (auto succ = 1u; succ < LLVMGetNumSuccessors(branch); ++succ) {
+					auto caseValue = LLVMGetOperand(branch, 2 * succ);
+					auto matches   = LLVMBuildICmp(*builder, LLVMIntEQ, cond, caseValue, "");
+					index          = LLVMBuildSelect(
+                        *builder, matches, LLVMConstInt(i64, base + firstCounter + succ, false),
+                        index, "");
+				}
+			}
+			buildIncrement(*builder, counters, index);
+		}
+
+		base += layout.counterCount;
+	}
+
+	auto header = std::string(rawProfileMagic) + nlohmann::json{{"functions", layoutJson}}.dump() +
+	              '\n';
+	addDestructor(module, buildWriter(module, counters, counterCount, header, rawProfilePath));
+}
+
+Result readProfile(const fs::path& path, Profile* toFill) {
+	assert(toFill != nullptr);
+
+	Result res;
+
+	auto notProfile = [&](const char* why) {
+		res.addEntry("E55", "File isn't a chigraph profile", {{"Path", path.string()}, {"Why", why}});
+		return res;
+	};
+
+	std::ifstream stream{path, std::ios::binary};
+	if (!stream) { return notProfile("it couldn't be opened"); }
+	std::string contents{std::istreambuf_iterator<char>(stream), {}};
+
+	// merged profiles are JSON
+	auto magicLength = std::strlen(rawProfileMagic);
+	if (contents.compare(0, magicLength, rawProfileMagic) != 0) {
+		auto data = nlohmann::json::parse(contents, nullptr, false);
+		if (data.is_discarded()) { return notProfile("it's neither a raw profile nor JSON"); }
+
+		auto profileCtx = res.addScopedContext({{"Path", path.string()}});
+		res += jsonToProfile(data, toFill);
+		return res;
+	}
+
+	auto layoutEnd = contents.find('\n', magicLength);
+	if (layoutEnd == std::string::npos) { return notProfile("the raw profile has no layout"); }
+
+	nlohmann::json layout;
+	try {
+		layout = nlohmann::json::parse(contents.begin() + magicLength,
+		                               contents.begin() + layoutEnd);
+	} catch (std::exception& e) { return notProfile(e.what()); }
+
+	if (!layout.is_object() || !layout.contains("functions") || !layout["functions"].is_array()) {
+		return notProfile("the layout has no functions");
+	}
+
+	Profile profile;
+	size_t  counterCount = 0;
+	for (auto funcJson : layout["functions"]) {
+		if (!funcJson.is_object() || !funcJson.contains("counters") ||
+		    !funcJson["counters"].is_number_unsigned()) {
+			return notProfile("a function in the layout has no counters");
+		}
+		size_t counters = funcJson["counters"];
+		funcJson["counts"] = std::vector<uint64_t>(counters, 0);
+
+		Profile funcProfile;
+		res += jsonToProfile({{"functions", nlohmann::json::array({funcJson})}}, &funcProfile);
+		if (!res) { return res; }
+
+		profile.functions.push_back(std::move(funcProfile.functions[0]));
+		counterCount += counters;
+	}
+
+	auto countsStart = layoutEnd + 1;
+	if (contents.size() - countsStart != counterCount * sizeof(uint64_t)) {
+		return notProfile("it doesn't have as many counts as its layout says");
+	}
+
+	for (auto& func : profile.functions) {
+		std::memcpy(func.counts.data(), contents.data() + countsStart,
+		            func.counts.size() * sizeof(uint64_t));
+		countsStart += func.counts.size() * sizeof(uint64_t);
+	}
+
+	*toFill = std::move(profile);
+
+	return res;
+}
+
+Result mergeProfiles(const Profile& from, Profile* into) {
+	assert(into != nullptr);
+
+	Result res;
+
+	std::unordered_map<std::string, FunctionProfile*> intoByName;
+	for (auto& func : into->functions) { intoByName.emplace(func.name, &func); }
+
+	for (const auto& func : from.functions) {
+		auto iter = intoByName.find(func.name);
+		if (iter == intoByName.end()) {
+			into->functions.push_back(func);
+			continue;
+		}
+
+		auto& existing = *iter->second;
+		if (existing.cfgHash != func.cfgHash || existing.counts.size() != func.counts.size()) {
+			res.addEntry("E56", "Function was profiled in two different versions",
+			             {{"Function", func.name}});
+			continue;
+		}
+
+		for (auto idx = 0ull; idx < func.counts.size(); ++idx) {
+			existing.counts[idx] += func.counts[idx];
+		}
+	}
+
+	return res;
+}
+
+nlohmann::json profileToJson(const Profile& profile) {
+	auto functions = nlohmann::json::array();
+	for (const auto& func : profile.functions) {
+		auto funcJson      = functionJson(func);
+		funcJson["counts"] = func.counts;
+		functions.push_back(std::move(funcJson));
+	}
+
+	return {{"functions", std::move(functions)}};
+}
+
+Result jsonToProfile(const nlohmann::json& data, Profile* toFill) {
+	assert(toFill != nullptr);
+
+	Result res;
+
+	auto malformed = [&] {
+		res.addEntry("E55", "Profile JSON is malformed", {{"Profile", data}});
+		return res;
+	};
+
+	using json = nlohmann::json;
+	auto has   = [](const json& obj, const char* key, bool (json::*isType)() const noexcept) {
+		return obj.is_object() && obj.contains(key) && (obj[key].*isType)();
+	};
+	auto isUnsignedArray = [](const json& arr) {
+		return std::all_of(arr.begin(), arr.end(),
+		                   [](const json& elem) { return elem.is_number_unsigned(); });
+	};
+
+	if (!has(data, "functions", &json::is_array)) { return malformed(); }
+
+	Profile profile;
+	for (const auto& funcJson : data["functions"]) {
+		if (!has(funcJson, "name", &json::is_string) || !has(funcJson, "hash", &json::is_string) ||
+		    !has(funcJson, "counts", &json::is_array) ||
+		    !has(funcJson, "blockLines", &json::is_array) || !isUnsignedArray(funcJson["counts"])) {
+			return malformed();
+		}
+
+		FunctionProfile func;
+		func.name    = funcJson["name"];
+		func.cfgHash = funcJson["hash"];
+		func.counts  = funcJson["counts"].get<std::vector<uint64_t>>();
+		for (const auto& lines : funcJson["blockLines"]) {
+			if (!lines.is_array() || !isUnsignedArray(lines)) { return malformed(); }
+			func.blockLines.push_back(lines.get<std::vector<unsigned>>());
+		}
+
+		// there's a count for each block, then for each branch successor
+		if (func.counts.size() < func.blockLines.size()) { return malformed(); }
+
+		profile.functions.push_back(std::move(func));
+	}
+
+	*toFill = std::move(profile);
+
+	return res;
+}
+
+Result applyProfile(LLVMModuleRef module, const Profile& profile) {
+	Result res;
+
+	auto ctx      = LLVMGetModuleContext(module);
+	auto i32      = LLVMInt32TypeInContext(ctx);
+	auto i64      = LLVMInt64TypeInContext(ctx);
+	auto profKind = LLVMGetMDKindIDInContext(ctx, "prof", 4);
+
+	std::unordered_map<std::string, const FunctionProfile*> profileByName;
+	for (const auto& func : profile.functions) { profileByName.emplace(func.name, &func); }
+
+	std::vector<uint64_t> blockCounts;
+	uint64_t              maxFunctionCount = 0, maxInternalCount = 0;
+	size_t                functionCount    = 0;
+	for (auto func = LLVMGetFirstFunction(module); func != nullptr;
+	     func      = LLVMGetNextFunction(func)) {
+		if (!isProfiled(func)) { continue; }
+
+		auto iter = profileByName.find(valueName(func));
+		if (iter == profileByName.end()) { continue; }
+		const auto& counts = iter->second->counts;
+
+		auto layout = layoutFunction(func);
+		if (layout.cfgHash != iter->second->cfgHash || layout.counterCount != counts.size()) {
+			res.addEntry("WUKN", "Function changed since it was profiled, not using its profile",
+			             {{"Function", valueName(func)}});
+			continue;
+		}
+
+		++functionCount;
+		maxFunctionCount = std::max(maxFunctionCount, counts[0]);
+		for (auto idx = 0ull; idx < layout.blocks.size(); ++idx) {
+			blockCounts.push_back(counts[idx]);
+			if (idx != 0) { maxInternalCount = std::max(maxInternalCount, counts[idx]); }
+		}
+
+		LLVMGlobalSetMetadata(
+		    func, profKind,
+		    metadataPair(ctx, "function_entry_count", LLVMConstInt(i64, counts[0], false)));
+
+		for (const auto& [branch, firstCounter] : layout.branches) {
+			auto successors = LLVMGetNumSuccessors(branch);
+			auto begin      = counts.begin() + firstCounter;
+			auto maxCount   = *std::max_element(begin, begin + successors);
+			if (maxCount == 0) { continue; }
+
+			// the weights are 32 bit, so scale them down together if they don't fit
+			auto divisor = maxCount / std::numeric_limits<uint32_t>::max() + 1;
+
+			std::vector<LLVMMetadataRef> weights{
+			    LLVMMDStringInContext2(ctx, "branch_weights", 14)};
+			for (auto succ = 0u; succ < successors; ++succ) {
+				weights.push_back(LLVMValueAsMetadata(
+				    LLVMConstInt(i32, counts[firstCounter + succ] / divisor, false)));
+			}
+			LLVMSetMetadata(branch, profKind,
+			                LLVMMetadataAsValue(
+			                    ctx, LLVMMDNodeInContext2(ctx, weights.data(), weights.size())));
+		}
+	}
+
+	if (functionCount != 0 && LLVMGetModuleFlag(module, "ProfileSummary", 14) == nullptr) {
+		LLVMAddModuleFlag(module, LLVMModuleFlagBehaviorError, "ProfileSummary", 14,
+		                  buildProfileSummary(ctx, std::move(blockCounts), maxFunctionCount,
+		                                      maxInternalCount, functionCount));
+	}
+
+	return res;
+}
+
+void attributeProfileToNodes(Context& context, const Profile& profile,
+                             std::unordered_map<GraphFunction*, std::vector<NodeCount>>* toFill) {
+	assert(toFill != nullptr);
+
+	// find the graph functions and line numbers of everything that's loaded
+	std::unordered_map<std::string, GraphModule*>                           moduleByFunction;
+	std::unordered_map<GraphModule*, std::unordered_map<unsigned, NodeInstance*>> nodeByLine;
+	for (auto mod : context.modules()) {
+		auto graphMod = dynamic_cast<GraphModule*>(mod);
+		if (graphMod == nullptr) { continue; }
+
+		for (const auto& func : graphMod->functions()) {
+			moduleByFunction.emplace(mangleFunctionName(graphMod->fullName(), func->name()),
+			                         graphMod);
+		}
+		nodeByLine.emplace(graphMod, graphMod->createLineNumberAssoc().second);
+	}
+
+	// functions with specialized clones are just dispatchers to them, so only the clones count
+	std::unordered_set<std::string> cloned;
+	for (const auto& func : profile.functions) {
+		auto dot = func.name.rfind(".exec");
+		if (dot != std::string::npos) { cloned.insert(func.name.substr(0, dot)); }
+	}
+
+	std::unordered_map<GraphFunction*, std::map<NodeInstance*, uint64_t>> counts;
+	for (const auto& func : profile.functions) {
+		// specialized clones count for the function they're a clone of
+		auto name = func.name;
+		auto dot  = name.rfind(".exec");
+		if (dot != std::string::npos) {
+			name.erase(dot);
+		} else if (cloned.count(name) != 0) {
+			continue;
+		}
+
+		auto modIter = moduleByFunction.find(name);
+		if (modIter == moduleByFunction.end()) { continue; }
+		const auto& lines = nodeByLine[modIter->second];
+
+		std::unordered_map<NodeInstance*, uint64_t> funcCounts;
+		for (auto blockIdx = 0ull; blockIdx < func.blockLines.size(); ++blockIdx) {
+			for (auto line : func.blockLines[blockIdx]) {
+				auto nodeIter = lines.find(line);
+				if (nodeIter == lines.end()) { continue; }
+
+				auto& count = funcCounts[nodeIter->second];
+				count       = std::max(count, func.counts[blockIdx]);
+			}
+		}
+
+		// nodes inlined from other functions count for the function they're in
+		for (const auto& [node, count] : funcCounts) {
+			if (count != 0) { counts[&node->function()][node] += count; }
+		}
+	}
+
+	toFill->clear();
+	for (const auto& [func, nodeCounts] : counts) {
+		auto& sorted = (*toFill)[func];
+		for (const auto& [node, count] : nodeCounts) { sorted.push_back({node, count}); }
+
+		std::sort(sorted.begin(), sorted.end(), [](const NodeCount& lhs, const NodeCount& rhs) {
+			if (lhs.count != rhs.count) { return lhs.count > rhs.count; }
+			return lhs.node->stringId() < rhs.node->stringId();
+		});
+	}
+}
+
+}  // namespace chi
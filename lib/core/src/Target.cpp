@@ -0,0 +1,102 @@
+/// \file Target.cpp
+
+#include "chi/Target.hpp"
+
+#include <llvm-c/Core.h>
+#include <llvm-c/Target.h>
+
+#include <cassert>
+#include <cstring>
+
+#include "chi/Support/Result.hpp"
+
+namespace chi {
+
+namespace {
+
+// give a function a string attribute, or take it away if it's empty
+void setFunctionAttribute(LLVMValueRef func, const char* key, const std::string& value) {
+	auto keyLen = static_cast<unsigned>(strlen(key));
+	if (value.empty()) {
+		LLVMRemoveStringAttributeAtIndex(func, LLVMAttributeFunctionIndex, key, keyLen);
+		return;
+	}
+
+	auto ctx = LLVMGetModuleContext(LLVMGetGlobalParent(func));
+	LLVMAddAttributeAtIndex(
+	    func, LLVMAttributeFunctionIndex,
+	    LLVMCreateStringAttribute(ctx, key, keyLen, value.c_str(), value.size()));
+}
+
+}  // anonymous namespace
+
+Result createTargetMachine(const TargetSettings& settings, LLVMCodeGenOptLevel optLevel,
+                           LLVMRelocMode relocMode, OwnedTargetMachine* toFill) {
+	assert(toFill != nullptr);
+
+	Result res;
+
+	// target machines are created on worker threads, and registering the target isn't thread safe
+	static const bool initFailed =
+	    LLVMInitializeNativeTarget() != 0 || LLVMInitializeNativeAsmPrinter() != 0;
+	if (initFailed) {
+		res.addEntry("EUKN", "Failed to initialize native target", {});
+		return res;
+	}
+
+	std::string triple = settings.triple;
+	if (triple.empty()) { triple = *OwnedMessage(LLVMGetDefaultTargetTriple()); }
+
+	std::string cpu = settings.cpu;
+	if (cpu == "native") { cpu = *OwnedMessage(LLVMGetHostCPUName()); }
+
+	std::string features = settings.features;
+	if (features == "native") { features = *OwnedMessage(LLVMGetHostCPUFeatures()); }
+
+	LLVMTargetRef target;
+	OwnedMessage  errorMessage;
+	if (LLVMGetTargetFromTriple(triple.c_str(), &target, &*errorMessage) != 0) {
+		res.addEntry("EUKN", "Failed to get target from triple",
+		             {{"Triple", triple}, {"Error", *errorMessage}});
+		return res;
+	}
+
+	*toFill = OwnedTargetMachine(LLVMCreateTargetMachine(target, triple.c_str(), cpu.c_str(),
+	                                                     features.c_str(), optLevel, relocMode,
+	                                                     LLVMCodeModelDefault));
+	if (!*toFill) {
+		res.addEntry("EUKN", "Failed to create target machine",
+		             {{"Triple", triple}, {"CPU", cpu}, {"Features", features}});
+	}
+
+	return res;
+}
+
+TargetSettings targetMachineSettings(LLVMTargetMachineRef machine) {
+	TargetSettings ret;
+	ret.triple   = *OwnedMessage(LLVMGetTargetMachineTriple(machine));
+	ret.cpu      = *OwnedMessage(LLVMGetTargetMachineCPU(machine));
+	ret.features = *OwnedMessage(LLVMGetTargetMachineFeatureString(machine));
+
+	return ret;
+}
+
+void setModuleTarget(LLVMModuleRef module, LLVMTargetMachineRef machine) {
+	auto settings = targetMachineSettings(machine);
+
+	LLVMSetTarget(module, settings.triple.c_str());
+
+	auto dataLayout = LLVMCreateTargetDataLayout(machine);
+	LLVMSetModuleDataLayout(module, dataLayout);
+	LLVMDisposeTargetData(dataLayout);
+
+	for (auto func = LLVMGetFirstFunction(module); func != nullptr;
+	     func      = LLVMGetNextFunction(func)) {
+		if (LLVMIsDeclaration(func)) { continue; }
+
+		setFunctionAttribute(func, "target-cpu", settings.cpu);
+		setFunctionAttribute(func, "target-features", settings.features);
+	}
+}
+
+}  // namespace chi
@@ -0,0 +1,387 @@
+/// \file ThinLink.cpp
+
+#include "chi/ThinLink.hpp"
+
+#include <llvm-c/Core.h>
+#include <llvm-c/DebugInfo.h>
+#include <llvm-c/Error.h>
+#include <llvm-c/Linker.h>
+#include <llvm-c/TargetMachine.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <deque>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "chi/BitcodeParser.hpp"
+#include "chi/NativeCodegen.hpp"
+#include "chi/Support/Result.hpp"
+
+namespace chi {
+
+namespace {
+
+// walks what a function references, through constants and the initializers of local constants
+struct ReferenceCollector {
+	explicit ReferenceCollector(FunctionSummary& summary) : mSummary{&summary} {}
+
+	void visit(LLVMValueRef value) {
+		visitConstantReferences(value, &mVisited, [this](LLVMValueRef global) {
+			if (LLVMIsAFunction(global) != nullptr) {
+				if (isLocal(global)) {
+					mSummary->importable = false;
+					return false;
+				}
+
+				auto name = valueName(global);
+				if (name.compare(0, 5, "llvm.") != 0) { mSummary->references.push_back(name); }
+				return false;
+			}
+
+			if (!isLocal(global)) { return false; }
+
+			// a copy of a local constant can be made next to the imported function, but a copy of
+			// a variable would be a different variable
+			if (LLVMIsAGlobalVariable(global) == nullptr || !LLVMIsGlobalConstant(global)) {
+				mSummary->importable = false;
+				return false;
+			}
+			return true;
+		});
+	}
+
+private:
+	FunctionSummary*                 mSummary;
+	std::unordered_set<LLVMValueRef> mVisited;
+};
+
+// turn a copy of a module into just the functions to import from it, as available_externally
+// definitions, and declarations of what they reference
+void prepareForImport(LLVMModuleRef module, const std::vector<std::string>& names) {
+	std::unordered_set<std::string> toImport(names.begin(), names.end());
+
+	// the debug info would add another compile unit to the module importing them
+	LLVMStripModuleDebugInfo(module);
+
+	std::vector<LLVMValueRef> functions, globals;
+	for (auto func = LLVMGetFirstFunction(module); func != nullptr;
+	     func      = LLVMGetNextFunction(func)) {
+		functions.push_back(func);
+	}
+	for (auto global = LLVMGetFirstGlobal(module); global != nullptr;
+	     global      = LLVMGetNextGlobal(global)) {
+		globals.push_back(global);
+	}
+
+	for (auto func : functions) {
+		if (LLVMIsDeclaration(func) || isLocal(func)) { continue; }
+
+		if (toImport.count(valueName(func)) != 0) {
+			LLVMSetLinkage(func, LLVMAvailableExternallyLinkage);
+		} else {
+			replaceWithDeclaration(func);
+		}
+	}
+
+	for (auto global : globals) {
+		// like llvm.global_ctors, which belong to the module they came from
+		if (LLVMGetLinkage(global) == LLVMAppendingLinkage) {
+			LLVMDeleteGlobal(global);
+			continue;
+		}
+
+		if (!LLVMIsDeclaration(global) && !isLocal(global)) { replaceWithDeclaration(global); }
+	}
+
+	// then remove the locals that only the functions that weren't imported used
+	for (auto removed = true; removed;) {
+		removed = false;
+
+		for (auto func = LLVMGetFirstFunction(module); func != nullptr;) {
+			auto next = LLVMGetNextFunction(func);
+			if (isLocal(func) && LLVMGetFirstUse(func) == nullptr) {
+				LLVMDeleteFunction(func);
+				removed = true;
+			}
+			func = next;
+		}
+		for (auto global = LLVMGetFirstGlobal(module); global != nullptr;) {
+			auto next = LLVMGetNextGlobal(global);
+			if (isLocal(global) && LLVMGetFirstUse(global) == nullptr) {
+				LLVMDeleteGlobal(global);
+				removed = true;
+			}
+			global = next;
+		}
+	}
+}
+
+// the imported functions that weren't optimized away are defined by the modules they came from
+void dropImportedDefinitions(LLVMModuleRef module) {
+	std::vector<LLVMValueRef> imported;
+	for (auto func = LLVMGetFirstFunction(module); func != nullptr;
+	     func      = LLVMGetNextFunction(func)) {
+		if (!LLVMIsDeclaration(func) &&
+		    LLVMGetLinkage(func) == LLVMAvailableExternallyLinkage) {
+			imported.push_back(func);
+		}
+	}
+
+	for (auto func : imported) { replaceWithDeclaration(func); }
+}
+
+}  // anonymous namespace
+
+ModuleSummary summarizeModule(LLVMModuleRef module, const std::string& moduleName) {
+	ModuleSummary ret;
+	ret.moduleName = moduleName;
+
+	for (auto func = LLVMGetFirstFunction(module); func != nullptr;
+	     func      = LLVMGetNextFunction(func)) {
+		if (LLVMIsDeclaration(func)) { continue; }
+
+		FunctionSummary summary;
+		summary.name       = valueName(func);
+		summary.importable = LLVMGetLinkage(func) == LLVMExternalLinkage;
+
+		ReferenceCollector collector{summary};
+		for (auto block = LLVMGetFirstBasicBlock(func); block != nullptr;
+		     block      = LLVMGetNextBasicBlock(block)) {
+			for (auto inst = LLVMGetFirstInstruction(block); inst != nullptr;
+			     inst      = LLVMGetNextInstruction(inst)) {
+				++summary.instructionCount;
+
+				for (auto idx = 0; idx < LLVMGetNumOperands(inst); ++idx) {
+					collector.visit(LLVMGetOperand(inst, idx));
+				}
+			}
+		}
+
+		ret.functions.push_back(std::move(summary));
+	}
+
+	return ret;
+}
+
+nlohmann::json moduleSummaryToJson(const ModuleSummary& summary) {
+	auto ret      = nlohmann::json::object();
+	ret["module"] = summary.moduleName;
+
+	auto& functionsJson = ret["functions"];
+	functionsJson       = nlohmann::json::array();
+	for (const auto& func : summary.functions) {
+		functionsJson.push_back({{"name", func.name},
+		                         {"instructions", func.instructionCount},
+		                         {"importable", func.importable},
+		                         {"references", func.references}});
+	}
+
+	return ret;
+}
+
+Result jsonToModuleSummary(const nlohmann::json& data, ModuleSummary* toFill) {
+	assert(toFill != nullptr);
+
+	Result res;
+
+	auto malformed = [&] {
+		res.addEntry("E54", "Module summary JSON is malformed", {{"Summary", data}});
+		return res;
+	};
+
+	using json = nlohmann::json;
+	auto has   = [](const json& obj, const char* key, bool (json::*isType)() const noexcept) {
+		return obj.is_object() && obj.contains(key) && (obj[key].*isType)();
+	};
+
+	if (!has(data, "module", &json::is_string) || !has(data, "functions", &json::is_array)) {
+		return malformed();
+	}
+
+	ModuleSummary summary;
+	summary.moduleName = data["module"];
+
+	for (const auto& funcJson : data["functions"]) {
+		if (!has(funcJson, "name", &json::is_string) ||
+		    !has(funcJson, "instructions", &json::is_number_unsigned) ||
+		    !has(funcJson, "importable", &json::is_boolean) ||
+		    !has(funcJson, "references", &json::is_array)) {
+			return malformed();
+		}
+
+		FunctionSummary func;
+		func.name             = funcJson["name"];
+		func.instructionCount = funcJson["instructions"];
+		func.importable       = funcJson["importable"];
+		for (const auto& ref : funcJson["references"]) {
+			if (!ref.is_string()) { return malformed(); }
+			func.references.push_back(ref);
+		}
+
+		summary.functions.push_back(std::move(func));
+	}
+
+	*toFill = std::move(summary);
+
+	return res;
+}
+
+ImportLists computeImports(const std::vector<ModuleSummary>& summaries, size_t threshold) {
+	// where each function is defined. If more than one module defines it, the first one wins, like
+	// it does when they're linked
+	std::unordered_map<std::string, std::pair<size_t, const FunctionSummary*>> definitions;
+	for (auto modIdx = 0ull; modIdx < summaries.size(); ++modIdx) {
+		for (const auto& func : summaries[modIdx].functions) {
+			definitions.emplace(func.name, std::make_pair(modIdx, &func));
+		}
+	}
+
+	ImportLists ret(summaries.size());
+	for (auto modIdx = 0ull; modIdx < summaries.size(); ++modIdx) {
+		std::unordered_set<std::string> available;
+		std::deque<std::pair<const std::string*, size_t>> toVisit;
+		for (const auto& func : summaries[modIdx].functions) {
+			available.insert(func.name);
+			for (const auto& ref : func.references) { toVisit.emplace_back(&ref, threshold); }
+		}
+
+		while (!toVisit.empty()) {
+			auto [name, funcThreshold] = toVisit.front();
+			toVisit.pop_front();
+
+			if (available.count(*name) != 0) { continue; }
+
+			auto defIter = definitions.find(*name);
+			if (defIter == definitions.end()) { continue; }
+
+			auto [defModIdx, def] = defIter->second;
+			if (!def->importable || def->instructionCount > funcThreshold) { continue; }
+
+			available.insert(*name);
+			ret[modIdx][defModIdx].push_back(*name);
+
+			// what gets imported because of an import should be smaller still, so a chain of
+			// calls doesn't pull in a whole module
+			for (const auto& ref : def->references) {
+				toVisit.emplace_back(&ref, funcThreshold * 7 / 10);
+			}
+		}
+	}
+
+	return ret;
+}
+
+Result thinLinkModules(std::vector<OwnedLLVMModule>       modules,
+                       const std::vector<ModuleSummary>& summaries,
+                       const ThinLinkSettings& settings, LLVMContextRef ctx,
+                       OwnedLLVMModule* toFill) {
+	assert(modules.size() == summaries.size() && !modules.empty() && toFill != nullptr);
+	assert(settings.optimizationLevel <= 3);
+
+	Result res;
+
+	auto optLevel = LLVMCodeGenOptLevel(LLVMCodeGenLevelNone + settings.optimizationLevel);
+
+	// each worker makes its own, this makes sure they can
+	OwnedTargetMachine checkMachine;
+	res += createTargetMachine(settings.target, optLevel, LLVMRelocDefault, &checkMachine);
+	if (!res) { return res; }
+
+	// LLVMContexts can't be shared between threads, so the modules go to the workers as bitcode
+	std::vector<std::string> bitcode(modules.size());
+	for (auto idx = 0ull; idx < modules.size(); ++idx) {
+		bitcode[idx]  = writeBitcode(*modules[idx]);
+		modules[idx] = {};
+	}
+
+	// nothing would be inlined at -O0, so there's no point in importing
+	auto imports = settings.optimizationLevel == 0
+	                   ? ImportLists(summaries.size())
+	                   : computeImports(summaries, settings.importInstructionThreshold);
+
+	auto passes = "default<O" + std::to_string(settings.optimizationLevel) + ">";
+	auto threadCount =
+	    std::max<size_t>(1, std::min<size_t>(settings.threadCount, modules.size()));
+
+	std::atomic<size_t>      nextToOptimize{0};
+	std::vector<Result>      moduleResults(modules.size());
+	std::vector<std::string> optimized(modules.size());
+
+	auto worker = [&] {
+		auto llctx = OwnedLLVMContext(LLVMContextCreate());
+		auto pbo   = OwnedPassBuilderOptions(LLVMCreatePassBuilderOptions());
+
+		OwnedTargetMachine targetMachine;
+		createTargetMachine(settings.target, optLevel, LLVMRelocDefault, &targetMachine);
+
+		for (auto idx = nextToOptimize++; idx < bitcode.size(); idx = nextToOptimize++) {
+			auto& modRes = moduleResults[idx];
+
+			OwnedLLVMModule llmod;
+			modRes += parseBitcodeString(bitcode[idx], *llctx, &llmod);
+			if (!modRes) { continue; }
+
+			for (const auto& [fromIdx, names] : imports[idx]) {
+				OwnedLLVMModule from;
+				modRes += parseBitcodeString(bitcode[fromIdx], *llctx, &from);
+				if (!modRes) { break; }
+
+				prepareForImport(*from, names);
+				if (LLVMLinkModules2(*llmod, from.take_ownership())) {
+					modRes.addEntry("EINT", "Failed to import functions",
+					                {{"From", summaries[fromIdx].moduleName}});
+					break;
+				}
+			}
+			if (!modRes) { continue; }
+
+			if (auto err = LLVMRunPasses(*llmod, passes.c_str(), *targetMachine, *pbo)) {
+				auto message = LLVMGetErrorMessage(err);
+				modRes.addEntry("EINT", "Failed to optimize module", {{"Error", message}});
+				LLVMDisposeErrorMessage(message);
+				continue;
+			}
+
+			dropImportedDefinitions(*llmod);
+
+			optimized[idx] = writeBitcode(*llmod);
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (auto workerID = 0ull; workerID < threadCount; ++workerID) { workers.emplace_back(worker); }
+	for (auto& thread : workers) { thread.join(); }
+
+	// then link them all into the first one
+	OwnedLLVMModule linked;
+	for (auto idx = 0ull; idx < optimized.size(); ++idx) {
+		auto modNameCtx = res.addScopedContext({{"Module Name", summaries[idx].moduleName}});
+
+		res += moduleResults[idx];
+		if (!res) { return res; }
+
+		OwnedLLVMModule llmod;
+		res += parseBitcodeString(optimized[idx], ctx, &llmod);
+		if (!res) { return res; }
+
+		if (!linked) {
+			linked = std::move(llmod);
+			continue;
+		}
+
+		if (LLVMLinkModules2(*linked, llmod.take_ownership())) {
+			res.addEntry("EINT", "Failed to link modules", {});
+			return res;
+		}
+	}
+
+	*toFill = std::move(linked);
+
+	return res;
+}
+
+}  // namespace chi
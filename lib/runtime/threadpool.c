@@ -0,0 +1,258 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// A work stealing thread pool, for lang:parallel-for
+//
+// Each worker has a deque of ranges of indices. A worker takes ranges from the bottom of its own
+// deque, and when it's empty, it steals from the top of the others. Running a range that's bigger
+// than its job's grain splits it in half first, leaving the top half for anyone to take, so big
+// ranges are spread over the workers without being split up front.
+//
+// The thread that calls chi_parallel_for works on the job too, until every index is done. Threads
+// that aren't workers share the first deque.
+//
+// The workers are started the first time chi_parallel_for is called. There are as many as
+// chi_thread_pool_set_workers says, or the CHI_WORKERS environment variable, or the number of
+// CPUs, counting the thread that calls chi_parallel_for.
+
+// the function that a lang:parallel-for node outlines its body into, which runs it for each index
+// from begin up to end
+typedef void (*chi_task)(void* context, int64_t begin, int64_t end);
+
+// a call to chi_parallel_for
+typedef struct {
+	chi_task task;
+	void*    context;
+	int64_t  grain;
+
+	// the number of indices that haven't been run yet
+	_Atomic int64_t remaining;
+} chi_job;
+
+typedef struct {
+	chi_job* job;
+	int64_t  begin;
+	int64_t  end;
+} chi_range;
+
+// the deques are locked, ranges are big enough that the lock isn't what takes the time
+typedef struct {
+	pthread_mutex_t lock;
+	chi_range*      ranges;
+	size_t          capacity;
+	size_t          top;
+	size_t          bottom;
+} chi_deque;
+
+static pthread_once_t chi_pool_once = PTHREAD_ONCE_INIT;
+static int32_t        chi_requested_workers = 0;
+static int32_t        chi_worker_count      = 1;
+static chi_deque*     chi_deques            = NULL;
+
+// threads sleep while there's nothing to take. Pushing a range or finishing a job counts as a
+// change, so a thread that didn't find anything only sleeps if nothing changed since it started
+// looking, and changes only wake threads when some are asleep.
+static pthread_mutex_t  chi_sleep_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   chi_wake       = PTHREAD_COND_INITIALIZER;
+static _Atomic uint64_t chi_changes    = 0;
+static _Atomic int32_t  chi_sleepers   = 0;
+
+// the deque of this thread, which is 0 for threads that aren't workers
+static _Thread_local int32_t chi_worker_id = 0;
+
+static void chi_out_of_memory(void) {
+	fprintf(stderr, "chigraph runtime: out of memory for the parallel-for thread pool\n");
+	abort();
+}
+
+static void chi_changed(void) {
+	atomic_fetch_add(&chi_changes, 1);
+	if (atomic_load(&chi_sleepers) > 0) {
+		pthread_mutex_lock(&chi_sleep_lock);
+		pthread_cond_broadcast(&chi_wake);
+		pthread_mutex_unlock(&chi_sleep_lock);
+	}
+}
+
+// sleep until there's been a change since changes was read, or until the job is done if there is
+// one
+static void chi_sleep(uint64_t changes, chi_job* job) {
+	pthread_mutex_lock(&chi_sleep_lock);
+	atomic_fetch_add(&chi_sleepers, 1);
+	while (atomic_load(&chi_changes) == changes &&
+	       (job == NULL || atomic_load(&job->remaining) > 0)) {
+		pthread_cond_wait(&chi_wake, &chi_sleep_lock);
+	}
+	atomic_fetch_sub(&chi_sleepers, 1);
+	pthread_mutex_unlock(&chi_sleep_lock);
+}
+
+static void chi_deque_push(chi_deque* deque, chi_range range) {
+	pthread_mutex_lock(&deque->lock);
+
+	if (deque->bottom == deque->capacity) {
+		// move them back to the start before growing
+		size_t count = deque->bottom - deque->top;
+		for (size_t idx = 0; idx < count; ++idx) {
+			deque->ranges[idx] = deque->ranges[deque->top + idx];
+		}
+		deque->top    = 0;
+		deque->bottom = count;
+
+		if (deque->bottom == deque->capacity) {
+			size_t     capacity = deque->capacity == 0 ? 64 : deque->capacity * 2;
+			chi_range* ranges   = realloc(deque->ranges, capacity * sizeof(chi_range));
+			if (ranges == NULL) { chi_out_of_memory(); }
+
+			deque->capacity = capacity;
+			deque->ranges   = ranges;
+		}
+	}
+	deque->ranges[deque->bottom++] = range;
+
+	pthread_mutex_unlock(&deque->lock);
+
+	chi_changed();
+}
+
+// take from the bottom, for the deque's own worker
+static int chi_deque_pop(chi_deque* deque, chi_range* range) {
+	pthread_mutex_lock(&deque->lock);
+
+	int found = deque->bottom != deque->top;
+	if (found) { *range = deque->ranges[--deque->bottom]; }
+
+	pthread_mutex_unlock(&deque->lock);
+	return found;
+}
+
+// take from the top, for other workers
+static int chi_deque_steal(chi_deque* deque, chi_range* range) {
+	pthread_mutex_lock(&deque->lock);
+
+	int found = deque->bottom != deque->top;
+	if (found) { *range = deque->ranges[deque->top++]; }
+
+	pthread_mutex_unlock(&deque->lock);
+	return found;
+}
+
+static int chi_find_range(chi_range* range) {
+	if (chi_deque_pop(&chi_deques[chi_worker_id], range)) { return 1; }
+
+	for (int32_t offset = 1; offset < chi_worker_count; ++offset) {
+		int32_t victim = (chi_worker_id + offset) % chi_worker_count;
+		if (chi_deque_steal(&chi_deques[victim], range)) { return 1; }
+	}
+	return 0;
+}
+
+static void chi_run_range(chi_range range) {
+	chi_job* job = range.job;
+
+	while (range.end - range.begin > job->grain) {
+		int64_t   middle = range.begin + (range.end - range.begin) / 2;
+		chi_range top    = {job, middle, range.end};
+		chi_deque_push(&chi_deques[chi_worker_id], top);
+
+		range.end = middle;
+	}
+
+	job->task(job->context, range.begin, range.end);
+
+	// the job belongs to the thread that's waiting on it, so it can't be used once it's done
+	if (atomic_fetch_sub(&job->remaining, range.end - range.begin) == range.end - range.begin) {
+		chi_changed();
+	}
+}
+
+static void* chi_worker(void* id) {
+	chi_worker_id = (int32_t)(intptr_t)id;
+
+	for (;;) {
+		uint64_t changes = atomic_load(&chi_changes);
+
+		chi_range range;
+		if (chi_find_range(&range)) {
+			chi_run_range(range);
+		} else {
+			chi_sleep(changes, NULL);
+		}
+	}
+	return NULL;
+}
+
+static void chi_pool_start(void) {
+	int32_t count = chi_requested_workers;
+	if (count <= 0) {
+		const char* fromEnvironment = getenv("CHI_WORKERS");
+		if (fromEnvironment != NULL) { count = atoi(fromEnvironment); }
+	}
+	if (count <= 0) { count = (int32_t)sysconf(_SC_NPROCESSORS_ONLN); }
+	if (count <= 0) { count = 1; }
+
+	chi_deques = calloc(count, sizeof(chi_deque));
+	if (chi_deques == NULL) { chi_out_of_memory(); }
+	for (int32_t id = 0; id < count; ++id) { pthread_mutex_init(&chi_deques[id].lock, NULL); }
+
+	// the calling thread is the first one. Only a worker puts ranges in its deque, so if one
+	// can't be started, its deque is just always empty.
+	chi_worker_count = count;
+	for (int32_t id = 1; id < count; ++id) {
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, chi_worker, (void*)(intptr_t)id) == 0) {
+			pthread_detach(thread);
+		}
+	}
+}
+
+// Set how many threads run parallel for loops, counting the one that starts them. It has to be
+// called before the first one runs.
+void chi_thread_pool_set_workers(int32_t count) { chi_requested_workers = count; }
+
+// Get how many threads run parallel for loops, which starts them if they haven't been
+int32_t chi_thread_pool_workers(void) {
+	pthread_once(&chi_pool_once, chi_pool_start);
+	return chi_worker_count;
+}
+
+// Run task for every index from begin up to end, split over the workers. It returns once they've
+// all been run.
+void chi_parallel_for(chi_task task, void* context, int64_t begin, int64_t end) {
+	if (end <= begin) { return; }
+
+	pthread_once(&chi_pool_once, chi_pool_start);
+	if (chi_worker_count == 1) {
+		task(context, begin, end);
+		return;
+	}
+
+	// a few ranges for each worker, so the ones that finish first can take some from the others
+	chi_job job;
+	job.task    = task;
+	job.context = context;
+	job.grain   = (end - begin) / (chi_worker_count * 8);
+	if (job.grain < 1) { job.grain = 1; }
+	atomic_init(&job.remaining, end - begin);
+
+	chi_range all = {&job, begin, end};
+	chi_deque_push(&chi_deques[chi_worker_id], all);
+
+	// help until it's done, which can mean running other jobs when this one is all taken. When
+	// there's nothing left to take, the rest of it is already running, so this sleeps until it's
+	// done or there's something new to help with.
+	while (atomic_load(&job.remaining) > 0) {
+		uint64_t changes = atomic_load(&chi_changes);
+
+		chi_range range;
+		if (chi_find_range(&range)) {
+			chi_run_range(range);
+		} else {
+			chi_sleep(changes, &job);
+		}
+	}
+}
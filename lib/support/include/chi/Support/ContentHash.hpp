@@ -0,0 +1,32 @@
+/// \file ContentHash.hpp
+
+#ifndef CHI_SUPPORT_CONTENT_HASH_HPP
+#define CHI_SUPPORT_CONTENT_HASH_HPP
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace chi {
+
+/// Hashes pieces of content together, for caches that are keyed on what went into something
+/// instead of when it was written. Each piece is length prefixed, so adding "ab" then "c" doesn't
+/// hash the same as adding "a" then "bc".
+struct ContentHasher {
+	/// Add a piece of content
+	/// \param piece The content to add
+	/// \return `*this`, so calls can be chained
+	ContentHasher& add(std::string_view piece);
+
+	/// Get the SHA-1 hash of everything that's been added
+	/// \return The hash, as 40 lowercase hex digits
+	std::string hexDigest() const;
+
+private:
+	std::string mContent;
+};
+
+}  // namespace chi
+
+#endif  // CHI_SUPPORT_CONTENT_HASH_HPP
@@ -0,0 +1,36 @@
+/// \file ContentHash.cpp
+
+#include "chi/Support/ContentHash.hpp"
+
+#include <boost/uuid/detail/sha1.hpp>
+#include <cstdio>
+
+namespace chi {
+
+ContentHasher& ContentHasher::add(std::string_view piece) {
+	mContent.append(std::to_string(piece.size()));
+	mContent.push_back(':');
+	mContent.append(piece);
+
+	return *this;
+}
+
+std::string ContentHasher::hexDigest() const {
+	boost::uuids::detail::sha1 sha;
+	sha.process_bytes(mContent.data(), mContent.size());
+
+	boost::uuids::detail::sha1::digest_type digest;
+	sha.get_digest(digest);
+
+	std::string ret;
+	ret.reserve(40);
+	for (auto word : digest) {
+		char buf[9];
+		std::snprintf(buf, sizeof(buf), "%08x", word);
+		ret.append(buf);
+	}
+
+	return ret;
+}
+
+}  // namespace chi
@@ -1,12 +1,21 @@
 #include <catch.hpp>
 
+#include <chi/CompileSession.hpp>
 #include <chi/Context.hpp>
 #include <chi/DataType.hpp>
+#include <chi/GraphFunction.hpp>
+#include <chi/GraphModule.hpp>
 #include <chi/LangModule.hpp>
+#include <chi/NameMangler.hpp>
+#include <chi/NodeInstance.hpp>
 #include <chi/NodeType.hpp>
 #include <chi/Support/Result.hpp>
 #include <chi/Support/TempFile.hpp>
 
+#include <llvm-c/Analysis.h>
+#include <llvm-c/Core.h>
+
+#include <algorithm>
 #include <fstream>
 
 using namespace chi;
@@ -128,3 +137,342 @@ TEST_CASE("Contexts can be created and modules can be added to them", "[Context]
 
 	GIVEN("A context constructed with a workspace") {}
 }
+
+TEST_CASE("Contexts keep module order and lookups in sync when unloading", "[Context]") {
+	Context c;
+
+	auto first  = c.newGraphModule("test/first");
+	auto second = c.newGraphModule("test/second");
+	auto third  = c.newGraphModule("test/third");
+
+	REQUIRE(c.modules() == std::vector<ChiModule*>{first, second, third});
+	REQUIRE(c.moduleByFullName("test/second") == second);
+
+	REQUIRE(c.unloadModule("test/second"));
+	REQUIRE_FALSE(c.unloadModule("test/second"));
+
+	REQUIRE(c.moduleByFullName("test/second") == nullptr);
+	REQUIRE(c.modules() == std::vector<ChiModule*>{first, third});
+
+	auto secondAgain = c.newGraphModule("test/second");
+	REQUIRE(c.moduleByFullName("test/second") == secondAgain);
+	REQUIRE(c.modules() == std::vector<ChiModule*>{first, third, secondAgain});
+}
+
+namespace {
+
+// makes a module with a single function that just goes from entry to exit
+GraphModule* makeDependencyTestModule(Context& c, const fs::path& name,
+                                      const std::vector<fs::path>& deps) {
+	auto mod = c.newGraphModule(name);
+	REQUIRE(mod->addDependency("lang"));
+	for (const auto& dep : deps) { REQUIRE(mod->addDependency(dep)); }
+
+	auto func = mod->getOrCreateFunction("fn", {}, {}, {""}, {""});
+
+	NodeInstance* entry;
+	REQUIRE(func->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+
+	std::unique_ptr<NodeType> exitType;
+	REQUIRE(func->createExitNodeType(&exitType));
+	NodeInstance* exit;
+	REQUIRE(func->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit));
+
+	REQUIRE(connectExec(*entry, 0, *exit, 0));
+
+	return mod;
+}
+
+}  // anonymous namespace
+
+TEST_CASE("Contexts compile dependency graphs", "[Context]") {
+	// create a workspace so compiled modules are cached somewhere temporary
+	fs::path workspaceDir = makeTempPath();
+	fs::create_directories(workspaceDir);
+	{ std::ofstream stream{workspaceDir / ".chigraphworkspace"}; }
+
+	Context c{workspaceDir};
+	Result  res;
+
+	// a diamond: a depends on b and c, which both depend on d
+	auto d = makeDependencyTestModule(c, "test/d", {});
+	auto b = makeDependencyTestModule(c, "test/b", {"test/d"});
+	auto e = makeDependencyTestModule(c, "test/c", {"test/d"});
+	auto a = makeDependencyTestModule(c, "test/a", {"test/b", "test/c"});
+
+	WHEN("The build order is computed") {
+		std::vector<ChiModule*> order;
+		res = moduleBuildOrder(*a, &order);
+		REQUIRE(res);
+
+		THEN("Every module comes after its dependencies") {
+			REQUIRE(order.size() == 5);  // lang is in there too
+			REQUIRE(order.back() == a);
+
+			auto indexOf = [&](ChiModule* mod) {
+				return std::find(order.begin(), order.end(), mod) - order.begin();
+			};
+			REQUIRE(indexOf(d) < indexOf(b));
+			REQUIRE(indexOf(d) < indexOf(e));
+			REQUIRE(indexOf(b) < indexOf(a));
+			REQUIRE(indexOf(e) < indexOf(a));
+		}
+	}
+
+	auto checkCompiled = [&](unsigned threadCount) {
+		c.setCompileThreadCount(threadCount);
+
+		OwnedLLVMModule llmod;
+		res = c.compileModule(*a, CompileSettings::LinkDependencies, &llmod);
+		REQUIRE(res);
+
+		// every function is defined exactly once, even d's, which is reachable twice
+		for (auto mod : {a, b, e, d}) {
+			auto fn = LLVMGetNamedFunction(*llmod,
+			                               mangleFunctionName(mod->fullName(), "fn").c_str());
+			REQUIRE(fn != nullptr);
+			REQUIRE_FALSE(LLVMIsDeclaration(fn));
+		}
+	};
+
+	WHEN("It's compiled on one thread") { checkCompiled(1); }
+	WHEN("It's compiled on several threads") { checkCompiled(4); }
+
+	WHEN("A dependency cycle is introduced") {
+		REQUIRE(d->addDependency("test/a"));
+
+		THEN("Compiling it should fail with E53") {
+			OwnedLLVMModule llmod;
+			res = c.compileModule(*a, CompileSettings::LinkDependencies, &llmod);
+			REQUIRE(!res);
+			REQUIRE(res.result_json[0]["errorcode"] == "E53");
+		}
+	}
+
+	fs::remove_all(workspaceDir);
+}
+
+TEST_CASE("Contexts compile modules for their target", "[Context]") {
+	fs::path workspaceDir = makeTempPath();
+	fs::create_directories(workspaceDir);
+	{ std::ofstream stream{workspaceDir / ".chigraphworkspace"}; }
+
+	Context c{workspaceDir};
+	Result  res;
+
+	auto b = makeDependencyTestModule(c, "test/b", {});
+	auto a = makeDependencyTestModule(c, "test/a", {"test/b"});
+
+	auto compile = [&](unsigned threadCount) {
+		c.setCompileThreadCount(threadCount);
+
+		OwnedLLVMModule llmod;
+		res = c.compileModule(*a, CompileSettings::Default, &llmod);
+		REQUIRE(res);
+		return llmod;
+	};
+	auto cpuOf = [](LLVMModuleRef llmod, ChiModule* mod) {
+		auto fn   = LLVMGetNamedFunction(llmod, mangleFunctionName(mod->fullName(), "fn").c_str());
+		auto attr = LLVMGetStringAttributeAtIndex(fn, LLVMAttributeFunctionIndex, "target-cpu", 10);
+		if (attr == nullptr) { return std::string{}; }
+
+		unsigned length;
+		auto     value = LLVMGetStringAttributeValue(attr, &length);
+		return std::string(value, length);
+	};
+
+	// the host, with a generic CPU
+	auto hostModule = compile(1);
+	REQUIRE(std::string(LLVMGetTarget(*hostModule)) == c.target().triple);
+	REQUIRE_FALSE(c.target().triple.empty());
+	REQUIRE(std::string(LLVMGetDataLayoutStr(*hostModule)) != "");
+	REQUIRE(cpuOf(*hostModule, a).empty());
+
+	WHEN("The target CPU is set") {
+		TargetSettings target;
+		target.cpu      = "haswell";
+		target.features = "+avx2";
+		res             = c.setTarget(target);
+		REQUIRE(res);
+		REQUIRE(c.target().cpu == "haswell");
+
+		THEN("Modules aren't taken from the cache of the last target") {
+			auto llmod = compile(1);
+			REQUIRE(cpuOf(*llmod, a) == "haswell");
+			REQUIRE(cpuOf(*llmod, b) == "haswell");
+		}
+
+		THEN("Modules compiled on other threads get it too") {
+			auto llmod = compile(4);
+			REQUIRE(cpuOf(*llmod, b) == "haswell");
+		}
+	}
+
+	WHEN("The target triple doesn't exist") {
+		TargetSettings target;
+		target.triple = "nothing-at-all";
+		res           = c.setTarget(target);
+		REQUIRE(!res);
+
+		THEN("The old target is kept") { REQUIRE(c.target().triple == LLVMGetTarget(*hostModule)); }
+	}
+
+	fs::remove_all(workspaceDir);
+}
+
+TEST_CASE("CompileSessions compile each module once per build", "[Context]") {
+	Context c;
+	Result  res;
+
+	// same diamond as above: a depends on b and c, which both depend on d
+	auto d = makeDependencyTestModule(c, "test/d", {});
+	auto b = makeDependencyTestModule(c, "test/b", {"test/d"});
+	auto e = makeDependencyTestModule(c, "test/c", {"test/d"});
+	auto a = makeDependencyTestModule(c, "test/a", {"test/b", "test/c"});
+
+	CompileSession session{c, CompileSettings::LinkDependencies};
+
+	WHEN("The transitive dependencies of a are found") {
+		const std::vector<ChiModule*>* deps;
+		res = session.transitiveDependencies(*a, &deps);
+		REQUIRE(res);
+
+		THEN("Each dependency shows up once") {
+			REQUIRE(deps->size() == 4);
+			for (ChiModule* dep : std::vector<ChiModule*>{c.langModule(), b, e, d}) {
+				REQUIRE(std::count(deps->begin(), deps->end(), dep) == 1);
+			}
+		}
+
+		THEN("Asking again is a hit") {
+			const std::vector<ChiModule*>* depsAgain;
+			REQUIRE(session.transitiveDependencies(*a, &depsAgain));
+			REQUIRE(depsAgain == deps);
+			REQUIRE(session.stats().dependencyHits == 1);
+		}
+	}
+
+	WHEN("b and then a are compiled in the session") {
+		OwnedLLVMModule bMod;
+		res = c.compileModule(*b, session, &bMod);
+		REQUIRE(res);
+
+		// lang, d, and b
+		REQUIRE(session.stats().moduleMisses == 3);
+		REQUIRE(session.stats().moduleHits == 0);
+
+		OwnedLLVMModule aMod;
+		res = c.compileModule(*a, session, &aMod);
+		REQUIRE(res);
+
+		THEN("Only c and a are compiled again") {
+			REQUIRE(session.stats().moduleMisses == 5);
+			REQUIRE(session.stats().moduleHits == 3);
+
+			// and the modules handed out are whole
+			for (auto mod : {a, b, e, d}) {
+				auto fn = LLVMGetNamedFunction(*aMod,
+				                               mangleFunctionName(mod->fullName(), "fn").c_str());
+				REQUIRE(fn != nullptr);
+				REQUIRE_FALSE(LLVMIsDeclaration(fn));
+			}
+		}
+	}
+}
+
+TEST_CASE("Contexts only link what's reachable from lazily loaded caches", "[Context]") {
+	fs::path workspaceDir = makeTempPath();
+	fs::create_directories(workspaceDir);
+	{ std::ofstream stream{workspaceDir / ".chigraphworkspace"}; }
+
+	Context c{workspaceDir};
+	Result  res;
+
+	// lib has a function that's used and one that isn't. used calls itself, so it isn't inlined
+	auto lib = c.newGraphModule("test/lib");
+	REQUIRE(lib->addDependency("lang"));
+	for (auto name : {"used", "unused"}) {
+		auto          func = lib->getOrCreateFunction(name, {}, {}, {""}, {""});
+		NodeInstance* entry;
+		REQUIRE(func->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+		std::unique_ptr<NodeType> exitType;
+		REQUIRE(func->createExitNodeType(&exitType));
+		NodeInstance* exit;
+		REQUIRE(func->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit));
+
+		if (name == std::string("used")) {
+			NodeInstance* call;
+			REQUIRE(func->insertNode("test/lib", "used", {}, 0, 0, Uuid::random(), &call));
+			REQUIRE(connectExec(*entry, 0, *call, 0));
+			REQUIRE(connectExec(*call, 0, *exit, 0));
+		} else {
+			REQUIRE(connectExec(*entry, 0, *exit, 0));
+		}
+	}
+
+	// root calls lib:used
+	auto root = makeDependencyTestModule(c, "test/root", {"test/lib"});
+	{
+		auto          func = root->functionFromName("fn");
+		NodeInstance* call;
+		REQUIRE(func->insertNode("test/lib", "used", {}, 0, 0, Uuid::random(), &call));
+
+		auto entry = func->entryNode();
+		auto exit  = entry->outputExecConnections[0].first;
+		REQUIRE(connectExec(*entry, 0, *call, 0));
+		REQUIRE(connectExec(*call, 0, *exit, 0));
+	}
+
+	// fill the cache
+	OwnedLLVMModule llmod;
+	res = c.compileModule(*root, CompileSettings::Default, &llmod);
+	REQUIRE(res);
+	REQUIRE(LLVMGetNamedFunction(*llmod, mangleFunctionName("test/lib", "unused").c_str()) !=
+	        nullptr);
+
+	WHEN("It's compiled again, loading the cache lazily") {
+		res = c.compileModule(
+		    *root, Flags<CompileSettings>{CompileSettings::Default} | CompileSettings::LazyLoadCache,
+		    &llmod);
+		REQUIRE(res);
+
+		THEN("Only the reachable functions are linked in, with their usual linkage") {
+			// calls go straight to the clone for the exec input they call
+			auto used = LLVMGetNamedFunction(
+			    *llmod, mangleSpecializedFunctionName("test/lib", "used", 0).c_str());
+			REQUIRE(used != nullptr);
+			REQUIRE_FALSE(LLVMIsDeclaration(used));
+			REQUIRE(LLVMGetLinkage(used) == LLVMExternalLinkage);
+
+			REQUIRE(LLVMGetNamedFunction(*llmod,
+			                             mangleFunctionName("test/lib", "unused").c_str()) ==
+			        nullptr);
+			REQUIRE(LLVMGetNamedFunction(
+			            *llmod, mangleSpecializedFunctionName("test/lib", "unused", 0).c_str()) ==
+			        nullptr);
+
+			REQUIRE_FALSE(LLVMVerifyModule(*llmod, LLVMReturnStatusAction, nullptr));
+		}
+	}
+
+	fs::remove_all(workspaceDir);
+}
+
+TEST_CASE("Contexts load the runtime once and hand out copies", "[Context]") {
+	Context c;
+
+	REQUIRE_FALSE(runtimeBitcodePath().empty());
+	REQUIRE_FALSE(runtimeObjectPath().empty());
+
+	OwnedLLVMModule first;
+	REQUIRE(c.runtimeModule(&first));
+	REQUIRE(*first != nullptr);
+
+	OwnedLLVMModule second;
+	REQUIRE(c.runtimeModule(&second));
+	REQUIRE(*second != nullptr);
+
+	// linking consumes them, so they can't be the same module
+	REQUIRE(*first != *second);
+	REQUIRE(LLVMGetModuleContext(*first) == c.llvmContext());
+}
@@ -0,0 +1,510 @@
+#include <catch.hpp>
+
+#include <chi/Context.hpp>
+#include <chi/DataType.hpp>
+#include <chi/FunctionInliner.hpp>
+#include <chi/FunctionOptimizer.hpp>
+#include <chi/GraphFunction.hpp>
+#include <chi/GraphModule.hpp>
+#include <chi/JitSession.hpp>
+#include <chi/LangModule.hpp>
+#include <chi/NameMangler.hpp>
+#include <chi/NodeCompiler.hpp>
+#include <chi/NodeInstance.hpp>
+#include <chi/NodeType.hpp>
+#include <chi/Support/Result.hpp>
+
+#include <llvm-c/Analysis.h>
+
+#include <string>
+
+using namespace chi;
+
+TEST_CASE("Pure nodes are only evaluated again when what they depend on changes",
+          "[FunctionCompiler]") {
+	Context c;
+	Result  res;
+
+	res += c.loadModule("lang");
+	REQUIRE(!!res);
+
+	auto i32 = c.langModule()->typeFromName("i32");
+
+	auto mod = c.newGraphModule("test/main");
+	mod->addDependency("lang");
+
+	auto func = mod->getOrCreateFunction("compute", {}, {NamedDataType{"ret", i32}}, {""},
+	                                     {""});
+	func->getOrCreateLocalVariable("x", i32);
+
+	// x = three + three
+	// x = x + (three + three)
+	// return x + (three + three)
+	NodeInstance *entry, *three, *sum, *getX, *add, *setX, *setXAgain, *exit;
+	REQUIRE(func->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+	REQUIRE(func->insertNode("lang", "const-int", 3, 0, 0, Uuid::random(), &three));
+	REQUIRE(func->insertNode("lang", "i32+i32", {}, 0, 0, Uuid::random(), &sum));
+	REQUIRE(func->insertNode("test/main", "_get_x", "lang:i32", 0, 0, Uuid::random(), &getX));
+	REQUIRE(func->insertNode("lang", "i32+i32", {}, 0, 0, Uuid::random(), &add));
+	REQUIRE(func->insertNode("test/main", "_set_x", "lang:i32", 0, 0, Uuid::random(), &setX));
+	REQUIRE(
+	    func->insertNode("test/main", "_set_x", "lang:i32", 0, 0, Uuid::random(), &setXAgain));
+
+	std::unique_ptr<NodeType> exitType;
+	REQUIRE(func->createExitNodeType(&exitType));
+	REQUIRE(func->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit));
+
+	REQUIRE(connectData(*three, 0, *sum, 0));
+	REQUIRE(connectData(*three, 0, *sum, 1));
+	REQUIRE(connectData(*getX, 0, *add, 0));
+	REQUIRE(connectData(*sum, 0, *add, 1));
+	REQUIRE(connectData(*sum, 0, *setX, 0));
+	REQUIRE(connectData(*add, 0, *setXAgain, 0));
+	REQUIRE(connectData(*add, 0, *exit, 0));
+
+	REQUIRE(connectExec(*entry, 0, *setX, 0));
+	REQUIRE(connectExec(*setX, 0, *setXAgain, 0));
+	REQUIRE(connectExec(*setXAgain, 0, *exit, 0));
+
+	// three is used twice, but only has to be evaluated once
+	REQUIRE(dependentPuresRecursive(*setX) == std::vector<NodeInstance*>{three, sum});
+	REQUIRE(dependentPuresRecursive(*exit) == std::vector<NodeInstance*>{getX, three, sum, add});
+
+	auto available = availablePures(*func);
+	REQUIRE(available[entry][0].empty());
+	REQUIRE(available[setX][0].empty());
+	REQUIRE(available[setXAgain][0] == std::unordered_set<NodeInstance*>{three, sum});
+
+	// setting x again changes add, so it has to be evaluated again
+	REQUIRE(available[exit][0] == std::unordered_set<NodeInstance*>{three, sum});
+
+	WHEN("The function is run") {
+		OwnedLLVMModule llmod;
+		res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+		REQUIRE(res);
+
+		// outputs that are passed straight to the nodes that use them still have valid IR
+		char* error    = nullptr;
+		auto  invalid  = LLVMVerifyModule(*llmod, LLVMReturnStatusAction, &error);
+		auto  errorStr = std::string(error);
+		LLVMDisposeMessage(error);
+		REQUIRE(errorStr == "");
+		REQUIRE(invalid == 0);
+
+		JitSession* session;
+		REQUIRE(JitSession::instance(LLVMCodeGenLevelNone, &session));
+
+		size_t moduleID;
+		REQUIRE(session->addModule(std::move(llmod), &moduleID));
+
+		void* compute;
+		REQUIRE(session->lookup(moduleID, mangleFunctionName("test/main", "compute"), &compute));
+
+		int ret = 0;
+		REQUIRE(reinterpret_cast<int (*)(int, int*)>(compute)(0, &ret) == 0);
+		REQUIRE(ret == 18);
+	}
+}
+
+TEST_CASE("Constant pure subgraphs are folded and the exec paths they rule out are skipped",
+          "[FunctionCompiler]") {
+	Context c;
+	Result  res;
+
+	res += c.loadModule("lang");
+	REQUIRE(!!res);
+
+	auto i32 = c.langModule()->typeFromName("i32");
+
+	auto mod = c.newGraphModule("test/main");
+	mod->addDependency("lang");
+
+	auto func = mod->getOrCreateFunction("compute", {}, {NamedDataType{"ret", i32}}, {""},
+	                                     {""});
+	func->getOrCreateLocalVariable("x", i32);
+
+	// if 3 < 4 then return 3 * 4 else x = 3 and return x
+	NodeInstance *entry, *three, *four, *less, *times, *branch, *getX, *setX, *exitTrue,
+	    *exitFalse;
+	REQUIRE(func->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+	REQUIRE(func->insertNode("lang", "const-int", 3, 0, 0, Uuid::random(), &three));
+	REQUIRE(func->insertNode("lang", "const-int", 4, 0, 0, Uuid::random(), &four));
+	REQUIRE(func->insertNode("lang", "i32<i32", {}, 0, 0, Uuid::random(), &less));
+	REQUIRE(func->insertNode("lang", "i32*i32", {}, 0, 0, Uuid::random(), &times));
+	REQUIRE(func->insertNode("lang", "if", {}, 0, 0, Uuid::random(), &branch));
+	REQUIRE(func->insertNode("test/main", "_get_x", "lang:i32", 0, 0, Uuid::random(), &getX));
+	REQUIRE(func->insertNode("test/main", "_set_x", "lang:i32", 0, 0, Uuid::random(), &setX));
+
+	for (auto exit : {&exitTrue, &exitFalse}) {
+		std::unique_ptr<NodeType> exitType;
+		REQUIRE(func->createExitNodeType(&exitType));
+		REQUIRE(func->insertNode(std::move(exitType), 0, 0, Uuid::random(), exit));
+	}
+
+	REQUIRE(connectData(*three, 0, *less, 0));
+	REQUIRE(connectData(*four, 0, *less, 1));
+	REQUIRE(connectData(*three, 0, *times, 0));
+	REQUIRE(connectData(*four, 0, *times, 1));
+	REQUIRE(connectData(*less, 0, *branch, 0));
+	REQUIRE(connectData(*times, 0, *exitTrue, 0));
+	REQUIRE(connectData(*three, 0, *setX, 0));
+	REQUIRE(connectData(*getX, 0, *exitFalse, 0));
+
+	REQUIRE(connectExec(*entry, 0, *branch, 0));
+	REQUIRE(connectExec(*branch, 0, *exitTrue, 0));
+	REQUIRE(connectExec(*branch, 1, *setX, 0));
+	REQUIRE(connectExec(*setX, 0, *exitFalse, 0));
+
+	auto opts = optimizeFunction(*func);
+
+	REQUIRE(LLVMConstIntGetSExtValue(opts.constant(*times, 0)) == 12);
+	REQUIRE(LLVMConstIntGetZExtValue(opts.constant(*less, 0)) == 1);
+	REQUIRE(opts.constant(*getX, 0) == nullptr);
+
+	REQUIRE(opts.reachable(*branch, 0));
+	REQUIRE_FALSE(opts.reachable(*branch, 1));
+	REQUIRE_FALSE(opts.reachable(*setX, 0));
+	REQUIRE(opts.reachableExecOutputs.count(exitFalse) == 0);
+
+	WHEN("The function is compiled") {
+		OwnedLLVMModule llmod;
+		res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+		REQUIRE(res);
+
+		char* error    = nullptr;
+		auto  invalid  = LLVMVerifyModule(*llmod, LLVMReturnStatusAction, &error);
+		auto  errorStr = std::string(error);
+		LLVMDisposeMessage(error);
+		REQUIRE(errorStr == "");
+		REQUIRE(invalid == 0);
+
+		// nothing on the false side is compiled
+		auto llfunc = LLVMGetNamedFunction(
+		    *llmod, mangleSpecializedFunctionName("test/main", "compute", 0).c_str());
+		REQUIRE(llfunc != nullptr);
+		for (auto block = LLVMGetFirstBasicBlock(llfunc); block != nullptr;
+		     block      = LLVMGetNextBasicBlock(block)) {
+			std::string name = LLVMGetBasicBlockName(block);
+			REQUIRE(name.find(setX->stringId()) == std::string::npos);
+			REQUIRE(name.find(exitFalse->stringId()) == std::string::npos);
+		}
+
+		JitSession* session;
+		REQUIRE(JitSession::instance(LLVMCodeGenLevelNone, &session));
+
+		size_t moduleID;
+		REQUIRE(session->addModule(std::move(llmod), &moduleID));
+
+		void* compute;
+		REQUIRE(session->lookup(moduleID, mangleFunctionName("test/main", "compute"), &compute));
+
+		int ret = 0;
+		REQUIRE(reinterpret_cast<int (*)(int, int*)>(compute)(0, &ret) == 0);
+		REQUIRE(ret == 12);
+	}
+}
+
+TEST_CASE("Folded bools are made in the module's LLVM context", "[FunctionCompiler]") {
+	Context c;
+	Result  res;
+
+	res += c.loadModule("lang");
+	REQUIRE(!!res);
+
+	auto mod = c.newGraphModule("test/main");
+	mod->addDependency("lang");
+
+	auto func = mod->getOrCreateFunction(
+	    "compute", {}, {NamedDataType{"r", c.langModule()->typeFromName("i1")}}, {""}, {""});
+
+	// return true, which is stored straight into the output instead of going to a branch
+	NodeInstance *entry, *yes, *exit;
+	REQUIRE(func->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+	REQUIRE(func->insertNode("lang", "const-bool", true, 0, 0, Uuid::random(), &yes));
+
+	std::unique_ptr<NodeType> exitType;
+	REQUIRE(func->createExitNodeType(&exitType));
+	REQUIRE(func->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit));
+
+	REQUIRE(connectData(*yes, 0, *exit, 0));
+	REQUIRE(connectExec(*entry, 0, *exit, 0));
+
+	auto opts = optimizeFunction(*func);
+	REQUIRE(LLVMConstIntGetZExtValue(opts.constant(*yes, 0)) == 1);
+
+	OwnedLLVMModule llmod;
+	res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+	REQUIRE(res);
+
+	char* error    = nullptr;
+	auto  invalid  = LLVMVerifyModule(*llmod, LLVMReturnStatusAction, &error);
+	auto  errorStr = std::string(error);
+	LLVMDisposeMessage(error);
+	REQUIRE(errorStr == "");
+	REQUIRE(invalid == 0);
+}
+
+TEST_CASE("Graph functions get a clone for each exec input that calls go straight to",
+          "[FunctionCompiler]") {
+	Context c;
+	Result  res;
+
+	res += c.loadModule("lang");
+	REQUIRE(!!res);
+
+	auto i32 = c.langModule()->typeFromName("i32");
+
+	auto mod = c.newGraphModule("test/main");
+	mod->addDependency("lang");
+
+	// pick returns 10 through a when it's called through a. Called through b, it calls itself
+	// through a and then returns 20 through b. Calling itself keeps it from being inlined.
+	auto pick = mod->getOrCreateFunction("pick", {}, {NamedDataType{"ret", i32}}, {"a", "b"},
+	                                     {"a", "b"});
+	{
+		NodeInstance *entry, *ten, *twenty, *call, *exitA, *exitB;
+		REQUIRE(pick->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+		REQUIRE(pick->insertNode("lang", "const-int", 10, 0, 0, Uuid::random(), &ten));
+		REQUIRE(pick->insertNode("lang", "const-int", 20, 0, 0, Uuid::random(), &twenty));
+		REQUIRE(pick->insertNode("test/main", "pick", {}, 0, 0, Uuid::random(), &call));
+
+		for (auto exit : {&exitA, &exitB}) {
+			std::unique_ptr<NodeType> exitType;
+			REQUIRE(pick->createExitNodeType(&exitType));
+			REQUIRE(pick->insertNode(std::move(exitType), 0, 0, Uuid::random(), exit));
+		}
+
+		REQUIRE(connectData(*ten, 0, *exitA, 0));
+		REQUIRE(connectData(*twenty, 0, *exitB, 0));
+		REQUIRE(connectExec(*entry, 0, *exitA, 0));
+		REQUIRE(connectExec(*entry, 1, *call, 0));
+		REQUIRE(connectExec(*call, 0, *exitB, 1));
+		REQUIRE(connectExec(*call, 1, *exitB, 1));
+	}
+
+	// main calls pick through b and returns what it got
+	auto main = mod->getOrCreateFunction("main", {}, {NamedDataType{"ret", i32}}, {""}, {""});
+	{
+		NodeInstance *entry, *call, *exitA, *exitB;
+		REQUIRE(main->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+		REQUIRE(main->insertNode("test/main", "pick", {}, 0, 0, Uuid::random(), &call));
+
+		for (auto exit : {&exitA, &exitB}) {
+			std::unique_ptr<NodeType> exitType;
+			REQUIRE(main->createExitNodeType(&exitType));
+			REQUIRE(main->insertNode(std::move(exitType), 0, 0, Uuid::random(), exit));
+		}
+
+		REQUIRE(connectData(*call, 0, *exitA, 0));
+		REQUIRE(connectData(*call, 0, *exitB, 0));
+		REQUIRE(connectExec(*entry, 0, *call, 1));
+		REQUIRE(connectExec(*call, 0, *exitA, 0));
+		REQUIRE(connectExec(*call, 1, *exitB, 0));
+	}
+
+	// pick is inlined into main once, but not into itself
+	REQUIRE(inlinedCallees(*main) == std::vector<const GraphFunction*>{pick});
+	REQUIRE(inlinedCallees(*pick).empty());
+
+	OwnedLLVMModule llmod;
+	res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+	REQUIRE(res);
+
+	char* error    = nullptr;
+	auto  invalid  = LLVMVerifyModule(*llmod, LLVMReturnStatusAction, &error);
+	auto  errorStr = std::string(error);
+	LLVMDisposeMessage(error);
+	REQUIRE(errorStr == "");
+	REQUIRE(invalid == 0);
+
+	// the clones don't take the exec input ID
+	auto pickA =
+	    LLVMGetNamedFunction(*llmod, mangleSpecializedFunctionName("test/main", "pick", 0).c_str());
+	auto pickB =
+	    LLVMGetNamedFunction(*llmod, mangleSpecializedFunctionName("test/main", "pick", 1).c_str());
+	REQUIRE(pickA != nullptr);
+	REQUIRE(pickB != nullptr);
+	auto dispatcher =
+	    LLVMGetNamedFunction(*llmod, mangleFunctionName("test/main", "pick").c_str());
+	REQUIRE(LLVMCountParams(pickB) == 1);
+	REQUIRE(LLVMCountParams(dispatcher) == 2);
+	REQUIRE(unmangleFunctionName(mangleSpecializedFunctionName("test/main", "pick", 1)) ==
+	        std::pair<std::string, std::string>{"test/main", "pick"});
+
+	// and calls to pick go to the clone for a, without the dispatcher
+	for (auto caller : {mangleSpecializedFunctionName("test/main", "main", 0),
+	                    mangleSpecializedFunctionName("test/main", "pick", 1)}) {
+		auto callsPickA = false;
+		auto llfunc     = LLVMGetNamedFunction(*llmod, caller.c_str());
+		REQUIRE(llfunc != nullptr);
+		for (auto block = LLVMGetFirstBasicBlock(llfunc); block != nullptr;
+		     block      = LLVMGetNextBasicBlock(block)) {
+			for (auto inst = LLVMGetFirstInstruction(block); inst != nullptr;
+			     inst      = LLVMGetNextInstruction(inst)) {
+				if (LLVMIsACallInst(inst) != nullptr) {
+					REQUIRE(LLVMGetCalledValue(inst) != dispatcher);
+					REQUIRE(LLVMGetCalledValue(inst) != pickB);
+					if (LLVMGetCalledValue(inst) == pickA) { callsPickA = true; }
+				}
+			}
+		}
+		REQUIRE(callsPickA);
+	}
+
+	JitSession* session;
+	REQUIRE(JitSession::instance(LLVMCodeGenLevelNone, &session));
+
+	size_t moduleID;
+	REQUIRE(session->addModule(std::move(llmod), &moduleID));
+
+	void *pickAddress, *mainAddress;
+	REQUIRE(session->lookup(moduleID, mangleFunctionName("test/main", "pick"), &pickAddress));
+	REQUIRE(session->lookup(moduleID, mangleFunctionName("test/main", "main"), &mainAddress));
+
+	// called with an exec input ID, it still goes to the right clone
+	int ret = 0;
+	REQUIRE(reinterpret_cast<int (*)(int, int*)>(pickAddress)(0, &ret) == 0);
+	REQUIRE(ret == 10);
+	REQUIRE(reinterpret_cast<int (*)(int, int*)>(pickAddress)(1, &ret) == 1);
+	REQUIRE(ret == 20);
+
+	REQUIRE(reinterpret_cast<int (*)(int, int*)>(mainAddress)(0, &ret) == 0);
+	REQUIRE(ret == 20);
+}
+
+TEST_CASE("Small functions are inlined, even from other modules", "[FunctionCompiler]") {
+	Context c;
+	Result  res;
+
+	res += c.loadModule("lang");
+	REQUIRE(!!res);
+
+	auto i32 = c.langModule()->typeFromName("i32");
+
+	// clamp goes through low with 0 if x < 0, and through ok with y = x + 1 otherwise
+	auto lib = c.newGraphModule("test/lib");
+	lib->addDependency("lang");
+	auto clamp = lib->getOrCreateFunction("clamp", {NamedDataType{"x", i32}},
+	                                      {NamedDataType{"ret", i32}}, {""}, {"low", "ok"});
+	clamp->getOrCreateLocalVariable("y", i32);
+	{
+		NodeInstance *entry, *zero, *one, *less, *plus, *branch, *setY, *getY, *exitLow, *exitOk;
+		REQUIRE(clamp->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+		REQUIRE(clamp->insertNode("lang", "const-int", 0, 0, 0, Uuid::random(), &zero));
+		REQUIRE(clamp->insertNode("lang", "const-int", 1, 0, 0, Uuid::random(), &one));
+		REQUIRE(clamp->insertNode("lang", "i32<i32", {}, 0, 0, Uuid::random(), &less));
+		REQUIRE(clamp->insertNode("lang", "i32+i32", {}, 0, 0, Uuid::random(), &plus));
+		REQUIRE(clamp->insertNode("lang", "if", {}, 0, 0, Uuid::random(), &branch));
+		REQUIRE(
+		    clamp->insertNode("test/lib", "_set_y", "lang:i32", 0, 0, Uuid::random(), &setY));
+		REQUIRE(
+		    clamp->insertNode("test/lib", "_get_y", "lang:i32", 0, 0, Uuid::random(), &getY));
+
+		for (auto exit : {&exitLow, &exitOk}) {
+			std::unique_ptr<NodeType> exitType;
+			REQUIRE(clamp->createExitNodeType(&exitType));
+			REQUIRE(clamp->insertNode(std::move(exitType), 0, 0, Uuid::random(), exit));
+		}
+
+		REQUIRE(connectData(*entry, 0, *less, 0));
+		REQUIRE(connectData(*zero, 0, *less, 1));
+		REQUIRE(connectData(*less, 0, *branch, 0));
+		REQUIRE(connectData(*zero, 0, *exitLow, 0));
+		REQUIRE(connectData(*entry, 0, *plus, 0));
+		REQUIRE(connectData(*one, 0, *plus, 1));
+		REQUIRE(connectData(*plus, 0, *setY, 0));
+		REQUIRE(connectData(*getY, 0, *exitOk, 0));
+
+		REQUIRE(connectExec(*entry, 0, *branch, 0));
+		REQUIRE(connectExec(*branch, 0, *exitLow, 0));
+		REQUIRE(connectExec(*branch, 1, *setY, 0));
+		REQUIRE(connectExec(*setY, 0, *exitOk, 1));
+	}
+
+	// compute returns clamp(clamp(x)) if the first one is ok, and 100 otherwise
+	auto mod = c.newGraphModule("test/main");
+	mod->addDependency("lang");
+	mod->addDependency("test/lib");
+	auto compute = mod->getOrCreateFunction("compute", {NamedDataType{"x", i32}},
+	                                        {NamedDataType{"ret", i32}}, {""}, {""});
+	{
+		NodeInstance *entry, *first, *second, *hundred, *exitLow, *exitOk;
+		REQUIRE(compute->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+		REQUIRE(compute->insertNode("test/lib", "clamp", {}, 0, 0, Uuid::random(), &first));
+		REQUIRE(compute->insertNode("test/lib", "clamp", {}, 0, 0, Uuid::random(), &second));
+		REQUIRE(compute->insertNode("lang", "const-int", 100, 0, 0, Uuid::random(), &hundred));
+
+		for (auto exit : {&exitLow, &exitOk}) {
+			std::unique_ptr<NodeType> exitType;
+			REQUIRE(compute->createExitNodeType(&exitType));
+			REQUIRE(compute->insertNode(std::move(exitType), 0, 0, Uuid::random(), exit));
+		}
+
+		REQUIRE(connectData(*entry, 0, *first, 0));
+		REQUIRE(connectData(*first, 0, *second, 0));
+		REQUIRE(connectData(*hundred, 0, *exitLow, 0));
+		REQUIRE(connectData(*second, 0, *exitOk, 0));
+
+		REQUIRE(connectExec(*entry, 0, *first, 0));
+		REQUIRE(connectExec(*first, 0, *exitLow, 0));
+		REQUIRE(connectExec(*first, 1, *second, 0));
+		REQUIRE(connectExec(*second, 0, *exitOk, 0));
+		REQUIRE(connectExec(*second, 1, *exitOk, 0));
+	}
+
+	REQUIRE(inlineCost(*clamp) <= inlineThreshold);
+	REQUIRE(inlinedCallees(*compute) == std::vector<const GraphFunction*>{clamp, clamp});
+
+	InlinedFunction inlined;
+	REQUIRE(inlineCalls(*compute, &inlined));
+	REQUIRE(inlined.function != nullptr);
+	REQUIRE(inlined.function->nodesWithType("test/lib", "clamp").empty());
+	REQUIRE(inlined.function->nodes().size() == inlined.origins.size());
+
+	// compute itself isn't changed
+	REQUIRE(compute->nodesWithType("test/lib", "clamp").size() == 2);
+	REQUIRE(compute->localVariables().empty());
+
+	OwnedLLVMModule llmod;
+	res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+	REQUIRE(res);
+
+	char* error    = nullptr;
+	auto  invalid  = LLVMVerifyModule(*llmod, LLVMReturnStatusAction, &error);
+	auto  errorStr = std::string(error);
+	LLVMDisposeMessage(error);
+	REQUIRE(errorStr == "");
+	REQUIRE(invalid == 0);
+
+	// there's nothing left to call
+	auto llfunc = LLVMGetNamedFunction(
+	    *llmod, mangleSpecializedFunctionName("test/main", "compute", 0).c_str());
+	REQUIRE(llfunc != nullptr);
+	for (auto block = LLVMGetFirstBasicBlock(llfunc); block != nullptr;
+	     block      = LLVMGetNextBasicBlock(block)) {
+		for (auto inst = LLVMGetFirstInstruction(block); inst != nullptr;
+		     inst      = LLVMGetNextInstruction(inst)) {
+			if (LLVMIsACallInst(inst) != nullptr) {
+				REQUIRE(LLVMIsAIntrinsicInst(inst) != nullptr);
+			}
+		}
+	}
+
+	JitSession* session;
+	REQUIRE(JitSession::instance(LLVMCodeGenLevelNone, &session));
+
+	size_t moduleID;
+	REQUIRE(session->addModule(std::move(llmod), &moduleID));
+
+	void* address;
+	REQUIRE(session->lookup(moduleID, mangleFunctionName("test/main", "compute"), &address));
+	auto computeFunc = reinterpret_cast<int (*)(int, int, int*)>(address);
+
+	int ret = 0;
+	REQUIRE(computeFunc(0, -5, &ret) == 0);
+	REQUIRE(ret == 100);
+	REQUIRE(computeFunc(0, 3, &ret) == 0);
+	REQUIRE(ret == 5);
+	REQUIRE(computeFunc(0, 0, &ret) == 0);
+	REQUIRE(ret == 2);
+}
@@ -1,11 +1,24 @@
 #include <catch.hpp>
 
 #include <chi/Context.hpp>
+#include <chi/GraphFunction.hpp>
 #include <chi/GraphModule.hpp>
 #include <chi/GraphStruct.hpp>
+#include <chi/LangModule.hpp>
+#include <chi/NameMangler.hpp>
+#include <chi/NodeInstance.hpp>
+#include <chi/NodeType.hpp>
 #include <chi/Support/Result.hpp>
+#include <chi/Support/TempFile.hpp>
+
+#include <llvm-c/Core.h>
+
+#include <filesystem>
+#include <fstream>
+#include <map>
 
 using namespace chi;
+namespace fs = std::filesystem;
 
 TEST_CASE("GraphModuleTest", "[module]") {
 	Context c;
@@ -105,3 +118,96 @@ TEST_CASE("GraphModuleTest", "[module]") {
 		}
 	}
 }
+
+TEST_CASE("GraphModules only recompile the functions that changed", "[module]") {
+	fs::path workspaceDir = makeTempPath();
+	fs::create_directories(workspaceDir);
+	{ std::ofstream stream{workspaceDir / ".chigraphworkspace"}; }
+
+	Context c{workspaceDir};
+	Result  res;
+
+	auto mod = c.newGraphModule("test/main");
+	REQUIRE(mod->addDependency("lang"));
+
+	auto makeFunction = [&](const std::string& name) {
+		auto func = mod->getOrCreateFunction(name, {}, {}, {""}, {""});
+
+		NodeInstance* entry;
+		REQUIRE(func->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+
+		std::unique_ptr<NodeType> exitType;
+		REQUIRE(func->createExitNodeType(&exitType));
+		NodeInstance* exit;
+		REQUIRE(func->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit));
+
+		REQUIRE(connectExec(*entry, 0, *exit, 0));
+
+		return func;
+	};
+	auto a = makeFunction("a");
+	auto b = makeFunction("b");
+
+	auto compile = [&] {
+		OwnedLLVMModule llmod;
+		res = c.compileModule("test/main", CompileSettings::Default, &llmod);
+		REQUIRE(res);
+
+		for (auto name : {"a", "b"}) {
+			INFO(name);
+			auto fn = LLVMGetNamedFunction(*llmod, mangleFunctionName("test/main", name).c_str());
+			REQUIRE(fn != nullptr);
+			REQUIRE(LLVMIsDeclaration(fn) == 0);
+		}
+	};
+	auto cacheFiles = [&] {
+		std::map<std::string, fs::file_time_type> files;
+		for (const auto& entry : fs::directory_iterator{mod->functionCacheDirectory()}) {
+			files[entry.path().filename().string()] = entry.last_write_time();
+		}
+		return files;
+	};
+
+	THEN("Each function's nodes get their own block of lines") {
+		auto lineByNode = mod->createLineNumberAssoc().first;
+		REQUIRE(lineByNode.size() == 4);
+
+		for (const auto& node : a->nodes()) {
+			REQUIRE(lineByNode[node.second.get()] >= 1);
+			REQUIRE(lineByNode[node.second.get()] <= 2);
+		}
+		for (const auto& node : b->nodes()) {
+			REQUIRE(lineByNode[node.second.get()] >= GraphModule::linesPerFunction + 1);
+			REQUIRE(lineByNode[node.second.get()] <= GraphModule::linesPerFunction + 2);
+		}
+	}
+
+	WHEN("The module is compiled") {
+		compile();
+
+		auto filesBefore = cacheFiles();
+		REQUIRE(filesBefore.size() == 2);
+
+		AND_WHEN("One function is changed and it's compiled again") {
+			b->getOrCreateLocalVariable("local", c.langModule()->typeFromName("i32"));
+			compile();
+
+			THEN("Only that function's cache is replaced") {
+				auto filesAfter = cacheFiles();
+				REQUIRE(filesAfter.size() == 2);
+
+				size_t kept = 0;
+				for (const auto& file : filesBefore) {
+					auto iter = filesAfter.find(file.first);
+					if (iter != filesAfter.end()) {
+						REQUIRE(iter->second == file.second);
+						++kept;
+					}
+				}
+				REQUIRE(kept == 1);
+			}
+		}
+	}
+
+	fs::remove_all(workspaceDir);
+}
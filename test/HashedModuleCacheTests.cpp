@@ -0,0 +1,133 @@
+#include <catch.hpp>
+
+#include <chi/Context.hpp>
+#include <chi/DataType.hpp>
+#include <chi/GraphFunction.hpp>
+#include <chi/GraphModule.hpp>
+#include <chi/HashedModuleCache.hpp>
+#include <chi/LangModule.hpp>
+#include <chi/NodeInstance.hpp>
+#include <chi/NodeType.hpp>
+#include <chi/Owned.hpp>
+#include <chi/Support/Result.hpp>
+#include <chi/Support/TempFile.hpp>
+
+#include <llvm-c/Core.h>
+
+#include <filesystem>
+#include <fstream>
+
+using namespace chi;
+namespace fs = std::filesystem;
+
+TEST_CASE("HashedModuleCache keys caches on module contents", "[HashedModuleCache]") {
+	fs::path workspaceDir = makeTempPath();
+	fs::create_directories(workspaceDir);
+	{ std::ofstream stream{workspaceDir / ".chigraphworkspace"}; }
+
+	Context           c{workspaceDir};
+	HashedModuleCache cache{c};
+	Result            res;
+
+	// a depends on b
+	auto b = c.newGraphModule("test/b");
+	REQUIRE(b->addDependency("lang"));
+	auto bFunc = b->getOrCreateFunction("fn", {}, {}, {""}, {""});
+
+	auto a = c.newGraphModule("test/a");
+	REQUIRE(a->addDependency("test/b"));
+	auto aFunc = a->getOrCreateFunction("fn", {}, {}, {""}, {""});
+
+	auto hashOf = [&](const fs::path& name) {
+		std::string hash;
+		res = cache.moduleHash(name, &hash);
+		REQUIRE(res);
+		REQUIRE(hash.size() == 40);
+		return hash;
+	};
+
+	auto aHash = hashOf("test/a");
+	auto bHash = hashOf("test/b");
+
+	REQUIRE(!HashedModuleCache::compilerVersion().empty());
+
+	THEN("Hashes are stable and depend on the module") {
+		REQUIRE(hashOf("test/a") == aHash);
+		REQUIRE(aHash != bHash);
+	}
+
+	THEN("Changing a module changes its hash") {
+		REQUIRE(aFunc->getOrInsertEntryNode(0, 0));
+		REQUIRE(hashOf("test/a") != aHash);
+	}
+
+	THEN("Changing the body of a dependency doesn't change the hash") {
+		REQUIRE(bFunc->getOrInsertEntryNode(0, 0));
+		REQUIRE(hashOf("test/b") != bHash);
+		REQUIRE(hashOf("test/a") == aHash);
+	}
+
+	THEN("Changing the interface of a dependency changes the hash") {
+		bFunc->addDataInput(c.langModule()->typeFromName("i32"), "in");
+		REQUIRE(hashOf("test/a") != aHash);
+	}
+
+	THEN("Changing the body of a dependency's function that's inlined changes the hash") {
+		NodeInstance *bEntry, *bExit, *aEntry, *call, *aExit;
+		REQUIRE(bFunc->getOrInsertEntryNode(0, 0, Uuid::random(), &bEntry));
+		REQUIRE(aFunc->getOrInsertEntryNode(0, 0, Uuid::random(), &aEntry));
+		REQUIRE(aFunc->insertNode("test/b", "fn", {}, 0, 0, Uuid::random(), &call));
+		for (auto [func, exit] : {std::pair{bFunc, &bExit}, std::pair{aFunc, &aExit}}) {
+			std::unique_ptr<NodeType> exitType;
+			REQUIRE(func->createExitNodeType(&exitType));
+			REQUIRE(func->insertNode(std::move(exitType), 0, 0, Uuid::random(), exit));
+		}
+		REQUIRE(connectExec(*bEntry, 0, *bExit, 0));
+		REQUIRE(connectExec(*aEntry, 0, *call, 0));
+		REQUIRE(connectExec(*call, 0, *aExit, 0));
+
+		auto callingHash = hashOf("test/a");
+		REQUIRE(bFunc->insertNode("lang", "const-int", 1, 0, 0));
+		REQUIRE(hashOf("test/a") != callingHash);
+	}
+
+	WHEN("A module is cached") {
+		auto llmod = OwnedLLVMModule(LLVMModuleCreateWithNameInContext("test/a", c.llvmContext()));
+		res        = cache.cacheModule("test/a", *llmod, {});
+		REQUIRE(res);
+
+		auto cachePath = cache.cachePathForModule("test/a", aHash);
+		REQUIRE(fs::is_regular_file(cachePath));
+
+		auto summaryPath = cache.summaryPathForModule("test/a", aHash);
+		REQUIRE(fs::is_regular_file(summaryPath));
+
+		THEN("It can be retrieved, no matter how old the module or cache look") {
+			fs::last_write_time(cachePath, ModuleCache::time_point{});
+			REQUIRE(*cache.retrieveFromCache("test/a", ModuleCache::time_point::max()) != nullptr);
+		}
+
+		THEN("It isn't retrieved after the module changes") {
+			REQUIRE(aFunc->getOrInsertEntryNode(0, 0));
+			REQUIRE(*cache.retrieveFromCache("test/a", {}) == nullptr);
+
+			AND_THEN("Caching it again replaces the old cache") {
+				res = cache.cacheModule("test/a", *llmod, {});
+				REQUIRE(res);
+
+				REQUIRE_FALSE(fs::exists(cachePath));
+				REQUIRE_FALSE(fs::exists(summaryPath));
+				REQUIRE(*cache.retrieveFromCache("test/a", {}) != nullptr);
+			}
+		}
+
+		THEN("Invalidating it removes it") {
+			cache.invalidateCache("test/a");
+			REQUIRE_FALSE(fs::exists(cachePath));
+			REQUIRE_FALSE(fs::exists(summaryPath));
+			REQUIRE(*cache.retrieveFromCache("test/a", {}) == nullptr);
+		}
+	}
+
+	fs::remove_all(workspaceDir);
+}
@@ -0,0 +1,239 @@
+#include <catch.hpp>
+
+#include <chi/Context.hpp>
+#include <chi/JitSession.hpp>
+#include <chi/Owned.hpp>
+#include <chi/Support/Result.hpp>
+
+#include <llvm-c/Core.h>
+#include <llvm-c/IRReader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace chi;
+namespace fs = std::filesystem;
+
+namespace {
+
+OwnedLLVMModule parseModule(Context& c, const std::string& ir) {
+	auto buffer = LLVMCreateMemoryBufferWithMemoryRangeCopy(ir.c_str(), ir.size(), "test");
+
+	OwnedLLVMModule mod;
+	OwnedMessage    message;
+	// takes the buffer
+	REQUIRE(LLVMParseIRInContext(c.llvmContext(), buffer, &*mod, &*message) == 0);
+
+	return mod;
+}
+
+// value() calls an internal function that reads a global, and unused() is never called
+std::string moduleReturning(int value) {
+	return R"(
+@offset = internal global i32 )" +
+	       std::to_string(value - 1) + R"(
+
+define internal i32 @addOffset(i32 %x) {
+  %offset = load i32, i32* @offset
+  %ret = add i32 %x, %offset
+  ret i32 %ret
+}
+
+define i32 @unused() {
+  ret i32 0
+}
+
+define i32 @value() {
+  %ret = call i32 @addOffset(i32 1)
+  ret i32 %ret
+}
+)";
+}
+
+}  // anonymous namespace
+
+TEST_CASE("JitSessions compile functions the first time they are called", "[JitSession]") {
+	Context c;
+	Result  res;
+
+	JitSession* session;
+	res = JitSession::instance(LLVMCodeGenLevelNone, &session);
+	REQUIRE(res);
+
+	JitSession* again;
+	REQUIRE(JitSession::instance(LLVMCodeGenLevelNone, &again));
+	REQUIRE(again == session);
+
+	auto before = session->stats();
+
+	size_t firstID;
+	res = session->addModule(parseModule(c, moduleReturning(42)), &firstID);
+	REQUIRE(res);
+
+	// modules can define the same symbols as each other
+	size_t secondID;
+	res = session->addModule(parseModule(c, moduleReturning(7)), &secondID);
+	REQUIRE(res);
+	REQUIRE(firstID != secondID);
+
+	REQUIRE(session->stats().modulesAdded == before.modulesAdded + 2);
+	REQUIRE(session->stats().functionsCompiled == before.functionsCompiled);
+
+	void* first;
+	res = session->lookup(firstID, "value", &first);
+	REQUIRE(res);
+
+	void* second;
+	res = session->lookup(secondID, "value", &second);
+	REQUIRE(res);
+
+	// looking them up doesn't compile them
+	REQUIRE(session->stats().functionsCompiled == before.functionsCompiled);
+
+	REQUIRE(reinterpret_cast<int (*)()>(first)() == 42);
+	REQUIRE(reinterpret_cast<int (*)()>(second)() == 7);
+
+	// value and addOffset, from each module, but never unused
+	REQUIRE(session->stats().functionsCompiled == before.functionsCompiled + 4);
+
+	void* missing;
+	REQUIRE(!session->lookup(firstID, "notthere", &missing));
+
+	WHEN("A module is removed") {
+		REQUIRE(session->removeModule(firstID));
+
+		// it's gone, but the other one is still there
+		REQUIRE(!session->lookup(firstID, "value", &missing));
+		REQUIRE(!session->removeModule(firstID));
+		REQUIRE(reinterpret_cast<int (*)()>(second)() == 7);
+
+		// and another module can be added with the same symbols
+		size_t thirdID;
+		REQUIRE(session->addModule(parseModule(c, moduleReturning(42)), &thirdID));
+
+		void* third;
+		REQUIRE(session->lookup(thirdID, "value", &third));
+		REQUIRE(reinterpret_cast<int (*)()>(third)() == 42);
+		REQUIRE(session->removeModule(thirdID));
+	}
+
+	WHEN("A module is interpreted") {
+		auto mod  = parseModule(c, moduleReturning(3));
+		auto func = LLVMGetNamedFunction(*mod, "value");
+
+		LLVMGenericValueRef ret;
+		res = interpretLLVMIR(std::move(mod), LLVMCodeGenLevelNone, {}, func, &ret);
+		REQUIRE(res);
+		REQUIRE(LLVMGenericValueToInt(ret, true) == 3);
+		LLVMDisposeGenericValue(ret);
+	}
+}
+
+TEST_CASE("JitSessions compile functions that are first called from several threads at once",
+          "[JitSession]") {
+	Context c;
+
+	JitSession* session;
+	REQUIRE(JitSession::instance(LLVMCodeGenLevelNone, &session));
+
+	// f0 returns 0, and each one after it adds one to the one before
+	std::string ir = "define i32 @f0() {\n  ret i32 0\n}\n";
+	for (auto idx = 1; idx < 32; ++idx) {
+		ir += "define i32 @f" + std::to_string(idx) + "() {\n  %last = call i32 @f" +
+		      std::to_string(idx - 1) + "()\n  %ret = add i32 %last, 1\n  ret i32 %ret\n}\n";
+	}
+
+	size_t moduleID;
+	REQUIRE(session->addModule(parseModule(c, ir), &moduleID));
+
+	std::vector<void*> funcs(32);
+	for (auto idx = 0; idx < 32; ++idx) {
+		REQUIRE(session->lookup(moduleID, "f" + std::to_string(idx), &funcs[idx]));
+	}
+
+	// each thread starts at a different function, so they compile them at the same time
+	std::vector<int>         wrong(8, 0);
+	std::vector<std::thread> threads;
+	for (auto thread = 0; thread < 8; ++thread) {
+		threads.emplace_back([&, thread] {
+			for (auto idx = 0; idx < 32; ++idx) {
+				auto func = (idx + thread * 4) % 32;
+				wrong[thread] += reinterpret_cast<int (*)()>(funcs[func])() != func;
+			}
+		});
+	}
+	for (auto& thread : threads) { thread.join(); }
+
+	REQUIRE(wrong == std::vector<int>(8, 0));
+}
+
+TEST_CASE("JitSessions load native code from the object cache", "[JitSession]") {
+	Context c;
+	Result  res;
+
+	auto cacheDir = fs::temp_directory_path() / "chi-jit-object-cache-test";
+	fs::remove_all(cacheDir);
+
+	// its own optimization level, so the other tests don't share the cache
+	JitSession* session;
+	res = JitSession::instance(LLVMCodeGenLevelLess, &session);
+	REQUIRE(res);
+	session->setObjectCacheDirectory(cacheDir);
+	REQUIRE(session->objectCacheDirectory() == cacheDir);
+
+	auto runValue = [&](int value) {
+		size_t id;
+		REQUIRE(session->addModule(parseModule(c, moduleReturning(value)), &id));
+
+		void* func;
+		REQUIRE(session->lookup(id, "value", &func));
+		return reinterpret_cast<int (*)()>(func)();
+	};
+
+	auto before = session->stats();
+	REQUIRE(runValue(42) == 42);
+
+	// value, addOffset and the globals
+	auto first = session->stats();
+	REQUIRE(first.objectCacheMisses == before.objectCacheMisses + 3);
+	REQUIRE(first.objectCacheHits == before.objectCacheHits);
+
+	// the code and the time it took to generate it, for each one
+	auto cached = std::distance(fs::directory_iterator{cacheDir}, fs::directory_iterator{});
+	REQUIRE(cached == 6);
+
+	WHEN("The same module is added again") {
+		// it needs its own globals, so it's kept apart from the first one and cached separately.
+		// The next process to add it reuses what the first one cached.
+		REQUIRE(runValue(42) == 42);
+
+		auto second = session->stats();
+		REQUIRE(second.objectCacheMisses == first.objectCacheMisses + 3);
+		REQUIRE(second.codegenTime > first.codegenTime);
+	}
+
+	WHEN("The cache is pruned") {
+		// it's all just been used
+		REQUIRE(session->pruneObjectCache() == 0);
+
+		// but if one hadn't been in a while, it's removed with its time
+		auto object = std::find_if(fs::directory_iterator{cacheDir}, fs::directory_iterator{},
+		                           [](const auto& entry) {
+			                           return entry.path().extension() == ".o";
+		                           })
+		                  ->path();
+		fs::last_write_time(object, fs::file_time_type::clock::now() - std::chrono::hours{24 * 8});
+
+		REQUIRE(session->pruneObjectCache() == 1);
+		REQUIRE(!fs::exists(object));
+		REQUIRE(!fs::exists(fs::path{object}.replace_extension(".time")));
+		REQUIRE(std::distance(fs::directory_iterator{cacheDir}, fs::directory_iterator{}) == 4);
+	}
+
+	session->setObjectCacheDirectory({});
+	fs::remove_all(cacheDir);
+}
@@ -2,10 +2,21 @@
 
 #include <chi/Context.hpp>
 #include <chi/DataType.hpp>
+#include <chi/GraphFunction.hpp>
+#include <chi/GraphModule.hpp>
+#include <chi/HashedModuleCache.hpp>
+#include <chi/JitSession.hpp>
 #include <chi/LangModule.hpp>
+#include <chi/NameMangler.hpp>
+#include <chi/NodeInstance.hpp>
 #include <chi/NodeType.hpp>
+#include <chi/Owned.hpp>
 #include <chi/Support/Result.hpp>
 
+#include <llvm-c/Analysis.h>
+
+#include <vector>
+
 using namespace chi;
 
 TEST_CASE("LangModule", "[module]") {
@@ -140,3 +151,711 @@ TEST_CASE("LangModule", "[module]") {
 		}
 	}
 }
+
+TEST_CASE("LangModule has vectors and nodes that work on them lane by lane", "[module]") {
+	Context c;
+	Result  res;
+
+	res += c.loadModule("lang");
+	REQUIRE(!!res);
+
+	auto lang = c.langModule();
+	auto i32  = lang->typeFromName("i32");
+
+	auto i32x4 = lang->typeFromName("i32x4");
+	REQUIRE(i32x4.valid());
+	REQUIRE(LLVMGetTypeKind(i32x4.llvmType()) == LLVMVectorTypeKind);
+	REQUIRE(LLVMGetVectorSize(i32x4.llvmType()) == 4);
+	REQUIRE(lang->typeFromName("floatx16").valid());
+
+	// pointers can't be lanes, and there have to be a power of two of them
+	REQUIRE(!lang->typeFromName("i8*x4").valid());
+	REQUIRE(!lang->typeFromName("i32x3").valid());
+	REQUIRE(!lang->typeFromName("i32x128").valid());
+	REQUIRE(!lang->typeFromName("x4").valid());
+
+	std::unique_ptr<NodeType> node;
+	REQUIRE(c.nodeTypeFromModule("lang", "floatx8<=floatx8", {}, &node));
+	REQUIRE(node->dataOutputs()[0].type.unqualifiedName() == "i1x8");
+
+	// masks can't be added, and floats can't be and-ed
+	res = c.nodeTypeFromModule("lang", "i1x4+i1x4", {}, &node);
+	REQUIRE(res.result_json[0]["errorcode"] == "E37");
+	res = c.nodeTypeFromModule(
+	    "lang", "vector-reduce", nlohmann::json{{"type", "floatx4"}, {"op", "and"}}, &node);
+	REQUIRE(res.result_json[0]["errorcode"] == "EUKN");
+
+	auto mod = c.newGraphModule("test/main");
+	mod->addDependency("lang");
+
+	auto func = mod->getOrCreateFunction(
+	    "compute", {NamedDataType{"x", i32}},
+	    {NamedDataType{"sum", i32}, NamedDataType{"first", i32},
+	     NamedDataType{"product", lang->typeFromName("float")}},
+	    {""}, {""});
+
+	// a = splat(x), b = a with lane 2 set to 10
+	// picked = select(b > a, a + b, a), then shuffled to lanes 2, 2, 0 and lane 1 of a
+	// return the sum of picked, its first lane, and the product of splat(float(x))
+	NodeInstance *entry, *ten, *a, *b, *sum, *greater, *picked, *shuffled, *reduced, *first,
+	    *toFloat, *floats, *product, *exit;
+	REQUIRE(func->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+	REQUIRE(func->insertNode("lang", "const-int", 10, 0, 0, Uuid::random(), &ten));
+	REQUIRE(func->insertNode("lang", "vector-splat", {{"type", "i32x4"}}, 0, 0, Uuid::random(),
+	                         &a));
+	REQUIRE(func->insertNode("lang", "vector-insert", {{"type", "i32x4"}, {"lane", 2}}, 0, 0,
+	                         Uuid::random(), &b));
+	REQUIRE(func->insertNode("lang", "i32x4+i32x4", {}, 0, 0, Uuid::random(), &sum));
+	REQUIRE(func->insertNode("lang", "i32x4>i32x4", {}, 0, 0, Uuid::random(), &greater));
+	REQUIRE(func->insertNode("lang", "vector-select", {{"type", "i32x4"}}, 0, 0, Uuid::random(),
+	                         &picked));
+	REQUIRE(func->insertNode("lang", "vector-shuffle",
+	                         {{"type", "i32x4"}, {"mask", {2, 2, 0, 5}}}, 0, 0, Uuid::random(),
+	                         &shuffled));
+	REQUIRE(func->insertNode("lang", "vector-reduce", {{"type", "i32x4"}, {"op", "+"}}, 0, 0,
+	                         Uuid::random(), &reduced));
+	REQUIRE(func->insertNode("lang", "vector-extract", {{"type", "i32x4"}, {"lane", 0}}, 0, 0,
+	                         Uuid::random(), &first));
+	REQUIRE(func->insertNode("lang", "inttofloat", {}, 0, 0, Uuid::random(), &toFloat));
+	REQUIRE(func->insertNode("lang", "vector-splat", {{"type", "floatx4"}}, 0, 0, Uuid::random(),
+	                         &floats));
+	REQUIRE(func->insertNode("lang", "vector-reduce", {{"type", "floatx4"}, {"op", "*"}}, 0, 0,
+	                         Uuid::random(), &product));
+
+	std::unique_ptr<NodeType> exitType;
+	REQUIRE(func->createExitNodeType(&exitType));
+	REQUIRE(func->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit));
+
+	REQUIRE(connectData(*entry, 0, *a, 0));
+	REQUIRE(connectData(*a, 0, *b, 0));
+	REQUIRE(connectData(*ten, 0, *b, 1));
+	REQUIRE(connectData(*a, 0, *sum, 0));
+	REQUIRE(connectData(*b, 0, *sum, 1));
+	REQUIRE(connectData(*b, 0, *greater, 0));
+	REQUIRE(connectData(*a, 0, *greater, 1));
+	REQUIRE(connectData(*greater, 0, *picked, 0));
+	REQUIRE(connectData(*sum, 0, *picked, 1));
+	REQUIRE(connectData(*a, 0, *picked, 2));
+	REQUIRE(connectData(*picked, 0, *shuffled, 0));
+	REQUIRE(connectData(*a, 0, *shuffled, 1));
+	REQUIRE(connectData(*shuffled, 0, *reduced, 0));
+	REQUIRE(connectData(*shuffled, 0, *first, 0));
+	REQUIRE(connectData(*entry, 0, *toFloat, 0));
+	REQUIRE(connectData(*toFloat, 0, *floats, 0));
+	REQUIRE(connectData(*floats, 0, *product, 0));
+	REQUIRE(connectData(*reduced, 0, *exit, 0));
+	REQUIRE(connectData(*first, 0, *exit, 1));
+	REQUIRE(connectData(*product, 0, *exit, 2));
+	REQUIRE(connectExec(*entry, 0, *exit, 0));
+
+	OwnedLLVMModule llmod;
+	res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+	REQUIRE(res);
+	REQUIRE(LLVMVerifyModule(*llmod, LLVMReturnStatusAction, nullptr) == 0);
+
+	JitSession* session;
+	REQUIRE(JitSession::instance(LLVMCodeGenLevelNone, &session));
+
+	size_t moduleID;
+	REQUIRE(session->addModule(std::move(llmod), &moduleID));
+
+	void* compute;
+	REQUIRE(session->lookup(moduleID, mangleFunctionName("test/main", "compute"), &compute));
+
+	// lanes 13, 13, 3, 3
+	int    sumOut = 0, firstOut = 0;
+	double productOut = 0;
+	REQUIRE(reinterpret_cast<int (*)(int, int, int*, int*, double*)>(compute)(
+	            0, 3, &sumOut, &firstOut, &productOut) == 0);
+	REQUIRE(sumOut == 32);
+	REQUIRE(firstOut == 13);
+	REQUIRE(productOut == 81.0);
+}
+
+TEST_CASE("LangModule has buffers and nodes that loop over them", "[module]") {
+	Context c;
+	Result  res;
+
+	res += c.loadModule("lang");
+	REQUIRE(!!res);
+
+	auto lang    = c.langModule();
+	auto i32     = lang->typeFromName("i32");
+	auto floatTy = lang->typeFromName("float");
+
+	auto i32Buffer = lang->typeFromName("i32[]");
+	REQUIRE(i32Buffer.valid());
+	REQUIRE(LLVMGetTypeKind(i32Buffer.llvmType()) == LLVMStructTypeKind);
+	REQUIRE(lang->typeFromName("i32x4[]").valid());
+
+	// buffers can't hold strings or buffers
+	REQUIRE(!lang->typeFromName("i8*[]").valid());
+	REQUIRE(!lang->typeFromName("i32[][]").valid());
+	REQUIRE(!lang->typeFromName("[]").valid());
+
+	std::unique_ptr<NodeType> node;
+	REQUIRE(c.nodeTypeFromModule("lang", "buffer-zip", {{"kernel", "lang:float<float"}}, &node));
+	REQUIRE(node->dataInputs()[2].type.unqualifiedName() == "i1[]");
+
+	// the kernel has to take as many elements as the node gives it
+	res = c.nodeTypeFromModule("lang", "buffer-map", {{"kernel", "lang:i32+i32"}}, &node);
+	REQUIRE(res.result_json[0]["errorcode"] == "EUKN");
+	res = c.nodeTypeFromModule("lang", "buffer-reduce", {{"kernel", "lang:i32<i32"}}, &node);
+	REQUIRE(res.result_json[0]["errorcode"] == "EUKN");
+	res = c.nodeTypeFromModule("lang", "buffer-map", {{"kernel", "lang:const-int"}}, &node);
+	REQUIRE(res.result_json[0]["errorcode"] == "EUKN");
+
+	auto mod = c.newGraphModule("test/main");
+	mod->addDependency("lang");
+
+	// a graph function can be the kernel too
+	auto half = mod->getOrCreateFunction("half", {NamedDataType{"x", i32}},
+	                                     {NamedDataType{"half", floatTy}}, {""}, {""});
+	{
+		NodeInstance *entry, *toFloat, *oneHalf, *times, *exit;
+		REQUIRE(half->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+		REQUIRE(half->insertNode("lang", "inttofloat", {}, 0, 0, Uuid::random(), &toFloat));
+		REQUIRE(half->insertNode("lang", "const-float", 0.5, 0, 0, Uuid::random(), &oneHalf));
+		REQUIRE(half->insertNode("lang", "float*float", {}, 0, 0, Uuid::random(), &times));
+
+		std::unique_ptr<NodeType> exitType;
+		REQUIRE(half->createExitNodeType(&exitType));
+		REQUIRE(half->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit));
+
+		REQUIRE(connectData(*entry, 0, *toFloat, 0));
+		REQUIRE(connectData(*toFloat, 0, *times, 0));
+		REQUIRE(connectData(*oneHalf, 0, *times, 1));
+		REQUIRE(connectData(*times, 0, *exit, 0));
+		REQUIRE(connectExec(*entry, 0, *exit, 0));
+	}
+
+	auto func = mod->getOrCreateFunction(
+	    "compute",
+	    {NamedDataType{"results", i32Buffer},
+	     NamedDataType{"sums", lang->typeFromName("float[]")}},
+	    {}, {""}, {""});
+
+	// a = [3] * 8, results[0] = sum(a), a = a + a, results[1] = sum(a), f = half(a),
+	// sums[0] = sum(f), results[2] = length(f), results[3] = a[2]
+	NodeInstance *entry, *eight, *zero, *one, *two, *three, *zeroFloat, *allocA, *allocF, *fillA,
+	    *sumA, *setFirst, *zip, *setSecond, *map, *sumF, *setSum, *lengthF, *setLength, *getA,
+	    *setThird, *freeA, *freeF, *exit;
+	REQUIRE(func->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+	REQUIRE(func->insertNode("lang", "const-int", 8, 0, 0, Uuid::random(), &eight));
+	REQUIRE(func->insertNode("lang", "const-int", 0, 0, 0, Uuid::random(), &zero));
+	REQUIRE(func->insertNode("lang", "const-int", 1, 0, 0, Uuid::random(), &one));
+	REQUIRE(func->insertNode("lang", "const-int", 2, 0, 0, Uuid::random(), &two));
+	REQUIRE(func->insertNode("lang", "const-int", 3, 0, 0, Uuid::random(), &three));
+	REQUIRE(func->insertNode("lang", "const-float", 0.0, 0, 0, Uuid::random(), &zeroFloat));
+	REQUIRE(func->insertNode("lang", "buffer-alloc", {{"type", "i32[]"}}, 0, 0, Uuid::random(),
+	                         &allocA));
+	REQUIRE(func->insertNode("lang", "buffer-alloc", {{"type", "float[]"}}, 0, 0,
+	                         Uuid::random(), &allocF));
+	REQUIRE(func->insertNode("lang", "buffer-fill", {{"type", "i32[]"}}, 0, 0, Uuid::random(),
+	                         &fillA));
+	REQUIRE(func->insertNode("lang", "buffer-reduce", {{"kernel", "lang:i32+i32"}}, 0, 0,
+	                         Uuid::random(), &sumA));
+	REQUIRE(func->insertNode("lang", "buffer-set", {{"type", "i32[]"}}, 0, 0, Uuid::random(),
+	                         &setFirst));
+	REQUIRE(func->insertNode("lang", "buffer-zip", {{"kernel", "lang:i32+i32"}}, 0, 0,
+	                         Uuid::random(), &zip));
+	REQUIRE(func->insertNode("lang", "buffer-set", {{"type", "i32[]"}}, 0, 0, Uuid::random(),
+	                         &setSecond));
+	REQUIRE(func->insertNode("lang", "buffer-map", {{"kernel", "test/main:half"}}, 0, 0,
+	                         Uuid::random(), &map));
+	REQUIRE(func->insertNode("lang", "buffer-reduce", {{"kernel", "lang:float+float"}}, 0, 0,
+	                         Uuid::random(), &sumF));
+	REQUIRE(func->insertNode("lang", "buffer-set", {{"type", "float[]"}}, 0, 0, Uuid::random(),
+	                         &setSum));
+	REQUIRE(func->insertNode("lang", "buffer-length", {{"type", "float[]"}}, 0, 0,
+	                         Uuid::random(), &lengthF));
+	REQUIRE(func->insertNode("lang", "buffer-set", {{"type", "i32[]"}}, 0, 0, Uuid::random(),
+	                         &setLength));
+	REQUIRE(func->insertNode("lang", "buffer-get", {{"type", "i32[]"}}, 0, 0, Uuid::random(),
+	                         &getA));
+	REQUIRE(func->insertNode("lang", "buffer-set", {{"type", "i32[]"}}, 0, 0, Uuid::random(),
+	                         &setThird));
+	REQUIRE(func->insertNode("lang", "buffer-free", {{"type", "i32[]"}}, 0, 0, Uuid::random(),
+	                         &freeA));
+	REQUIRE(func->insertNode("lang", "buffer-free", {{"type", "float[]"}}, 0, 0, Uuid::random(),
+	                         &freeF));
+
+	std::unique_ptr<NodeType> exitType;
+	REQUIRE(func->createExitNodeType(&exitType));
+	REQUIRE(func->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit));
+
+	NodeInstance* execOrder[] = {entry,  allocA,    allocF, fillA,     setFirst, zip,
+	                             setSecond, map,    setSum, setLength, setThird, freeA,
+	                             freeF,     exit};
+	for (auto idx = 0ull; idx + 1 < std::size(execOrder); ++idx) {
+		REQUIRE(connectExec(*execOrder[idx], 0, *execOrder[idx + 1], 0));
+	}
+
+	REQUIRE(connectData(*eight, 0, *allocA, 0));
+	REQUIRE(connectData(*eight, 0, *allocF, 0));
+	REQUIRE(connectData(*allocA, 0, *fillA, 0));
+	REQUIRE(connectData(*three, 0, *fillA, 1));
+
+	// sumA is read before and after the zip, which changes a
+	REQUIRE(connectData(*allocA, 0, *sumA, 0));
+	REQUIRE(connectData(*zero, 0, *sumA, 1));
+	REQUIRE(connectData(*entry, 0, *setFirst, 0));
+	REQUIRE(connectData(*zero, 0, *setFirst, 1));
+	REQUIRE(connectData(*sumA, 0, *setFirst, 2));
+
+	REQUIRE(connectData(*allocA, 0, *zip, 0));
+	REQUIRE(connectData(*allocA, 0, *zip, 1));
+	REQUIRE(connectData(*allocA, 0, *zip, 2));
+	REQUIRE(connectData(*entry, 0, *setSecond, 0));
+	REQUIRE(connectData(*one, 0, *setSecond, 1));
+	REQUIRE(connectData(*sumA, 0, *setSecond, 2));
+
+	REQUIRE(connectData(*allocA, 0, *map, 0));
+	REQUIRE(connectData(*allocF, 0, *map, 1));
+	REQUIRE(connectData(*allocF, 0, *sumF, 0));
+	REQUIRE(connectData(*zeroFloat, 0, *sumF, 1));
+	REQUIRE(connectData(*entry, 1, *setSum, 0));
+	REQUIRE(connectData(*zero, 0, *setSum, 1));
+	REQUIRE(connectData(*sumF, 0, *setSum, 2));
+
+	REQUIRE(connectData(*allocF, 0, *lengthF, 0));
+	REQUIRE(connectData(*entry, 0, *setLength, 0));
+	REQUIRE(connectData(*two, 0, *setLength, 1));
+	REQUIRE(connectData(*lengthF, 0, *setLength, 2));
+
+	REQUIRE(connectData(*allocA, 0, *getA, 0));
+	REQUIRE(connectData(*two, 0, *getA, 1));
+	REQUIRE(connectData(*entry, 0, *setThird, 0));
+	REQUIRE(connectData(*three, 0, *setThird, 1));
+	REQUIRE(connectData(*getA, 0, *setThird, 2));
+
+	REQUIRE(connectData(*allocA, 0, *freeA, 0));
+	REQUIRE(connectData(*allocF, 0, *freeF, 0));
+
+	OwnedLLVMModule llmod;
+	res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+	INFO(res);
+	REQUIRE(res);
+	REQUIRE(LLVMVerifyModule(*llmod, LLVMReturnStatusAction, nullptr) == 0);
+
+	// the loops are marked to be vectorized
+	std::string ir = *OwnedMessage(LLVMPrintModuleToString(*llmod));
+	REQUIRE(ir.find("!llvm.loop") != std::string::npos);
+	REQUIRE(ir.find("llvm.loop.vectorize.enable") != std::string::npos);
+
+	JitSession* session;
+	REQUIRE(JitSession::instance(LLVMCodeGenLevelNone, &session));
+
+	size_t moduleID;
+	REQUIRE(session->addModule(std::move(llmod), &moduleID));
+
+	void* compute;
+	REQUIRE(session->lookup(moduleID, mangleFunctionName("test/main", "compute"), &compute));
+
+	// a buffer argument is passed as its pointer and length
+	int    results[4] = {};
+	double sums[1]    = {};
+	REQUIRE(reinterpret_cast<int (*)(int, int*, int, double*, int)>(compute)(0, results, 4, sums,
+	                                                                         1) == 0);
+	REQUIRE(results[0] == 24);
+	REQUIRE(results[1] == 48);
+	REQUIRE(results[2] == 8);
+	REQUIRE(results[3] == 6);
+	REQUIRE(sums[0] == 24.0);
+
+	// the interfaces of graph function kernels go into the cache keys of the functions using them
+	REQUIRE(map->type().referencedFunctions() == std::vector<const GraphFunction*>{half});
+	REQUIRE(zip->type().referencedFunctions().empty());
+
+	WHEN("A graph function kernel is used in a module that doesn't depend on its module") {
+		auto other = c.newGraphModule("test/other");
+		other->addDependency("lang");
+
+		auto run = other->getOrCreateFunction(
+		    "run",
+		    {NamedDataType{"source", i32Buffer},
+		     NamedDataType{"destination", lang->typeFromName("float[]")}},
+		    {}, {""}, {""});
+
+		NodeInstance *runEntry, *runMap, *runExit;
+		REQUIRE(run->getOrInsertEntryNode(0, 0, Uuid::random(), &runEntry));
+		REQUIRE(run->insertNode("lang", "buffer-map", {{"kernel", "test/main:half"}}, 0, 0,
+		                        Uuid::random(), &runMap));
+
+		std::unique_ptr<NodeType> runExitType;
+		REQUIRE(run->createExitNodeType(&runExitType));
+		REQUIRE(run->insertNode(std::move(runExitType), 0, 0, Uuid::random(), &runExit));
+
+		REQUIRE(connectExec(*runEntry, 0, *runMap, 0));
+		REQUIRE(connectExec(*runMap, 0, *runExit, 0));
+		REQUIRE(connectData(*runEntry, 0, *runMap, 0));
+		REQUIRE(connectData(*runEntry, 1, *runMap, 1));
+
+		OwnedLLVMModule otherLLMod;
+		res = c.compileModule(*other, CompileSettings::Default, &otherLLMod);
+		REQUIRE(!res);
+		REQUIRE(res.result_json[0]["errorcode"] == "EUKN");
+		REQUIRE(res.result_json[0]["data"]["Module"] == "test/other");
+	}
+}
+
+TEST_CASE("LangModule has narrow and wide numbers that convert to each other", "[module]") {
+	Context c;
+	Result  res;
+
+	res += c.loadModule("lang");
+	REQUIRE(!!res);
+
+	auto lang = c.langModule();
+	auto i8   = lang->typeFromName("i8");
+	auto i64  = lang->typeFromName("i64");
+	auto f32  = lang->typeFromName("f32");
+
+	REQUIRE(LLVMGetIntTypeWidth(lang->typeFromName("i16").llvmType()) == 16);
+	REQUIRE(LLVMGetIntTypeWidth(i64.llvmType()) == 64);
+	REQUIRE(LLVMGetTypeKind(f32.llvmType()) == LLVMFloatTypeKind);
+	REQUIRE(LLVMGetTypeKind(lang->typeFromName("f64").llvmType()) == LLVMDoubleTypeKind);
+
+	// narrow lanes fit more in a vector register
+	REQUIRE(LLVMGetVectorSize(lang->typeFromName("i8x32").llvmType()) == 32);
+	REQUIRE(lang->typeFromName("f32[]").valid());
+
+	// the converters are registered with the context
+	auto converter = c.createConverterNodeType(i8, i64);
+	REQUIRE(converter != nullptr);
+	REQUIRE(converter->qualifiedName() == "lang:i8toi64");
+	REQUIRE(c.createConverterNodeType(lang->typeFromName("float"), i64) != nullptr);
+	REQUIRE(c.createConverterNodeType(i64, i64) == nullptr);
+
+	std::unique_ptr<NodeType> node;
+	REQUIRE(c.nodeTypeFromModule("lang", "i16<=i16", {}, &node));
+	REQUIRE(c.nodeTypeFromModule("lang", "f32x8*f32x8", {}, &node));
+
+	auto mod = c.newGraphModule("test/main");
+	mod->addDependency("lang");
+
+	auto func = mod->getOrCreateFunction(
+	    "compute", {NamedDataType{"small", i8}, NamedDataType{"big", i64},
+	                NamedDataType{"single", f32}},
+	    {NamedDataType{"product", i64}, NamedDataType{"sum", f32},
+	     NamedDataType{"less", lang->typeFromName("i1")}, NamedDataType{"wrapped", i8}},
+	    {""}, {""});
+
+	// product = i64(small) * big, sum = single + f32(small), less = small < i8(big),
+	// wrapped = i8(product)
+	NodeInstance *entry, *widen, *times, *toSingle, *plus, *narrow, *compare, *wrap, *exit;
+	REQUIRE(func->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+	REQUIRE(func->insertNode(std::move(converter), 0, 0, Uuid::random(), &widen));
+	REQUIRE(func->insertNode("lang", "i64*i64", {}, 0, 0, Uuid::random(), &times));
+	REQUIRE(func->insertNode("lang", "i8tof32", {}, 0, 0, Uuid::random(), &toSingle));
+	REQUIRE(func->insertNode("lang", "f32+f32", {}, 0, 0, Uuid::random(), &plus));
+	REQUIRE(func->insertNode("lang", "i64toi8", {}, 0, 0, Uuid::random(), &narrow));
+	REQUIRE(func->insertNode("lang", "i8<i8", {}, 0, 0, Uuid::random(), &compare));
+	REQUIRE(func->insertNode("lang", "i64toi8", {}, 0, 0, Uuid::random(), &wrap));
+
+	std::unique_ptr<NodeType> exitType;
+	REQUIRE(func->createExitNodeType(&exitType));
+	REQUIRE(func->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit));
+
+	REQUIRE(connectData(*entry, 0, *widen, 0));
+	REQUIRE(connectData(*widen, 0, *times, 0));
+	REQUIRE(connectData(*entry, 1, *times, 1));
+	REQUIRE(connectData(*entry, 0, *toSingle, 0));
+	REQUIRE(connectData(*entry, 2, *plus, 0));
+	REQUIRE(connectData(*toSingle, 0, *plus, 1));
+	REQUIRE(connectData(*entry, 1, *narrow, 0));
+	REQUIRE(connectData(*entry, 0, *compare, 0));
+	REQUIRE(connectData(*narrow, 0, *compare, 1));
+	REQUIRE(connectData(*times, 0, *wrap, 0));
+	REQUIRE(connectData(*times, 0, *exit, 0));
+	REQUIRE(connectData(*plus, 0, *exit, 1));
+	REQUIRE(connectData(*compare, 0, *exit, 2));
+	REQUIRE(connectData(*wrap, 0, *exit, 3));
+	REQUIRE(connectExec(*entry, 0, *exit, 0));
+
+	OwnedLLVMModule llmod;
+	res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+	INFO(res);
+	REQUIRE(res);
+	REQUIRE(LLVMVerifyModule(*llmod, LLVMReturnStatusAction, nullptr) == 0);
+
+	JitSession* session;
+	REQUIRE(JitSession::instance(LLVMCodeGenLevelNone, &session));
+
+	size_t moduleID;
+	REQUIRE(session->addModule(std::move(llmod), &moduleID));
+
+	void* compute;
+	REQUIRE(session->lookup(moduleID, mangleFunctionName("test/main", "compute"), &compute));
+
+	// big doesn't fit in an i32, and its low byte is 1
+	int64_t product = 0;
+	float   sum     = 0;
+	bool    less    = false;
+	int8_t  wrapped = 0;
+	REQUIRE(reinterpret_cast<int (*)(int, int8_t, int64_t, float, int64_t*, float*, bool*,
+	                                 int8_t*)>(compute)(0, -3, 0x100000001, 0.5f, &product, &sum,
+	                                                    &less, &wrapped) == 0);
+	REQUIRE(product == -3 * 0x100000001);
+	REQUIRE(sum == -2.5f);
+	REQUIRE(less);
+	REQUIRE(wrapped == -3);
+}
+
+TEST_CASE("LangModule has loop nodes with hints for optimizing them", "[module]") {
+	Context c;
+	Result  res;
+
+	res += c.loadModule("lang");
+	REQUIRE(!!res);
+
+	auto i32 = c.langModule()->typeFromName("i32");
+
+	std::unique_ptr<NodeType> node;
+	REQUIRE(c.nodeTypeFromModule("lang", "for", {{"type", "i64"}, {"unroll", 4}}, &node));
+	REQUIRE(node->dataOutputs()[0].type.unqualifiedName() == "i64");
+	REQUIRE(node->toJSON() == nlohmann::json{{"type", "i64"}, {"unroll", 4}});
+
+	res = c.nodeTypeFromModule("lang", "for", {{"type", "float"}}, &node);
+	REQUIRE(res.result_json[0]["errorcode"] == "EUKN");
+
+	// bad hints are left out
+	res = c.nodeTypeFromModule("lang", "while", {{"interleave", -2}}, &node);
+	REQUIRE(res.result_json[0]["errorcode"] == "WUKN");
+	REQUIRE(node->toJSON() == nlohmann::json::object());
+
+	auto mod = c.newGraphModule("test/main");
+	mod->addDependency("lang");
+
+	auto func = mod->getOrCreateFunction(
+	    "compute", {NamedDataType{"n", i32}},
+	    {NamedDataType{"squares", i32}, NamedDataType{"power", i32}}, {""}, {""});
+	func->getOrCreateLocalVariable("total", i32);
+	func->getOrCreateLocalVariable("x", i32);
+
+	// total = 0, for i in 0..n: total += i * i
+	// x = 1, while x < n: x *= 2
+	NodeInstance *entry, *zero, *one, *two, *startTotal, *loop, *square, *getTotal, *addSquare,
+	    *setTotal, *startX, *whileLoop, *getX, *less, *doubled, *setX, *exit;
+	REQUIRE(func->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+	REQUIRE(func->insertNode("lang", "const-int", 0, 0, 0, Uuid::random(), &zero));
+	REQUIRE(func->insertNode("lang", "const-int", 1, 0, 0, Uuid::random(), &one));
+	REQUIRE(func->insertNode("lang", "const-int", 2, 0, 0, Uuid::random(), &two));
+	REQUIRE(func->insertNode("test/main", "_set_total", "lang:i32", 0, 0, Uuid::random(),
+	                         &startTotal));
+	REQUIRE(func->insertNode("lang", "for", {{"vectorize", true}, {"interleave", 2}}, 0, 0,
+	                         Uuid::random(), &loop));
+	REQUIRE(func->insertNode("lang", "i32*i32", {}, 0, 0, Uuid::random(), &square));
+	REQUIRE(func->insertNode("test/main", "_get_total", "lang:i32", 0, 0, Uuid::random(),
+	                         &getTotal));
+	REQUIRE(func->insertNode("lang", "i32+i32", {}, 0, 0, Uuid::random(), &addSquare));
+	REQUIRE(func->insertNode("test/main", "_set_total", "lang:i32", 0, 0, Uuid::random(),
+	                         &setTotal));
+	REQUIRE(
+	    func->insertNode("test/main", "_set_x", "lang:i32", 0, 0, Uuid::random(), &startX));
+	REQUIRE(func->insertNode("lang", "while", {{"unroll", 2}}, 0, 0, Uuid::random(), &whileLoop));
+	REQUIRE(func->insertNode("test/main", "_get_x", "lang:i32", 0, 0, Uuid::random(), &getX));
+	REQUIRE(func->insertNode("lang", "i32<i32", {}, 0, 0, Uuid::random(), &less));
+	REQUIRE(func->insertNode("lang", "i32*i32", {}, 0, 0, Uuid::random(), &doubled));
+	REQUIRE(func->insertNode("test/main", "_set_x", "lang:i32", 0, 0, Uuid::random(), &setX));
+
+	std::unique_ptr<NodeType> exitType;
+	REQUIRE(func->createExitNodeType(&exitType));
+	REQUIRE(func->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit));
+
+	REQUIRE(connectExec(*entry, 0, *startTotal, 0));
+	REQUIRE(connectExec(*startTotal, 0, *loop, 0));
+	REQUIRE(connectExec(*loop, 0, *setTotal, 0));
+	REQUIRE(connectExec(*setTotal, 0, *loop, 1));
+	REQUIRE(connectExec(*loop, 1, *startX, 0));
+	REQUIRE(connectExec(*startX, 0, *whileLoop, 0));
+	REQUIRE(connectExec(*whileLoop, 0, *setX, 0));
+	REQUIRE(connectExec(*setX, 0, *whileLoop, 1));
+	REQUIRE(connectExec(*whileLoop, 1, *exit, 0));
+
+	REQUIRE(connectData(*zero, 0, *startTotal, 0));
+	REQUIRE(connectData(*zero, 0, *loop, 0));
+	REQUIRE(connectData(*entry, 0, *loop, 1));
+	REQUIRE(connectData(*loop, 0, *square, 0));
+	REQUIRE(connectData(*loop, 0, *square, 1));
+	REQUIRE(connectData(*getTotal, 0, *addSquare, 0));
+	REQUIRE(connectData(*square, 0, *addSquare, 1));
+	REQUIRE(connectData(*addSquare, 0, *setTotal, 0));
+
+	REQUIRE(connectData(*one, 0, *startX, 0));
+	REQUIRE(connectData(*getX, 0, *less, 0));
+	REQUIRE(connectData(*entry, 0, *less, 1));
+	REQUIRE(connectData(*less, 0, *whileLoop, 0));
+	REQUIRE(connectData(*getX, 0, *doubled, 0));
+	REQUIRE(connectData(*two, 0, *doubled, 1));
+	REQUIRE(connectData(*doubled, 0, *setX, 0));
+
+	REQUIRE(connectData(*getTotal, 0, *exit, 0));
+	REQUIRE(connectData(*getX, 0, *exit, 1));
+
+	OwnedLLVMModule llmod;
+	res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+	INFO(res);
+	REQUIRE(res);
+	REQUIRE(LLVMVerifyModule(*llmod, LLVMReturnStatusAction, nullptr) == 0);
+
+	// each loop has its hints on the branch back to its body
+	std::string ir = *OwnedMessage(LLVMPrintModuleToString(*llmod));
+	REQUIRE(ir.find("!{!\"llvm.loop.vectorize.enable\", i1 true}") != std::string::npos);
+	REQUIRE(ir.find("!{!\"llvm.loop.interleave.count\", i32 2}") != std::string::npos);
+	REQUIRE(ir.find("!{!\"llvm.loop.unroll.count\", i32 2}") != std::string::npos);
+
+	JitSession* session;
+	REQUIRE(JitSession::instance(LLVMCodeGenLevelNone, &session));
+
+	size_t moduleID;
+	REQUIRE(session->addModule(std::move(llmod), &moduleID));
+
+	void* compute;
+	REQUIRE(session->lookup(moduleID, mangleFunctionName("test/main", "compute"), &compute));
+
+	auto computeFunc = reinterpret_cast<int (*)(int, int, int*, int*)>(compute);
+
+	int squares = -1, power = -1;
+	REQUIRE(computeFunc(0, 5, &squares, &power) == 0);
+	REQUIRE(squares == 0 + 1 + 4 + 9 + 16);
+	REQUIRE(power == 8);
+
+	// neither loop runs
+	REQUIRE(computeFunc(0, 0, &squares, &power) == 0);
+	REQUIRE(squares == 0);
+	REQUIRE(power == 1);
+}
+
+extern "C" void chi_thread_pool_set_workers(int32_t count);
+
+TEST_CASE("LangModule has a parallel for node that runs a function on the thread pool",
+          "[module]") {
+	// the pool only starts once, so every test that uses it asks for the same number of workers
+	chi_thread_pool_set_workers(4);
+
+	Context c;
+	Result  res;
+
+	res += c.loadModule("lang");
+	REQUIRE(!!res);
+
+	auto lang      = c.langModule();
+	auto i32       = lang->typeFromName("i32");
+	auto i32Buffer = lang->typeFromName("i32[]");
+
+	auto mod = c.newGraphModule("test/main");
+	mod->addDependency("lang");
+
+	// square(i, out): out[i] = i * i
+	auto square = mod->getOrCreateFunction(
+	    "square", {NamedDataType{"i", i32}, NamedDataType{"out", i32Buffer}}, {}, {""}, {""});
+	{
+		NodeInstance *entry, *times, *set, *exit;
+		REQUIRE(square->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+		REQUIRE(square->insertNode("lang", "i32*i32", {}, 0, 0, Uuid::random(), &times));
+		REQUIRE(square->insertNode("lang", "buffer-set", {{"type", "i32[]"}}, 0, 0,
+		                           Uuid::random(), &set));
+
+		std::unique_ptr<NodeType> exitType;
+		REQUIRE(square->createExitNodeType(&exitType));
+		REQUIRE(square->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit));
+
+		REQUIRE(connectExec(*entry, 0, *set, 0));
+		REQUIRE(connectExec(*set, 0, *exit, 0));
+
+		REQUIRE(connectData(*entry, 0, *times, 0));
+		REQUIRE(connectData(*entry, 0, *times, 1));
+		REQUIRE(connectData(*entry, 1, *set, 0));
+		REQUIRE(connectData(*entry, 0, *set, 1));
+		REQUIRE(connectData(*times, 0, *set, 2));
+	}
+
+	std::unique_ptr<NodeType> node;
+	REQUIRE(c.nodeTypeFromModule("lang", "parallel-for", {{"body", "test/main:square"}}, &node));
+	REQUIRE(node->dataInputs().size() == 3);
+	REQUIRE(node->dataInputs()[2].type == i32Buffer);
+	REQUIRE(node->toJSON() == nlohmann::json{{"body", "test/main:square"}});
+
+	// the body has to take the index first and can't have outputs
+	res = c.nodeTypeFromModule("lang", "parallel-for", {{"body", "lang:i32+i32"}}, &node);
+	REQUIRE(res.result_json[0]["errorcode"] == "EUKN");
+	res = c.nodeTypeFromModule("lang", "parallel-for", nlohmann::json::object(), &node);
+	REQUIRE(res.result_json[0]["errorcode"] == "EUKN");
+
+	// compute(results): parallel for i in 0..length(results): square(i, results)
+	auto addCompute = [&](GraphModule& inMod) {
+		auto func = inMod.getOrCreateFunction("compute", {NamedDataType{"results", i32Buffer}},
+		                                      {}, {""}, {""});
+
+		NodeInstance *entry, *zero, *length, *loop, *exit;
+		REQUIRE(func->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+		REQUIRE(func->insertNode("lang", "const-int", 0, 0, 0, Uuid::random(), &zero));
+		REQUIRE(func->insertNode("lang", "buffer-length", {{"type", "i32[]"}}, 0, 0,
+		                         Uuid::random(), &length));
+		REQUIRE(func->insertNode("lang", "parallel-for", {{"body", "test/main:square"}}, 0, 0,
+		                         Uuid::random(), &loop));
+
+		std::unique_ptr<NodeType> exitType;
+		REQUIRE(func->createExitNodeType(&exitType));
+		REQUIRE(func->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit));
+
+		REQUIRE(connectExec(*entry, 0, *loop, 0));
+		REQUIRE(connectExec(*loop, 0, *exit, 0));
+
+		REQUIRE(connectData(*entry, 0, *length, 0));
+		REQUIRE(connectData(*zero, 0, *loop, 0));
+		REQUIRE(connectData(*length, 0, *loop, 1));
+		REQUIRE(connectData(*entry, 0, *loop, 2));
+
+		return func;
+	};
+	auto func = addCompute(*mod);
+
+	OwnedLLVMModule llmod;
+	res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+	INFO(res);
+	REQUIRE(res);
+	REQUIRE(LLVMVerifyModule(*llmod, LLVMReturnStatusAction, nullptr) == 0);
+
+	// the body is outlined into a task that the runtime runs
+	std::string ir = *OwnedMessage(LLVMPrintModuleToString(*llmod));
+	REQUIRE(ir.find("call void @chi_parallel_for") != std::string::npos);
+
+	JitSession* session;
+	REQUIRE(JitSession::instance(LLVMCodeGenLevelNone, &session));
+
+	size_t moduleID;
+	REQUIRE(session->addModule(std::move(llmod), &moduleID));
+
+	void* compute;
+	REQUIRE(session->lookup(moduleID, mangleFunctionName("test/main", "compute"), &compute));
+
+	std::vector<int> results(10000, -1);
+	REQUIRE(reinterpret_cast<int (*)(int, int*, int)>(compute)(0, results.data(),
+	                                                           int(results.size())) == 0);
+	auto wrong = 0;
+	for (auto idx = 0; idx < int(results.size()); ++idx) { wrong += results[idx] != idx * idx; }
+	REQUIRE(wrong == 0);
+
+	// the body's interface goes into the cache keys of the functions that use it
+	auto referencedHash = referencedInterfacesHash(*func);
+	REQUIRE(referencedHash != referencedInterfacesHash(*square));
+
+	WHEN("It's used in a module that doesn't depend on the body's module") {
+		auto other = c.newGraphModule("test/other");
+		other->addDependency("lang");
+		addCompute(*other);
+
+		OwnedLLVMModule otherLLMod;
+		res = c.compileModule(*other, CompileSettings::Default, &otherLLMod);
+		REQUIRE(!res);
+		REQUIRE(res.result_json[0]["errorcode"] == "EUKN");
+		REQUIRE(res.result_json[0]["data"]["Module"] == "test/other");
+	}
+
+	WHEN("The body's interface changes") {
+		square->addDataInput(i32, "unused");
+		REQUIRE(referencedInterfacesHash(*func) != referencedHash);
+	}
+}
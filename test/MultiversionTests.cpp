@@ -0,0 +1,179 @@
+#include <catch.hpp>
+
+#include <chi/Context.hpp>
+#include <chi/Multiversion.hpp>
+#include <chi/Owned.hpp>
+#include <chi/Support/Result.hpp>
+
+#include <llvm-c/Analysis.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/ExecutionEngine.h>
+#include <llvm-c/IRReader.h>
+
+#include <cstring>
+#include <string>
+
+using namespace chi;
+
+namespace {
+
+// sum(n) adds up 0 to n - 1 with a helper, and counts how many times it was called in a variable
+// that only it can see
+constexpr const char* programIR = R"(
+target triple = "x86_64-unknown-linux-gnu"
+
+@calls = internal global i32 0
+@unused = internal global i32 0
+
+define internal i32 @add(i32 %a, i32 %b) {
+  %sum = add i32 %a, %b
+  ret i32 %sum
+}
+
+define i32 @sum(i32 %n) {
+entry:
+  %calls = load i32, i32* @calls
+  %newCalls = add i32 %calls, 1
+  store i32 %newCalls, i32* @calls
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %loop ]
+  %total = phi i32 [ 0, %entry ], [ %newTotal, %loop ]
+  %newTotal = call i32 @add(i32 %total, i32 %i)
+  %next = add i32 %i, 1
+  %done = icmp eq i32 %next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %newTotal
+}
+
+define i32 @callsSum(i32 %n) {
+  %first = call i32 @sum(i32 %n)
+  %second = call i32 @sum(i32 %n)
+  %calls = load i32, i32* @calls
+  %total = add i32 %first, %second
+  %withCalls = add i32 %total, %calls
+  store i32 1, i32* @unused
+  ret i32 %withCalls
+}
+)";
+
+OwnedLLVMModule parseModule(Context& c, const std::string& ir) {
+	auto buffer = LLVMCreateMemoryBufferWithMemoryRangeCopy(ir.c_str(), ir.size(), "test");
+
+	OwnedLLVMModule mod;
+	OwnedMessage    message;
+	// takes the buffer
+	REQUIRE(LLVMParseIRInContext(c.llvmContext(), buffer, &*mod, &*message) == 0);
+
+	return mod;
+}
+
+std::string targetCPU(LLVMValueRef func) {
+	auto attr = LLVMGetStringAttributeAtIndex(func, LLVMAttributeFunctionIndex, "target-cpu", 10);
+	if (attr == nullptr) { return {}; }
+
+	unsigned    length;
+	const char* value = LLVMGetStringAttributeValue(attr, &length);
+	return {value, length};
+}
+
+}  // anonymous namespace
+
+TEST_CASE("Instruction sets are parsed", "[Multiversion]") {
+	std::vector<VectorISA> isas;
+	Result                 res = parseVectorISAs("avx2,sse4.2,avx2", &isas);
+	REQUIRE(res);
+	REQUIRE(isas == std::vector<VectorISA>{VectorISA::AVX2, VectorISA::SSE42});
+
+	res += parseVectorISAs("avx2,neon", &isas);
+	REQUIRE(!res);
+	REQUIRE(res.result_json[0]["errorcode"] == "EUKN");
+}
+
+TEST_CASE("Functions get versions for instruction sets", "[Multiversion]") {
+	Context c;
+	Result  res;
+
+	auto mod = parseModule(c, programIR);
+	res += multiversionFunctions(*mod, {"sum", "notThere"}, {VectorISA::AVX2, VectorISA::AVX512});
+	INFO(res);
+	REQUIRE(res);
+	REQUIRE(LLVMVerifyModule(*mod, LLVMReturnStatusAction, nullptr) == 0);
+
+	THEN("Each version is generated for its instruction set with its own copy of what it calls") {
+		auto avx2   = LLVMGetNamedFunction(*mod, "sum.avx2");
+		auto avx512 = LLVMGetNamedFunction(*mod, "sum.avx512");
+		REQUIRE(avx2 != nullptr);
+		REQUIRE(avx512 != nullptr);
+		REQUIRE(targetCPU(avx2) == "x86-64-v3");
+		REQUIRE(targetCPU(avx512) == "x86-64-v4");
+		REQUIRE(LLVMGetLinkage(avx2) == LLVMInternalLinkage);
+
+		auto calledAdds = 0;
+		for (auto func = LLVMGetFirstFunction(*mod); func != nullptr;
+		     func      = LLVMGetNextFunction(func)) {
+			size_t      length;
+			const char* name = LLVMGetValueName2(func, &length);
+			if (std::string(name, length).rfind("add", 0) == 0) { ++calledAdds; }
+		}
+		REQUIRE(calledAdds == 3);
+	}
+
+	THEN("The original is the default version, behind a dispatcher with its name") {
+		auto dispatcher = LLVMGetNamedFunction(*mod, "sum");
+		REQUIRE(LLVMGetLinkage(dispatcher) == LLVMExternalLinkage);
+		REQUIRE(targetCPU(dispatcher).empty());
+
+		auto defaultVersion = LLVMGetNamedFunction(*mod, "sum.default");
+		REQUIRE(defaultVersion != nullptr);
+		REQUIRE(LLVMGetLinkage(defaultVersion) == LLVMInternalLinkage);
+	}
+
+	THEN("Functions that weren't asked for don't get versions") {
+		REQUIRE(LLVMGetNamedFunction(*mod, "callsSum.avx2") == nullptr);
+		REQUIRE(LLVMGetNamedFunction(*mod, "callsSum.default") == nullptr);
+	}
+
+	THEN("The versions share the variables, and it runs") {
+		auto func = LLVMGetNamedFunction(*mod, "callsSum");
+		auto arg  = OwnedLLVMGenericValue(
+		    LLVMCreateGenericValueOfInt(LLVMInt32TypeInContext(c.llvmContext()), 10, false));
+
+		LLVMGenericValueRef ret;
+		res = interpretLLVMIR(std::move(mod), LLVMCodeGenLevelDefault, {*arg}, func, &ret);
+		REQUIRE(res);
+		REQUIRE(LLVMGenericValueToInt(ret, false) == 45 + 45 + 2);
+		LLVMDisposeGenericValue(ret);
+	}
+}
+
+TEST_CASE("Functions that never ran don't get versions", "[Multiversion]") {
+	Context c;
+
+	auto mod = parseModule(c, std::string(programIR) + R"(
+define i32 @cold(i32 %n) !prof !0 {
+  ret i32 %n
+}
+
+!0 = !{!"function_entry_count", i64 0}
+)");
+	Result res = multiversionFunctions(*mod, {"cold"}, {VectorISA::SSE42});
+	REQUIRE(res);
+	REQUIRE(LLVMGetNamedFunction(*mod, "cold.sse4.2") == nullptr);
+	REQUIRE(LLVMGetNamedFunction(*mod, "cold.default") == nullptr);
+}
+
+TEST_CASE("Functions only get versions for instruction sets on x86", "[Multiversion]") {
+	Context c;
+
+	auto mod = parseModule(c, programIR);
+	LLVMSetTarget(*mod, "aarch64-unknown-linux-gnu");
+
+	Result res = multiversionFunctions(*mod, {"sum"}, {VectorISA::AVX2});
+	REQUIRE(!res);
+	REQUIRE(res.result_json[0]["errorcode"] == "EUKN");
+	REQUIRE(LLVMGetNamedFunction(*mod, "sum.avx2") == nullptr);
+}
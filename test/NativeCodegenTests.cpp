@@ -0,0 +1,176 @@
+#include <catch.hpp>
+
+#include <chi/NativeCodegen.hpp>
+#include <chi/Owned.hpp>
+#include <chi/Support/FindProgram.hpp>
+#include <chi/Support/Result.hpp>
+#include <chi/Support/Subprocess.hpp>
+#include <chi/Support/TempFile.hpp>
+
+#include <llvm-c/Core.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using namespace chi;
+namespace fs = std::filesystem;
+
+namespace {
+
+LLVMTypeRef i32Type(LLVMModuleRef mod) { return LLVMInt32TypeInContext(LLVMGetModuleContext(mod)); }
+
+LLVMValueRef call(LLVMBuilderRef builder, LLVMValueRef callee, LLVMValueRef arg) {
+	LLVMValueRef args[] = {arg};
+	return LLVMBuildCall2(builder, LLVMGlobalGetValueType(callee), callee, args,
+	                      arg == nullptr ? 0 : 1, "");
+}
+
+// main() returns the sum of part0(1) through part5(6), where partN(x) is x * triple(x) plus a
+// private constant of 7, and triple is internal. That's 3 * 91 + 6 * 7 = 315, so it exits with 59.
+OwnedLLVMModule makeProgram(LLVMContextRef ctx) {
+	auto mod     = OwnedLLVMModule(LLVMModuleCreateWithNameInContext("program", ctx));
+	auto i32     = i32Type(*mod);
+	auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(ctx));
+
+	auto triple = LLVMAddFunction(*mod, "triple", LLVMFunctionType(i32, &i32, 1, false));
+	LLVMSetLinkage(triple, LLVMInternalLinkage);
+	LLVMPositionBuilderAtEnd(*builder, LLVMAppendBasicBlock(triple, "entry"));
+	LLVMBuildRet(*builder, LLVMBuildMul(*builder, LLVMGetParam(triple, 0),
+	                                    LLVMConstInt(i32, 3, false), ""));
+
+	auto constant = LLVMAddGlobal(*mod, i32, "");
+	LLVMSetLinkage(constant, LLVMPrivateLinkage);
+	LLVMSetGlobalConstant(constant, true);
+	LLVMSetInitializer(constant, LLVMConstInt(i32, 7, false));
+
+	std::vector<LLVMValueRef> parts;
+	for (auto idx = 0; idx < 6; ++idx) {
+		auto name = "part" + std::to_string(idx);
+		auto part = LLVMAddFunction(*mod, name.c_str(), LLVMFunctionType(i32, &i32, 1, false));
+		LLVMPositionBuilderAtEnd(*builder, LLVMAppendBasicBlock(part, "entry"));
+
+		auto tripled = call(*builder, triple, LLVMGetParam(part, 0));
+		auto product = LLVMBuildMul(*builder, LLVMGetParam(part, 0), tripled, "");
+		auto offset  = LLVMBuildLoad2(*builder, i32, constant, "");
+		LLVMBuildRet(*builder, LLVMBuildAdd(*builder, product, offset, ""));
+
+		parts.push_back(part);
+	}
+
+	auto main = LLVMAddFunction(*mod, "main", LLVMFunctionType(i32, nullptr, 0, false));
+	LLVMPositionBuilderAtEnd(*builder, LLVMAppendBasicBlock(main, "entry"));
+	auto sum = LLVMConstInt(i32, 0, false);
+	for (auto idx = 0ull; idx < parts.size(); ++idx) {
+		auto result = call(*builder, parts[idx], LLVMConstInt(i32, idx + 1, false));
+		sum         = LLVMBuildAdd(*builder, sum, result, "");
+	}
+	LLVMBuildRet(*builder, sum);
+
+	return mod;
+}
+
+int runExecutable(const fs::path& path) {
+	Subprocess exe{path};
+	REQUIRE(exe.start());
+	return exe.exitCode();
+}
+
+}  // anonymous namespace
+
+TEST_CASE("Native code is generated in partitions", "[NativeCodegen]") {
+	auto ctx = OwnedLLVMContext(LLVMContextCreate());
+	auto mod = makeProgram(*ctx);
+
+	CodegenSettings settings;
+
+	WHEN("It's generated on one thread") {
+		settings.threadCount = 1;
+
+		std::vector<std::string> objects;
+		Result                   res = emitObjectFiles(*mod, settings, &objects);
+		REQUIRE(res);
+
+		THEN("There's one object and the locals are left alone") {
+			REQUIRE(objects.size() == 1);
+			REQUIRE_FALSE(objects[0].empty());
+			REQUIRE(LLVMGetLinkage(LLVMGetNamedFunction(*mod, "triple")) == LLVMInternalLinkage);
+		}
+	}
+
+	WHEN("It's generated on more threads than it has functions") {
+		settings.threadCount = 16;
+
+		std::vector<std::string> objects;
+		Result                   res = emitObjectFiles(*mod, settings, &objects);
+		REQUIRE(res);
+
+		THEN("Each function gets a partition and the locals are promoted") {
+			// triple, the 6 parts and main
+			REQUIRE(objects.size() == 8);
+			for (const auto& object : objects) { REQUIRE_FALSE(object.empty()); }
+
+			REQUIRE(LLVMGetNamedFunction(*mod, "triple") == nullptr);
+			for (auto func = LLVMGetFirstFunction(*mod); func != nullptr;
+			     func      = LLVMGetNextFunction(func)) {
+				REQUIRE(LLVMGetLinkage(func) == LLVMExternalLinkage);
+			}
+			for (auto global = LLVMGetFirstGlobal(*mod); global != nullptr;
+			     global      = LLVMGetNextGlobal(global)) {
+				REQUIRE(LLVMGetLinkage(global) == LLVMExternalLinkage);
+				REQUIRE(LLVMGetVisibility(global) == LLVMHiddenVisibility);
+			}
+		}
+	}
+
+	// the rest needs a system linker
+	if (findProgram("cc").empty()) { return; }
+
+	WHEN("Three partitions are linked into an executable") {
+		settings.threadCount = 3;
+
+		std::vector<std::string> objects;
+		Result                   res = emitObjectFiles(*mod, settings, &objects);
+		REQUIRE(res);
+		REQUIRE(objects.size() == 3);
+
+		auto exePath = makeTempPath();
+		res += linkExecutable(objects, {}, exePath);
+		INFO(res);
+		REQUIRE(res);
+
+		THEN("It runs") { REQUIRE(runExecutable(exePath) == 59); }
+
+		fs::remove(exePath);
+	}
+
+	WHEN("Three partitions are written to one object file") {
+		settings.threadCount = 3;
+
+		std::vector<std::string> objects;
+		Result                   res = emitObjectFiles(*mod, settings, &objects);
+		REQUIRE(res);
+
+		auto objectPath = makeTempPath(".o");
+		res += writeObjectFile(objects, objectPath);
+		INFO(res);
+		REQUIRE(res);
+
+		THEN("The object can be linked on its own") {
+			std::ifstream stream{objectPath, std::ios::binary};
+			std::string   object{std::istreambuf_iterator<char>(stream), {}};
+
+			auto exePath = makeTempPath();
+			res += linkExecutable({object}, {}, exePath);
+			INFO(res);
+			REQUIRE(res);
+
+			REQUIRE(runExecutable(exePath) == 59);
+
+			fs::remove(exePath);
+		}
+
+		fs::remove(objectPath);
+	}
+}
@@ -0,0 +1,189 @@
+#include <catch.hpp>
+
+#include <chi/Context.hpp>
+#include <chi/Owned.hpp>
+#include <chi/Profile.hpp>
+#include <chi/Support/Result.hpp>
+#include <chi/Support/TempFile.hpp>
+
+#include <llvm-c/Analysis.h>
+#include <llvm-c/Core.h>
+#include <llvm-c/ExecutionEngine.h>
+#include <llvm-c/IRReader.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace chi;
+namespace fs = std::filesystem;
+
+namespace {
+
+// countOdd(n) loops n times and counts the odd numbers on the way
+constexpr const char* programIR = R"(
+define i32 @countOdd(i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %next, %latch ]
+  %count = phi i32 [ 0, %entry ], [ %newCount, %latch ]
+  %bit = and i32 %i, 1
+  %odd = icmp ne i32 %bit, 0
+  br i1 %odd, label %isOdd, label %latch
+
+isOdd:
+  %incremented = add i32 %count, 1
+  br label %latch
+
+latch:
+  %newCount = phi i32 [ %incremented, %isOdd ], [ %count, %loop ]
+  %next = add i32 %i, 1
+  %done = icmp eq i32 %next, %n
+  br i1 %done, label %exit, label %loop
+
+exit:
+  ret i32 %newCount
+}
+)";
+
+OwnedLLVMModule parseModule(Context& c, const std::string& ir) {
+	auto buffer = LLVMCreateMemoryBufferWithMemoryRangeCopy(ir.c_str(), ir.size(), "test");
+
+	OwnedLLVMModule mod;
+	OwnedMessage    message;
+	// takes the buffer
+	REQUIRE(LLVMParseIRInContext(c.llvmContext(), buffer, &*mod, &*message) == 0);
+
+	return mod;
+}
+
+uint64_t branchWeight(LLVMValueRef branch, unsigned successor) {
+	auto ctx  = LLVMGetTypeContext(LLVMTypeOf(branch));
+	auto prof = LLVMGetMetadata(branch, LLVMGetMDKindIDInContext(ctx, "prof", 4));
+	REQUIRE(prof != nullptr);
+	REQUIRE(LLVMGetMDNodeNumOperands(prof) == LLVMGetNumSuccessors(branch) + 1);
+
+	std::vector<LLVMValueRef> operands(LLVMGetMDNodeNumOperands(prof));
+	LLVMGetMDNodeOperands(prof, operands.data());
+	return LLVMConstIntGetZExtValue(operands[successor + 1]);
+}
+
+}  // anonymous namespace
+
+TEST_CASE("Profiles are collected from instrumented modules and used to optimize",
+          "[Profile]") {
+	Context c;
+	Result  res;
+
+	auto rawPath = makeTempPath(".chiprofraw");
+
+	auto instrumented = parseModule(c, programIR);
+	instrumentProfiling(*instrumented, rawPath.string());
+	REQUIRE(LLVMVerifyModule(*instrumented, LLVMReturnStatusAction, nullptr) == 0);
+
+	auto func = LLVMGetNamedFunction(*instrumented, "countOdd");
+	auto arg  = OwnedLLVMGenericValue(
+	    LLVMCreateGenericValueOfInt(LLVMInt32TypeInContext(c.llvmContext()), 10, false));
+
+	LLVMGenericValueRef ret;
+	res = interpretLLVMIR(std::move(instrumented), LLVMCodeGenLevelNone, {*arg}, func, &ret);
+	REQUIRE(res);
+	REQUIRE(LLVMGenericValueToInt(ret, false) == 5);
+	LLVMDisposeGenericValue(ret);
+
+	Profile profile;
+	res += readProfile(rawPath, &profile);
+	INFO(res);
+	REQUIRE(res);
+	fs::remove(rawPath);
+
+	REQUIRE(profile.functions.size() == 1);
+	const auto& countOdd = profile.functions[0];
+	REQUIRE(countOdd.name == "countOdd");
+	// the 5 blocks, then both successors of both conditional branches
+	REQUIRE(countOdd.counts == std::vector<uint64_t>{1, 10, 5, 10, 1, 5, 5, 1, 9});
+
+	WHEN("It's written as JSON and read back") {
+		Profile fromJson;
+		res += jsonToProfile(profileToJson(profile), &fromJson);
+		REQUIRE(res);
+
+		REQUIRE(fromJson.functions.size() == 1);
+		REQUIRE(fromJson.functions[0].cfgHash == countOdd.cfgHash);
+		REQUIRE(fromJson.functions[0].counts == countOdd.counts);
+	}
+
+	WHEN("It's merged with itself") {
+		Profile merged;
+		res += mergeProfiles(profile, &merged);
+		res += mergeProfiles(profile, &merged);
+		REQUIRE(res);
+
+		THEN("The counts add up") {
+			REQUIRE(merged.functions.size() == 1);
+			REQUIRE(merged.functions[0].counts ==
+			        std::vector<uint64_t>{2, 20, 10, 20, 2, 10, 10, 2, 18});
+		}
+	}
+
+	WHEN("It's merged with a profile of a different version of the function") {
+		auto changed                 = profile;
+		changed.functions[0].cfgHash = "0";
+
+		res += mergeProfiles(changed, &profile);
+		REQUIRE(!res);
+		REQUIRE(res.result_json[0]["errorcode"] == "E56");
+	}
+
+	WHEN("It's applied to the same module") {
+		auto mod = parseModule(c, programIR);
+		res += applyProfile(*mod, profile);
+		REQUIRE(res);
+		REQUIRE(res.result_json.empty());
+
+		auto optimized = LLVMGetNamedFunction(*mod, "countOdd");
+
+		THEN("The branches are weighted with how often they were taken") {
+			auto loop  = LLVMGetNextBasicBlock(LLVMGetEntryBasicBlock(optimized));
+			auto latch = LLVMGetNextBasicBlock(LLVMGetNextBasicBlock(loop));
+
+			REQUIRE(branchWeight(LLVMGetBasicBlockTerminator(loop), 0) == 5);
+			REQUIRE(branchWeight(LLVMGetBasicBlockTerminator(loop), 1) == 5);
+			REQUIRE(branchWeight(LLVMGetBasicBlockTerminator(latch), 0) == 1);
+			REQUIRE(branchWeight(LLVMGetBasicBlockTerminator(latch), 1) == 9);
+		}
+
+		THEN("The module has a profile summary") {
+			REQUIRE(LLVMGetModuleFlag(*mod, "ProfileSummary", 14) != nullptr);
+		}
+	}
+
+	WHEN("It's applied to a module where the function changed") {
+		auto mod = parseModule(c, R"(
+define i32 @countOdd(i32 %n) {
+  ret i32 %n
+}
+)");
+		res += applyProfile(*mod, profile);
+
+		THEN("It's skipped with a warning") {
+			REQUIRE(res);
+			REQUIRE(res.result_json.size() == 1);
+			REQUIRE(LLVMGetModuleFlag(*mod, "ProfileSummary", 14) == nullptr);
+		}
+	}
+}
+
+TEST_CASE("Files that aren't profiles aren't read as profiles", "[Profile]") {
+	auto path = makeTempPath(".chiprof");
+	{ std::ofstream{path} << R"({"functions": [{"name": "f"}]})"; }
+
+	Profile profile;
+	Result  res = readProfile(path, &profile);
+	REQUIRE(!res);
+	REQUIRE(res.result_json[0]["errorcode"] == "E55");
+
+	fs::remove(path);
+}
@@ -0,0 +1,363 @@
+#include <catch.hpp>
+
+#include <chi/CompileSession.hpp>
+#include <chi/Context.hpp>
+#include <chi/DataType.hpp>
+#include <chi/GraphFunction.hpp>
+#include <chi/GraphModule.hpp>
+#include <chi/HashedModuleCache.hpp>
+#include <chi/JitSession.hpp>
+#include <chi/LangModule.hpp>
+#include <chi/NameMangler.hpp>
+#include <chi/NodeInstance.hpp>
+#include <chi/NodeType.hpp>
+#include <chi/Owned.hpp>
+#include <chi/Support/Result.hpp>
+#include <chi/Support/TempFile.hpp>
+#include <chi/ThinLink.hpp>
+
+#include <llvm-c/Analysis.h>
+#include <llvm-c/Core.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace chi;
+namespace fs = std::filesystem;
+
+namespace {
+
+LLVMTypeRef i32Type(LLVMModuleRef mod) { return LLVMInt32TypeInContext(LLVMGetModuleContext(mod)); }
+
+LLVMValueRef declare(LLVMModuleRef mod, const char* name) {
+	auto i32 = i32Type(mod);
+	return LLVMAddFunction(mod, name, LLVMFunctionType(i32, &i32, 1, false));
+}
+
+// define name(x) as x * factor, with `adds` more instructions adding 1 first
+LLVMValueRef defineMultiply(LLVMModuleRef mod, const char* name, int factor, int adds = 0) {
+	auto func    = declare(mod, name);
+	auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(LLVMGetModuleContext(mod)));
+	LLVMPositionBuilderAtEnd(*builder, LLVMAppendBasicBlock(func, "entry"));
+
+	auto value = LLVMGetParam(func, 0);
+	for (auto add = 0; add < adds; ++add) {
+		value = LLVMBuildAdd(*builder, value, LLVMConstInt(i32Type(mod), 1, false), "");
+	}
+	LLVMBuildRet(*builder,
+	             LLVMBuildMul(*builder, value, LLVMConstInt(i32Type(mod), factor, false), ""));
+
+	return func;
+}
+
+// define name(x) as callee(x)
+LLVMValueRef defineForward(LLVMModuleRef mod, const char* name, LLVMValueRef callee) {
+	auto func    = declare(mod, name);
+	auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(LLVMGetModuleContext(mod)));
+	LLVMPositionBuilderAtEnd(*builder, LLVMAppendBasicBlock(func, "entry"));
+
+	LLVMValueRef args[] = {LLVMGetParam(func, 0)};
+	LLVMBuildRet(*builder,
+	             LLVMBuildCall2(*builder, LLVMGlobalGetValueType(callee), callee, args, 1, ""));
+
+	return func;
+}
+
+// the library: small, big, counts (which uses a local variable), callsHidden (which calls a local
+// function) and callsSmall
+OwnedLLVMModule makeLibrary(LLVMContextRef ctx) {
+	auto mod = OwnedLLVMModule(LLVMModuleCreateWithNameInContext("lib", ctx));
+
+	auto small = defineMultiply(*mod, "small", 3);
+	defineMultiply(*mod, "big", 2, 150);
+
+	auto counter = LLVMAddGlobal(*mod, i32Type(*mod), "counter");
+	LLVMSetLinkage(counter, LLVMInternalLinkage);
+	LLVMSetInitializer(counter, LLVMConstInt(i32Type(*mod), 0, false));
+	{
+		auto func    = declare(*mod, "counts");
+		auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(ctx));
+		LLVMPositionBuilderAtEnd(*builder, LLVMAppendBasicBlock(func, "entry"));
+
+		auto count = LLVMBuildLoad2(*builder, i32Type(*mod), counter, "");
+		auto sum   = LLVMBuildAdd(*builder, count, LLVMGetParam(func, 0), "");
+		LLVMBuildStore(*builder, sum, counter);
+		LLVMBuildRet(*builder, sum);
+	}
+
+	auto hidden = defineMultiply(*mod, "hidden", 5);
+	LLVMSetLinkage(hidden, LLVMInternalLinkage);
+	defineForward(*mod, "callsHidden", hidden);
+
+	defineForward(*mod, "callsSmall", small);
+
+	return mod;
+}
+
+// the program: entry() returns small(2) + big(1) + counts(0)
+OwnedLLVMModule makeProgram(LLVMContextRef ctx) {
+	auto mod = OwnedLLVMModule(LLVMModuleCreateWithNameInContext("program", ctx));
+
+	auto entry = LLVMAddFunction(*mod, "entry", LLVMFunctionType(i32Type(*mod), nullptr, 0, false));
+	auto builder = OwnedLLVMBuilder(LLVMCreateBuilderInContext(ctx));
+	LLVMPositionBuilderAtEnd(*builder, LLVMAppendBasicBlock(entry, "entry"));
+
+	LLVMValueRef sum = nullptr;
+	for (auto [name, arg] : {std::pair{"small", 2}, std::pair{"big", 1}, std::pair{"counts", 0}}) {
+		auto         callee = declare(*mod, name);
+		LLVMValueRef args[] = {LLVMConstInt(i32Type(*mod), arg, false)};
+		auto         result =
+		    LLVMBuildCall2(*builder, LLVMGlobalGetValueType(callee), callee, args, 1, "");
+
+		sum = sum == nullptr ? result : LLVMBuildAdd(*builder, sum, result, "");
+	}
+	LLVMBuildRet(*builder, sum);
+
+	return mod;
+}
+
+const FunctionSummary* findSummary(const ModuleSummary& summary, const std::string& name) {
+	for (const auto& func : summary.functions) {
+		if (func.name == name) { return &func; }
+	}
+	return nullptr;
+}
+
+// the functions that a function calls, once for each call
+std::vector<std::string> callees(LLVMValueRef func) {
+	std::vector<std::string> ret;
+	for (auto block = LLVMGetFirstBasicBlock(func); block != nullptr;
+	     block      = LLVMGetNextBasicBlock(block)) {
+		for (auto inst = LLVMGetFirstInstruction(block); inst != nullptr;
+		     inst      = LLVMGetNextInstruction(inst)) {
+			if (LLVMIsACallInst(inst) == nullptr) { continue; }
+
+			size_t len;
+			auto   name = LLVMGetValueName2(LLVMGetCalledValue(inst), &len);
+			ret.emplace_back(name, len);
+		}
+	}
+	return ret;
+}
+
+}  // namespace
+
+TEST_CASE("Module summaries record what can be imported", "[ThinLink]") {
+	auto ctx = OwnedLLVMContext(LLVMContextCreate());
+	auto lib = makeLibrary(*ctx);
+
+	auto summary = summarizeModule(*lib, "lib");
+	REQUIRE(summary.moduleName == "lib");
+	REQUIRE(summary.functions.size() == 6);
+
+	auto small = findSummary(summary, "small");
+	REQUIRE(small != nullptr);
+	REQUIRE(small->instructionCount == 2);
+	REQUIRE(small->importable);
+	REQUIRE(small->references.empty());
+
+	REQUIRE(findSummary(summary, "big")->instructionCount == 152);
+	REQUIRE(findSummary(summary, "callsSmall")->references == std::vector<std::string>{"small"});
+
+	// copies of these couldn't see the local they use
+	REQUIRE_FALSE(findSummary(summary, "counts")->importable);
+	REQUIRE_FALSE(findSummary(summary, "callsHidden")->importable);
+	REQUIRE_FALSE(findSummary(summary, "hidden")->importable);
+
+	THEN("They can be serialized to JSON and back") {
+		ModuleSummary fromJson;
+		REQUIRE(jsonToModuleSummary(moduleSummaryToJson(summary), &fromJson));
+		REQUIRE(fromJson.moduleName == "lib");
+		REQUIRE(fromJson.functions.size() == summary.functions.size());
+		REQUIRE(findSummary(fromJson, "callsSmall")->references ==
+		        std::vector<std::string>{"small"});
+		REQUIRE(findSummary(fromJson, "big")->instructionCount == 152);
+	}
+
+	THEN("Malformed JSON fails with E54") {
+		auto data                            = moduleSummaryToJson(summary);
+		data["functions"][0]["instructions"] = "many";
+
+		ModuleSummary fromJson;
+		auto          res = jsonToModuleSummary(data, &fromJson);
+		REQUIRE_FALSE(res);
+		REQUIRE(res.result_json[0]["errorcode"] == "E54");
+	}
+}
+
+TEST_CASE("Imports are decided from summaries alone", "[ThinLink]") {
+	// user calls outer, which calls inner. Both cost 10
+	ModuleSummary program{"program", {{"user", 1, true, {"outer", "missing"}}}};
+	ModuleSummary lib{"lib", {{"outer", 10, true, {"inner"}}, {"inner", 10, true, {}}}};
+
+	auto imports = computeImports({program, lib}, 14);
+	REQUIRE(imports.size() == 2);
+	REQUIRE(imports[1].empty());
+
+	// inner would cost more than 14 * 0.7
+	REQUIRE(imports[0] == std::map<size_t, std::vector<std::string>>{{1, {"outer"}}});
+
+	imports = computeImports({program, lib}, 20);
+	REQUIRE(imports[0] == std::map<size_t, std::vector<std::string>>{{1, {"outer", "inner"}}});
+
+	imports = computeImports({program, lib}, 5);
+	REQUIRE(imports[0].empty());
+
+	lib.functions[0].importable = false;
+	REQUIRE(computeImports({program, lib}, 20)[0].empty());
+}
+
+TEST_CASE("Thin linking optimizes modules with what they import", "[ThinLink]") {
+	auto ctx = OwnedLLVMContext(LLVMContextCreate());
+
+	auto link = [&](unsigned level, unsigned threads) {
+		auto workerCtx = OwnedLLVMContext(LLVMContextCreate());
+
+		std::vector<OwnedLLVMModule> modules;
+		modules.push_back(makeProgram(*workerCtx));
+		modules.push_back(makeLibrary(*workerCtx));
+
+		std::vector<ModuleSummary> summaries = {summarizeModule(*modules[0], "program"),
+		                                        summarizeModule(*modules[1], "lib")};
+
+		ThinLinkSettings settings;
+		settings.optimizationLevel = level;
+		settings.threadCount       = threads;
+
+		OwnedLLVMModule linked;
+		auto res = thinLinkModules(std::move(modules), summaries, settings, *ctx, &linked);
+		REQUIRE(res);
+		REQUIRE(*linked != nullptr);
+
+		OwnedMessage error;
+		REQUIRE_FALSE(LLVMVerifyModule(*linked, LLVMReturnStatusAction, &*error));
+
+		return linked;
+	};
+
+	for (auto threads : {1u, 2u}) {
+		auto linked = link(2, threads);
+
+		// small was imported and inlined, the others are still called
+		auto calls = callees(LLVMGetNamedFunction(*linked, "entry"));
+		std::sort(calls.begin(), calls.end());
+		REQUIRE(calls == std::vector<std::string>{"big", "counts"});
+
+		// but it's only defined once, by lib, and nothing else was copied
+		auto small = LLVMGetNamedFunction(*linked, "small");
+		REQUIRE(small != nullptr);
+		REQUIRE_FALSE(LLVMIsDeclaration(small));
+		REQUIRE(LLVMGetLinkage(small) == LLVMExternalLinkage);
+		REQUIRE(LLVMGetNamedFunction(*linked, "small.1") == nullptr);
+		REQUIRE(LLVMGetFirstGlobal(*linked) == LLVMGetLastGlobal(*linked));
+	}
+
+	// nothing is imported at -O0
+	auto linked = link(0, 2);
+	REQUIRE(callees(LLVMGetNamedFunction(*linked, "entry")).size() == 3);
+}
+
+TEST_CASE("Thin linking graph modules", "[ThinLink]") {
+	fs::path workspaceDir = makeTempPath();
+	fs::create_directories(workspaceDir);
+	{ std::ofstream stream{workspaceDir / ".chigraphworkspace"}; }
+
+	Context c{workspaceDir};
+	REQUIRE(c.loadModule("lang"));
+
+	auto i32 = c.langModule()->typeFromName("i32");
+
+	// main:run returns lib:fn(41), and fn returns its input plus one
+	auto lib = c.newGraphModule("test/lib");
+	lib->addDependency("lang");
+	auto fn = lib->getOrCreateFunction("fn", {NamedDataType{"x", i32}},
+	                                   {NamedDataType{"ret", i32}}, {""}, {""});
+	{
+		NodeInstance *entry, *one, *plus, *exit;
+		REQUIRE(fn->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+		REQUIRE(fn->insertNode("lang", "const-int", 1, 0, 0, Uuid::random(), &one));
+		REQUIRE(fn->insertNode("lang", "i32+i32", {}, 0, 0, Uuid::random(), &plus));
+
+		std::unique_ptr<NodeType> exitType;
+		REQUIRE(fn->createExitNodeType(&exitType));
+		REQUIRE(fn->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit));
+
+		REQUIRE(connectData(*entry, 0, *plus, 0));
+		REQUIRE(connectData(*one, 0, *plus, 1));
+		REQUIRE(connectData(*plus, 0, *exit, 0));
+		REQUIRE(connectExec(*entry, 0, *exit, 0));
+	}
+
+	auto mod = c.newGraphModule("test/main");
+	mod->addDependency("lang");
+	mod->addDependency("test/lib");
+	auto run = mod->getOrCreateFunction("run", {}, {NamedDataType{"ret", i32}}, {""}, {""});
+	{
+		NodeInstance *entry, *arg, *call, *exit;
+		REQUIRE(run->getOrInsertEntryNode(0, 0, Uuid::random(), &entry));
+		REQUIRE(run->insertNode("lang", "const-int", 41, 0, 0, Uuid::random(), &arg));
+		REQUIRE(run->insertNode("test/lib", "fn", {}, 0, 0, Uuid::random(), &call));
+
+		std::unique_ptr<NodeType> exitType;
+		REQUIRE(run->createExitNodeType(&exitType));
+		REQUIRE(run->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit));
+
+		REQUIRE(connectData(*arg, 0, *call, 0));
+		REQUIRE(connectData(*call, 0, *exit, 0));
+		REQUIRE(connectExec(*entry, 0, *call, 0));
+		REQUIRE(connectExec(*call, 0, *exit, 0));
+	}
+
+	c.setCompileThreadCount(2);
+
+	ThinLinkSettings settings;
+	settings.threadCount = 2;
+
+	for (auto pass : {"compiled", "cached"}) {
+		CompileSession  session{c, CompileSettings::Default};
+		OwnedLLVMModule llmod;
+		auto            res = c.compileModuleWithThinLink(*mod, session, settings, &llmod);
+		INFO(pass);
+		REQUIRE(res);
+
+		for (auto [modName, funcName] :
+		     {std::pair{"test/lib", "fn"}, std::pair{"test/main", "run"}}) {
+			auto func = LLVMGetNamedFunction(*llmod, mangleFunctionName(modName, funcName).c_str());
+			REQUIRE(func != nullptr);
+			REQUIRE_FALSE(LLVMIsDeclaration(func));
+		}
+
+		OwnedMessage error;
+		REQUIRE_FALSE(LLVMVerifyModule(*llmod, LLVMReturnStatusAction, &*error));
+
+		JitSession* jit;
+		REQUIRE(JitSession::instance(LLVMCodeGenLevelNone, &jit));
+
+		size_t moduleID;
+		REQUIRE(jit->addModule(std::move(llmod), &moduleID));
+
+		void* runAddress;
+		REQUIRE(jit->lookup(moduleID, mangleFunctionName("test/main", "run"), &runAddress));
+
+		int ret = 0;
+		reinterpret_cast<int (*)(int, int*)>(runAddress)(0, &ret);
+		REQUIRE(ret == 42);
+	}
+
+	// both modules' summaries were cached next to them
+	HashedModuleCache cache{c};
+	for (auto modName : {"test/lib", "test/main"}) {
+		std::string hash;
+		REQUIRE(cache.moduleHash(modName, &hash));
+		REQUIRE(fs::is_regular_file(cache.summaryPathForModule(modName, hash)));
+
+		ModuleSummary summary;
+		REQUIRE(cache.retrieveSummary(modName, &summary));
+		REQUIRE(summary.moduleName == modName);
+		REQUIRE_FALSE(summary.functions.empty());
+	}
+
+	fs::remove_all(workspaceDir);
+}
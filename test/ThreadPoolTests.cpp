@@ -0,0 +1,79 @@
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+// the runtime's thread pool, which is C
+extern "C" {
+void    chi_thread_pool_set_workers(int32_t count);
+int32_t chi_thread_pool_workers(void);
+void    chi_parallel_for(void (*task)(void*, int64_t, int64_t), void* context, int64_t begin,
+                         int64_t end);
+}
+
+namespace {
+
+void squareAll(void* context, int64_t begin, int64_t end) {
+	auto& squares = *static_cast<std::vector<int64_t>*>(context);
+	for (auto idx = begin; idx < end; ++idx) { squares[idx] = idx * idx; }
+}
+
+void countInner(void* context, int64_t begin, int64_t end) {
+	static_cast<std::atomic<int64_t>*>(context)->fetch_add(end - begin);
+}
+
+void runInner(void* context, int64_t begin, int64_t end) {
+	for (auto idx = begin; idx < end; ++idx) { chi_parallel_for(countInner, context, 0, 1000); }
+}
+
+void sleepFor(void* context, int64_t begin, int64_t end) {
+	std::this_thread::sleep_for(*static_cast<std::chrono::milliseconds*>(context));
+}
+
+}  // anonymous namespace
+
+TEST_CASE("The runtime thread pool runs parallel for loops", "[runtime]") {
+	// the pool only starts once, so every test that uses it asks for the same number of workers
+	chi_thread_pool_set_workers(4);
+	REQUIRE(chi_thread_pool_workers() == 4);
+
+	WHEN("A loop is run, every index is run once") {
+		std::vector<int64_t> squares(100000, -1);
+		chi_parallel_for(squareAll, &squares, 0, int64_t(squares.size()));
+
+		auto wrong = 0;
+		for (auto idx = 0ll; idx < int64_t(squares.size()); ++idx) {
+			wrong += squares[idx] != idx * idx;
+		}
+		REQUIRE(wrong == 0);
+	}
+
+	WHEN("A range is empty, the task isn't run") {
+		std::atomic<int64_t> count{0};
+		chi_parallel_for(countInner, &count, 10, 10);
+		chi_parallel_for(countInner, &count, 10, 5);
+		REQUIRE(count == 0);
+	}
+
+	WHEN("Loops are run from inside loops, they all finish") {
+		std::atomic<int64_t> count{0};
+		chi_parallel_for(runInner, &count, 0, 100);
+		REQUIRE(count == 100 * 1000);
+	}
+
+	WHEN("A loop has fewer indices than there are workers, the idle ones sleep") {
+		// the task sleeps too, so none of the threads should take much time
+		std::chrono::milliseconds duration{300};
+
+		auto cpuBefore = std::clock();
+		chi_parallel_for(sleepFor, &duration, 0, 1);
+		auto cpuTime =
+		    std::chrono::milliseconds{(std::clock() - cpuBefore) * 1000 / CLOCKS_PER_SEC};
+
+		REQUIRE(cpuTime < duration / 2);
+	}
+}
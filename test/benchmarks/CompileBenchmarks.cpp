@@ -0,0 +1,170 @@
+#include <catch.hpp>
+
+#include <chi/CompileSession.hpp>
+#include <chi/Context.hpp>
+#include <chi/DataType.hpp>
+#include <chi/GraphFunction.hpp>
+#include <chi/GraphModule.hpp>
+#include <chi/NativeCodegen.hpp>
+#include <chi/NodeInstance.hpp>
+#include <chi/NodeType.hpp>
+#include <chi/Support/Result.hpp>
+#include <chi/Support/TempFile.hpp>
+#include <chi/ThinLink.hpp>
+
+#include <llvm-c/Core.h>
+#include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace chi;
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int leafModuleCount    = 16;
+constexpr int functionsPerModule = 10;
+constexpr int callsPerFunction   = 10;
+
+// function N calls function N - 1 a few times in a row before exiting
+void addSyntheticFunction(GraphModule& mod, int id) {
+	auto func = mod.getOrCreateFunction("fn" + std::to_string(id), {}, {}, {""}, {""});
+
+	NodeInstance* last;
+	func->getOrInsertEntryNode(0, 0, Uuid::random(), &last);
+
+	if (id != 0) {
+		for (auto call = 0; call < callsPerFunction; ++call) {
+			NodeInstance* callNode;
+			func->insertNode(mod.fullNamePath(), "fn" + std::to_string(id - 1), {}, 0, 0,
+			                 Uuid::random(), &callNode);
+			connectExec(*last, 0, *callNode, 0);
+			last = callNode;
+		}
+	}
+
+	std::unique_ptr<NodeType> exitType;
+	func->createExitNodeType(&exitType);
+	NodeInstance* exit;
+	func->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit);
+	connectExec(*last, 0, *exit, 0);
+}
+
+// a root module that depends on a bunch of independent leaf modules
+GraphModule* makeWideModuleGraph(Context& c) {
+	auto root = c.newGraphModule("bench/root");
+	root->addDependency("lang");
+
+	for (auto leafID = 0; leafID < leafModuleCount; ++leafID) {
+		auto leaf = c.newGraphModule("bench/leaf" + std::to_string(leafID));
+		leaf->addDependency("lang");
+		for (auto id = 0; id < functionsPerModule; ++id) { addSyntheticFunction(*leaf, id); }
+
+		root->addDependency(leaf->fullNamePath());
+	}
+	addSyntheticFunction(*root, 0);
+
+	return root;
+}
+
+}  // namespace
+
+TEST_CASE("Compiling a wide module dependency graph", "[Context][benchmark]") {
+	fs::path workspaceDir = makeTempPath();
+	fs::create_directories(workspaceDir);
+	{ std::ofstream stream{workspaceDir / ".chigraphworkspace"}; }
+
+	Context c{workspaceDir};
+	auto    root = makeWideModuleGraph(c);
+
+	auto compileWith = [&](unsigned threadCount) {
+		c.setCompileThreadCount(threadCount);
+
+		OwnedLLVMModule llmod;
+		auto            res = c.compileModule(*root, CompileSettings::LinkDependencies, &llmod);
+		if (!res) { FAIL(res.dump()); }
+		return LLVMGetFirstFunction(*llmod) != nullptr;
+	};
+
+	BENCHMARK("Compile 16 leaf modules on one thread") { return compileWith(1); };
+	BENCHMARK("Compile 16 leaf modules on four threads") { return compileWith(4); };
+
+	fs::remove_all(workspaceDir);
+}
+
+TEST_CASE("Optimizing a wide module dependency graph", "[Context][benchmark]") {
+	fs::path workspaceDir = makeTempPath();
+	fs::create_directories(workspaceDir);
+	{ std::ofstream stream{workspaceDir / ".chigraphworkspace"}; }
+
+	Context c{workspaceDir};
+	auto    root = makeWideModuleGraph(c);
+
+	// the modules come from the cache, so this is mostly optimizing and linking
+	auto linkThenOptimize = [&] {
+		OwnedLLVMModule llmod;
+		auto            res = c.compileModule(*root, CompileSettings::Default, &llmod);
+		if (!res) { FAIL(res.dump()); }
+
+		LLVMInitializeNativeTarget();
+		auto          triple = OwnedMessage(LLVMGetDefaultTargetTriple());
+		LLVMTargetRef target;
+		LLVMGetTargetFromTriple(*triple, &target, nullptr);
+		auto targetMachine = OwnedTargetMachine(
+		    LLVMCreateTargetMachine(target, *triple, "", "", LLVMCodeGenLevelDefault,
+		                            LLVMRelocDefault, LLVMCodeModelDefault));
+		auto pbo = OwnedPassBuilderOptions(LLVMCreatePassBuilderOptions());
+		LLVMRunPasses(*llmod, "default<O2>", *targetMachine, *pbo);
+
+		return LLVMGetFirstFunction(*llmod) != nullptr;
+	};
+	auto thinLinkWith = [&](unsigned threadCount) {
+		ThinLinkSettings settings;
+		settings.threadCount = threadCount;
+
+		CompileSession  session{c, CompileSettings::Default};
+		OwnedLLVMModule llmod;
+		auto            res = c.compileModuleWithThinLink(*root, session, settings, &llmod);
+		if (!res) { FAIL(res.dump()); }
+		return LLVMGetFirstFunction(*llmod) != nullptr;
+	};
+
+	BENCHMARK("Link 16 leaf modules then optimize them together") { return linkThenOptimize(); };
+	BENCHMARK("Thin link 16 leaf modules on one thread") { return thinLinkWith(1); };
+	BENCHMARK("Thin link 16 leaf modules on four threads") { return thinLinkWith(4); };
+
+	fs::remove_all(workspaceDir);
+}
+
+TEST_CASE("Generating native code for a wide module dependency graph", "[Context][benchmark]") {
+	fs::path workspaceDir = makeTempPath();
+	fs::create_directories(workspaceDir);
+	{ std::ofstream stream{workspaceDir / ".chigraphworkspace"}; }
+
+	Context c{workspaceDir};
+	auto    root = makeWideModuleGraph(c);
+
+	// code is generated for what chi compile would output, the linked module
+	OwnedLLVMModule llmod;
+	auto            res = c.compileModule(*root, CompileSettings::Default, &llmod);
+	if (!res) { FAIL(res.dump()); }
+
+	auto emitWith = [&](unsigned threadCount) {
+		CodegenSettings settings;
+		settings.threadCount = threadCount;
+
+		std::vector<std::string> objects;
+		auto                     res = emitObjectFiles(*llmod, settings, &objects);
+		if (!res) { FAIL(res.dump()); }
+		return objects.size();
+	};
+
+	BENCHMARK("Generate code for 16 leaf modules on one thread") { return emitWith(1); };
+	BENCHMARK("Generate code for 16 leaf modules on four threads") { return emitWith(4); };
+
+	fs::remove_all(workspaceDir);
+}
@@ -0,0 +1,56 @@
+#include <catch.hpp>
+
+#include <chi/Context.hpp>
+#include <chi/GraphModule.hpp>
+#include <chi/Support/Result.hpp>
+
+#include <string>
+
+using namespace chi;
+
+namespace {
+
+constexpr int syntheticModuleCount = 10000;
+
+std::string syntheticModuleName(int id) { return "bench/synthetic/mod" + std::to_string(id); }
+
+// each module depends on the one created before it, so loading also resolves a dependency
+nlohmann::json syntheticModuleJson(int id) {
+	auto deps = nlohmann::json::array();
+	if (id != 0) { deps.push_back(syntheticModuleName(id - 1)); }
+
+	return {{"has_c_support", false},
+	        {"dependencies", deps},
+	        {"types", nlohmann::json::object()},
+	        {"graphs", nlohmann::json::array()}};
+}
+
+}  // namespace
+
+TEST_CASE("Loading and looking up many modules", "[Context][benchmark]") {
+	std::vector<nlohmann::json> jsons;
+	for (auto id = 0; id < syntheticModuleCount; ++id) { jsons.push_back(syntheticModuleJson(id)); }
+
+	BENCHMARK("Load 10k synthetic modules") {
+		Context c;
+		for (auto id = 0; id < syntheticModuleCount; ++id) {
+			auto res = c.addModuleFromJson(syntheticModuleName(id), jsons[id]);
+			if (!res) { FAIL(res.dump()); }
+		}
+		return c.modules().size();
+	};
+
+	Context c;
+	for (auto id = 0; id < syntheticModuleCount; ++id) {
+		c.addModuleFromJson(syntheticModuleName(id), jsons[id]);
+	}
+	REQUIRE(c.modules().size() == syntheticModuleCount);
+
+	BENCHMARK("Look up 10k modules by full name") {
+		auto found = 0;
+		for (auto id = 0; id < syntheticModuleCount; ++id) {
+			if (c.moduleByFullName(syntheticModuleName(id)) != nullptr) { ++found; }
+		}
+		return found;
+	};
+}
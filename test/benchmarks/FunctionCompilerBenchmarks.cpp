@@ -0,0 +1,539 @@
+#include <catch.hpp>
+
+#include <chi/Context.hpp>
+#include <chi/DataType.hpp>
+#include <chi/GraphFunction.hpp>
+#include <chi/GraphModule.hpp>
+#include <chi/JitSession.hpp>
+#include <chi/LangModule.hpp>
+#include <chi/NameMangler.hpp>
+#include <chi/NodeInstance.hpp>
+#include <chi/NodeType.hpp>
+#include <chi/Support/Result.hpp>
+
+#include <llvm-c/Core.h>
+#include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace chi;
+
+namespace {
+
+constexpr int pureDepth       = 12;
+constexpr int consumerCount   = 64;
+constexpr int expressionCount = 200;
+constexpr int callDepth       = 64;
+constexpr int stepCalls       = 64;
+
+// each pure adds the one before it to itself, and a chain of _set_ nodes all use the last one
+GraphModule* makePureFanOutModule(Context& c) {
+	auto i32 = c.langModule()->typeFromName("i32");
+
+	auto mod = c.newGraphModule("bench/pures");
+	mod->addDependency("lang");
+
+	auto func = mod->getOrCreateFunction("fanout", {}, {}, {""}, {""});
+	func->getOrCreateLocalVariable("x", i32);
+
+	NodeInstance* last;
+	func->getOrInsertEntryNode(0, 0, Uuid::random(), &last);
+
+	NodeInstance* pure;
+	func->insertNode("lang", "const-int", 1, 0, 0, Uuid::random(), &pure);
+	for (auto depth = 0; depth < pureDepth; ++depth) {
+		NodeInstance* sum;
+		func->insertNode("lang", "i32+i32", {}, 0, 0, Uuid::random(), &sum);
+		connectData(*pure, 0, *sum, 0);
+		connectData(*pure, 0, *sum, 1);
+		pure = sum;
+	}
+
+	for (auto consumer = 0; consumer < consumerCount; ++consumer) {
+		NodeInstance* set;
+		func->insertNode(mod->fullNamePath(), "_set_x", "lang:i32", 0, 0, Uuid::random(), &set);
+		connectData(*pure, 0, *set, 0);
+		connectExec(*last, 0, *set, 0);
+		last = set;
+	}
+
+	std::unique_ptr<NodeType> exitType;
+	func->createExitNodeType(&exitType);
+	NodeInstance* exit;
+	func->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit);
+	connectExec(*last, 0, *exit, 0);
+
+	return mod;
+}
+
+// x = x * 3 + 1 as pure nodes, returning the +
+NodeInstance* addTimesThreePlusOne(GraphFunction& func) {
+	NodeInstance *getX, *three, *one, *times, *plus;
+	func.insertNode(func.module().fullNamePath(), "_get_x", "lang:i32", 0, 0, Uuid::random(),
+	                &getX);
+	func.insertNode("lang", "const-int", 3, 0, 0, Uuid::random(), &three);
+	func.insertNode("lang", "const-int", 1, 0, 0, Uuid::random(), &one);
+	func.insertNode("lang", "i32*i32", {}, 0, 0, Uuid::random(), &times);
+	func.insertNode("lang", "i32+i32", {}, 0, 0, Uuid::random(), &plus);
+	connectData(*getX, 0, *times, 0);
+	connectData(*three, 0, *times, 1);
+	connectData(*times, 0, *plus, 0);
+	connectData(*one, 0, *plus, 1);
+
+	return plus;
+}
+
+// x = x * 3 + 1, over and over, then return x. With sharedPures they all use the same pure nodes,
+// otherwise they each have their own.
+GraphModule* makeLocalChainModule(Context& c, int length, bool sharedPures) {
+	auto i32 = c.langModule()->typeFromName("i32");
+
+	auto mod = c.newGraphModule("bench/chain");
+	mod->addDependency("lang");
+
+	auto func = mod->getOrCreateFunction("chain", {}, {NamedDataType{"x", i32}}, {""}, {""});
+	func->getOrCreateLocalVariable("x", i32);
+
+	NodeInstance* last;
+	func->getOrInsertEntryNode(0, 0, Uuid::random(), &last);
+
+	auto plus = addTimesThreePlusOne(*func);
+	for (auto consumer = 0; consumer < length; ++consumer) {
+		if (!sharedPures && consumer != 0) { plus = addTimesThreePlusOne(*func); }
+
+		NodeInstance* set;
+		func->insertNode(mod->fullNamePath(), "_set_x", "lang:i32", 0, 0, Uuid::random(), &set);
+		connectData(*plus, 0, *set, 0);
+		connectExec(*last, 0, *set, 0);
+		last = set;
+	}
+
+	NodeInstance* getX;
+	func->insertNode(mod->fullNamePath(), "_get_x", "lang:i32", 0, 0, Uuid::random(), &getX);
+
+	std::unique_ptr<NodeType> exitType;
+	func->createExitNodeType(&exitType);
+	NodeInstance* exit;
+	func->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit);
+	connectData(*getX, 0, *exit, 0);
+	connectExec(*last, 0, *exit, 0);
+
+	return mod;
+}
+
+// adds an exit that returns x
+NodeInstance* addReturnX(GraphFunction& func) {
+	NodeInstance* getX;
+	func.insertNode(func.module().fullNamePath(), "_get_x", "lang:i32", 0, 0, Uuid::random(),
+	                &getX);
+
+	std::unique_ptr<NodeType> exitType;
+	func.createExitNodeType(&exitType);
+	NodeInstance* exit;
+	func.insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit);
+	connectData(*getX, 0, *exit, 0);
+
+	return exit;
+}
+
+// a chain of ifs on index < index * 2 + 1, which is always true. Each sets x to the constant on
+// the true side, and on the false side sets it to x * 3 + 1 and returns it.
+GraphModule* makeConstantBranchesModule(Context& c, int length) {
+	auto i32 = c.langModule()->typeFromName("i32");
+
+	auto mod = c.newGraphModule("bench/branches");
+	mod->addDependency("lang");
+
+	auto func = mod->getOrCreateFunction("branches", {}, {NamedDataType{"x", i32}}, {""}, {""});
+	func->getOrCreateLocalVariable("x", i32);
+
+	NodeInstance* last;
+	func->getOrInsertEntryNode(0, 0, Uuid::random(), &last);
+
+	for (auto id = 0; id < length; ++id) {
+		NodeInstance *index, *two, *one, *times, *plus, *less, *branch, *setConstant, *setVaries;
+		func->insertNode("lang", "const-int", id, 0, 0, Uuid::random(), &index);
+		func->insertNode("lang", "const-int", 2, 0, 0, Uuid::random(), &two);
+		func->insertNode("lang", "const-int", 1, 0, 0, Uuid::random(), &one);
+		func->insertNode("lang", "i32*i32", {}, 0, 0, Uuid::random(), &times);
+		func->insertNode("lang", "i32+i32", {}, 0, 0, Uuid::random(), &plus);
+		func->insertNode("lang", "i32<i32", {}, 0, 0, Uuid::random(), &less);
+		func->insertNode("lang", "if", {}, 0, 0, Uuid::random(), &branch);
+		func->insertNode(mod->fullNamePath(), "_set_x", "lang:i32", 0, 0, Uuid::random(),
+		                 &setConstant);
+		func->insertNode(mod->fullNamePath(), "_set_x", "lang:i32", 0, 0, Uuid::random(),
+		                 &setVaries);
+
+		connectData(*index, 0, *times, 0);
+		connectData(*two, 0, *times, 1);
+		connectData(*times, 0, *plus, 0);
+		connectData(*one, 0, *plus, 1);
+		connectData(*index, 0, *less, 0);
+		connectData(*plus, 0, *less, 1);
+		connectData(*less, 0, *branch, 0);
+		connectData(*plus, 0, *setConstant, 0);
+		connectData(*addTimesThreePlusOne(*func), 0, *setVaries, 0);
+
+		connectExec(*last, 0, *branch, 0);
+		connectExec(*branch, 0, *setConstant, 0);
+		connectExec(*branch, 1, *setVaries, 0);
+		connectExec(*setVaries, 0, *addReturnX(*func), 0);
+		last = setConstant;
+	}
+
+	connectExec(*last, 0, *addReturnX(*func), 0);
+
+	return mod;
+}
+
+// fnN returns fnN-1(x) + 1, and fn0 returns x
+GraphModule* makeCallChainModule(Context& c, int depth) {
+	auto i32 = c.langModule()->typeFromName("i32");
+
+	auto mod = c.newGraphModule("bench/calls");
+	mod->addDependency("lang");
+
+	for (auto id = 0; id < depth; ++id) {
+		auto func = mod->getOrCreateFunction("fn" + std::to_string(id), {NamedDataType{"x", i32}},
+		                                     {NamedDataType{"ret", i32}}, {""}, {""});
+
+		NodeInstance* entry;
+		func->getOrInsertEntryNode(0, 0, Uuid::random(), &entry);
+
+		std::unique_ptr<NodeType> exitType;
+		func->createExitNodeType(&exitType);
+		NodeInstance* exit;
+		func->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit);
+
+		if (id == 0) {
+			connectData(*entry, 0, *exit, 0);
+			connectExec(*entry, 0, *exit, 0);
+			continue;
+		}
+
+		NodeInstance *call, *one, *plus;
+		func->insertNode(mod->fullNamePath(), "fn" + std::to_string(id - 1), {}, 0, 0,
+		                 Uuid::random(), &call);
+		func->insertNode("lang", "const-int", 1, 0, 0, Uuid::random(), &one);
+		func->insertNode("lang", "i32+i32", {}, 0, 0, Uuid::random(), &plus);
+
+		connectData(*entry, 0, *call, 0);
+		connectData(*call, 0, *plus, 0);
+		connectData(*one, 0, *plus, 1);
+		connectData(*plus, 0, *exit, 0);
+
+		connectExec(*entry, 0, *call, 0);
+		connectExec(*call, 0, *exit, 0);
+	}
+
+	return mod;
+}
+
+// bench/lib:step returns x * 3 + 1, and bench/main:run calls it over and over on x
+GraphModule* makeCrossModuleCallsModule(Context& c, int count) {
+	auto i32 = c.langModule()->typeFromName("i32");
+
+	auto lib = c.newGraphModule("bench/lib");
+	lib->addDependency("lang");
+	{
+		auto func = lib->getOrCreateFunction("step", {NamedDataType{"x", i32}},
+		                                     {NamedDataType{"ret", i32}}, {""}, {""});
+
+		NodeInstance *entry, *three, *one, *times, *plus;
+		func->getOrInsertEntryNode(0, 0, Uuid::random(), &entry);
+		func->insertNode("lang", "const-int", 3, 0, 0, Uuid::random(), &three);
+		func->insertNode("lang", "const-int", 1, 0, 0, Uuid::random(), &one);
+		func->insertNode("lang", "i32*i32", {}, 0, 0, Uuid::random(), &times);
+		func->insertNode("lang", "i32+i32", {}, 0, 0, Uuid::random(), &plus);
+
+		std::unique_ptr<NodeType> exitType;
+		func->createExitNodeType(&exitType);
+		NodeInstance* exit;
+		func->insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit);
+
+		connectData(*entry, 0, *times, 0);
+		connectData(*three, 0, *times, 1);
+		connectData(*times, 0, *plus, 0);
+		connectData(*one, 0, *plus, 1);
+		connectData(*plus, 0, *exit, 0);
+		connectExec(*entry, 0, *exit, 0);
+	}
+
+	auto mod = c.newGraphModule("bench/main");
+	mod->addDependency("lang");
+	mod->addDependency("bench/lib");
+
+	auto func = mod->getOrCreateFunction("run", {NamedDataType{"x", i32}},
+	                                     {NamedDataType{"ret", i32}}, {""}, {""});
+	func->getOrCreateLocalVariable("x", i32);
+
+	NodeInstance *entry, *last;
+	func->getOrInsertEntryNode(0, 0, Uuid::random(), &entry);
+	func->insertNode(mod->fullNamePath(), "_set_x", "lang:i32", 0, 0, Uuid::random(), &last);
+	connectData(*entry, 0, *last, 0);
+	connectExec(*entry, 0, *last, 0);
+
+	for (auto id = 0; id < count; ++id) {
+		NodeInstance *getX, *call, *setX;
+		func->insertNode(mod->fullNamePath(), "_get_x", "lang:i32", 0, 0, Uuid::random(), &getX);
+		func->insertNode("bench/lib", "step", {}, 0, 0, Uuid::random(), &call);
+		func->insertNode(mod->fullNamePath(), "_set_x", "lang:i32", 0, 0, Uuid::random(), &setX);
+
+		connectData(*getX, 0, *call, 0);
+		connectData(*call, 0, *setX, 0);
+		connectExec(*last, 0, *call, 0);
+		connectExec(*call, 0, *setX, 0);
+		last = setX;
+	}
+
+	connectExec(*last, 0, *addReturnX(*func), 0);
+
+	return mod;
+}
+
+OwnedTargetMachine hostMachine(LLVMCodeGenOptLevel optLevel) {
+	LLVMInitializeNativeTarget();
+	LLVMInitializeNativeAsmPrinter();
+
+	auto          triple = OwnedMessage(LLVMGetDefaultTargetTriple());
+	LLVMTargetRef target;
+	REQUIRE(LLVMGetTargetFromTriple(*triple, &target, nullptr) == 0);
+
+	return OwnedTargetMachine(LLVMCreateTargetMachine(target, *triple, "", "", optLevel,
+	                                                  LLVMRelocDefault, LLVMCodeModelJITDefault));
+}
+
+void optimize(LLVMModuleRef mod) {
+	auto machine = hostMachine(LLVMCodeGenLevelDefault);
+	auto options = OwnedPassBuilderOptions(LLVMCreatePassBuilderOptions());
+	REQUIRE(!LLVMRunPasses(mod, "default<O2>", *machine, *options));
+}
+
+// calls to functions that aren't intrinsics
+size_t callCount(LLVMModuleRef mod) {
+	size_t count = 0;
+	for (auto func = LLVMGetFirstFunction(mod); func != nullptr; func = LLVMGetNextFunction(func)) {
+		for (auto block = LLVMGetFirstBasicBlock(func); block != nullptr;
+		     block      = LLVMGetNextBasicBlock(block)) {
+			for (auto inst = LLVMGetFirstInstruction(block); inst != nullptr;
+			     inst      = LLVMGetNextInstruction(inst)) {
+				if (LLVMIsACallInst(inst) != nullptr && LLVMIsAIntrinsicInst(inst) == nullptr) {
+					++count;
+				}
+			}
+		}
+	}
+	return count;
+}
+
+// not counting debug info
+size_t instructionCount(LLVMModuleRef mod) {
+	size_t count = 0;
+	for (auto func = LLVMGetFirstFunction(mod); func != nullptr; func = LLVMGetNextFunction(func)) {
+		for (auto block = LLVMGetFirstBasicBlock(func); block != nullptr;
+		     block      = LLVMGetNextBasicBlock(block)) {
+			for (auto inst = LLVMGetFirstInstruction(block); inst != nullptr;
+			     inst      = LLVMGetNextInstruction(inst)) {
+				if (LLVMIsADbgInfoIntrinsic(inst) == nullptr) { ++count; }
+			}
+		}
+	}
+	return count;
+}
+
+}  // namespace
+
+TEST_CASE("Compiling a function with heavy pure fan-out", "[FunctionCompiler][benchmark]") {
+	Context c;
+	REQUIRE(c.loadModule("lang"));
+
+	auto mod = makePureFanOutModule(c);
+
+	auto compile = [&] {
+		OwnedLLVMModule llmod;
+		auto            res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+		if (!res) { FAIL(res.dump()); }
+		return llmod;
+	};
+
+	WARN("Instructions: " << instructionCount(*compile()));
+
+	BENCHMARK("Compile 64 consumers of a pure chain 12 deep") { return compile(); };
+}
+
+TEST_CASE("Running a function that reevaluates its pures", "[FunctionCompiler][benchmark]") {
+	Context c;
+	REQUIRE(c.loadModule("lang"));
+
+	auto mod = makeLocalChainModule(c, consumerCount, true);
+
+	OwnedLLVMModule llmod;
+	auto            res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+	if (!res) { FAIL(res.dump()); }
+
+	optimize(*llmod);
+	WARN("Instructions after -O2: " << instructionCount(*llmod));
+
+	JitSession* session;
+	REQUIRE(JitSession::instance(LLVMCodeGenLevelDefault, &session));
+
+	size_t moduleID;
+	REQUIRE(session->addModule(std::move(llmod), &moduleID));
+
+	void* address;
+	REQUIRE(session->lookup(moduleID, mangleFunctionName("bench/chain", "chain"), &address));
+	auto chain = reinterpret_cast<int (*)(int, int*)>(address);
+
+	BENCHMARK("Run 64 reevaluations of a pure chain 10000 times") {
+		int sum = 0;
+		for (auto run = 0; run < 10000; ++run) {
+			int x;
+			chain(0, &x);
+			sum += x;
+		}
+		return sum;
+	};
+}
+
+TEST_CASE("Compiling a function with many pure expressions at -O0",
+          "[FunctionCompiler][benchmark]") {
+	Context c;
+	REQUIRE(c.loadModule("lang"));
+
+	auto mod     = makeLocalChainModule(c, expressionCount, false);
+	auto machine = hostMachine(LLVMCodeGenLevelNone);
+
+	auto compile = [&] {
+		OwnedLLVMModule llmod;
+		auto            res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+		if (!res) { FAIL(res.dump()); }
+		return llmod;
+	};
+
+	WARN("Instructions: " << instructionCount(*compile()));
+
+	BENCHMARK("Generate IR for 200 pure expressions") { return compile(); };
+	BENCHMARK("Generate IR and code for 200 pure expressions") {
+		auto llmod = compile();
+
+		LLVMMemoryBufferRef object;
+		REQUIRE(!LLVMTargetMachineEmitToMemoryBuffer(*machine, *llmod, LLVMObjectFile, nullptr,
+		                                             &object));
+		LLVMDisposeMemoryBuffer(object);
+	};
+}
+
+TEST_CASE("Compiling a function with constant conditions at -O0",
+          "[FunctionCompiler][benchmark]") {
+	Context c;
+	REQUIRE(c.loadModule("lang"));
+
+	auto mod     = makeConstantBranchesModule(c, expressionCount);
+	auto machine = hostMachine(LLVMCodeGenLevelNone);
+
+	auto compile = [&] {
+		OwnedLLVMModule llmod;
+		auto            res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+		if (!res) { FAIL(res.dump()); }
+		return llmod;
+	};
+
+	WARN("Instructions: " << instructionCount(*compile()));
+
+	BENCHMARK("Generate IR for 200 constant ifs") { return compile(); };
+	BENCHMARK("Generate IR and code for 200 constant ifs") {
+		auto llmod = compile();
+
+		LLVMMemoryBufferRef object;
+		REQUIRE(!LLVMTargetMachineEmitToMemoryBuffer(*machine, *llmod, LLVMObjectFile, nullptr,
+		                                             &object));
+		LLVMDisposeMemoryBuffer(object);
+	};
+}
+
+TEST_CASE("Running a deep chain of graph function calls", "[FunctionCompiler][benchmark]") {
+	Context c;
+	REQUIRE(c.loadModule("lang"));
+
+	auto mod = makeCallChainModule(c, callDepth);
+
+	OwnedLLVMModule llmod;
+	auto            res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+	if (!res) { FAIL(res.dump()); }
+
+	WARN("Instructions: " << instructionCount(*llmod));
+
+	// unoptimized, so the calls and what's around them are left the way they were generated
+	JitSession* session;
+	REQUIRE(JitSession::instance(LLVMCodeGenLevelNone, &session));
+
+	size_t moduleID;
+	REQUIRE(session->addModule(std::move(llmod), &moduleID));
+
+	void* address;
+	REQUIRE(session->lookup(moduleID,
+	                        mangleFunctionName("bench/calls", "fn" + std::to_string(callDepth - 1)),
+	                        &address));
+	auto top = reinterpret_cast<int (*)(int, int, int*)>(address);
+
+	int check = 0;
+	top(0, 0, &check);
+	REQUIRE(check == callDepth - 1);
+
+	BENCHMARK("Run a chain of 64 calls 10000 times") {
+		int sum = 0;
+		for (auto run = 0; run < 10000; ++run) {
+			int ret;
+			top(0, run, &ret);
+			sum += ret;
+		}
+		return sum;
+	};
+}
+
+TEST_CASE("Running calls to a small function in another module", "[FunctionCompiler][benchmark]") {
+	Context c;
+	REQUIRE(c.loadModule("lang"));
+
+	auto mod = makeCrossModuleCallsModule(c, stepCalls);
+
+	// compiled by itself, like it would be without linking everything and optimizing it together
+	{
+		OwnedLLVMModule llmod;
+		auto            res = c.compileModule(*mod, CompileSettings::UseCache, &llmod);
+		if (!res) { FAIL(res.dump()); }
+
+		optimize(*llmod);
+		WARN("Calls left after -O2 without linking: " << callCount(*llmod));
+	}
+
+	OwnedLLVMModule llmod;
+	auto            res = c.compileModule(*mod, CompileSettings::Default, &llmod);
+	if (!res) { FAIL(res.dump()); }
+
+	WARN("Instructions: " << instructionCount(*llmod));
+
+	JitSession* session;
+	REQUIRE(JitSession::instance(LLVMCodeGenLevelNone, &session));
+
+	size_t moduleID;
+	REQUIRE(session->addModule(std::move(llmod), &moduleID));
+
+	void* address;
+	REQUIRE(session->lookup(moduleID, mangleFunctionName("bench/main", "run"), &address));
+	auto run = reinterpret_cast<int (*)(int, int, int*)>(address);
+
+	BENCHMARK("Run 64 calls to a function in another module 10000 times") {
+		int sum = 0;
+		for (auto iter = 0; iter < 10000; ++iter) {
+			int ret;
+			run(0, iter, &ret);
+			sum += ret;
+		}
+		return sum;
+	};
+}
@@ -0,0 +1,74 @@
+#include <catch.hpp>
+
+#include <chi/Context.hpp>
+#include <chi/Owned.hpp>
+#include <chi/Support/Result.hpp>
+
+#include <llvm-c/Core.h>
+#include <llvm-c/ExecutionEngine.h>
+#include <llvm-c/IRReader.h>
+#include <llvm-c/Target.h>
+
+#include <string>
+
+using namespace chi;
+
+namespace {
+
+constexpr int functionCount = 2000;
+
+// fnN does a bit of arithmetic and calls fnN-1, and main only calls fn0
+std::string makeProgram() {
+	std::string ir = "define i32 @fn0(i32 %x) {\n  ret i32 %x\n}\n";
+	for (auto id = 1; id < functionCount; ++id) {
+		ir += "define i32 @fn" + std::to_string(id) + "(i32 %x) {\n";
+		ir += "  %a = mul i32 %x, 3\n  %b = add i32 %a, 7\n  %c = xor i32 %b, %x\n";
+		ir += "  %d = call i32 @fn" + std::to_string(id - 1) + "(i32 %c)\n";
+		ir += "  ret i32 %d\n}\n";
+	}
+	ir += "define i32 @main() {\n  %r = call i32 @fn0(i32 1)\n  ret i32 %r\n}\n";
+
+	return ir;
+}
+
+OwnedLLVMModule parseProgram(Context& c, const std::string& ir) {
+	auto buffer = LLVMCreateMemoryBufferWithMemoryRangeCopy(ir.c_str(), ir.size(), "program");
+
+	OwnedLLVMModule mod;
+	OwnedMessage    message;
+	if (LLVMParseIRInContext(c.llvmContext(), buffer, &*mod, &*message)) { FAIL(*message); }
+
+	return mod;
+}
+
+}  // namespace
+
+TEST_CASE("Running a small part of a big program", "[JitSession][benchmark]") {
+	Context c;
+	auto    ir = makeProgram();
+
+	BENCHMARK("Run main from a 2000 function module with the JitSession") {
+		int  ret;
+		auto res = interpretLLVMIRAsMain(parseProgram(c, ir), LLVMCodeGenLevelDefault, {},
+		                                 nullptr, &ret);
+		if (!res) { FAIL(res.dump()); }
+		return ret;
+	};
+
+	// what interpretLLVMIRAsMain used to do, for comparison
+	LLVMLinkInMCJIT();
+	LLVMInitializeNativeTarget();
+	LLVMInitializeNativeAsmPrinter();
+	BENCHMARK("Run main from a 2000 function module with a new MCJIT") {
+		auto mod  = parseProgram(c, ir);
+		auto main = LLVMGetNamedFunction(*mod, "main");
+
+		OwnedLLVMExecutionEngine engine;
+		OwnedMessage             message;
+		if (LLVMCreateJITCompilerForModule(&*engine, mod.take_ownership(), LLVMCodeGenLevelDefault,
+		                                   &*message)) {
+			FAIL(*message);
+		}
+		return LLVMRunFunctionAsMain(*engine, main, 0, nullptr, nullptr);
+	};
+}
@@ -0,0 +1,110 @@
+#include <catch.hpp>
+
+#include <chi/Context.hpp>
+#include <chi/DataType.hpp>
+#include <chi/DefaultModuleCache.hpp>
+#include <chi/GraphFunction.hpp>
+#include <chi/GraphModule.hpp>
+#include <chi/NodeInstance.hpp>
+#include <chi/NodeType.hpp>
+#include <chi/Support/Result.hpp>
+#include <chi/Support/TempFile.hpp>
+
+#include <llvm-c/Core.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+using namespace chi;
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr int libraryFunctionCount = 500;
+constexpr int callsPerFunction     = 10;
+
+void connectEntryToExit(GraphFunction& func, const std::vector<NodeInstance*>& between) {
+	NodeInstance* last;
+	func.getOrInsertEntryNode(0, 0, Uuid::random(), &last);
+
+	for (auto node : between) {
+		connectExec(*last, 0, *node, 0);
+		last = node;
+	}
+
+	std::unique_ptr<NodeType> exitType;
+	func.createExitNodeType(&exitType);
+	NodeInstance* exit;
+	func.insertNode(std::move(exitType), 0, 0, Uuid::random(), &exit);
+	connectExec(*last, 0, *exit, 0);
+}
+
+// a big library where function N calls function N - 1, and a main module that only calls the first
+// couple of them
+GraphModule* makeLibraryAndRoot(Context& c) {
+	auto lib = c.newGraphModule("bench/biglib");
+	lib->addDependency("lang");
+
+	for (auto id = 0; id < libraryFunctionCount; ++id) {
+		auto func = lib->getOrCreateFunction("fn" + std::to_string(id), {}, {}, {""}, {""});
+
+		std::vector<NodeInstance*> calls;
+		for (auto call = 0; id != 0 && call < callsPerFunction; ++call) {
+			NodeInstance* callNode;
+			func->insertNode(lib->fullNamePath(), "fn" + std::to_string(id - 1), {}, 0, 0,
+			                 Uuid::random(), &callNode);
+			calls.push_back(callNode);
+		}
+		connectEntryToExit(*func, calls);
+	}
+
+	auto root = c.newGraphModule("bench/root");
+	root->addDependency("lang");
+	root->addDependency(lib->fullNamePath());
+
+	auto          func = root->getOrCreateFunction("fn", {}, {}, {""}, {""});
+	NodeInstance* callNode;
+	func->insertNode(lib->fullNamePath(), "fn1", {}, 0, 0, Uuid::random(), &callNode);
+	connectEntryToExit(*func, {callNode});
+
+	return root;
+}
+
+void benchmarkLinking(Flags<CompileSettings> settings) {
+	fs::path workspaceDir = makeTempPath();
+	fs::create_directories(workspaceDir);
+	{ std::ofstream stream{workspaceDir / ".chigraphworkspace"}; }
+
+	// the timestamp cache, so hashing modules doesn't drown out loading them
+	Context c{workspaceDir};
+	c.setModuleCache(std::make_unique<DefaultModuleCache>(c));
+	auto root = makeLibraryAndRoot(c);
+
+	// fill the cache
+	OwnedLLVMModule llmod;
+	auto            res = c.compileModule(*root, CompileSettings::Default, &llmod);
+	if (!res) { FAIL(res.dump()); }
+
+	BENCHMARK("Compile a small module against a cached 500 function library") {
+		auto res = c.compileModule(*root, settings, &llmod);
+		if (!res) { FAIL(res.dump()); }
+		return LLVMGetFirstFunction(*llmod) != nullptr;
+	};
+
+	fs::remove_all(workspaceDir);
+}
+
+}  // namespace
+
+// these are separate test cases so they can each be ran in their own process to compare peak memory
+
+TEST_CASE("Linking cached dependencies eagerly", "[Context][benchmark]") {
+	benchmarkLinking(CompileSettings::Default);
+}
+
+TEST_CASE("Linking cached dependencies lazily", "[Context][benchmark]") {
+	benchmarkLinking(Flags<CompileSettings>{CompileSettings::Default} |
+	                 CompileSettings::LazyLoadCache);
+}
@@ -300,11 +300,11 @@ int main(int argc, char** argv) {
 		std::cout << "Suceeded." << std::endl;
 	}
 
-	std::cout << "Testing with chi run...";
-	std::cout.flush();
+	// the second time, the native code comes from the object cache
+	for (auto pass : {"chi run", "chi run with cached code"}) {
+		std::cout << "Testing with " << pass << "...";
+		std::cout.flush();
 
-	// chi run
-	{
 		std::string generatedstdout, generatedstderr;
 		{
 			Subprocess chiexe{chiExePath};
@@ -325,8 +325,8 @@ int main(int argc, char** argv) {
 			int retcode = chiexe.exitCode();
 
 			if (retcode != expectedreturncode) {
-				std::cerr << "(chi run) Unexpected retcode: " << retcode << " expected was "
-				          << expectedreturncode << std::endl
+				std::cerr << "(" << pass << ") Unexpected retcode: " << retcode
+				          << " expected was " << expectedreturncode << std::endl
 				          << "stdout: \"" << generatedstdout << "\"" << std::endl
 				          << "stderr: \"" << generatedstderr << "\"" << std::endl;
 
@@ -334,7 +334,7 @@ int main(int argc, char** argv) {
 			}
 
 			if (generatedstdout != expectedcout) {
-				std::cerr << "(chi run) Unexpected stdout: \"" << generatedstdout
+				std::cerr << "(" << pass << ") Unexpected stdout: \"" << generatedstdout
 				          << "\" expected was \"" << expectedcout << '\"' << std::endl
 				          << "retcode: \"" << retcode << "\"" << std::endl
 				          << "stderr: \"" << generatedstderr << "\"" << std::endl;
@@ -343,7 +343,7 @@ int main(int argc, char** argv) {
 			}
 
 			if (generatedstderr != expectedcerr) {
-				std::cerr << "(chi run) Unexpected stderr: \"" << generatedstderr
+				std::cerr << "(" << pass << ") Unexpected stderr: \"" << generatedstderr
 				          << "\" expected was \"" << expectedcerr << '\"' << std::endl
 				          << "retcode: \"" << retcode << "\"" << std::endl
 				          << "stdout: \"" << generatedstdout << "\"" << std::endl;